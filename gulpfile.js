@@ -1,6 +1,7 @@
 const gulp = require("gulp");
 const uglify = require("gulp-uglify");
 const cssnano = require("gulp-cssnano");
+const gzip = require("gulp-gzip");
 const through = require("through2");
 const path = require("path");
 const fs = require("fs");
@@ -17,8 +18,66 @@ function dumpFileSize() {
   });
 }
 
+/** This function replaces region of given field in new_http.c with output */
+function writeRegion(file, field_name, output, cb) {
+  const target_path = path.join(path.dirname(file.path), destination);
+  //console.log(`Updated ${target_path}`);
+
+  const rl = readline.createInterface({
+    input: fs.createReadStream(target_path),
+    crlfDelay: Infinity,
+  });
+
+  const merged_contents = [];
+  const marker_start = `// region_start ${field_name}`;
+  const marker_end = `// region_end ${field_name}`;
+  let region_state = 0;
+
+  rl.on("line", (line) => {
+    if (line.trim() === marker_start) {
+      region_state = 1;
+      merged_contents.push(marker_start);
+      merged_contents.push(output);
+      merged_contents.push(marker_end);
+    } else {
+      //Skip all existing content lines till region ends
+      if (region_state === 1) {
+        if (line.trim() === marker_end) {
+          region_state = 2;
+        }
+      } else {
+        merged_contents.push(line);
+      }
+    }
+  });
+
+  rl.on("close", () => {
+    if (region_state === 0) {
+      //Starting marker was not found, append
+
+      merged_contents.push("");
+      merged_contents.push(marker_start);
+      merged_contents.push(output);
+      merged_contents.push(marker_end);
+    }
+
+    if (region_state === 1) {
+      cb(`Ending marker "${marker_end}" was not found.`, file);
+    } else {
+      fs.writeFile(
+        target_path,
+        merged_contents.join("\r\n"),
+        "utf8",
+        (err) => {
+          cb(err, file);
+        }
+      );
+    }
+  });
+}
+
 /** This function injects C for a const field in new_http.c */
-function generateCode(field_name, is_script) {
+function generateCode(field_name, is_script, is_static) {
   return through.obj(function (file, enc, cb) {
     if (file.isBuffer()) {
       const contents = file.contents;
@@ -29,65 +88,40 @@ function generateCode(field_name, is_script) {
         `Processing ${file.basename}, reduced length ${contents.length}`
       );
 
-      const prefix = is_script ? "<script type='text/javascript'>" : "<style>";
-      const suffix = is_script ? "</script>" : "</style>";
+      // static files are served as obk.js/obk.css, without the tags
+      let prefix = is_script ? "<script type='text/javascript'>" : "<style>";
+      let suffix = is_script ? "</script>" : "</style>";
+      if (is_static) {
+        prefix = "";
+        suffix = "";
+      }
       output = `const char ${field_name}[] = "${prefix}${output}${suffix}";`;
 
-      const target_path = path.join(path.dirname(file.path), destination);
-      //console.log(`Updated ${target_path}`);
-
-      const rl = readline.createInterface({
-        input: fs.createReadStream(target_path),
-        crlfDelay: Infinity,
-      });
-
-      const merged_contents = [];
-      const marker_start = `//region_start ${field_name}`;
-      const marker_end = `//region_end ${field_name}`;
-      let region_state = 0;
-
-      rl.on("line", (line) => {
-        if (line.trim() === marker_start) {
-          region_state = 1;
-          merged_contents.push(marker_start);
-          merged_contents.push(output);
-          merged_contents.push(marker_end);
-        } else {
-          //Skip all existing content lines till region ends
-          if (region_state === 1) {
-            if (line.trim() === marker_end) {
-              region_state = 2;
-            }
-          } else {
-            merged_contents.push(line);
-          }
-        }
-      });
+      writeRegion(file, field_name, output, cb);
+      return;
+    }
 
-      rl.on("close", () => {
-        if (region_state === 0) {
-          //Starting marker was not found, append
+    cb(null, file);
+  });
+}
 
-          merged_contents.push("");
-          merged_contents.push(marker_start);
-          merged_contents.push(output);
-          merged_contents.push(marker_end);
-        }
+/** This function injects gzipped content as a byte array into new_http.c */
+function generateGzCode(field_name) {
+  return through.obj(function (file, enc, cb) {
+    if (file.isBuffer()) {
+      const contents = file.contents;
+      const lines = [];
 
-        if (region_state === 1) {
-          cb(`Ending marker "${marker_end}" was not found.`, file);
-        } else {
-          fs.writeFile(
-            target_path,
-            merged_contents.join("\r\n"),
-            "utf8",
-            (err) => {
-              cb(err, file);
-            }
-          );
-        }
-      });
+      console.log(
+        `Processing ${file.basename}, gzipped length ${contents.length}`
+      );
+      for (let i = 0; i < contents.length; i += 32) {
+        const bytes = Array.from(contents.subarray(i, i + 32));
+        lines.push(bytes.map((b) => "0x" + b.toString(16).padStart(2, "0")).join(","));
+      }
+      const output = `const unsigned char ${field_name}[] = {\r\n${lines.join(",\r\n")}\r\n};`;
 
+      writeRegion(file, field_name, output, cb);
       return;
     }
 
@@ -100,7 +134,15 @@ function minifyJs() {
     .src("./src/httpserver/script.js")
     .pipe(dumpFileSize())
     .pipe(uglify())
-    .pipe(generateCode("pageScript", true));
+    .pipe(generateCode("pageScript", true, true));
+}
+
+function minifyJsGz() {
+  return gulp
+    .src("./src/httpserver/script.js")
+    .pipe(uglify())
+    .pipe(gzip({ gzipOptions: { level: 9 } }))
+    .pipe(generateGzCode("pageScriptGz"));
 }
 
 function minifyHassDiscoveryJs() {
@@ -116,7 +158,15 @@ function minifyCss() {
     .src("./src/httpserver/style.css")
     .pipe(dumpFileSize())
     .pipe(cssnano())
-    .pipe(generateCode("htmlHeadStyle", false));
+    .pipe(generateCode("htmlHeadStyle", false, true));
+}
+
+function minifyCssGz() {
+  return gulp
+    .src("./src/httpserver/style.css")
+    .pipe(cssnano())
+    .pipe(gzip({ gzipOptions: { level: 9 } }))
+    .pipe(generateGzCode("htmlHeadStyleGz"));
 }
 
-exports.default = gulp.series(minifyJs, minifyHassDiscoveryJs, minifyCss);
+exports.default = gulp.series(minifyJs, minifyJsGz, minifyHassDiscoveryJs, minifyCss, minifyCssGz);
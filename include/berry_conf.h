@@ -236,23 +236,32 @@
 #endif
  // BK7231/RTL wraps malloc, free etc. to freertos ports. Some platforms don't do it.
 #if PLATFORM_W800 || PLATFORM_W600 || PLATFORM_LN882H
-#define BE_EXPLICIT_MALLOC pvPortMalloc
-#define BE_EXPLICIT_REALLOC pvPortRealloc
-#define BE_EXPLICIT_FREE vPortFree
+#define BE_SYS_MALLOC pvPortMalloc
+#define BE_SYS_REALLOC pvPortRealloc
+#define BE_SYS_FREE vPortFree
 #elif PLATFORM_TR6260 || PLATFORM_ECR6600
-#define BE_EXPLICIT_MALLOC os_malloc
-#define BE_EXPLICIT_FREE os_free
-#define BE_EXPLICIT_REALLOC os_realloc
+#define BE_SYS_MALLOC os_malloc
+#define BE_SYS_FREE os_free
+#define BE_SYS_REALLOC os_realloc
 #else
-#define BE_EXPLICIT_MALLOC malloc
-#define BE_EXPLICIT_FREE free
-#define BE_EXPLICIT_REALLOC realloc
+#define BE_SYS_MALLOC malloc
+#define BE_SYS_FREE free
+#define BE_SYS_REALLOC realloc
 #endif
 // normal realloc appears broken on OpenBK7231T: #1563, #298
 #if PLATFORM_BEKEN
-#undef BE_EXPLICIT_REALLOC
-#define BE_EXPLICIT_REALLOC os_realloc
+#undef BE_SYS_REALLOC
+#define BE_SYS_REALLOC os_realloc
 #endif
+/* Small Berry objects come from a size-classed pool (see be_port.c),
+ * bigger ones from the allocator above. */
+#include <stddef.h>
+void *berryPool_Malloc(size_t size);
+void *berryPool_Realloc(void *ptr, size_t size);
+void berryPool_Free(void *ptr);
+#define BE_EXPLICIT_MALLOC berryPool_Malloc
+#define BE_EXPLICIT_REALLOC berryPool_Realloc
+#define BE_EXPLICIT_FREE berryPool_Free
 
 /* Macro: be_assert
  * Berry debug assertion. Only enabled when BE_DEBUG is active.
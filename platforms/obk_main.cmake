@@ -36,6 +36,7 @@ set(OBKM_SRC
 	${OBK_SRCS}hal/generic/hal_uart_generic.c
 	${OBK_SRCS}httpserver/hass.c
 	${OBK_SRCS}httpserver/http_basic_auth.c
+	${OBK_SRCS}httpserver/http_events.c
 	${OBK_SRCS}httpserver/http_fns.c
 	${OBK_SRCS}httpserver/http_tcp_server.c
 	${OBK_SRCS}httpserver/new_tcp_server.c
@@ -65,6 +66,7 @@ set(OBKM_SRC
 	${OBK_SRCS}driver/drv_battery.c
 	${OBK_SRCS}driver/drv_bl0937.c
 	${OBK_SRCS}driver/drv_bl0942.c
+	${OBK_SRCS}driver/drv_bl_samples.c
 	${OBK_SRCS}driver/drv_bl_shared.c
 	${OBK_SRCS}driver/drv_bmp280.c
 	${OBK_SRCS}driver/drv_bmpi2c.c
@@ -51,6 +51,7 @@ OBKM_SRC  += $(OBK_SRCS)hal/generic/hal_wifi_generic.c
 OBKM_SRC  += $(OBK_SRCS)hal/generic/hal_uart_generic.c
 OBKM_SRC  += $(OBK_SRCS)httpserver/hass.c
 OBKM_SRC  += $(OBK_SRCS)httpserver/http_basic_auth.c
+OBKM_SRC  += $(OBK_SRCS)httpserver/http_events.c
 OBKM_SRC  += $(OBK_SRCS)httpserver/http_fns.c
 OBKM_SRC  += $(OBK_SRCS)httpserver/http_tcp_server.c
 OBKM_SRC  += $(OBK_SRCS)httpserver/new_tcp_server.c
@@ -82,6 +83,7 @@ OBKM_SRC  += $(OBK_SRCS)driver/drv_aht2x.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_battery.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_bl0937.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_bl0942.c
+OBKM_SRC  += $(OBK_SRCS)driver/drv_bl_samples.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_bl_shared.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_bmp280.c
 OBKM_SRC  += $(OBK_SRCS)driver/drv_bmpi2c.c
@@ -14,6 +14,7 @@
 
 #include "../littlefs/our_lfs.h"
 #include "../logging/logging.h"
+#include "be_run.h"
 
 /* this file contains configuration for the file system. */
 
@@ -176,3 +177,286 @@ size_t be_fsize(void *hfile) {
 }
 
 #endif // ENABLE_LITTLEFS
+
+/* memory allocation for the VM */
+
+// Strings, closures, upvalues and small lists are mostly below 128 bytes,
+// so they are served from fixed size slots in pages of one arena, allocated
+// once. That keeps Berry garbage from fragmenting the heap lwIP uses.
+// Bigger blocks, or all blocks when arena is full, go to the system heap.
+#ifndef BERRY_POOL_PAGES
+#define BERRY_POOL_PAGES 64
+#endif
+#define BERRY_POOL_PAGE_SIZE 256
+#define BERRY_POOL_CLASSES 8
+#define BERRY_POOL_NONE 0xFF
+
+static const unsigned short g_poolClassSizes[BERRY_POOL_CLASSES] = { 8, 16, 24, 32, 48, 64, 96, 128 };
+
+typedef struct berryPoolPage_s {
+	// BERRY_POOL_NONE if page is empty
+	unsigned char sizeClass;
+	unsigned char used;
+	// first freed slot, next free slot index is in its first byte
+	unsigned char freeHead;
+	// slots from that index on were never used
+	unsigned char nextUnused;
+} berryPoolPage_t;
+
+// keeps heap blocks aligned like malloc does
+typedef union berryHeapHeader_u {
+	size_t size;
+	double align;
+} berryHeapHeader_t;
+
+static unsigned char *g_poolBase = 0;
+static berryPoolPage_t g_poolPages[BERRY_POOL_PAGES];
+static unsigned char g_poolHint[BERRY_POOL_CLASSES];
+static int g_poolUsedBytes = 0;
+static int g_poolHeapBytes = 0;
+static int g_poolPeakBytes = 0;
+static int g_poolLimit = 0;
+static int g_poolFailed = 0;
+
+static int berryPool_GetClass(size_t size) {
+	int i;
+
+	for (i = 0; i < BERRY_POOL_CLASSES; i++) {
+		if (size <= g_poolClassSizes[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool berryPool_Owns(void *ptr) {
+	unsigned char *p = (unsigned char*)ptr;
+
+	return g_poolBase && p >= g_poolBase && p < g_poolBase + BERRY_POOL_PAGES * BERRY_POOL_PAGE_SIZE;
+}
+
+static bool berryPool_CanGrow(int delta) {
+	if (g_poolLimit > 0 && delta > 0 && g_poolUsedBytes + g_poolHeapBytes + delta > g_poolLimit) {
+		// Berry will collect garbage and try again, then throw memory_error
+		g_poolFailed++;
+		return false;
+	}
+	return true;
+}
+
+static void berryPool_UpdatePeak() {
+	if (g_poolUsedBytes + g_poolHeapBytes > g_poolPeakBytes) {
+		g_poolPeakBytes = g_poolUsedBytes + g_poolHeapBytes;
+	}
+}
+
+static bool berryPool_HasSpace(berryPoolPage_t *pg, int c) {
+	return pg->sizeClass == c && (pg->freeHead != BERRY_POOL_NONE
+		|| pg->nextUnused < BERRY_POOL_PAGE_SIZE / g_poolClassSizes[c]);
+}
+
+static void *berryPool_AllocSlot(int c) {
+	berryPoolPage_t *pg;
+	unsigned char *slot;
+	int i, page;
+
+	if (g_poolBase == 0) {
+		g_poolBase = (unsigned char*)BE_SYS_MALLOC(BERRY_POOL_PAGES * BERRY_POOL_PAGE_SIZE);
+		if (g_poolBase == 0) {
+			return 0;
+		}
+		for (i = 0; i < BERRY_POOL_PAGES; i++) {
+			g_poolPages[i].sizeClass = BERRY_POOL_NONE;
+		}
+		memset(g_poolHint, 0, sizeof(g_poolHint));
+	}
+	page = -1;
+	if (berryPool_HasSpace(&g_poolPages[g_poolHint[c]], c)) {
+		page = g_poolHint[c];
+	}
+	else {
+		for (i = 0; i < BERRY_POOL_PAGES; i++) {
+			if (berryPool_HasSpace(&g_poolPages[i], c)) {
+				page = i;
+				break;
+			}
+			if (page == -1 && g_poolPages[i].sizeClass == BERRY_POOL_NONE) {
+				// remember first empty page, but prefer partially used ones
+				page = -2 - i;
+			}
+		}
+		if (page == -1) {
+			return 0;
+		}
+		if (page < -1) {
+			page = -2 - page;
+			pg = &g_poolPages[page];
+			pg->sizeClass = c;
+			pg->used = 0;
+			pg->freeHead = BERRY_POOL_NONE;
+			pg->nextUnused = 0;
+		}
+		g_poolHint[c] = page;
+	}
+	pg = &g_poolPages[page];
+	if (pg->freeHead != BERRY_POOL_NONE) {
+		slot = g_poolBase + page * BERRY_POOL_PAGE_SIZE + pg->freeHead * g_poolClassSizes[c];
+		pg->freeHead = slot[0];
+	}
+	else {
+		slot = g_poolBase + page * BERRY_POOL_PAGE_SIZE + pg->nextUnused * g_poolClassSizes[c];
+		pg->nextUnused++;
+	}
+	pg->used++;
+	g_poolUsedBytes += g_poolClassSizes[c];
+	return slot;
+}
+
+static void berryPool_FreeSlot(void *ptr) {
+	berryPoolPage_t *pg;
+	unsigned char *p = (unsigned char*)ptr;
+	int page, ofs, c;
+
+	ofs = p - g_poolBase;
+	page = ofs / BERRY_POOL_PAGE_SIZE;
+	pg = &g_poolPages[page];
+	c = pg->sizeClass;
+	p[0] = pg->freeHead;
+	pg->freeHead = (ofs % BERRY_POOL_PAGE_SIZE) / g_poolClassSizes[c];
+	pg->used--;
+	g_poolUsedBytes -= g_poolClassSizes[c];
+	if (pg->used == 0) {
+		// whole page can now be used by any size
+		pg->sizeClass = BERRY_POOL_NONE;
+	}
+}
+
+static int berryPool_GetSize(void *ptr) {
+	if (berryPool_Owns(ptr)) {
+		return g_poolClassSizes[g_poolPages[((unsigned char*)ptr - g_poolBase) / BERRY_POOL_PAGE_SIZE].sizeClass];
+	}
+	return ((berryHeapHeader_t*)ptr - 1)->size;
+}
+
+void *berryPool_Malloc(size_t size) {
+	berryHeapHeader_t *h;
+	void *r;
+	int c;
+
+	c = berryPool_GetClass(size);
+	if (!berryPool_CanGrow(c >= 0 ? g_poolClassSizes[c] : (int)size)) {
+		return 0;
+	}
+	if (c >= 0) {
+		r = berryPool_AllocSlot(c);
+		if (r) {
+			berryPool_UpdatePeak();
+			return r;
+		}
+	}
+	h = (berryHeapHeader_t*)BE_SYS_MALLOC(sizeof(berryHeapHeader_t) + size);
+	if (h == 0) {
+		g_poolFailed++;
+		return 0;
+	}
+	h->size = size;
+	g_poolHeapBytes += size;
+	berryPool_UpdatePeak();
+	return h + 1;
+}
+
+void berryPool_Free(void *ptr) {
+	berryHeapHeader_t *h;
+
+	if (ptr == 0) {
+		return;
+	}
+	if (berryPool_Owns(ptr)) {
+		berryPool_FreeSlot(ptr);
+		return;
+	}
+	h = (berryHeapHeader_t*)ptr - 1;
+	g_poolHeapBytes -= h->size;
+	BE_SYS_FREE(h);
+}
+
+void *berryPool_Realloc(void *ptr, size_t size) {
+	berryHeapHeader_t *h;
+	void *r;
+	int oldSize;
+
+	if (ptr == 0) {
+		return berryPool_Malloc(size);
+	}
+	if (size == 0) {
+		berryPool_Free(ptr);
+		return 0;
+	}
+	oldSize = berryPool_GetSize(ptr);
+	if (berryPool_Owns(ptr)) {
+		if ((int)size <= oldSize) {
+			return ptr;
+		}
+	}
+	else if (berryPool_GetClass(size) < 0) {
+		// stays on heap
+		if (!berryPool_CanGrow((int)size - oldSize)) {
+			return 0;
+		}
+		h = (berryHeapHeader_t*)BE_SYS_REALLOC((berryHeapHeader_t*)ptr - 1, sizeof(berryHeapHeader_t) + size);
+		if (h == 0) {
+			g_poolFailed++;
+			return 0;
+		}
+		h->size = size;
+		g_poolHeapBytes += (int)size - oldSize;
+		berryPool_UpdatePeak();
+		return h + 1;
+	}
+	// moves between pool and heap, or to bigger slot
+	r = berryPool_Malloc(size);
+	if (r == 0) {
+		return 0;
+	}
+	memcpy(r, ptr, oldSize < (int)size ? oldSize : (int)size);
+	berryPool_Free(ptr);
+	return r;
+}
+
+// gives arena back to system once VM is gone
+void berryPool_Release() {
+	int i;
+
+	for (i = 0; i < BERRY_POOL_PAGES; i++) {
+		if (g_poolBase && g_poolPages[i].sizeClass != BERRY_POOL_NONE) {
+			return;
+		}
+	}
+	if (g_poolBase) {
+		BE_SYS_FREE(g_poolBase);
+		g_poolBase = 0;
+	}
+	g_poolPeakBytes = g_poolHeapBytes;
+}
+
+void berryPool_SetLimit(int bytes) {
+	g_poolLimit = bytes;
+}
+
+void berryPool_GetStats(berryPoolStats_t *s) {
+	int i;
+
+	s->liveBytes = g_poolUsedBytes + g_poolHeapBytes;
+	s->peakBytes = g_poolPeakBytes;
+	s->limit = g_poolLimit;
+	s->poolSize = g_poolBase ? BERRY_POOL_PAGES * BERRY_POOL_PAGE_SIZE : 0;
+	s->poolUsedBytes = g_poolUsedBytes;
+	s->poolPagesUsed = 0;
+	for (i = 0; g_poolBase && i < BERRY_POOL_PAGES; i++) {
+		if (g_poolPages[i].sizeClass != BERRY_POOL_NONE) {
+			s->poolPagesUsed++;
+		}
+	}
+	s->heapBytes = g_poolHeapBytes;
+	s->failedAllocs = g_poolFailed;
+}
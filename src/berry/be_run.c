@@ -2,24 +2,150 @@
 #include "../logging/logging.h"
 #include "be_debug.h"
 
-const char berryPrelude[] =
-	"_suspended_closures = {}\n"
-	"_suspended_closures_idx = 0\n"
-	"\n"
-	"def suspend_closure(closure)\n"
-	"  _suspended_closures_idx += 1\n"
-	"  _suspended_closures[_suspended_closures_idx] = closure\n"
-	"  return _suspended_closures_idx\n"
-	"end\n"
-	"\n"
-	"def run_closure(idx, *args)\n"
-	"  closure = _suspended_closures[idx]\n"
-	"  call(closure, args)\n"
-	"end\n"
-	"\n"
-	"def remove_closure(idx)\n"
-	"  _suspended_closures.remove(idx)\n"
-	"end\n";
+// Closures waiting for an event or timer. Berry values can only be kept alive
+// by something the GC can reach, so closures live in a raw map stored as
+// global _suspended_closures, keyed by slot. Slots are handed out here and the
+// closure is fetched and called directly, without going through Berry code.
+// Closure ID is generation << BERRY_CLOSURE_SLOT_BITS | slot, so a stale ID of
+// a finished closure never matches a new closure reusing the slot.
+#define BERRY_CLOSURE_SLOT_BITS 12
+#define BERRY_CLOSURE_SLOT_MASK ((1 << BERRY_CLOSURE_SLOT_BITS) - 1)
+// Thread IDs returned to scripts are BERRY_THREAD_ID_BASE + closure ID, keep them positive
+#define BERRY_CLOSURE_MAX_GENERATION ((0x7FFFFFFF - BERRY_THREAD_ID_BASE) >> BERRY_CLOSURE_SLOT_BITS)
+
+// ID of closure in given slot, 0 if slot is free
+static int *g_closureIds = 0;
+static int *g_closureGenerations = 0;
+static int g_closureSlots = 0;
+static int g_closureFirstFree = 0;
+
+static int berryGetClosureSlot(int closureId) {
+	int slot;
+
+	if (closureId <= 0) {
+		return -1;
+	}
+	slot = closureId & BERRY_CLOSURE_SLOT_MASK;
+	if (slot >= g_closureSlots || g_closureIds[slot] != closureId) {
+		return -1;
+	}
+	return slot;
+}
+
+static int berryAllocClosureSlot() {
+	int slot, newSize;
+	int *ids, *gens;
+
+	for (slot = g_closureFirstFree; slot < g_closureSlots; slot++) {
+		if (g_closureIds[slot] == 0) {
+			return slot;
+		}
+	}
+	if (g_closureSlots > BERRY_CLOSURE_SLOT_MASK) {
+		return -1;
+	}
+	newSize = g_closureSlots ? g_closureSlots * 2 : 8;
+	if (newSize > BERRY_CLOSURE_SLOT_MASK + 1) {
+		newSize = BERRY_CLOSURE_SLOT_MASK + 1;
+	}
+	ids = (int*)realloc(g_closureIds, newSize * sizeof(int));
+	if (ids == 0) {
+		return -1;
+	}
+	g_closureIds = ids;
+	gens = (int*)realloc(g_closureGenerations, newSize * sizeof(int));
+	if (gens == 0) {
+		return -1;
+	}
+	g_closureGenerations = gens;
+	memset(g_closureIds + g_closureSlots, 0, (newSize - g_closureSlots) * sizeof(int));
+	memset(g_closureGenerations + g_closureSlots, 0, (newSize - g_closureSlots) * sizeof(int));
+	slot = g_closureSlots;
+	g_closureSlots = newSize;
+	return slot;
+}
+
+// forget all handles, called when a new VM is created
+void berryResetClosures() {
+	free(g_closureIds);
+	free(g_closureGenerations);
+	g_closureIds = 0;
+	g_closureGenerations = 0;
+	g_closureSlots = 0;
+	g_closureFirstFree = 0;
+}
+
+// creates the map holding closures, must be called once for each new VM
+void berryInitClosures(bvm *vm) {
+	berryResetClosures();
+	be_newmap(vm);
+	be_setglobal(vm, "_suspended_closures");
+	be_pop(vm, 1);
+}
+
+int berryGetClosuresCount() {
+	int i, r;
+
+	r = 0;
+	for (i = 0; i < g_closureSlots; i++) {
+		if (g_closureIds[i]) {
+			r++;
+		}
+	}
+	return r;
+}
+
+// keeps the function at given (positive) stack index alive and returns its ID, 0 on failure
+int berrySuspendClosure(bvm *vm, int index) {
+	int slot, gen;
+
+	if (!be_getglobal(vm, "_suspended_closures") || !be_ismap(vm, -1)) {
+		be_pop(vm, 1);
+		return 0;
+	}
+	slot = berryAllocClosureSlot();
+	if (slot < 0) {
+		be_pop(vm, 1);
+		return 0;
+	}
+	be_pushint(vm, slot);
+	be_pushvalue(vm, index);
+	if (!be_data_insert(vm, -3)) {
+		// stale entry left in the map, it must not be called under the new ID
+		be_setindex(vm, -3);
+	}
+	be_pop(vm, 3);
+
+	gen = g_closureGenerations[slot] + 1;
+	if (gen > BERRY_CLOSURE_MAX_GENERATION) {
+		gen = 1;
+	}
+	g_closureGenerations[slot] = gen;
+	g_closureIds[slot] = (gen << BERRY_CLOSURE_SLOT_BITS) | slot;
+	g_closureFirstFree = slot + 1;
+	return g_closureIds[slot];
+}
+
+// pushes closure map, slot and closure, so caller has to pop 3 + arguments after call
+static bool berryPushClosure(bvm *vm, int closureId) {
+	int slot;
+
+	slot = berryGetClosureSlot(closureId);
+	if (slot < 0) {
+		return false;
+	}
+	if (!be_getglobal(vm, "_suspended_closures")) {
+		be_pop(vm, 1);
+		return false;
+	}
+	be_pushint(vm, slot);
+	be_getindex(vm, -2);
+	if (!be_isfunction(vm, -1)) {
+		be_pop(vm, 3);
+		return false;
+	}
+	return true;
+}
 
 void be_error_pop_all(bvm *vm) {
 	be_pop(vm, be_top(vm)); // clear Berry stack
@@ -73,129 +199,90 @@ err:
 }
 
 void berryRunClosure(bvm *vm, int closureId) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
-	// call run_closure(closureId)
-	be_call(vm, 1);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 2);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 0);
+	be_pop(vm, 3);
 }
 void berryRunClosureBytes(bvm *vm, int closureId, byte *data, int len) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
 	be_pushbytes(vm, data, len);
-	// call run_closure(closureId)
-	be_call(vm, 2);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 3);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 1);
+	be_pop(vm, 4);
 }
 void berryRunClosureIntBytes(bvm *vm, int closureId, int x, const byte *data, int len) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
 	be_pushint(vm, x);
 	be_pushbytes(vm, data, len);
-	// call run_closure(closureId)
-	be_call(vm, 3);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 4);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 2);
+	be_pop(vm, 5);
 }
 void berryRunClosureIntInt(bvm *vm, int closureId, int x, int y) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
 	be_pushint(vm, x);
 	be_pushint(vm, y);
-	// call run_closure(closureId)
-	be_call(vm, 3);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 4);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 2);
+	be_pop(vm, 5);
 }
 
 void berryRunClosurePtr(bvm *vm, int closureId, void* x) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
 	be_pushcomptr(vm, x);
-	// call run_closure(closureId)
-	be_call(vm, 2);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 3);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 1);
+	be_pop(vm, 4);
 }
 void berryRunClosureInt(bvm *vm, int closureId, int x) {
-	int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	be_pushint(vm, closureId);
 	be_pushint(vm, x);
-	be_call(vm, 2);
-	//int s2 = Berry_GetStackSizeCurrent();
-	be_pop(vm, 3);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
+	be_call(vm, 1);
+	be_pop(vm, 4);
 }
 void berryRunClosureStr(bvm *vm, int closureId, const char * x, const char * y) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "run_closure")) {
+	if (!berryPushClosure(vm, closureId)) {
 		return;
 	}
-	// call run_closure(closureId)
-	be_pushint(vm, closureId);
 	be_pushstring(vm, x);
-	//int s2;
 	if (y) {
 		be_pushstring(vm, y);
-		be_call(vm, 3);
-		//s2 = Berry_GetStackSizeCurrent();
-		be_pop(vm, 4);
+		be_call(vm, 2);
+		be_pop(vm, 5);
 	}
 	else {
-		be_call(vm, 2);
-		//s2 = Berry_GetStackSizeCurrent();
-		be_pop(vm, 3);
+		be_call(vm, 1);
+		be_pop(vm, 4);
 	}
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
 }
 void berryRemoveClosure(bvm *vm, int closureId) {
-	//int s1 = Berry_GetStackSizeCurrent();
-	if (!be_getglobal(vm, "remove_closure")) {
+	int slot;
+
+	slot = berryGetClosureSlot(closureId);
+	if (slot < 0) {
 		return;
 	}
-	be_pushint(vm, closureId);
-	// call remove_closure(closureId)
-	be_call(vm, 1);
-	//int s2 = Berry_GetStackSizeCurrent();
+	g_closureIds[slot] = 0;
+	if (slot < g_closureFirstFree) {
+		g_closureFirstFree = slot;
+	}
+	if (!be_getglobal(vm, "_suspended_closures") || !be_ismap(vm, -1)) {
+		be_pop(vm, 1);
+		return;
+	}
+	be_pushint(vm, slot);
+	be_data_remove(vm, -2);
 	be_pop(vm, 2);
-	//int s3 = Berry_GetStackSizeCurrent();
-	//printf("%i %i %i\n", s1, s2, s3);
 }
 
 void berryFreeAllClosures(bvm *vm) {
-	// free waiting closures
-	// kind of hacky
-	berryRun(vm, "_suspended_closures = {}");
+	berryInitClosures(vm);
 }
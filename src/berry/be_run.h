@@ -2,7 +2,6 @@
 #include "../new_common.h"
 #include "berry.h"
 
-extern const char berryPrelude[];
 void be_dumpstack(bvm *vm);
 
 bool berryRun(bvm *vm, const char *prog);
@@ -13,8 +12,29 @@ void berryRunClosureIntInt(bvm *vm, int closureId, int x, int y);
 void berryRunClosureInt(bvm *vm, int closureId, int x);
 void berryRunClosureStr(bvm *vm, int closureId, const char *x, const char *y);
 void berryRunClosurePtr(bvm *vm, int closureId, void *x);
+void berryInitClosures(bvm *vm);
+void berryResetClosures();
+// Berry thread IDs are closure IDs offset by this
+#define BERRY_THREAD_ID_BASE 5000
+int berrySuspendClosure(bvm *vm, int index);
+int berryGetClosuresCount();
 void berryRemoveClosure(bvm *vm, int closureId);
-void berryResumeClosure(bvm *vm, int closureId);
 void berryFreeAllClosures(bvm *vm);
 void Berry_StopScripts(int id);
-int Berry_GetStackSizeCurrent();
\ No newline at end of file
+int Berry_GetStackSizeCurrent();
+// be_port.c
+typedef struct berryPoolStats_s {
+	int liveBytes;
+	int peakBytes;
+	// 0 if not limited
+	int limit;
+	int poolSize;
+	int poolUsedBytes;
+	int poolPagesUsed;
+	int heapBytes;
+	int failedAllocs;
+} berryPoolStats_t;
+
+void berryPool_SetLimit(int bytes);
+void berryPool_GetStats(berryPoolStats_t *s);
+void berryPool_Release();
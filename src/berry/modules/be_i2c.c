@@ -7,6 +7,22 @@
 #include "../../driver/drv_local.h"
 #include "../../logging/logging.h"
 
+// bus is registered for SoftI2C_Stats, so it has to be released before free
+static int m_destroyI2c(bvm* vm)
+{
+	int top = be_top(vm);
+	if(top >= 1)
+	{
+		softI2C_t* i2c = be_tocomptr(vm, 1);
+		if(i2c != NULL)
+		{
+			Soft_I2C_Release(i2c);
+			free(i2c);
+		}
+	}
+	be_return_nil(vm);
+}
+
 static int m_initI2c(bvm* vm)
 {
 	int top = be_top(vm);
@@ -27,7 +43,7 @@ static int m_initI2c(bvm* vm)
 		}
 		Soft_I2C_PreInit(i2c);
 		be_pushcomptr(vm, i2c);
-		be_newcomobj(vm, i2c, &be_commonobj_destroy_generic);
+		be_newcomobj(vm, i2c, &m_destroyI2c);
 		be_return(vm);
 	}
 	be_return_nil(vm);
@@ -20,6 +20,7 @@
 #include "../berry/be_run.h"
 #include "be_repl.h"
 #include "be_vm.h"
+#include "be_gc.h"
 #include "berry.h"
 #include "../libraries/obktime/obktime.h"	// for time functions
 #include "../driver/drv_deviceclock.h"
@@ -33,24 +34,128 @@ typedef struct berryInstance_s
 {
 	int uniqueID;
 	int totalDelayMS;
-	int currentDelayMS;
 	int delayRepeats;
+	// in g_berryTimeMS
+	unsigned int deadlineMS;
 	int closureId;
 	eventWait_t wait;
 	bool bFire;
+	// instance can't be reused while it's still linked in any of those lists
+	bool bInEventList;
+	bool bInTimerList;
+	bool bInFiredList;
 
+	// all allocated instances, including free ones
 	struct berryInstance_s* next;
+	struct berryInstance_s* nextForEvent;
+	struct berryInstance_s* nextTimer;
+	struct berryInstance_s* nextFired;
 } berryInstance_t;
 
 berryInstance_t *g_berryThreads = 0;
+// handlers and waiters, by event code
+static berryInstance_t *g_berryEventHandlers[CMD_EVENT_MAX_TYPES];
+// timeouts and intervals, sorted by deadline
+static berryInstance_t *g_berryTimers = 0;
+// waiters matched by an event, run on next Berry_RunThreads
+static berryInstance_t *g_berryFired = 0;
+static unsigned int g_berryTimeMS = 0;
+// while closures run, finished instances are only marked and unlinked later,
+// so list walks up the call stack stay valid
+static int g_berryDispatchDepth = 0;
+static bool g_berryNeedsSweep = false;
+
+// Berry GC is a full mark and sweep. It runs whenever allocation goes over
+// its threshold, which is usually in the middle of a handler, so garbage is
+// also collected from the quick tick while no timer is due soon.
+// Collect when that many bytes were allocated since last collection
+#define BERRY_GC_IDLE_GROWTH 4096
+// and last collection was at least that long ago
+#define BERRY_GC_IDLE_INTERVAL_MS 1000
+static int g_berryGCIdleGrowth = BERRY_GC_IDLE_GROWTH;
+static int g_berryGCCount = 0;
+static int g_berryGCIdleCount = 0;
+static int g_berryGCLastPauseMS = 0;
+static int g_berryGCMaxPauseMS = 0;
+static int g_berryGCLiveAfter = 0;
+static unsigned int g_berryGCStartTick = 0;
+static unsigned int g_berryGCLastTimeMS = 0;
+
+static void Berry_Sweep() {
+	berryInstance_t **p;
+	int i;
+
+	if (g_berryNeedsSweep == false || g_berryDispatchDepth > 0) {
+		return;
+	}
+	g_berryNeedsSweep = false;
+	for (i = 0; i < CMD_EVENT_MAX_TYPES; i++) {
+		p = &g_berryEventHandlers[i];
+		while (*p) {
+			if ((*p)->uniqueID <= 0) {
+				(*p)->bInEventList = false;
+				*p = (*p)->nextForEvent;
+			}
+			else {
+				p = &(*p)->nextForEvent;
+			}
+		}
+	}
+	p = &g_berryTimers;
+	while (*p) {
+		if ((*p)->uniqueID <= 0) {
+			(*p)->bInTimerList = false;
+			*p = (*p)->nextTimer;
+		}
+		else {
+			p = &(*p)->nextTimer;
+		}
+	}
+	p = &g_berryFired;
+	while (*p) {
+		if ((*p)->uniqueID <= 0) {
+			(*p)->bInFiredList = false;
+			*p = (*p)->nextFired;
+		}
+		else {
+			p = &(*p)->nextFired;
+		}
+	}
+}
+static void Berry_BeginDispatch() {
+	g_berryDispatchDepth++;
+}
+static void Berry_EndDispatch() {
+	g_berryDispatchDepth--;
+	Berry_Sweep();
+}
+static berryInstance_t *Berry_GetEventHandlers(byte eventCode) {
+	if (eventCode >= CMD_EVENT_MAX_TYPES) {
+		return 0;
+	}
+	return g_berryEventHandlers[eventCode];
+}
+static void Berry_InsertTimer(berryInstance_t *t) {
+	berryInstance_t **p;
+
+	// after timers with the same deadline, so they run in order of adding
+	p = &g_berryTimers;
+	while (*p && (int)((*p)->deadlineMS - t->deadlineMS) <= 0) {
+		p = &(*p)->nextTimer;
+	}
+	t->nextTimer = *p;
+	*p = t;
+	t->bInTimerList = true;
+}
 
 berryInstance_t *Berry_RegisterThread() {
 	berryInstance_t *r;
+	berryInstance_t *next;
 
 	r = g_berryThreads;
 
 	while (r) {
-		if (r->uniqueID == 0) {
+		if (r->uniqueID == 0 && !r->bInEventList && !r->bInTimerList && !r->bInFiredList) {
 			break;
 		}
 		r = r->next;
@@ -61,155 +166,148 @@ berryInstance_t *Berry_RegisterThread() {
 		r->next = g_berryThreads;
 		g_berryThreads = r;
 	}
-	r->uniqueID = 0;
-	r->currentDelayMS = 0;
+	else {
+		next = r->next;
+		memset(r, 0, sizeof(berryInstance_t));
+		r->next = next;
+	}
 	return r;
 }
 
 void CMD_Berry_ProcessWaitersForEvent(byte eventCode, int argument) {
 	berryInstance_t *t;
 
-
-	t = g_berryThreads;
-
-	while (t) {
-		if (CheckEventCondition(&t->wait, eventCode, argument)) {
+	for (t = Berry_GetEventHandlers(eventCode); t; t = t->nextForEvent) {
+		if (t->uniqueID > 0 && CheckEventCondition(&t->wait, eventCode, argument)) {
 			t->bFire = true;
+			if (!t->bInFiredList) {
+				t->nextFired = g_berryFired;
+				g_berryFired = t;
+				t->bInFiredList = true;
+			}
 		}
-		t = t->next;
 	}
 	// TODO: better
 	CMD_Berry_RunEventHandlers_IntInt(eventCode, argument, 0);
 }
 void CMD_Berry_RunEventHandlers_IntInt(byte eventCode, int argument, int argument2) {
-	berryInstance_t *t;
-
-	t = g_berryThreads;
-
-	while (t) {
-		if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'a') {
+	berryInstance_t *t, *n;
+
+	Berry_BeginDispatch();
+	for (t = Berry_GetEventHandlers(eventCode); t; t = n) {
+		n = t->nextForEvent;
+		if (t->uniqueID <= 0)
+			continue;
+		if (t->wait.waitingForRelation == 'a') {
 			berryRunClosureIntInt(g_vm, t->closureId, argument, argument2);
-		} else if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'm'
+		} else if (t->wait.waitingForRelation == 'm'
 			&& t->wait.waitingForArgument == argument) {
 			berryRunClosureInt(g_vm, t->closureId, argument2);
 		}
-		t = t->next;
 	}
+	Berry_EndDispatch();
 }
 
 int CMD_Berry_RunEventHandlers_StrPtr(byte eventCode, const char *argument, void* argument2) {
-	berryInstance_t *t;
-
-	t = g_berryThreads;
+	berryInstance_t *t, *n;
 
 	int calls = 0;
-	while (t) {
-		if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'a') {
+	Berry_BeginDispatch();
+	for (t = Berry_GetEventHandlers(eventCode); t; t = n) {
+		n = t->nextForEvent;
+		if (t->uniqueID <= 0)
+			continue;
+		if (t->wait.waitingForRelation == 'a') {
 			berryRunClosureStr(g_vm, t->closureId, argument, argument2);
 			calls++;
-		} else if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'm'
+		} else if (t->wait.waitingForRelation == 'm'
 			&& !stricmp(t->wait.waitingForArgumentStr,argument)) {
 			berryRunClosurePtr(g_vm, t->closureId, argument2);
 			calls++;
 		}
-		t = t->next;
 	}
+	Berry_EndDispatch();
 	return calls;
 }
 
 void CMD_Berry_RunEventHandlers_IntBytes(byte eventCode, int argument, const byte *data, int size) {
-	berryInstance_t *t;
-
-	t = g_berryThreads;
-
-	while (t) {
-		if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'a') {
+	berryInstance_t *t, *n;
+
+	Berry_BeginDispatch();
+	for (t = Berry_GetEventHandlers(eventCode); t; t = n) {
+		n = t->nextForEvent;
+		if (t->uniqueID <= 0)
+			continue;
+		if (t->wait.waitingForRelation == 'a') {
 			berryRunClosureIntBytes(g_vm, t->closureId, argument, data, size);
 		}
-		else if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'm'
+		else if (t->wait.waitingForRelation == 'm'
 			&& t->wait.waitingForArgument == argument) {
 			berryRunClosureBytes(g_vm, t->closureId, data, size);
 		}
-		t = t->next;
 	}
+	Berry_EndDispatch();
 }
 int CMD_Berry_RunEventHandlers_Str(byte eventCode, const char *argument, const char *argument2) {
-	berryInstance_t *t;
-
-	t = g_berryThreads;
+	berryInstance_t *t, *n;
 
 	int c_run = 0;
-	while (t) {
-		if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'a') {
+	Berry_BeginDispatch();
+	for (t = Berry_GetEventHandlers(eventCode); t; t = n) {
+		n = t->nextForEvent;
+		if (t->uniqueID <= 0)
+			continue;
+		if (t->wait.waitingForRelation == 'a') {
 			berryRunClosureStr(g_vm, t->closureId, argument, argument2);
 			c_run++;
 		}
-		else if (t->wait.waitingForEvent == eventCode
-			&& t->wait.waitingForRelation == 'm'
+		else if (t->wait.waitingForRelation == 'm'
 			&& !stricmp(t->wait.waitingForArgumentStr,argument)) {
 			berryRunClosureStr(g_vm, t->closureId, argument2, "");
 			c_run++;
 		}
-		t = t->next;
 	}
+	Berry_EndDispatch();
 	return c_run;
 }
 int be_addClosure(bvm *vm, const char *eventName, int relation, int reqArg, const char *reqArgStr, int argumentIndex) {
 	int eventCode = EVENT_ParseEventName(eventName);
-	if (eventCode == CMD_EVENT_NONE) {
+	if (eventCode == CMD_EVENT_NONE || eventCode >= CMD_EVENT_MAX_TYPES) {
 		ADDLOG_INFO(LOG_FEATURE_EVENT, "be_AddChangeHandler: %s is not a valid event", eventName);
 		be_return_nil(vm);
 	}
 
-	// try to push suspend_closure function on the stack
-	if (!be_getglobal(vm, "suspend_closure")) {
-		// prelude not loaded??
+	// keep closure alive, its ID is used to wake it up later
+	int closure_id = berrySuspendClosure(vm, argumentIndex);
+	if (closure_id == 0) {
 		be_return_nil(vm);
 	}
-	// push the 4th argument (closure) on the stack
-	be_pushvalue(vm, argumentIndex);
-	// call suspend_closure with the second arg
-	be_call(vm, 1);
-	// it should return an ID of the suspended closure, to be used to wake up later
-	if (be_isint(vm, -2)) {
-		int closure_id = be_toint(vm, -2);
-		berryInstance_t *th;
-		th = Berry_RegisterThread();
-		if (th == 0) {
-			ADDLOG_INFO(LOG_FEATURE_CMD, "be_AddChangeHandler: failed to alloc thread");
-			be_return_nil(vm);
-		}
-		int thread_id = 5000 + closure_id; // TODO: alloc IDs?
-		th->uniqueID = thread_id;
-		th->currentDelayMS = 0;
-		th->wait.waitingForEvent = eventCode;
-		th->wait.waitingForArgument = reqArg;
-		if (reqArgStr) {
-			strcpy_safe(th->wait.waitingForArgumentStr, reqArgStr, sizeof(th->wait.waitingForArgumentStr));
-		}
-		else {
-			th->wait.waitingForArgumentStr[0] = 0;
-		}
-		th->wait.waitingForRelation = relation;
-		th->closureId = closure_id;
-
-		// remove the 2 values we pushed on the stack
-		be_pop(vm, 2);
-
-		// Return the thread ID to Berry
-		be_pushint(vm, thread_id);
-		be_return(vm);
+	berryInstance_t *th;
+	th = Berry_RegisterThread();
+	if (th == 0) {
+		ADDLOG_INFO(LOG_FEATURE_CMD, "be_AddChangeHandler: failed to alloc thread");
+		berryRemoveClosure(vm, closure_id);
+		be_return_nil(vm);
 	}
-	// remove the 2 values we pushed on the stack
-	be_pop(vm, 2);
-	be_return_nil(vm);
+	int thread_id = BERRY_THREAD_ID_BASE + closure_id;
+	th->uniqueID = thread_id;
+	th->wait.waitingForEvent = eventCode;
+	th->wait.waitingForArgument = reqArg;
+	if (reqArgStr) {
+		strcpy_safe(th->wait.waitingForArgumentStr, reqArgStr, sizeof(th->wait.waitingForArgumentStr));
+	}
+	else {
+		th->wait.waitingForArgumentStr[0] = 0;
+	}
+	th->wait.waitingForRelation = relation;
+	th->closureId = closure_id;
+	th->nextForEvent = g_berryEventHandlers[eventCode];
+	g_berryEventHandlers[eventCode] = th;
+	th->bInEventList = true;
+
+	// Return the thread ID to Berry
+	be_pushint(vm, thread_id);
+	be_return(vm);
 }
 int be_poststr(bvm *vm) {
 	int top = be_top(vm);
@@ -274,40 +372,29 @@ int be_setTimeoutInternal(bvm *vm, int repeats) {
 	int top = be_top(vm);
 	if (top == 2 && be_isint(vm, 2) && be_isfunction(vm, 1)) {
 		int delay_ms = be_toint(vm, 2);
-		// try to push suspend_closure function on the stack
-		if (!be_getglobal(vm, "suspend_closure")) {
-			// prelude not loaded??
+		// keep closure alive, its ID is used to wake it up later
+		int closure_id = berrySuspendClosure(vm, 1);
+		if (closure_id == 0) {
 			be_return_nil(vm);
 		}
-		// push the second argument (closure) on the stack
-		be_pushvalue(vm, 1);
-		// call suspend_closure with the second arg
-		be_call(vm, 1);
-		// it should return an ID of the suspended closure, to be used to wake up later
-		if (be_isint(vm, -2)) {
-			int closure_id = be_toint(vm, -2);
-			berryInstance_t *th;
-			th = Berry_RegisterThread();
-			if (th == 0) {
-				ADDLOG_INFO(LOG_FEATURE_CMD, "be_delayMs: failed to alloc thread");
-				be_return_nil(vm);
-			}
-			int thread_id = 5000 + closure_id; // TODO: alloc IDs?
-			th->uniqueID = thread_id;
-			th->currentDelayMS = delay_ms;
-			th->totalDelayMS = delay_ms;
-			th->closureId = closure_id;
-			th->delayRepeats = repeats;
-
-			// remove the 2 values we pushed on the stack
-			be_pop(vm, 2);
-
-			// Return the thread ID to Berry
-			be_pushint(vm, thread_id);
-			be_return(vm);
+		berryInstance_t *th;
+		th = Berry_RegisterThread();
+		if (th == 0) {
+			ADDLOG_INFO(LOG_FEATURE_CMD, "be_delayMs: failed to alloc thread");
+			berryRemoveClosure(vm, closure_id);
+			be_return_nil(vm);
 		}
-		// remove the 2 values we pushed on the stack
-		be_pop(vm, 2);
+		int thread_id = BERRY_THREAD_ID_BASE + closure_id;
+		th->uniqueID = thread_id;
+		th->totalDelayMS = delay_ms;
+		th->deadlineMS = g_berryTimeMS + delay_ms;
+		th->closureId = closure_id;
+		th->delayRepeats = repeats;
+		Berry_InsertTimer(th);
+
+		// Return the thread ID to Berry
+		be_pushint(vm, thread_id);
+		be_return(vm);
 	}
 	be_return_nil(vm);
 }
@@ -418,11 +505,80 @@ int be_gmtime(bvm *vm) {
 
 
 
+static void Berry_ObsHook(bvm *vm, int event, ...) {
+	berryPoolStats_t st;
+
+	if (event == BE_OBS_GC_START) {
+		g_berryGCStartTick = xTaskGetTickCount();
+	}
+	else if (event == BE_OBS_GC_END) {
+		g_berryGCLastPauseMS = (xTaskGetTickCount() - g_berryGCStartTick) * portTICK_PERIOD_MS;
+		if (g_berryGCLastPauseMS > g_berryGCMaxPauseMS) {
+			g_berryGCMaxPauseMS = g_berryGCLastPauseMS;
+		}
+		g_berryGCCount++;
+		g_berryGCLastTimeMS = g_berryTimeMS;
+		berryPool_GetStats(&st);
+		g_berryGCLiveAfter = st.liveBytes;
+	}
+}
+
+static void Berry_RunIdleGC() {
+	berryPoolStats_t st;
+	int growth, nextTimer;
+
+	if (g_vm == 0 || g_berryFired) {
+		return;
+	}
+	if ((int)(g_berryTimeMS - g_berryGCLastTimeMS) < BERRY_GC_IDLE_INTERVAL_MS) {
+		return;
+	}
+	berryPool_GetStats(&st);
+	growth = st.liveBytes - g_berryGCLiveAfter;
+	// near the limit, collect sooner, so allocations don't fail in handlers
+	if (growth < g_berryGCIdleGrowth && !(st.limit > 0 && st.liveBytes > st.limit - st.limit / 4)) {
+		return;
+	}
+	if (g_berryTimers) {
+		nextTimer = (int)(g_berryTimers->deadlineMS - g_berryTimeMS);
+		// would delay it, longest pause seen so far is the estimate
+		if (nextTimer <= g_berryGCMaxPauseMS) {
+			return;
+		}
+	}
+	g_berryGCIdleCount++;
+	be_gc_collect(g_vm);
+	// in case observability hook was not called
+	g_berryGCLastTimeMS = g_berryTimeMS;
+	berryPool_GetStats(&st);
+	g_berryGCLiveAfter = st.liveBytes;
+}
+
+void Berry_GetGCStats(int *collections, int *idleCollections, int *lastPauseMS, int *maxPauseMS) {
+	*collections = g_berryGCCount;
+	*idleCollections = g_berryGCIdleCount;
+	*lastPauseMS = g_berryGCLastPauseMS;
+	*maxPauseMS = g_berryGCMaxPauseMS;
+}
+
+int Berry_GetMemStatsJSON(char *out, int outLen) {
+	berryPoolStats_t st;
+
+	berryPool_GetStats(&st);
+	return snprintf(out, outLen, "{\"live\":%i,\"peak\":%i,\"limit\":%i,"
+		"\"pool_size\":%i,\"pool_used\":%i,\"pool_pages\":%i,\"heap\":%i,\"failed\":%i,"
+		"\"gc\":%i,\"gc_idle\":%i,\"gc_last_ms\":%i,\"gc_max_ms\":%i}",
+		st.liveBytes, st.peakBytes, st.limit,
+		st.poolSize, st.poolUsedBytes, st.poolPagesUsed, st.heapBytes, st.failedAllocs,
+		g_berryGCCount, g_berryGCIdleCount, g_berryGCLastPauseMS, g_berryGCMaxPauseMS);
+}
+
 static int BasicInit() {
 	if (!g_vm) {
 		// Lazy init for now, to avoid resource consumption and boot loops
 		ADDLOG_INFO(LOG_FEATURE_BERRY, "[berry init]");
 		g_vm = be_vm_new(); /* create a virtual machine instance */
+		be_set_obs_hook(g_vm, Berry_ObsHook);
 		be_regfunc(g_vm, "setChannel", be_ChannelSet);
 		be_regfunc(g_vm, "setTimeout", be_setTimeout);
 		be_regfunc(g_vm, "getVar", be_get);
@@ -449,9 +605,7 @@ static int BasicInit() {
 #if ENABLE_DRIVER_MQTTSERVER
 		MQTTS_Berry_Init();
 #endif
-		if (!berryRun(g_vm, berryPrelude)) {
-			return 0;
-		}
+		berryInitClosures(g_vm);
 	}
 	return 1;
 }
@@ -471,29 +625,17 @@ void eval_berry_snippet(const char *s) {
 void berryThreadComplete(berryInstance_t *thread) {
 	// Free the associated closure if it exists
 	if (thread->closureId > 0 && g_vm) {
-		// Get the _suspended_closures table from global scope
-		if (be_getglobal(g_vm, "_suspended_closures")) {
-			// Push the closure ID as the key
-			be_pushint(g_vm, thread->closureId);
-
-			// Push nil as the value
-			be_pushnil(g_vm);
-
-			// Set _suspended_closures[closureId] = nil
-			be_setindex(g_vm, -3);
-
-			// Pop the _suspended_closures table from the stack
-			be_pop(g_vm, 1);
-		}
+		berryRemoveClosure(g_vm, thread->closureId);
 	}
 
-	// Reset all Berry-specific flags and data
-	thread->closureId = -1;
+	// Reset all Berry-specific flags and data, instance is unlinked by Berry_Sweep
+	thread->closureId = 0;
 	thread->uniqueID = 0;
-	thread->currentDelayMS = 0;
+	thread->bFire = false;
 	thread->wait.waitingForArgument = 0;
 	thread->wait.waitingForEvent = 0;
 	thread->wait.waitingForRelation = 0;
+	g_berryNeedsSweep = true;
 }
 
 // Useful for testing things that affect global state:
@@ -507,6 +649,7 @@ void stopBerrySVM() {
 			berryThreadComplete(t);
 			t = t->next;
 		}
+		Berry_Sweep();
 	}
 }
 
@@ -515,6 +658,8 @@ void CMD_StopBerry() {
 		stopBerrySVM();
 		be_vm_delete(g_vm);
 		g_vm = NULL;
+		berryPool_Release();
+		g_berryGCLiveAfter = 0;
 	}
 }
 static commandResult_t CMD_StopBerryCommand(const void *context, const char *cmd, const char *args, int cmdFlags) {
@@ -527,16 +672,10 @@ void Berry_StopAllScripts() {
 
 	t = g_berryThreads;
 	while (t) {
-		t->uniqueID = 0;
-		t->currentDelayMS = 0;
 		berryThreadComplete(t);
 		t = t->next;
 	}
-}
-void Berry_RunThread(berryInstance_t *t) {
-	berryRunClosure(g_vm, t->closureId);
-	berryRemoveClosure(g_vm, t->closureId);
-	berryThreadComplete(t);
+	Berry_Sweep();
 }
 void Berry_StopScripts(int id) {
 	berryInstance_t *t;
@@ -544,12 +683,11 @@ void Berry_StopScripts(int id) {
 	t = g_berryThreads;
 	while (t) {
 		if (t->uniqueID == id) {
-			t->uniqueID = 0;
-			t->currentDelayMS = 0;
 			berryThreadComplete(t);
 		}
 		t = t->next;
 	}
+	Berry_Sweep();
 }
 int Berry_GetStackSizeTotal() {
 	if (g_vm) {
@@ -567,53 +705,135 @@ int Berry_GetStackSizeCurrent() {
 }
 
 void Berry_RunThreads(int deltaMS) {
-	int c_sleep, c_run;
-
-	c_sleep = 0;
-	c_run = 0;
-
+	berryInstance_t *t, *due;
+	berryInstance_t **tail;
+	int id;
+
+	g_berryTimeMS += deltaMS;
+	Berry_BeginDispatch();
+
+	// waiters matched by events since last run, in order of matching
+	due = 0;
+	while (g_berryFired) {
+		t = g_berryFired;
+		g_berryFired = t->nextFired;
+		t->nextFired = due;
+		due = t;
+	}
+	while (due) {
+		t = due;
+		due = t->nextFired;
+		t->bInFiredList = false;
+		if (t->uniqueID > 0 && t->bFire) {
+			t->bFire = false;
+			berryRunClosure(g_vm, t->closureId);
+		}
+	}
 
-	berryInstance_t *g_activeThread = g_berryThreads;
-	while (g_activeThread) {
-		if (g_activeThread->uniqueID > 0) {
-			if (g_activeThread->wait.waitingForEvent) {
-				if (g_activeThread->bFire) {
-					berryRunClosure(g_vm, g_activeThread->closureId);
-					g_activeThread->bFire = false;
-				}
-				// do nothing
-			}
-			else {
-				if (g_activeThread->currentDelayMS > 0) {
-					g_activeThread->currentDelayMS -= deltaMS;
-					// the following block is needed to handle with long freezes on simulator
-					if (g_activeThread->currentDelayMS <= 0) {
-						if (g_activeThread->delayRepeats == -1) {
-							berryRunClosure(g_vm, g_activeThread->closureId);
-							g_activeThread->currentDelayMS = g_activeThread->totalDelayMS;
-						}
-						else if (g_activeThread->delayRepeats > 0) {
-							g_activeThread->delayRepeats--;
-							berryRunClosure(g_vm, g_activeThread->closureId);
-							g_activeThread->currentDelayMS = g_activeThread->totalDelayMS;
-						}
-						else {
-							// finish totally
-							berryRunClosure(g_vm, g_activeThread->closureId);
-							berryRemoveClosure(g_vm, g_activeThread->closureId);
-							g_activeThread->closureId = 0;
-							g_activeThread->uniqueID = 0;//free
-						}
-					}
-				}
-				else {
-					Berry_RunThread(g_activeThread);
-				}
+	// take all expired timers first, the ones added by them wait for next run
+	due = 0;
+	tail = &due;
+	while (g_berryTimers && (int)(g_berryTimers->deadlineMS - g_berryTimeMS) <= 0) {
+		t = g_berryTimers;
+		g_berryTimers = t->nextTimer;
+		*tail = t;
+		tail = &t->nextTimer;
+	}
+	*tail = 0;
+	while (due) {
+		t = due;
+		due = t->nextTimer;
+		t->bInTimerList = false;
+		if (t->uniqueID <= 0) {
+			continue;
+		}
+		id = t->uniqueID;
+		berryRunClosure(g_vm, t->closureId);
+		if (t->uniqueID != id) {
+			// cancelled by itself
+			continue;
+		}
+		if (t->totalDelayMS > 0 && (t->delayRepeats == -1 || t->delayRepeats > 0)) {
+			if (t->delayRepeats > 0) {
+				t->delayRepeats--;
 			}
+			t->deadlineMS = g_berryTimeMS + t->totalDelayMS;
+			Berry_InsertTimer(t);
+		}
+		else {
+			// finish totally
+			berryThreadComplete(t);
 		}
-		g_activeThread = g_activeThread->next;
 	}
+	Berry_EndDispatch();
+	Berry_RunIdleGC();
+}
+bool CMD_Berry_HasEventHandlers(byte eventCode) {
+	berryInstance_t *t;
+
+	for (t = Berry_GetEventHandlers(eventCode); t; t = t->nextForEvent) {
+		if (t->uniqueID > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+#ifdef WINDOWS
+// Used by simulator to fast-forward time, same as SVM_GetNextDeadlineMS
+int Berry_GetNextDeadlineMS() {
+	int ret;
 
+	if (g_berryFired) {
+		return 0;
+	}
+	if (g_berryTimers == 0) {
+		return -1;
+	}
+	ret = (int)(g_berryTimers->deadlineMS - g_berryTimeMS);
+	if (ret < 0) {
+		ret = 0;
+	}
+	return ret;
+}
+void Berry_SkipIdleTime(int deltaMS) {
+	// nothing expires in skipped time, see Berry_GetNextDeadlineMS
+	g_berryTimeMS += deltaMS;
+}
+int Berry_Test_GetTimersCount() {
+	berryInstance_t *t;
+	int ret;
+
+	ret = 0;
+	for (t = g_berryTimers; t; t = t->nextTimer) {
+		ret++;
+	}
+	return ret;
+}
+int Berry_Test_GetEventHandlersCount(byte eventCode) {
+	berryInstance_t *t;
+	int ret;
+
+	ret = 0;
+	for (t = Berry_GetEventHandlers(eventCode); t; t = t->nextForEvent) {
+		ret++;
+	}
+	return ret;
+}
+#endif
+// BerryMem [limitBytes] [idleGCGrowthBytes]
+static commandResult_t CMD_BerryMem(const void *context, const char *cmd, const char *args, int cmdFlags) {
+	char tmp[256];
+
+	Tokenizer_TokenizeString(args, 0);
+	if (Tokenizer_GetArgsCount() >= 1) {
+		berryPool_SetLimit(Tokenizer_GetArgInteger(0));
+	}
+	if (Tokenizer_GetArgsCount() >= 2) {
+		g_berryGCIdleGrowth = Tokenizer_GetArgInteger(1);
+	}
+	Berry_GetMemStatsJSON(tmp, sizeof(tmp));
+	ADDLOG_INFO(LOG_FEATURE_BERRY, "BerryMem: %s", tmp);
+	return CMD_RES_OK;
 }
 void CMD_InitBerry() {
 	//cmddetail:{"name":"berry","args":"[Berry code]",
@@ -626,6 +846,11 @@ void CMD_InitBerry() {
 	//cmddetail:"fn":"CMD_StopBerryCommand","file":"cmnds/cmd_berry.c","requires":"",
 	//cmddetail:"examples":"stopBerry"}
 	CMD_RegisterCommand("stopBerry", CMD_StopBerryCommand, NULL);
+	//cmddetail:{"name":"BerryMem","args":"[LimitBytes][IdleGCGrowthBytes]",
+	//cmddetail:"descr":"Prints Berry memory and garbage collector statistics. Optionally sets the limit of memory used by Berry objects (0 - no limit) and how many bytes must be allocated before garbage is collected while Berry is idle.",
+	//cmddetail:"fn":"CMD_BerryMem","file":"cmnds/cmd_berry.c","requires":"",
+	//cmddetail:"examples":"BerryMem 32768"}
+	CMD_RegisterCommand("BerryMem", CMD_BerryMem, NULL);
 }
 
 #endif
@@ -6,6 +6,7 @@
 #include "../new_cfg.h"
 #include "../driver/drv_public.h"
 #include "../driver/drv_battery.h"
+#include "../driver/drv_bl_samples.h"
 #include "../driver/drv_ntp.h"
 #include "../driver/drv_deviceclock.h"
 #include "../hal/hal_flashVars.h"
@@ -583,6 +584,13 @@ const char *CMD_ExpandConstantFloat(const char *s, const char *stop, float *out)
 #if ENABLE_EXPAND_CONSTANT
 	const constant_t *var;
 	int i;
+#if ENABLE_BL_SAMPLES
+	// $power_max_1s etc, checked first, as $power would match its beginning
+	const char *stat = BL_Samples_ExpandConstant(s, stop, out);
+	if (stat) {
+		return stat;
+	}
+#endif
 	var = g_constants;
 	for (i = 0; i < g_totalConstants; i++, var++) {
 		bool bAllowWildCard = strstr(var->constantName, "*") != 0;
@@ -135,6 +135,11 @@ int LED_GetFirstChannelIndex() {
 #endif
 }
 
+#ifndef OBK_DISABLE_ALL_DRIVERS
+static const char* const g_ledChipDrivers[] = { "SM2135", "BP5758D", "TESTLED", "SM2235", "BP1658CJ", "KP18058", "SM16703P", "SM15155E", "DMX" };
+static int g_ledChipDriversCache[sizeof(g_ledChipDrivers) / sizeof(g_ledChipDrivers[0])];
+#endif
+
 bool LED_IsLedDriverChipRunning()
 {
 #if	ENABLE_DRIVER_TUYAMCU
@@ -143,13 +148,7 @@ bool LED_IsLedDriverChipRunning()
 	}
 #endif
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("SM2135") || DRV_IsRunning("BP5758D") 
-		|| DRV_IsRunning("TESTLED") || DRV_IsRunning("SM2235") || DRV_IsRunning("BP1658CJ")
-		|| DRV_IsRunning("KP18058")
-		|| DRV_IsRunning("SM16703P")
-		|| DRV_IsRunning("SM15155E")
-		|| DRV_IsRunning("DMX")
-		; 
+	return DRV_IsAnyRunningCached(g_ledChipDrivers, g_ledChipDriversCache, sizeof(g_ledChipDrivers) / sizeof(g_ledChipDrivers[0]));
 #else
 	return false;
 #endif
@@ -250,6 +249,14 @@ void LED_ApplyEmulatedCool(int firstChannelIndex, float chVal) {
 	CHANNEL_Set_FloatPWM(firstChannelIndex + 2, rgb[2], CHANNEL_SET_FLAG_SKIP_MQTT | CHANNEL_SET_FLAG_SILENT);
 }
 
+// written on every LED update, so driver names are resolved only once
+#ifdef ENABLE_DRIVER_LED
+static int g_sm2135Cache, g_bp5758dCache, g_bp1658cjCache, g_sm2235Cache, g_kp18058Cache;
+#endif
+#ifdef ENABLE_DRIVER_SM15155E
+static int g_sm15155eCache;
+#endif
+
 void LED_I2CDriver_WriteRGBCW(float* finalRGBCW) {
 #ifdef ENABLE_DRIVER_GOSUNDSW2
 	if (DRV_IsRunning("GosundSW2")) {
@@ -266,24 +273,24 @@ void LED_I2CDriver_WriteRGBCW(float* finalRGBCW) {
 			// keep W unchanged
 		}
 	}
-	if (DRV_IsRunning("SM2135")) {
+	if (DRV_IsRunningCached("SM2135", &g_sm2135Cache)) {
 		SM2135_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("BP5758D")) {
+	if (DRV_IsRunningCached("BP5758D", &g_bp5758dCache)) {
 		BP5758D_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("BP1658CJ")) {
+	if (DRV_IsRunningCached("BP1658CJ", &g_bp1658cjCache)) {
 		BP1658CJ_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("SM2235")) {
+	if (DRV_IsRunningCached("SM2235", &g_sm2235Cache)) {
 		SM2235_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("KP18058")) {
+	if (DRV_IsRunningCached("KP18058", &g_kp18058Cache)) {
 		KP18058_Write(finalRGBCW);
 	}
 #endif
 #ifdef ENABLE_DRIVER_SM15155E
-	if (DRV_IsRunning("SM15155E")) {
+	if (DRV_IsRunningCached("SM15155E", &g_sm15155eCache)) {
 		SM15155E_Write(finalRGBCW);
 	}
 #endif
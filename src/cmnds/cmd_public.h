@@ -229,6 +229,10 @@ void Tokenizer_TokenizeString(const char* s, int flags);
 // cmd_repeatingEvents.c
 void RepeatingEvents_Init();
 void RepeatingEvents_RunUpdate(float deltaTimeSeconds);
+#ifdef WINDOWS
+int RepeatingEvents_GetIdleFrames(int maxFrames, float frameSeconds);
+void RepeatingEvents_SkipIdleFrames(int frames, float frameSeconds);
+#endif
 void SIM_GenerateRepeatingEventsDesc(char *o, int outLen);
 void SIM_GeneratePowerStateDesc(char *o, int outLen);
 // cmd_eventHandlers.c
@@ -325,11 +329,22 @@ void CMD_Berry_RunEventHandlers_IntInt(byte eventCode, int argument, int argumen
 void CMD_Berry_RunEventHandlers_IntBytes(byte eventCode, int argument, const byte *data, int size);
 int CMD_Berry_RunEventHandlers_StrPtr(byte eventCode, const char *argument, void* argument2);
 int CMD_Berry_RunEventHandlers_Str(byte eventCode, const char *argument, const char *argument2);
+bool CMD_Berry_HasEventHandlers(byte eventCode);
+int Berry_GetMemStatsJSON(char *out, int outLen);
+void Berry_GetGCStats(int *collections, int *idleCollections, int *lastPauseMS, int *maxPauseMS);
+#ifdef WINDOWS
+int Berry_Test_GetTimersCount();
+int Berry_Test_GetEventHandlersCount(byte eventCode);
+#endif
 
 const char* CMD_GetResultString(commandResult_t r);
 
 void SVM_StartBacklog(const char *command);
 void SVM_RunThreads(int deltaMS);
+#ifdef WINDOWS
+int SVM_GetNextDeadlineMS();
+void SVM_SkipIdleTime(int deltaMS);
+#endif
 void CMD_InitScripting();
 void SVM_RunStartupCommandAsScript();
 byte* LFS_ReadFile(const char* fname);
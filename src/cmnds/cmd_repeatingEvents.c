@@ -159,6 +159,44 @@ void RepeatingEvents_RunUpdate(float deltaTimeSeconds) {
 
 	//addLogAdv(LOG_INFO, LOG_FEATURE_CMD,"RepeatingEvents_OnEverySecond checked %i events, ran %i",c_checked,c_ran);
 }
+#ifdef WINDOWS
+// Used by simulator to fast-forward time.
+// Returns how many updates of frameSeconds (up to maxFrames) can pass without
+// any event firing. Intervals are floats, so it repeats the exact subtraction
+// done by RepeatingEvents_RunUpdate to stay in sync with frame-by-frame run.
+int RepeatingEvents_GetIdleFrames(int maxFrames, float frameSeconds) {
+	repeatingEvent_t *cur;
+	float left;
+	int frames;
+
+	for (cur = g_repeatingEvents; cur; cur = cur->next) {
+		if (cur->times > 0 || cur->times == -1) {
+			left = cur->currentInterval;
+			for (frames = 0; frames < maxFrames; frames++) {
+				left -= frameSeconds;
+				if (left <= 0) {
+					break;
+				}
+			}
+			maxFrames = frames;
+		}
+	}
+	return maxFrames;
+}
+// caller guarantees that frames is not more than RepeatingEvents_GetIdleFrames
+void RepeatingEvents_SkipIdleFrames(int frames, float frameSeconds) {
+	repeatingEvent_t *cur;
+	int i;
+
+	for (cur = g_repeatingEvents; cur; cur = cur->next) {
+		if (cur->times > 0 || cur->times == -1) {
+			for (i = 0; i < frames; i++) {
+				cur->currentInterval -= frameSeconds;
+			}
+		}
+	}
+}
+#endif
 // addRepeatingEventID 1234 5 -1 DGR_SendPower "testgr" 1 1 
 // cancelRepeatingEvent 1234
 #define MIN_REPEATING_INTERVAL 0.001f
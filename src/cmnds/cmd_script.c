@@ -474,6 +474,41 @@ void SVM_RunThreads(int deltaMS) {
 
 	//ADDLOG_INFO(LOG_FEATURE_CMD, "SCR sleep %i, ran %i",c_sleep,c_run);
 }
+#ifdef WINDOWS
+// Used by simulator to fast-forward time.
+// Returns -1 if no thread is delayed, 0 if a thread wants to run now,
+// otherwise time in ms until first delayed thread wakes up.
+int SVM_GetNextDeadlineMS() {
+	scriptInstance_t *t;
+	int ret;
+
+	ret = -1;
+	for (t = g_scriptThreads; t; t = t->next) {
+		if (t->wait.waitingForEvent) {
+			continue;
+		}
+		if (t->currentDelayMS > 0) {
+			if (ret == -1 || t->currentDelayMS < ret) {
+				ret = t->currentDelayMS;
+			}
+		}
+		else if (t->curLine != 0) {
+			return 0;
+		}
+	}
+	return ret;
+}
+// caller guarantees that no delay expires within deltaMS
+void SVM_SkipIdleTime(int deltaMS) {
+	scriptInstance_t *t;
+
+	for (t = g_scriptThreads; t; t = t->next) {
+		if (t->wait.waitingForEvent == 0 && t->currentDelayMS > 0) {
+			t->currentDelayMS -= deltaMS;
+		}
+	}
+}
+#endif
 bool CheckEventCondition(eventWait_t *w, byte eventCode, int argument) {
 	if (w->waitingForEvent != eventCode) {
 		return false;
@@ -45,6 +45,20 @@ static commandResult_t CMD_SendPOST(const void* context, const char* cmd, const
 	return CMD_RES_OK;
 }
 
+// httpClientStats
+// Prints request queue depth and how many requests have reused a kept-alive connection
+static commandResult_t CMD_HTTPClientStats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	httpclient_stats_t stats;
+
+	HTTPClient_GetStats(&stats);
+	ADDLOG_INFO(LOG_FEATURE_CMD, "HTTP client: queued %i (peak %i), dropped %i, coalesced %i",
+		stats.queueDepth, stats.queuePeak, stats.dropped, stats.coalesced);
+	ADDLOG_INFO(LOG_FEATURE_CMD, "HTTP client: completed %i, new connections %i, reused %i",
+		stats.completed, stats.connects, stats.reused);
+
+	return CMD_RES_OK;
+}
+
 int CMD_InitSendCommands() {
 	//cmddetail:{"name":"sendGet","args":"[TargetURL]",
 	//cmddetail:"descr":"Sends a HTTP GET request to target URL. May include GET arguments. Can be used to control devices by Tasmota HTTP protocol. Command supports argument expansion, so $CH11 changes to value of channel 11, etc, etc.",
@@ -61,6 +75,12 @@ int CMD_InitSendCommands() {
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("sendPOST", CMD_SendPOST, NULL);
 
+	//cmddetail:{"name":"httpClientStats","args":"",
+	//cmddetail:"descr":"Prints HTTP client request queue depth, dropped and coalesced requests and keep-alive connection reuse counters.",
+	//cmddetail:"fn":"CMD_HTTPClientStats","file":"cmnds/cmd_send.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("httpClientStats", CMD_HTTPClientStats, NULL);
+
 	return 0;
 }
 
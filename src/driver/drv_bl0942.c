@@ -13,6 +13,8 @@
 #include "../new_pins.h"
 #include "../cmnds/cmd_public.h"
 #include "drv_bl_shared.h"
+#include "drv_bl_samples.h"
+#include "../quicktick.h"
 #include "drv_pwrCal.h"
 #include "drv_spi.h"
 #include "drv_uart.h"
@@ -26,6 +28,10 @@ static unsigned short bl0942_opts= 0;
 #define BL0942_OPTBIT0_UART1 1
 #define BL0942_OPTBIT1_UART2 2
 #endif
+#if ENABLE_BL_SAMPLES
+// last value written to REG_MODE, EnergySamples interval can change it at runtime
+static uint32_t bl0942_mode = 0;
+#endif
 #define BL0942_DEVICE_INDEX_0 0
 #define BL0942_DEVICE_INDEX_1 1
 
@@ -101,84 +107,23 @@ static void ScaleAndUpdate(bl0942_data_t * data) {
         fabsf(PwrCal_ScalePowerOnly(diff)) * 1638.4f * 256.0f / 3600.0f;
     }
     PrevCfCnt[adeviceindex] = data->cf_cnt;
-#if ENABLE_BL_TWIN
     //I assume that adeviceindex BL0942_DEVICE_INDEX_0/1 is equal to BL_SENSORS_IX_0/1 [to save flash memory]
-    BL_ProcessUpdateEx(adeviceindex, voltage, current, power, frequency, energyWh);
-#else
-    BL_ProcessUpdate(voltage, current, power, frequency, energyWh);
-#endif
+    BL_ProcessSample(adeviceindex, voltage, current, power, frequency, energyWh);
     //addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "Sensors ix %i v=%.f c=%.f p=%.f e=%.f",
     //    adeviceindex, voltage, current, power, frequency, energyWh);
 }
 
-#if !ENABLE_BL_TWIN
-static int BL0942_UART_TryToGetNextPacket() {
-  int cs;
-  int i;
-  int c_garbage_consumed = 0;
-  byte checksum;
-
-  cs = UART_GetDataSize();
-
-  if(cs < BL0942_UART_PACKET_LEN) {
-    return 0;
-  }
-  // skip garbage data (should not happen)
-  while(cs > 0) {
-    if (UART_GetByte(0) != BL0942_UART_PACKET_HEAD) {
-      UART_ConsumeBytes(1);
-      c_garbage_consumed++;
-      cs--;
-    } else {
-      break;
-    }
-  }
-  if(c_garbage_consumed > 0){
-    ADDLOG_WARN(LOG_FEATURE_ENERGYMETER,
-      "Consumed %i unwanted non-header byte in BL0942 buffer\n",
-      c_garbage_consumed);
-  }
-  if(cs < BL0942_UART_PACKET_LEN) {
-    return 0;
-  }
-  if (UART_GetByte(0) != 0x55)
-    return 0;
-  checksum = BL0942_UART_CMD_READ(BL0942_UART_ADDR);
-
-  for(i = 0; i < BL0942_UART_PACKET_LEN-1; i++) {
-    checksum += UART_GetByte(i);
-  }
-  checksum ^= 0xFF;
-
-  if (checksum != UART_GetByte(BL0942_UART_PACKET_LEN - 1)) {
-    ADDLOG_WARN(LOG_FEATURE_ENERGYMETER,
-      "Skipping packet with bad checksum %02X wanted %02X\n",
-      UART_GetByte(BL0942_UART_PACKET_LEN - 1), checksum);
-    UART_ConsumeBytes(BL0942_UART_PACKET_LEN);
-    return 1;
-  }
-
-  bl0942_data_t data;
-  data.i_rms =
-    (UART_GetByte(3) << 16) | (UART_GetByte(2) << 8) | UART_GetByte(1);
-  data.v_rms =
-    (UART_GetByte(6) << 16) | (UART_GetByte(5) << 8) | UART_GetByte(4);
-  data.watt = Int24ToInt32((UART_GetByte(12) << 16) |
-    (UART_GetByte(11) << 8) | UART_GetByte(10));
-  data.cf_cnt =
-    (UART_GetByte(15) << 16) | (UART_GetByte(14) << 8) | UART_GetByte(13);
-  data.freq = (UART_GetByte(17) << 8) | UART_GetByte(16);
-  ScaleAndUpdate(&data);
-
-  UART_ConsumeBytes(BL0942_UART_PACKET_LEN);
-  return BL0942_UART_PACKET_LEN;
-}
-
-#else
+#if ENABLE_BL_TWIN
 static int BL0942_UART_TryToGetNextPacket(int adeviceindex, int auartindex) {
+#else
+static int BL0942_UART_TryToGetNextPacket() {
+	int auartindex = UART_GetSelectedPortIndex();
+#endif
+	static const byte header = BL0942_UART_PACKET_HEAD;
+	byte packet[BL0942_UART_PACKET_LEN];
 	int cs;
 	int i;
-	int c_garbage_consumed = 0;
+	int c_garbage_consumed;
 	byte checksum;
 
 	cs = UART_GetDataSizeEx(auartindex);
@@ -187,16 +132,13 @@ static int BL0942_UART_TryToGetNextPacket(int adeviceindex, int auartindex) {
 		return 0;
 	}
 	// skip garbage data (should not happen)
-	while(cs > 0) {
-        if (UART_GetByteEx(auartindex,0) != BL0942_UART_PACKET_HEAD) {
-			UART_ConsumeBytesEx(auartindex, 1);
-			c_garbage_consumed++;
-			cs--;
-		} else {
-			break;
-		}
+	c_garbage_consumed = UART_FindHeaderEx(auartindex, 0, &header, 1);
+	if(c_garbage_consumed < 0) {
+		c_garbage_consumed = cs;
 	}
 	if(c_garbage_consumed > 0){
+		UART_ConsumeBytesEx(auartindex, c_garbage_consumed);
+		cs -= c_garbage_consumed;
         ADDLOG_WARN(LOG_FEATURE_ENERGYMETER,
                     "Consumed %i unwanted non-header byte in BL0942 buffer\n",
                     c_garbage_consumed);
@@ -204,38 +146,36 @@ static int BL0942_UART_TryToGetNextPacket(int adeviceindex, int auartindex) {
 	if(cs < BL0942_UART_PACKET_LEN) {
 		return 0;
 	}
-    if (UART_GetByteEx(auartindex, 0) != 0x55)
-		return 0;
+	UART_CopyBytesEx(auartindex, 0, packet, BL0942_UART_PACKET_LEN);
     checksum = BL0942_UART_CMD_READ(BL0942_UART_ADDR);
 
     for(i = 0; i < BL0942_UART_PACKET_LEN-1; i++) {
-        checksum += UART_GetByteEx(auartindex, i);
+        checksum += packet[i];
 	}
 	checksum ^= 0xFF;
 
-    if (checksum != UART_GetByteEx(auartindex, BL0942_UART_PACKET_LEN - 1)) {
+    if (checksum != packet[BL0942_UART_PACKET_LEN - 1]) {
         ADDLOG_WARN(LOG_FEATURE_ENERGYMETER,
                     "Skipping packet with bad checksum %02X wanted %02X\n",
-                    UART_GetByteEx(auartindex, BL0942_UART_PACKET_LEN - 1), checksum);
+                    packet[BL0942_UART_PACKET_LEN - 1], checksum);
         UART_ConsumeBytesEx(auartindex, BL0942_UART_PACKET_LEN);
 		return 1;
 	}
 
     bl0942_data_t data;
-    data.i_rms =
-        (UART_GetByteEx(auartindex, 3) << 16) | (UART_GetByteEx(auartindex, 2) << 8) | UART_GetByteEx(auartindex, 1);
-    data.v_rms =
-        (UART_GetByteEx(auartindex, 6) << 16) | (UART_GetByteEx(auartindex, 5) << 8) | UART_GetByteEx(auartindex, 4);
-    data.watt = Int24ToInt32((UART_GetByteEx(auartindex, 12) << 16) |
-                             (UART_GetByteEx(auartindex, 11) << 8) | UART_GetByteEx(auartindex, 10));
-    data.cf_cnt =
-        (UART_GetByteEx(auartindex, 15) << 16) | (UART_GetByteEx(auartindex, 14) << 8) | UART_GetByteEx(auartindex, 13);
-    data.freq = (UART_GetByteEx(auartindex, 17) << 8) | UART_GetByteEx(auartindex, 16);
+    data.i_rms = (packet[3] << 16) | (packet[2] << 8) | packet[1];
+    data.v_rms = (packet[6] << 16) | (packet[5] << 8) | packet[4];
+    data.watt = Int24ToInt32((packet[12] << 16) | (packet[11] << 8) | packet[10]);
+    data.cf_cnt = (packet[15] << 16) | (packet[14] << 8) | packet[13];
+    data.freq = (packet[17] << 8) | packet[16];
+#if ENABLE_BL_TWIN
     ScaleAndUpdate(adeviceindex, &data);
+#else
+    ScaleAndUpdate(&data);
+#endif
     UART_ConsumeBytesEx(auartindex, BL0942_UART_PACKET_LEN);
 	return BL0942_UART_PACKET_LEN;
 }
-#endif
 
 #if ENABLE_BL_TWIN
 static void UART_WriteReg(int auartindex, uint8_t reg, uint32_t val) {
@@ -315,7 +255,20 @@ static int SPI_WriteReg(uint8_t reg, uint32_t val) {
     return -1;
 }
 
+static uint32_t BL0942_GetMode(void) {
+#if ENABLE_BL_SAMPLES
+    // RMS registers refresh every 400 ms instead of 800 ms
+    if (BL_Samples_IsFastPolling()) {
+        return BL0942_MODE_DEFAULT;
+    }
+#endif
+    return BL0942_MODE_DEFAULT | BL0942_MODE_RMS_UPDATE_SEL_800_MS;
+}
+
 static void BL0942_Init(void) {
+#if ENABLE_BL_SAMPLES
+  bl0942_mode = BL0942_GetMode();
+#endif
   PrevCfCnt[BL0942_DEVICE_INDEX_0] = CF_CNT_INVALID;
 #if ENABLE_BL_TWIN
   PrevCfCnt[BL0942_DEVICE_INDEX_1] = CF_CNT_INVALID;
@@ -339,8 +292,7 @@ void BL0942_UART_Init(void) {
   UART_InitReceiveRingBuffer(BL0942_UART_RECEIVE_BUFFER_SIZE);
 
   UART_WriteReg(BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
-  UART_WriteReg(BL0942_REG_MODE,
-    BL0942_MODE_DEFAULT | BL0942_MODE_RMS_UPDATE_SEL_800_MS);
+  UART_WriteReg(BL0942_REG_MODE, BL0942_GetMode());
 }
 #else
 void BL0942_UART_InitEx(int auartindex) {
@@ -352,8 +304,7 @@ void BL0942_UART_InitEx(int auartindex) {
 	UART_InitReceiveRingBufferEx(auartindex, BL0942_UART_RECEIVE_BUFFER_SIZE);
 
     UART_WriteReg(auartindex, BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
-    UART_WriteReg(auartindex, BL0942_REG_MODE,
-                  BL0942_MODE_DEFAULT | BL0942_MODE_RMS_UPDATE_SEL_800_MS);
+    UART_WriteReg(auartindex, BL0942_REG_MODE, BL0942_GetMode());
 }
 
 void BL0942_UART_Init(void) {
@@ -373,7 +324,7 @@ void BL0942_UART_Init(void) {
 #endif
 
 #if ENABLE_BL_TWIN
-void BL0942_UART_RunEverySecondEx(int adeviceindex, int auartindex) {
+static void BL0942_UART_PollEx(int adeviceindex, int auartindex) {
   BL0942_UART_TryToGetNextPacket(adeviceindex, auartindex);
 
   UART_InitUARTEx(auartindex, bl0942_baudRate, 0, false);
@@ -381,22 +332,23 @@ void BL0942_UART_RunEverySecondEx(int adeviceindex, int auartindex) {
   UART_SendByteEx(auartindex, BL0942_UART_REG_PACKET);
 }
 
-void BL0942_UART_RunEverySecond(void) {
+static void BL0942_UART_Poll(void) {
   if (!bl0942_opts) {
     int fuartindex = UART_GetSelectedPortIndex();
-    BL0942_UART_RunEverySecondEx(BL0942_DEVICE_INDEX_0, fuartindex);
+    BL0942_UART_PollEx(BL0942_DEVICE_INDEX_0, fuartindex);
   }
   else {
     if (bl0942_opts & BL0942_OPTBIT0_UART1) {
-      BL0942_UART_RunEverySecondEx(BL0942_DEVICE_INDEX_0, UART_PORT_INDEX_0);
+      BL0942_UART_PollEx(BL0942_DEVICE_INDEX_0, UART_PORT_INDEX_0);
     }
     if (bl0942_opts & BL0942_OPTBIT1_UART2) {
-      BL0942_UART_RunEverySecondEx(BL0942_DEVICE_INDEX_1, UART_PORT_INDEX_1);
+      BL0942_UART_PollEx(BL0942_DEVICE_INDEX_1, UART_PORT_INDEX_1);
     }
   }
 }
 #else
-void BL0942_UART_RunEverySecond(void) {
+// reads packet requested by previous poll and requests next one
+static void BL0942_UART_Poll(void) {
 #if ENABLE_BL_TWIN
   int fuartindex = UART_GetSelectedPortIndex();
   BL0942_UART_TryToGetNextPacket(BL0942_DEVICE_INDEX_0, fuartindex);
@@ -412,6 +364,65 @@ void BL0942_UART_RunEverySecond(void) {
 }
 #endif
 
+#if ENABLE_BL_SAMPLES
+#if ENABLE_BL_TWIN
+static void BL0942_UART_WriteModeEx(int auartindex) {
+  UART_WriteReg(auartindex, BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
+  UART_WriteReg(auartindex, BL0942_REG_MODE, bl0942_mode);
+}
+
+static void BL0942_UART_WriteMode(void) {
+  if (!bl0942_opts) {
+    BL0942_UART_WriteModeEx(UART_GetSelectedPortIndex());
+  }
+  else {
+    if (bl0942_opts & BL0942_OPTBIT0_UART1) {
+      BL0942_UART_WriteModeEx(UART_PORT_INDEX_0);
+    }
+    if (bl0942_opts & BL0942_OPTBIT1_UART2) {
+      BL0942_UART_WriteModeEx(UART_PORT_INDEX_1);
+    }
+  }
+}
+#else
+static void BL0942_UART_WriteMode(void) {
+  UART_WriteReg(BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
+  UART_WriteReg(BL0942_REG_MODE, bl0942_mode);
+}
+#endif
+#endif
+
+void BL0942_UART_RunEverySecond(void) {
+#if ENABLE_BL_SAMPLES
+  if (BL0942_GetMode() != bl0942_mode) {
+    bl0942_mode = BL0942_GetMode();
+    BL0942_UART_WriteMode();
+  }
+  if (BL_Samples_IsFastPolling()) {
+    // polled in quick tick, just publish what was read
+    BL_ProcessHeldSamples();
+    return;
+  }
+#endif
+  BL0942_UART_Poll();
+}
+
+#if ENABLE_BL_SAMPLES
+void BL0942_UART_RunQuickTick(void) {
+  static int msSincePoll = 0;
+
+  if (!BL_Samples_IsFastPolling()) {
+    return;
+  }
+  msSincePoll += g_deltaTimeMS;
+  if (msSincePoll < BL_Samples_GetIntervalMs()) {
+    return;
+  }
+  msSincePoll = 0;
+  BL0942_UART_Poll();
+}
+#endif
+
 void BL0942_SPI_Init(void) {
 	BL0942_Init();
 
@@ -427,11 +438,10 @@ void BL0942_SPI_Init(void) {
 	OBK_SPI_Init(&cfg);
 
     SPI_WriteReg(BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
-    SPI_WriteReg(BL0942_REG_MODE,
-                 BL0942_MODE_DEFAULT | BL0942_MODE_RMS_UPDATE_SEL_800_MS);
+    SPI_WriteReg(BL0942_REG_MODE, BL0942_GetMode());
 }
 
-void BL0942_SPI_RunEverySecond(void) {
+static void BL0942_SPI_Poll(void) {
     bl0942_data_t data;
     SPI_ReadReg(BL0942_REG_I_RMS, &data.i_rms);
     SPI_ReadReg(BL0942_REG_V_RMS, &data.v_rms);
@@ -446,6 +456,37 @@ void BL0942_SPI_RunEverySecond(void) {
 #endif
 }
 
+void BL0942_SPI_RunEverySecond(void) {
+#if ENABLE_BL_SAMPLES
+    if (BL0942_GetMode() != bl0942_mode) {
+        bl0942_mode = BL0942_GetMode();
+        SPI_WriteReg(BL0942_REG_USR_WRPROT, BL0942_USR_WRPROT_DISABLE);
+        SPI_WriteReg(BL0942_REG_MODE, bl0942_mode);
+    }
+    if (BL_Samples_IsFastPolling()) {
+        BL_ProcessHeldSamples();
+        return;
+    }
+#endif
+    BL0942_SPI_Poll();
+}
+
+#if ENABLE_BL_SAMPLES
+void BL0942_SPI_RunQuickTick(void) {
+    static int msSincePoll = 0;
+
+    if (!BL_Samples_IsFastPolling()) {
+        return;
+    }
+    msSincePoll += g_deltaTimeMS;
+    if (msSincePoll < BL_Samples_GetIntervalMs()) {
+        return;
+    }
+    msSincePoll = 0;
+    BL0942_SPI_Poll();
+}
+#endif
+
 #if ENABLE_BL_TWIN
 static commandResult_t CMD_BL0942opts(const void* context, const char* cmd, const char* args, int cmdFlags) {
   Tokenizer_TokenizeString(args, 0);
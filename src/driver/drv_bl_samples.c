@@ -0,0 +1,533 @@
+#include "../new_common.h"
+#include "../obk_config.h"
+
+#if ENABLE_BL_SAMPLES
+
+#include <math.h>
+
+#include "../logging/logging.h"
+#include "../cmnds/cmd_public.h"
+#include "../httpserver/new_http.h"
+#include "../quicktick.h"
+#include "drv_public.h"
+#include "drv_bl_samples.h"
+
+// Sample ring and windowed statistics for power metering chips.
+// Drivers give here every reading parsed from UART/SPI packet, so short events
+// like inrush current are not lost between once a second MQTT publishes.
+// Enabled with 'EnergySamples [RingSize] [IntervalMs]', then:
+// - last RingSize samples (at most one per IntervalMs) are kept for /api/energysamples
+// - min/max/mean/RMS and approximate percentiles are counted over 1 s, 1 min and 15 min
+//   windows, see DRV_GetReadingStat and $power_max_1s style constants.
+// Per sample work is a few additions and one histogram bin increment,
+// no JSON, MQTT or flash is involved.
+
+// percentiles come from log scale histogram, 4 bins per octave,
+// so they are accurate to about 10%
+#define BL_SAMPLES_HIST_BINS 64
+#define BL_SAMPLES_HIST_BINS_PER_OCTAVE 4
+// histograms are kept for current and power only
+#define BL_SAMPLES_HIST_QUANTITIES 2
+// max records in one /api/energysamples reply, client asks again with since=next
+#define BL_SAMPLES_EXPORT_MAX 64
+#define BL_SAMPLES_EXPORT_HEADER 24
+#define BL_SAMPLES_EXPORT_RECORD 16
+#define BL_SAMPLES_MAX_RING 4096
+#define BL_SAMPLES_MIN_INTERVAL 10
+// chips don't refresh readings faster, polling them more often only repeats values
+#define BL_SAMPLES_BL0942_INTERVAL 400
+#define BL_SAMPLES_CSE7766_INTERVAL 50
+
+typedef struct blSample_s {
+	unsigned int timeMs;
+	float values[BL_SAMPLE__NUM_QUANTITIES];
+} blSample_t;
+
+typedef struct blSamplesWindow_s {
+	// window being filled
+	unsigned int startMs;
+	int count;
+	float min[BL_SAMPLE__NUM_QUANTITIES];
+	float max[BL_SAMPLE__NUM_QUANTITIES];
+	// double, 15 minutes of samples would lose precision in float
+	double sum[BL_SAMPLE__NUM_QUANTITIES];
+	double sumSq[BL_SAMPLE__NUM_QUANTITIES];
+	unsigned short hist[BL_SAMPLES_HIST_QUANTITIES][BL_SAMPLES_HIST_BINS];
+	// results of last completed window
+	float stats[BL_SAMPLE__NUM_QUANTITIES][BL_SAMPLE__NUM_STATS];
+} blSamplesWindow_t;
+
+typedef struct blSamplesMeter_s {
+	blSample_t *ring;
+	// number of samples ever added to ring, last one is at (seq - 1) % ringSize
+	unsigned int seq;
+	unsigned int lastSampleMs;
+	bool bStarted;
+	blSamplesWindow_t windows[BL_SAMPLE__NUM_WINDOWS];
+} blSamplesMeter_t;
+
+static blSamplesMeter_t *g_samplesMeters[BL_SAMPLES_MAX_METERS];
+// 0 means disabled
+static int g_samplesRingSize = 0;
+static int g_samplesIntervalMs = 1000;
+
+static const unsigned int g_samplesWindowMs[BL_SAMPLE__NUM_WINDOWS] = { 1000, 60 * 1000, 15 * 60 * 1000 };
+// value of first histogram bin, 1 mA and 0.25 W
+static const float g_samplesHistBase[BL_SAMPLES_HIST_QUANTITIES] = { 0.001f, 0.25f };
+
+static const char *g_samplesQuantityNames[BL_SAMPLE__NUM_QUANTITIES] = { "voltage", "current", "power" };
+static const char *g_samplesStatNames[BL_SAMPLE__NUM_STATS] = { "min", "max", "avg", "rms", "p50", "p90", "p99", "count" };
+static const char *g_samplesWindowNames[BL_SAMPLE__NUM_WINDOWS] = { "1s", "1m", "15m" };
+
+static unsigned int Samples_NowMs() {
+	return g_timeMs;
+}
+
+static int Samples_Bin(float v, float base) {
+	float m;
+	int e, bin;
+
+	v = fabsf(v) / base;
+	if (v < 1.0f) {
+		return 0;
+	}
+	// v = m * 2^e, m in [0.5, 1)
+	m = frexpf(v, &e);
+	bin = 1 + (e - 1) * BL_SAMPLES_HIST_BINS_PER_OCTAVE + (int)((m * 2.0f - 1.0f) * BL_SAMPLES_HIST_BINS_PER_OCTAVE);
+	if (bin >= BL_SAMPLES_HIST_BINS) {
+		bin = BL_SAMPLES_HIST_BINS - 1;
+	}
+	return bin;
+}
+
+// middle of the bin
+static float Samples_BinValue(int bin, float base) {
+	if (bin == 0) {
+		return base * 0.5f;
+	}
+	bin--;
+	return ldexpf(base * (1.0f + ((bin % BL_SAMPLES_HIST_BINS_PER_OCTAVE) + 0.5f) / BL_SAMPLES_HIST_BINS_PER_OCTAVE),
+		bin / BL_SAMPLES_HIST_BINS_PER_OCTAVE);
+}
+
+static float Samples_Percentile(const unsigned short *hist, float base, float p, float lo, float hi) {
+	int total, target, sum, i;
+	float v;
+
+	total = 0;
+	for (i = 0; i < BL_SAMPLES_HIST_BINS; i++) {
+		total += hist[i];
+	}
+	target = (int)ceilf(p * total);
+	if (target < 1) {
+		target = 1;
+	}
+	sum = 0;
+	for (i = 0; i < BL_SAMPLES_HIST_BINS; i++) {
+		sum += hist[i];
+		if (sum >= target) {
+			break;
+		}
+	}
+	v = Samples_BinValue(i, base);
+	// exact value for flat signal
+	if (v < lo)
+		v = lo;
+	if (v > hi)
+		v = hi;
+	return v;
+}
+
+static void Samples_CloseWindow(blSamplesWindow_t *w, bool bEmpty) {
+	static const float percentiles[3] = { 0.5f, 0.9f, 0.99f };
+	float *st, lo, hi;
+	int q, h, i;
+
+	for (q = 0; q < BL_SAMPLE__NUM_QUANTITIES; q++) {
+		st = w->stats[q];
+		for (i = 0; i < BL_SAMPLE__NUM_STATS; i++) {
+			st[i] = NAN;
+		}
+		if (bEmpty || w->count == 0) {
+			st[BL_SAMPLE_STAT_COUNT] = 0;
+			continue;
+		}
+		st[BL_SAMPLE_STAT_MIN] = w->min[q];
+		st[BL_SAMPLE_STAT_MAX] = w->max[q];
+		st[BL_SAMPLE_STAT_MEAN] = (float)(w->sum[q] / w->count);
+		st[BL_SAMPLE_STAT_RMS] = (float)sqrt(w->sumSq[q] / w->count);
+		st[BL_SAMPLE_STAT_COUNT] = (float)w->count;
+		if (q == BL_SAMPLE_VOLTAGE) {
+			continue;
+		}
+		// histogram has absolute values
+		h = q - BL_SAMPLE_CURRENT;
+		hi = fabsf(w->max[q]) > fabsf(w->min[q]) ? fabsf(w->max[q]) : fabsf(w->min[q]);
+		lo = w->min[q] >= 0 ? w->min[q] : 0;
+		for (i = 0; i < 3; i++) {
+			st[BL_SAMPLE_STAT_P50 + i] = Samples_Percentile(w->hist[h], g_samplesHistBase[h], percentiles[i], lo, hi);
+		}
+	}
+	w->count = 0;
+	memset(w->sum, 0, sizeof(w->sum));
+	memset(w->sumSq, 0, sizeof(w->sumSq));
+	memset(w->hist, 0, sizeof(w->hist));
+}
+
+// complete windows that have ended, also when no samples come
+static void Samples_Roll(blSamplesMeter_t *m, unsigned int now) {
+	blSamplesWindow_t *w;
+	unsigned int elapsed;
+	int i;
+
+	for (i = 0; i < BL_SAMPLE__NUM_WINDOWS; i++) {
+		w = &m->windows[i];
+		elapsed = now - w->startMs;
+		if (elapsed < g_samplesWindowMs[i]) {
+			continue;
+		}
+		// if whole window has passed without samples, last completed one is empty
+		Samples_CloseWindow(w, elapsed >= 2 * g_samplesWindowMs[i]);
+		w->startMs += elapsed - elapsed % g_samplesWindowMs[i];
+	}
+}
+
+static blSamplesMeter_t *Samples_GetMeter(int meter) {
+	blSamplesMeter_t *m;
+	int i;
+
+	m = g_samplesMeters[meter];
+	if (m) {
+		return m;
+	}
+	m = (blSamplesMeter_t*)malloc(sizeof(blSamplesMeter_t));
+	if (m == 0) {
+		return 0;
+	}
+	memset(m, 0, sizeof(*m));
+	m->ring = (blSample_t*)malloc(g_samplesRingSize * sizeof(blSample_t));
+	if (m->ring == 0) {
+		free(m);
+		return 0;
+	}
+	for (i = 0; i < BL_SAMPLE__NUM_WINDOWS; i++) {
+		Samples_CloseWindow(&m->windows[i], true);
+	}
+	g_samplesMeters[meter] = m;
+	return m;
+}
+
+static void Samples_Free() {
+	int i;
+
+	for (i = 0; i < BL_SAMPLES_MAX_METERS; i++) {
+		if (g_samplesMeters[i]) {
+			free(g_samplesMeters[i]->ring);
+			free(g_samplesMeters[i]);
+			g_samplesMeters[i] = 0;
+		}
+	}
+}
+
+void BL_Samples_Add(int meter, float voltage, float current, float power) {
+	blSamplesMeter_t *m;
+	blSamplesWindow_t *w;
+	blSample_t *s;
+	unsigned short *bin;
+	unsigned int now;
+	float values[BL_SAMPLE__NUM_QUANTITIES];
+	int i, q, h, interval;
+
+	if (g_samplesRingSize <= 0 || meter < 0 || meter >= BL_SAMPLES_MAX_METERS) {
+		return;
+	}
+	m = Samples_GetMeter(meter);
+	if (m == 0) {
+		return;
+	}
+	now = Samples_NowMs();
+	if (m->bStarted == false) {
+		for (i = 0; i < BL_SAMPLE__NUM_WINDOWS; i++) {
+			m->windows[i].startMs = now;
+		}
+		m->bStarted = true;
+	}
+	Samples_Roll(m, now);
+
+	values[BL_SAMPLE_VOLTAGE] = voltage;
+	values[BL_SAMPLE_CURRENT] = current;
+	values[BL_SAMPLE_POWER] = power;
+	// every reading goes to statistics...
+	for (i = 0; i < BL_SAMPLE__NUM_WINDOWS; i++) {
+		w = &m->windows[i];
+		for (q = 0; q < BL_SAMPLE__NUM_QUANTITIES; q++) {
+			if (w->count == 0 || values[q] < w->min[q])
+				w->min[q] = values[q];
+			if (w->count == 0 || values[q] > w->max[q])
+				w->max[q] = values[q];
+			w->sum[q] += values[q];
+			w->sumSq[q] += values[q] * values[q];
+		}
+		for (h = 0; h < BL_SAMPLES_HIST_QUANTITIES; h++) {
+			bin = &w->hist[h][Samples_Bin(values[BL_SAMPLE_CURRENT + h], g_samplesHistBase[h])];
+			if (++(*bin) == 0xFFFF) {
+				// keep proportions instead of overflowing
+				for (q = 0; q < BL_SAMPLES_HIST_BINS; q++) {
+					w->hist[h][q] >>= 1;
+				}
+			}
+		}
+		w->count++;
+	}
+	// ...but ring only keeps them at requested rate. A bit of jitter is allowed,
+	// so a chip polled every IntervalMs doesn't lose every second sample
+	interval = BL_Samples_GetIntervalMs();
+	if (m->seq && now - m->lastSampleMs < (unsigned int)(interval - interval / 4)) {
+		return;
+	}
+	s = &m->ring[m->seq % g_samplesRingSize];
+	s->timeMs = now;
+	s->values[BL_SAMPLE_VOLTAGE] = voltage;
+	s->values[BL_SAMPLE_CURRENT] = current;
+	s->values[BL_SAMPLE_POWER] = power;
+	m->lastSampleMs = now;
+	m->seq++;
+}
+
+int BL_Samples_IsFastPolling(void) {
+	return g_samplesRingSize > 0 && BL_Samples_GetIntervalMs() < 1000;
+}
+
+// shortest period in which running metering chip has new readings
+static int Samples_GetChipIntervalMs(void) {
+	static const char* const bl0942[] = { "BL0942", "BL0942SPI" };
+	static int bl0942Cache[2];
+	static int cse7766Cache;
+
+	if (DRV_IsAnyRunningCached(bl0942, bl0942Cache, 2)) {
+		return BL_SAMPLES_BL0942_INTERVAL;
+	}
+	if (DRV_IsRunningCached("CSE7766", &cse7766Cache)) {
+		return BL_SAMPLES_CSE7766_INTERVAL;
+	}
+	return BL_SAMPLES_MIN_INTERVAL;
+}
+
+// requested interval, but not shorter than what the chip can deliver
+int BL_Samples_GetIntervalMs(void) {
+	int chip = Samples_GetChipIntervalMs();
+
+	return g_samplesIntervalMs < chip ? chip : g_samplesIntervalMs;
+}
+
+float DRV_GetReadingStat(int meter, blSampleQuantity_t quantity, blSampleWindow_t window, blSampleStat_t stat) {
+	blSamplesMeter_t *m;
+
+	if (meter < 0 || meter >= BL_SAMPLES_MAX_METERS)
+		return NAN;
+	if (quantity < 0 || quantity >= BL_SAMPLE__NUM_QUANTITIES)
+		return NAN;
+	if (window < 0 || window >= BL_SAMPLE__NUM_WINDOWS)
+		return NAN;
+	if (stat < 0 || stat >= BL_SAMPLE__NUM_STATS)
+		return NAN;
+	m = g_samplesMeters[meter];
+	if (m == 0 || m->bStarted == false) {
+		return NAN;
+	}
+	Samples_Roll(m, Samples_NowMs());
+	return m->windows[window].stats[quantity][stat];
+}
+
+// matches one of words at s, followed by terminator (0 means end of constant)
+static const char *Samples_MatchWord(const char *s, const char *stop, const char **words, int count, char term, int *index) {
+	const char *e;
+	int i, len;
+
+	for (i = 0; i < count; i++) {
+		len = strlen(words[i]);
+		if (stop && s + len > stop)
+			continue;
+		if (wal_strnicmp(s, words[i], len))
+			continue;
+		e = s + len;
+		if (term) {
+			if (e == stop || *e != term)
+				continue;
+			e++;
+		}
+		else if (e != stop && (isalnum((int)*e) || *e == '_')) {
+			continue;
+		}
+		*index = i;
+		return e;
+	}
+	return 0;
+}
+
+//cnstdetail:{"name":"$power_max_1s",
+//cnstdetail:"title":"$power_max_1s",
+//cnstdetail:"descr":"Statistics of power metering samples, see EnergySamples command. Name is $[voltage|current|power]_[min|max|avg|rms|p50|p90|p99|count]_[1s|1m|15m], for example $current_p99_1m. Values are from last completed window, percentiles are approximate and only for current and power.",
+//cnstdetail:"requires":""}
+const char *BL_Samples_ExpandConstant(const char *s, const char *stop, float *out) {
+	int q, st, w;
+
+	if (*s != '$') {
+		return 0;
+	}
+	s++;
+	s = Samples_MatchWord(s, stop, g_samplesQuantityNames, BL_SAMPLE__NUM_QUANTITIES, '_', &q);
+	if (s == 0) {
+		return 0;
+	}
+	s = Samples_MatchWord(s, stop, g_samplesStatNames, BL_SAMPLE__NUM_STATS, '_', &st);
+	if (s == 0) {
+		return 0;
+	}
+	s = Samples_MatchWord(s, stop, g_samplesWindowNames, BL_SAMPLE__NUM_WINDOWS, 0, &w);
+	if (s == 0) {
+		return 0;
+	}
+	*out = DRV_GetReadingStat(0, q, w, st);
+	return s;
+}
+
+static void Samples_Put32(byte *p, unsigned int v) {
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = (v >> 24) & 0xFF;
+}
+
+static void Samples_PutFloat(byte *p, float f) {
+	unsigned int v;
+
+	memcpy(&v, &f, sizeof(v));
+	Samples_Put32(p, v);
+}
+
+// /api/energysamples?meter=0&since=123
+// Binary reply, all little endian:
+// "OBKS", u8 version, u8 meter, u16 count, u32 seq of first record, u32 next seq,
+// u32 interval ms, u32 now ms, then count records of u32 time ms, f32 V, f32 A, f32 W.
+// Ring is written without a lock, so records are copied first
+// and the ones that were overwritten meanwhile are cut off.
+static int BL_Samples_HTTP_Export(http_request_t *request) {
+	blSamplesMeter_t *m = 0;
+	const blSample_t *s;
+	char tmp[16];
+	byte *buf, *p;
+	unsigned int since, first, seq, after;
+	int meter, count, i;
+
+	meter = 0;
+	if (http_getArg(request->url, "meter", tmp, sizeof(tmp))) {
+		meter = atoi(tmp);
+	}
+	if (meter >= 0 && meter < BL_SAMPLES_MAX_METERS) {
+		m = g_samplesMeters[meter];
+	}
+	buf = (byte*)malloc(BL_SAMPLES_EXPORT_HEADER + BL_SAMPLES_EXPORT_MAX * BL_SAMPLES_EXPORT_RECORD);
+	if (m == 0 || buf == 0) {
+		free(buf);
+		request->responseCode = 404;
+		http_setup(request, httpMimeTypeText);
+		poststr(request, "No samples, see EnergySamples command");
+		poststr(request, NULL);
+		return 0;
+	}
+	seq = m->seq;
+	first = seq > (unsigned int)g_samplesRingSize ? seq - g_samplesRingSize : 0;
+	since = first;
+	if (http_getArg(request->url, "since", tmp, sizeof(tmp))) {
+		since = strtoul(tmp, 0, 10);
+	}
+	if (since > first && since <= seq) {
+		first = since;
+	}
+	count = seq - first;
+	if (count > BL_SAMPLES_EXPORT_MAX) {
+		count = BL_SAMPLES_EXPORT_MAX;
+	}
+	p = buf + BL_SAMPLES_EXPORT_HEADER;
+	for (i = 0; i < count; i++, p += BL_SAMPLES_EXPORT_RECORD) {
+		s = &m->ring[(first + i) % g_samplesRingSize];
+		Samples_Put32(p, s->timeMs);
+		Samples_PutFloat(p + 4, s->values[BL_SAMPLE_VOLTAGE]);
+		Samples_PutFloat(p + 8, s->values[BL_SAMPLE_CURRENT]);
+		Samples_PutFloat(p + 12, s->values[BL_SAMPLE_POWER]);
+	}
+	after = m->seq;
+	if (after - first > (unsigned int)g_samplesRingSize) {
+		// oldest records were overwritten while copying
+		i = after - first - g_samplesRingSize;
+		if (i > count)
+			i = count;
+		memmove(buf + BL_SAMPLES_EXPORT_HEADER, buf + BL_SAMPLES_EXPORT_HEADER + i * BL_SAMPLES_EXPORT_RECORD,
+			(count - i) * BL_SAMPLES_EXPORT_RECORD);
+		first += i;
+		count -= i;
+	}
+	memcpy(buf, "OBKS", 4);
+	buf[4] = 1;
+	buf[5] = meter;
+	buf[6] = count & 0xFF;
+	buf[7] = (count >> 8) & 0xFF;
+	Samples_Put32(buf + 8, first);
+	Samples_Put32(buf + 12, first + count);
+	Samples_Put32(buf + 16, BL_Samples_GetIntervalMs());
+	Samples_Put32(buf + 20, Samples_NowMs());
+
+	http_setup(request, "application/octet-stream");
+	postany(request, (const char*)buf, BL_SAMPLES_EXPORT_HEADER + count * BL_SAMPLES_EXPORT_RECORD);
+	poststr(request, NULL);
+	free(buf);
+	return 0;
+}
+
+static commandResult_t CMD_EnergySamples(const void *context, const char *cmd, const char *args, int cmdFlags) {
+	int ringSize, interval;
+
+	Tokenizer_TokenizeString(args, 0);
+	if (Tokenizer_GetArgsCount() == 0) {
+		ADDLOG_INFO(LOG_FEATURE_ENERGYMETER, "EnergySamples: ring %i, interval %i ms (requested %i ms)",
+			g_samplesRingSize, BL_Samples_GetIntervalMs(), g_samplesIntervalMs);
+		return CMD_RES_OK;
+	}
+	ringSize = Tokenizer_GetArgInteger(0);
+	interval = Tokenizer_GetArgIntegerDefault(1, 1000);
+	if (ringSize < 0 || ringSize > BL_SAMPLES_MAX_RING || interval < BL_SAMPLES_MIN_INTERVAL) {
+		return CMD_RES_BAD_ARGUMENT;
+	}
+	// interval is only read by drivers, it can change any time,
+	// BL0942 sends its new RMS refresh mode on next second
+	g_samplesIntervalMs = interval;
+	if (BL_Samples_GetIntervalMs() != interval) {
+		ADDLOG_INFO(LOG_FEATURE_ENERGYMETER, "EnergySamples: chip refreshes every %i ms, using that",
+			BL_Samples_GetIntervalMs());
+	}
+	if (ringSize == g_samplesRingSize) {
+		return CMD_RES_OK;
+	}
+	// running driver adds samples from its own tick, ring can't be freed under it
+	if (DRV_IsMeasuringPower()) {
+		ADDLOG_ERROR(LOG_FEATURE_ENERGYMETER, "EnergySamples: stop power metering driver to change ring size");
+		return CMD_RES_ERROR;
+	}
+	// sizes change, so start over
+	Samples_Free();
+	g_samplesRingSize = ringSize;
+	return CMD_RES_OK;
+}
+
+void BL_Samples_Init(void) {
+	HTTP_RegisterCallback("/api/energysamples", HTTP_GET, BL_Samples_HTTP_Export, 1);
+
+	//cmddetail:{"name":"EnergySamples","args":"[RingSize][IntervalMs]",
+	//cmddetail:"descr":"Keeps power metering samples in a ring of RingSize (0 disables, default) at most one per IntervalMs, and counts 1 s, 1 min and 15 min statistics of them, see $power_max_1s. With IntervalMs below 1000, BL0942 and CSE7766 are read that often, but not faster than they refresh readings (BL0942 400 ms, CSE7766 50 ms). Samples can be downloaded in binary from /api/energysamples?since=N. RingSize can only be changed while no power metering driver runs, IntervalMs any time.",
+	//cmddetail:"fn":"CMD_EnergySamples","file":"driver/drv_bl_samples.c","requires":"",
+	//cmddetail:"examples":"EnergySamples 256 100"}
+	CMD_RegisterCommand("EnergySamples", CMD_EnergySamples, NULL);
+}
+
+#endif
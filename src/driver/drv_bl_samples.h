@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../obk_config.h"
+
+#if ENABLE_BL_SAMPLES
+
+// two BL0942 (ENABLE_BL_TWIN) or two channels of HLW8112
+#define BL_SAMPLES_MAX_METERS 2
+
+typedef enum {
+	BL_SAMPLE_VOLTAGE,
+	BL_SAMPLE_CURRENT,
+	BL_SAMPLE_POWER,
+	BL_SAMPLE__NUM_QUANTITIES
+} blSampleQuantity_t;
+
+typedef enum {
+	BL_SAMPLE_WINDOW_1S,
+	BL_SAMPLE_WINDOW_1M,
+	BL_SAMPLE_WINDOW_15M,
+	BL_SAMPLE__NUM_WINDOWS
+} blSampleWindow_t;
+
+typedef enum {
+	BL_SAMPLE_STAT_MIN,
+	BL_SAMPLE_STAT_MAX,
+	BL_SAMPLE_STAT_MEAN,
+	BL_SAMPLE_STAT_RMS,
+	// percentiles are only kept for current and power
+	BL_SAMPLE_STAT_P50,
+	BL_SAMPLE_STAT_P90,
+	BL_SAMPLE_STAT_P99,
+	BL_SAMPLE_STAT_COUNT,
+	BL_SAMPLE__NUM_STATS
+} blSampleStat_t;
+
+void BL_Samples_Init(void);
+// called for every reading parsed from metering chip
+void BL_Samples_Add(int meter, float voltage, float current, float power);
+// true if drivers should poll chip faster than once a second
+int BL_Samples_IsFastPolling(void);
+int BL_Samples_GetIntervalMs(void);
+// stats of last completed window, NAN if there were no samples
+float DRV_GetReadingStat(int meter, blSampleQuantity_t quantity, blSampleWindow_t window, blSampleStat_t stat);
+// $power_max_1s etc, see drv_bl_samples.c
+const char *BL_Samples_ExpandConstant(const char *s, const char *stop, float *out);
+
+#endif
@@ -15,6 +15,7 @@
 #include "drv_deviceclock.h"
 #include "drv_public.h"
 #include "drv_uart.h"
+#include "drv_bl_samples.h"
 #include "../cmnds/cmd_public.h" //for enum EventCode
 #include <math.h>
 //#include <time.h>
@@ -617,15 +618,29 @@ float BL_ChangeEnergyUnitIfNeeded(float Wh) {
 	return Wh;
 }
 
-#if ENABLE_BL_TWIN
-void BL_ProcessUpdateEx(int asensdatasetix, float voltage, float current, float power,
-  float frequency, float energyWh) {
-  if ((asensdatasetix < 0) || (asensdatasetix >= BL_SENSDATASETS_COUNT)) return;  //to avoid bad index on data[BL_SENSDATASETS_COUNT]
-#else
-void BL_ProcessUpdate(float voltage, float current, float power,
-  float frequency, float energyWh) {
-  int asensdatasetix = BL_SENSORS_IX_0;
-#endif
+static void BL_ClampReadings(float *voltage, float *current, float *power) {
+  // I had reports that BL0942 sometimes gives 
+  // a large, negative peak of current/power
+  if (!CFG_HasFlag(OBK_FLAG_POWER_ALLOW_NEGATIVE))
+  {
+    if (*power < 0.0f)
+      *power = 0.0f;
+    if (*voltage < 0.0f)
+      *voltage = 0.0f;
+    if (*current < 0.0f)
+      *current = 0.0f;
+  }
+  if (CFG_HasFlag(OBK_FLAG_POWER_FORCE_ZERO_IF_RELAYS_OPEN))
+  {
+    if (Channel_AreAllRelaysOpen()) {
+      *power = 0;
+      *current = 0;
+    }
+  }
+}
+
+static void BL_ProcessUpdateInternal(int asensdatasetix, float voltage, float current, float power,
+  float frequency, float energyWh, bool bAddSample) {
   energysensdataset_t* sensdataset = &datasetlist[asensdatasetix];
 
   int i;
@@ -639,24 +654,12 @@ void BL_ProcessUpdate(float voltage, float current, float power,
   char datetime[64];
   float diff;
 
-  // I had reports that BL0942 sometimes gives 
-  // a large, negative peak of current/power
-  if (!CFG_HasFlag(OBK_FLAG_POWER_ALLOW_NEGATIVE))
-  {
-    if (power < 0.0f)
-      power = 0.0f;
-    if (voltage < 0.0f)
-      voltage = 0.0f;
-    if (current < 0.0f)
-      current = 0.0f;
-  }
-  if (CFG_HasFlag(OBK_FLAG_POWER_FORCE_ZERO_IF_RELAYS_OPEN))
-  {
-    if (Channel_AreAllRelaysOpen()) {
-      power = 0;
-      current = 0;
-    }
+  BL_ClampReadings(&voltage, &current, &power);
+#if ENABLE_BL_SAMPLES
+  if (bAddSample) {
+    BL_Samples_Add(asensdatasetix, voltage, current, power);
   }
+#endif
 
 #ifdef ENABLE_BL_MOVINGAVG
   power = XJ_MovingAverage_float((float)sensdataset->sensors[OBK_POWER].lastReading, power);
@@ -677,6 +680,8 @@ void BL_ProcessUpdate(float voltage, float current, float power,
 
 
   sensors_reciveddata[asensdatasetix] = 1;
+  // readings are printed by BL09XX_AppendInformationToHTTPIndexPage
+  HTTP_IndexStateChanged();
   {
     float energy = 0;
     if (isnan(energyWh)) {
@@ -973,11 +978,69 @@ void BL_ProcessUpdate(float voltage, float current, float power,
 }
 
 #if ENABLE_BL_TWIN
+void BL_ProcessUpdateEx(int asensdatasetix, float voltage, float current, float power,
+  float frequency, float energyWh) {
+  if ((asensdatasetix < 0) || (asensdatasetix >= BL_SENSDATASETS_COUNT)) return;  //to avoid bad index on data[BL_SENSDATASETS_COUNT]
+  BL_ProcessUpdateInternal(asensdatasetix, voltage, current, power, frequency, energyWh, true);
+}
+#endif
+
 void BL_ProcessUpdate(float voltage, float current, float power,
   float frequency, float energyWh) {
-  BL_ProcessUpdateEx(BL_SENSORS_IX_0, voltage, current, power, frequency, energyWh);
+  BL_ProcessUpdateInternal(BL_SENSORS_IX_0, voltage, current, power, frequency, energyWh, true);
+}
+
+#if ENABLE_BL_SAMPLES
+// Readings of a driver polling chip faster than once a second wait here,
+// only the last one (with summed energy) goes to MQTT/stats/flash once a second.
+typedef struct {
+  bool bHeld;
+  float voltage, current, power, frequency;
+  float energyWh;
+} heldReading_t;
+static heldReading_t heldReadings[BL_SENSDATASETS_COUNT];
+#endif
+
+void BL_ProcessSample(int asensdatasetix, float voltage, float current, float power,
+  float frequency, float energyWh) {
+  if ((asensdatasetix < 0) || (asensdatasetix >= BL_SENSDATASETS_COUNT)) return;  //to avoid bad index on data[BL_SENSDATASETS_COUNT]
+#if ENABLE_BL_SAMPLES
+  if (BL_Samples_IsFastPolling()) {
+    heldReading_t* held = &heldReadings[asensdatasetix];
+
+    BL_ClampReadings(&voltage, &current, &power);
+    BL_Samples_Add(asensdatasetix, voltage, current, power);
+    if (!held->bHeld || isnan(held->energyWh)) {
+      held->energyWh = energyWh;
+    } else if (!isnan(energyWh)) {
+      held->energyWh += energyWh;
+    }
+    held->voltage = voltage;
+    held->current = current;
+    held->power = power;
+    held->frequency = frequency;
+    held->bHeld = true;
+    return;
+  }
+#endif
+  BL_ProcessUpdateInternal(asensdatasetix, voltage, current, power, frequency, energyWh, true);
 }
+
+void BL_ProcessHeldSamples(void) {
+#if ENABLE_BL_SAMPLES
+  heldReading_t* held;
+  int i;
+
+  for (i = 0; i < BL_SENSDATASETS_COUNT; i++) {
+    held = &heldReadings[i];
+    if (!held->bHeld)
+      continue;
+    held->bHeld = false;
+    // already in samples
+    BL_ProcessUpdateInternal(i, held->voltage, held->current, held->power, held->frequency, held->energyWh, false);
+  }
 #endif
+}
 
 void BL_Shared_Init(void) {
   energysensdataset_t* sensdataset = &datasetlist[BL_SENSORS_IX_0];
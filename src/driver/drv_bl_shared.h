@@ -8,6 +8,11 @@
 void BL_Shared_Init(void);
 void BL_ProcessUpdate(float voltage, float current, float power,
                       float frequency, float energyWh);
+// for drivers parsing chip packets, with fast polling (see EnergySamples)
+// readings are held and processed by BL_ProcessHeldSamples once a second
+void BL_ProcessSample(int asensdatasetix, float voltage, float current, float power,
+                      float frequency, float energyWh);
+void BL_ProcessHeldSamples(void);
 void BL09XX_AppendInformationToHTTPIndexPage(http_request_t *request, int bPreState);
 void BL09XX_SaveEmeteringStatistics();
 
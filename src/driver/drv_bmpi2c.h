@@ -229,48 +229,31 @@ unsigned short BMP_Read(unsigned short ack)
 
 void BMP_Write8(uint8_t reg_addr, uint8_t _data)
 {
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, reg_addr);
-	Soft_I2C_WriteByte(&g_softI2C, _data);
-	Soft_I2C_Stop(&g_softI2C);
+	Soft_I2C_WriteRegs(&g_softI2C, g_softI2C.address8bit, reg_addr, &_data, 1);
 }
 
 uint8_t BMP_Read8(uint8_t reg_addr)
 {
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, reg_addr);
-	Soft_I2C_Stop(&g_softI2C);
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit | 1);
-	uint8_t ret = BMP_Read(0);
-	Soft_I2C_Stop(&g_softI2C);
+	uint8_t ret;
+	Soft_I2C_ReadRegs(&g_softI2C, g_softI2C.address8bit, reg_addr, &ret, 1);
 
 	return ret;
 }
 
 uint16_t BMP_Read16(uint8_t reg_addr)
 {
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, reg_addr);
-	Soft_I2C_Stop(&g_softI2C);
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit | 1);
-	uint8_t b1 = BMP_Read(1);
-	uint8_t b2 = BMP_Read(0);
-	Soft_I2C_Stop(&g_softI2C);
+	uint8_t b[2];
+	Soft_I2C_ReadRegs(&g_softI2C, g_softI2C.address8bit, reg_addr, b, 2);
 
-	return(b1 | (b2 << 8));
+	return(b[0] | (b[1] << 8));
 }
 
 uint16_t BMP_Read16BE(uint8_t reg_addr)
 {
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, reg_addr);
-	Soft_I2C_Stop(&g_softI2C);
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit | 1);
-	uint8_t b1 = BMP_Read(1);
-	uint8_t b2 = BMP_Read(0);
-	Soft_I2C_Stop(&g_softI2C);
+	uint8_t b[2];
+	Soft_I2C_ReadRegs(&g_softI2C, g_softI2C.address8bit, reg_addr, b, 2);
 
-	return((uint16_t)b1 << 8 | b2);
+	return((uint16_t)b[0] << 8 | b[1]);
 }
 
 BMP_mode GetMode(int val)
@@ -376,23 +359,11 @@ void ReadCalibData_BMP180()
 
 void ReadCalibData_BME68X()
 {
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, BME68X_REG_COEFF1);
-	Soft_I2C_Stop(&g_softI2C);
-
 	uint8_t cal1[25];
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit | 1);
-	Soft_I2C_ReadBytes(&g_softI2C, cal1, 24);
-	Soft_I2C_Stop(&g_softI2C);
-
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit);
-	Soft_I2C_WriteByte(&g_softI2C, BME68X_REG_COEFF2);
-	Soft_I2C_Stop(&g_softI2C);
+	Soft_I2C_ReadRegs(&g_softI2C, g_softI2C.address8bit, BME68X_REG_COEFF1, cal1, 24);
 
 	uint8_t cal2[16];
-	Soft_I2C_Start(&g_softI2C, g_softI2C.address8bit | 1);
-	Soft_I2C_ReadBytes(&g_softI2C, cal2, 15);
-	Soft_I2C_Stop(&g_softI2C);
+	Soft_I2C_ReadRegs(&g_softI2C, g_softI2C.address8bit, BME68X_REG_COEFF2, cal2, 15);
 
 	BME68X_calib.T1  = cal2[9] << 8 | cal2[8];
 	BME68X_calib.T2  = cal1[2] << 8 | cal1[1];
@@ -204,6 +204,22 @@ goto again
 
 
 
+*/
+/*
+// Sample 10
+// Long term temperature history
+// Keeps 60 raw samples, plus min/avg/max of last 120 minutes and 72 hours.
+// Page fetches data from /chart_data?tier=0 (raw), 1 (minutes) or 2 (hours)
+startDriver charts
+startDriver NTP
+waitFor NTPState 1
+chart_create 60 1 1 120 72
+chart_setVar 0 "Temperature" "axtemp"
+chart_setAxis 0 "axtemp" 0 "Temperature (C)"
+addRepeatingEvent 10 -1 chart_addNow $CH1*0.1
+
+
+
 */
 #define AX_RIGHT 1
 typedef struct var_s {
@@ -218,6 +234,31 @@ typedef struct axis_s {
 	int flags;
 } axis_t;
 
+// Downsampled tiers, kept along with raw samples.
+// Each tier is a ring of fixed size with min/avg/max of every var per period.
+#define CHART_TIER_MINUTE 0
+#define CHART_TIER_HOUR 1
+#define CHART_MAX_TIERS 2
+
+typedef struct chartTier_s {
+	// in seconds
+	int period;
+	int maxSamples;
+	int nextSample;
+	int count;
+	time_t *times;
+	// [sample * numVars + var]
+	float *mins;
+	float *avgs;
+	float *maxs;
+	// accumulator for period that is not finished yet
+	time_t accStart;
+	int accCount;
+	float *accSum;
+	float *accMin;
+	float *accMax;
+} chartTier_t;
+
 typedef struct chart_s {
 	int maxSamples;
 	int nextSample;
@@ -227,6 +268,7 @@ typedef struct chart_s {
 	var_t *vars;
 	int numAxes;
 	axis_t *axes;
+	chartTier_t tiers[CHART_MAX_TIERS];
 } chart_t;
 
 chart_t *g_chart = 0;
@@ -261,6 +303,12 @@ void Chart_Free(chart_t **ptr) {
 	if (s->times) {
 		free(s->times);
 	}
+	for (int i = 0; i < CHART_MAX_TIERS; i++) {
+		// single block, see Chart_CreateTier
+		if (s->tiers[i].times) {
+			free(s->tiers[i].times);
+		}
+	}
 	free(s);
 	*ptr = 0;
 }
@@ -315,6 +363,73 @@ chart_t *Chart_Create(int maxSamples, int numVars, int numAxes) {
 	s->lastSample = 0; 
 	return s;
 }
+// allocates whole tier in a single block, so memory use is fixed and known upfront
+int Chart_CreateTier(chart_t *s, int tier, int period, int maxSamples) {
+	chartTier_t *t;
+	int floats;
+	byte *block;
+
+	if (!s || tier >= CHART_MAX_TIERS || maxSamples <= 0) {
+		return 0;
+	}
+	t = &s->tiers[tier];
+	floats = (maxSamples * 3 + 3) * s->numVars;
+	block = ZeroMalloc(sizeof(time_t) * maxSamples + sizeof(float) * floats);
+	if (block == 0) {
+		return 0;
+	}
+	t->times = (time_t*)block;
+	t->mins = (float*)(block + sizeof(time_t) * maxSamples);
+	t->avgs = t->mins + maxSamples * s->numVars;
+	t->maxs = t->avgs + maxSamples * s->numVars;
+	t->accSum = t->maxs + maxSamples * s->numVars;
+	t->accMin = t->accSum + s->numVars;
+	t->accMax = t->accMin + s->numVars;
+	t->period = period;
+	t->maxSamples = maxSamples;
+	return 1;
+}
+static void Chart_TierCommit(chart_t *s, chartTier_t *t) {
+	int base = t->nextSample * s->numVars;
+
+	t->times[t->nextSample] = t->accStart;
+	for (int v = 0; v < s->numVars; v++) {
+		t->mins[base + v] = t->accMin[v];
+		t->avgs[base + v] = t->accSum[v] / t->accCount;
+		t->maxs[base + v] = t->accMax[v];
+	}
+	t->nextSample = (t->nextSample + 1) % t->maxSamples;
+	if (t->count < t->maxSamples) {
+		t->count++;
+	}
+	t->accCount = 0;
+}
+// called for every raw sample, values are at raw index 'rawIndex'
+static void Chart_TierAdd(chart_t *s, chartTier_t *t, int rawIndex, time_t time) {
+	time_t start = time - (time % t->period);
+	float f;
+
+	if (t->accCount && start != t->accStart) {
+		Chart_TierCommit(s, t);
+	}
+	for (int v = 0; v < s->numVars; v++) {
+		f = s->vars[v].samples[rawIndex];
+		if (t->accCount == 0) {
+			t->accSum[v] = f;
+			t->accMin[v] = f;
+			t->accMax[v] = f;
+		}
+		else {
+			t->accSum[v] += f;
+			if (f < t->accMin[v])
+				t->accMin[v] = f;
+			if (f > t->accMax[v])
+				t->accMax[v] = f;
+		}
+	}
+	t->accStart = start;
+	t->accCount++;
+}
 void Chart_SetAxis(chart_t *s, int idx, const char *name, int flags, const char *label) {
 	if (!s || idx >= s->numAxes) {
 		return;
@@ -332,16 +447,19 @@ void Chart_SetVar(chart_t *s, int idx, const char *title, const char *axis) {
 }
 void Chart_SetSample(chart_t *s, int idx, float value) {
 	if (!s || idx >= s->numVars) {
-	bk_printf("DEBUG CHARTS: ERROR - Chart_SetSample ixd=%i /  s->numVars=%i / value=%f\n",idx, s->numVars,value); 
 		return;
 	}
-	bk_printf("DEBUG CHARTS: OK - Chart_SetSample ixd=%i /  s->numVars=%i  / value=%f\n",idx, s->numVars,value); 
 	s->vars[idx].samples[s->nextSample] = value;
 }
 void Chart_AddTime(chart_t *s, time_t time) {
 	if (!s) {
 		return;
 	}
+	for (int i = 0; i < CHART_MAX_TIERS; i++) {
+		if (s->tiers[i].maxSamples) {
+			Chart_TierAdd(s, &s->tiers[i], s->nextSample, time);
+		}
+	}
 	s->times[s->nextSample] = time;
 	s->nextSample = (s->nextSample + 1) % s->maxSamples;
 	if (s->lastSample == s->nextSample) {
@@ -368,29 +486,183 @@ void Chart_Iterate(chart_t *s, int index, void (*callback)(float *val, time_t *t
 		}
 	}
 }
-void Chart_DisplayLabel(float *val, time_t *time, void *userData) {
-	char buffer[64];
-	http_request_t *request = (http_request_t *)userData;
-	if (request->userCounter != 0) {
-		poststr(request, ",");
+// Small output buffer, so JSON is not sent by many tiny poststr calls
+typedef struct chartWriter_s {
+	http_request_t *request;
+	char buffer[256];
+	int len;
+} chartWriter_t;
+
+static void Chart_WriterFlush(chartWriter_t *w) {
+	if (w->len) {
+		w->buffer[w->len] = 0;
+		poststr(w->request, w->buffer);
+		w->len = 0;
 	}
-	request->userCounter++;
-	snprintf(buffer, sizeof(buffer), "%ld", (long)(*time));					// don't transmit too much data, use only the timestamps here and handle conversion later  ....
-	poststr(request, buffer);
 }
-void Chart_DisplayData(float *val, time_t *time, void *userData) {
-	char buffer[32];
-	http_request_t *request = (http_request_t *)userData;
-	if (request->userCounter != 0) {
-		poststr(request, ",");
+static void Chart_WriterStr(chartWriter_t *w, const char *str) {
+	int l = strlen(str);
+	if (w->len + l >= (int)sizeof(w->buffer) - 1) {
+		Chart_WriterFlush(w);
+		if (l >= (int)sizeof(w->buffer) - 1) {
+			poststr(w->request, str);
+			return;
+		}
 	}
-	request->userCounter++;
-	snprintf(buffer, sizeof(buffer), "%.2f", *val);
-	poststr(request, buffer);
+	memcpy(w->buffer + w->len, str, l);
+	w->len += l;
 }
-void Chart_Display(http_request_t *request, chart_t *s) {
-	char buffer[64];
+static void Chart_WriterFloat(chartWriter_t *w, float f) {
+	char tmp[24];
+	char *p;
 
+	snprintf(tmp, sizeof(tmp), "%.2f", f);
+	// strip trailing zeros, 20.00 -> 20, 3.50 -> 3.5
+	p = tmp + strlen(tmp) - 1;
+	while (*p == '0') {
+		*p = 0;
+		p--;
+	}
+	if (*p == '.') {
+		*p = 0;
+	}
+	Chart_WriterStr(w, tmp);
+}
+static void Chart_WriterInt(chartWriter_t *w, long v) {
+	char tmp[16];
+	snprintf(tmp, sizeof(tmp), "%ld", v);
+	Chart_WriterStr(w, tmp);
+}
+// tier -1 is raw. Returns number of samples, with start index in ring
+static int Chart_GetRange(chart_t *s, int tier, int *first, int *ringSize) {
+	if (tier < 0) {
+		*first = s->lastSample;
+		*ringSize = s->maxSamples;
+		return (s->nextSample - s->lastSample + s->maxSamples) % s->maxSamples;
+	}
+	chartTier_t *t = &s->tiers[tier];
+	*first = (t->nextSample - t->count + t->maxSamples) % t->maxSamples;
+	*ringSize = t->maxSamples;
+	return t->count;
+}
+static void Chart_WriteTierValues(chartWriter_t *w, chart_t *s, chartTier_t *t, float *values, float *accValues, int first, int count) {
+	Chart_WriterStr(w, "[");
+	for (int v = 0; v < s->numVars; v++) {
+		if (v) {
+			Chart_WriterStr(w, ",");
+		}
+		Chart_WriterStr(w, "[");
+		for (int i = 0; i < count; i++) {
+			if (i) {
+				Chart_WriterStr(w, ",");
+			}
+			Chart_WriterFloat(w, values[((first + i) % t->maxSamples) * s->numVars + v]);
+		}
+		// unfinished period goes last
+		if (t->accCount) {
+			if (count) {
+				Chart_WriterStr(w, ",");
+			}
+			Chart_WriterFloat(w, accValues ? accValues[v] : t->accSum[v] / t->accCount);
+		}
+		Chart_WriterStr(w, "]");
+	}
+	Chart_WriterStr(w, "]");
+}
+// Writes chart data as JSON with times delta encoded:
+// {"tier":0,"period":0,"t0":1725606094,"dt":[0,10000,...],"v":[[20,22,...],...]}
+// for tiers, there is "min", "avg" and "max" instead of "v"
+void Chart_WriteJSON(http_request_t *request, chart_t *s, int tier) {
+	chartWriter_t w;
+	chartTier_t *t;
+	int first, ringSize, count, idx;
+	long prev, cur;
+
+	w.request = request;
+	w.len = 0;
+	if (tier < 0 || tier > CHART_MAX_TIERS || (tier >= 1 && s->tiers[tier - 1].maxSamples == 0)) {
+		tier = 0;
+	}
+	t = tier ? &s->tiers[tier - 1] : 0;
+	count = Chart_GetRange(s, tier - 1, &first, &ringSize);
+
+	Chart_WriterStr(&w, "{\"tier\":");
+	Chart_WriterInt(&w, tier);
+	Chart_WriterStr(&w, ",\"period\":");
+	Chart_WriterInt(&w, t ? t->period : 0);
+	Chart_WriterStr(&w, ",\"t0\":");
+	prev = 0;
+	if (count) {
+		prev = (long)(t ? t->times[first] : s->times[first]);
+	}
+	else if (t && t->accCount) {
+		prev = (long)t->accStart;
+	}
+	Chart_WriterInt(&w, prev);
+	Chart_WriterStr(&w, ",\"dt\":[");
+	for (int i = 0; i < count; i++) {
+		idx = (first + i) % ringSize;
+		cur = (long)(t ? t->times[idx] : s->times[idx]);
+		if (i) {
+			Chart_WriterStr(&w, ",");
+		}
+		Chart_WriterInt(&w, cur - prev);
+		prev = cur;
+	}
+	if (t && t->accCount) {
+		if (count) {
+			Chart_WriterStr(&w, ",");
+		}
+		Chart_WriterInt(&w, (long)t->accStart - prev);
+	}
+	Chart_WriterStr(&w, "]");
+	if (t == 0) {
+		Chart_WriterStr(&w, ",\"v\":[");
+		for (int v = 0; v < s->numVars; v++) {
+			if (v) {
+				Chart_WriterStr(&w, ",");
+			}
+			Chart_WriterStr(&w, "[");
+			for (int i = 0; i < count; i++) {
+				if (i) {
+					Chart_WriterStr(&w, ",");
+				}
+				Chart_WriterFloat(&w, s->vars[v].samples[(first + i) % ringSize]);
+			}
+			Chart_WriterStr(&w, "]");
+		}
+		Chart_WriterStr(&w, "]");
+	}
+	else {
+		Chart_WriterStr(&w, ",\"min\":");
+		Chart_WriteTierValues(&w, s, t, t->mins, t->accMin, first, count);
+		Chart_WriterStr(&w, ",\"avg\":");
+		Chart_WriteTierValues(&w, s, t, t->avgs, 0, first, count);
+		Chart_WriterStr(&w, ",\"max\":");
+		Chart_WriteTierValues(&w, s, t, t->maxs, t->accMax, first, count);
+	}
+	Chart_WriterStr(&w, "}");
+	Chart_WriterFlush(&w);
+}
+// GET /chart_data?tier=0 (raw), 1 (minutes), 2 (hours)
+static int Chart_HTTP_Data(http_request_t *request) {
+	char tmp[8];
+	int tier = 0;
+
+	if (http_getArg(request->url, "tier", tmp, sizeof(tmp))) {
+		tier = atoi(tmp);
+	}
+	http_setup(request, httpMimeTypeJson);
+	if (g_chart == 0) {
+		poststr(request, "{}");
+	}
+	else {
+		Chart_WriteJSON(request, g_chart, tier);
+	}
+	poststr(request, NULL);
+	return 0;
+}
+void Chart_Display(http_request_t *request, chart_t *s) {
 	if (s == 0) {
 		poststr(request, "<h4>Chart is NULL</h4>");
 		return;
@@ -418,22 +690,24 @@ void Chart_Display(http_request_t *request, chart_t *s) {
 	poststr(request, "<canvas id=\"obkChart\" width=\"400\" height=\"200\"></canvas>");
 	poststr(request, "<script src=\"https://cdn.jsdelivr.net/npm/chart.js\"></script>");
 */
-	poststr(request, "<input type='hidden' id='chartlabels' value='");
-	request->userCounter = 0;
-	Chart_Iterate(s, 0, Chart_DisplayLabel, request);
-	poststr(request, "'>");
-	for (int i = 0; i < s->numVars; i++) {
-		hprintf255(request, "<input type='hidden' id='chartdata%i' value='",i);
-		request->userCounter = 0;
-		Chart_Iterate(s, i,  Chart_DisplayData, request);
-		poststr(request, "'>");
+	// samples are not sent inline anymore, JS fetches them from /chart_data
+	if (s->tiers[CHART_TIER_MINUTE].maxSamples || s->tiers[CHART_TIER_HOUR].maxSamples) {
+		poststr(request, "<button onclick='window.obkChartTier=0;cha()'>Raw</button>");
+		if (s->tiers[CHART_TIER_MINUTE].maxSamples) {
+			poststr(request, "<button onclick='window.obkChartTier=1;cha()'>Minutes</button>");
+		}
+		if (s->tiers[CHART_TIER_HOUR].maxSamples) {
+			poststr(request, "<button onclick='window.obkChartTier=2;cha()'>Hours</button>");
+		}
 	}
 	poststr(request, "<script>");
 	poststr(request, "function cha() {");
-	poststr(request, "var labels =document.getElementById('chartlabels').value.split(/\s*,\s*/).map(Number).map((x)=>new Date(x * 1000).toLocaleTimeString());"); // we transmitted only timestamps, let Javascript do the work to convert them ;-)
-	for (int i = 0; i < s->numVars; i++) {
-		hprintf255(request, "var data%i = document.getElementById('chartdata%i').value.split(/\s*,\s*/).map(Number);",i,i);	
-	}
+	poststr(request, "fetch('/chart_data?tier='+(window.obkChartTier||0)).then(r=>r.json()).then(d=>{");
+	poststr(request, "if (d.dt===undefined) return;");
+	// times are delta encoded, let Javascript do the work to convert them ;-)
+	poststr(request, "var t=d.t0;");
+	poststr(request, "var labels=d.dt.map(x=>{t+=x;var e=new Date(t*1000);return d.period>=3600?e.toLocaleString():e.toLocaleTimeString();});");
+	poststr(request, "var vals=d.v||d.avg;");
 	poststr(request, "if (! window.obkChartInstance) {");
 	poststr(request, "console.log('Initializing chart');");
 	poststr(request, "var ctx = document.getElementById('obkChart');");
@@ -450,7 +724,7 @@ void Chart_Display(http_request_t *request, chart_t *s) {
 		}
 		poststr(request, "{");
 		hprintf255(request, "            label: '%s',", s->vars[i].title);
-		hprintf255(request, "            data: data%i,",i);
+		hprintf255(request, "            data: vals[%i],",i);
 		if (i == 2) {
 			poststr(request, "                borderColor: 'rgba(155, 33, 55, 1)',");
 		}
@@ -502,64 +776,13 @@ void Chart_Display(http_request_t *request, chart_t *s) {
 	poststr(request, "else {\n");
 	poststr(request, "console.log('Updating chart');\n");
 	poststr(request, "	window.obkChartInstance.data.labels=labels;\n");
-	for (int i = 0; i < s->numVars; i++) {
-		hprintf255(request, "	window.obkChartInstance.data.datasets[%i].data=data%i;\n",i,i);	
-	}
+	poststr(request, "	vals.forEach((x,i)=>window.obkChartInstance.data.datasets[i].data=x);\n");
 	poststr(request, "	window.obkChartInstance.update();\n");
-	poststr(request, "}\n}");
+	poststr(request, "}\n});\n}");
 	poststr(request, "</script>");
 	poststr(request, "<style onload='cha();'></style>");
 
 }
-void DRV_Charts_AddToHtmlPage_Test(http_request_t *request, int bPreState) {
-	if (bPreState) {
-		return;
-	}
-	// chart_create [NumSamples] [NumVariables] [NumAxes]
-	// chart_create 16 3 2
-	chart_t *s = Chart_Create(16, 3, 2);
-	// chart_setVar [VarIndex] [DisplayName] [AxisCode]
-	// chart_setVar 0 "Room t" "axtemp"
-	// chart_setVar 1 "Outside T" "axtemp"
-	// chart_setVar 2 "Humidity" "axhum"
-	Chart_SetVar(s, 0, "Room T", "axtemp");
-	Chart_SetVar(s, 1, "Outside T", "axtemp");
-	Chart_SetVar(s, 2, "Humidity", "axhum");
-	// chart_setAxis [AxisIndex] [AxisCode] [Flags] [AxisLabel]
-	// chart_setAxis 0 "axtemp" 0 "Temperature ('C)"
-	// chart_setAxis 1 "axtemp" 1 "Humidity (%s)"
-	Chart_SetAxis(s, 0, "axtemp", 0, "Temperature (C)");
-	Chart_SetAxis(s, 1, "axhum", AX_RIGHT, "Humidity (%)");
-
-	// chart_addNow [Var0] [Var1] [Var2] [VarN]
-	// chart_add [Time] [Var0] [Var1] [Var2] [VarN]
-	Chart_SetSample(s, 0, 20);
-	Chart_SetSample(s, 1, 15);
-	Chart_SetSample(s, 2, 89);
-	Chart_AddTime(s, 1725606094);
-	Chart_SetSample(s, 0, 22);
-	Chart_SetSample(s, 1, 16);
-	Chart_SetSample(s, 2, 88);
-	Chart_AddTime(s, 1725616094);
-	Chart_SetSample(s, 0, 26);
-	Chart_SetSample(s, 1, 17);
-	Chart_SetSample(s, 2, 91);
-	Chart_AddTime(s, 1725626094);
-	Chart_SetSample(s, 0, 30);
-	Chart_SetSample(s, 1, 14);
-	Chart_SetSample(s, 2, 92);
-	Chart_AddTime(s, 1725636094);
-	Chart_SetSample(s, 0, 28);
-	Chart_SetSample(s, 1, 13);
-	Chart_SetSample(s, 2, 92);
-	Chart_AddTime(s, 1725646094);
-	Chart_SetSample(s, 0, 27);
-	Chart_SetSample(s, 1, 15);
-	Chart_SetSample(s, 2, 91);
-	Chart_AddTime(s, 1725656094);
-	Chart_Display(request, s);
-	Chart_Free(&s);
-}
 // startDriver Charts
 void DRV_Charts_AddToHtmlPage(http_request_t *request, int bPreState) {
 	if (bPreState)
@@ -578,9 +801,14 @@ static commandResult_t CMD_Chart_Create(const void *context, const char *cmd, co
 	int numSamples = Tokenizer_GetArgInteger(0);
 	int numVars = Tokenizer_GetArgInteger(1);
 	int numAxes = Tokenizer_GetArgInteger(2);
+	// optional, 0 means no tier
+	int numMinuteSamples = Tokenizer_GetArgIntegerDefault(3, 0);
+	int numHourSamples = Tokenizer_GetArgIntegerDefault(4, 0);
 
 	Chart_Free(&g_chart);
 	g_chart = Chart_Create(numSamples, numVars, numAxes);
+	Chart_CreateTier(g_chart, CHART_TIER_MINUTE, 60, numMinuteSamples);
+	Chart_CreateTier(g_chart, CHART_TIER_HOUR, 3600, numHourSamples);
 
 	return CMD_RES_OK;
 }
@@ -651,7 +879,14 @@ static commandResult_t CMD_Chart_Add(const void *context, const char *cmd, const
 	if (cnt < 2) {
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
-	int time = Tokenizer_GetArgInteger(0);
+	int time;
+	// expression evaluation goes through float and would round NTP time to 128 seconds
+	if (Tokenizer_IsArgInteger(0)) {
+		time = strtoul(Tokenizer_GetArg(0), 0, 10);
+	}
+	else {
+		time = Tokenizer_GetArgInteger(0);
+	}
 	for (int i = 1; i < cnt; i++) {
 		float f = Tokenizer_GetArgFloat(i);
 		if (i > g_chart->numVars){
@@ -669,6 +904,7 @@ static commandResult_t CMD_Chart_Add(const void *context, const char *cmd, const
 
 void DRV_Charts_Init() {
 
+	HTTP_RegisterCallback("/chart_data", HTTP_GET, Chart_HTTP_Data, 0);
 
 
 	//cmddetail:{"name":"chart_setAxis","args":"[axis_index][name][flags][label]",
@@ -681,8 +917,8 @@ void DRV_Charts_Init() {
 	//cmddetail:"fn":"CMD_Chart_SetVar","file":"driver/drv_charts.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("chart_setVar", CMD_Chart_SetVar, NULL);
-	//cmddetail:{"name":"chart_create","args":"[max_samples][num_vars][num_axes]",
-	//cmddetail:"descr":"Creates a chart with a specified number of samples, variables, and axes. See [tutorial](https://www.elektroda.com/rtvforum/topic4075289.html).",
+	//cmddetail:{"name":"chart_create","args":"[max_samples][num_vars][num_axes][OptionalMinuteSamples][OptionalHourSamples]",
+	//cmddetail:"descr":"Creates a chart with a specified number of samples, variables, and axes. Optionally, also keeps per-minute and per-hour min/avg/max of given sizes, available at /chart_data?tier=1 and tier=2. See [tutorial](https://www.elektroda.com/rtvforum/topic4075289.html).",
 	//cmddetail:"fn":"CMD_Chart_Create","file":"driver/drv_charts.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("chart_create", CMD_Chart_Create, NULL);
@@ -10,6 +10,7 @@
 #include "../logging/logging.h"
 #include "../new_pins.h"
 #include "drv_bl_shared.h"
+#include "drv_bl_samples.h"
 #include "drv_pwrCal.h"
 #include "drv_uart.h"
 
@@ -18,14 +19,15 @@
 #define DEFAULT_POWER_CAL 1.88214409
 
 #define CSE7766_BAUD_RATE 4800
+#define CSE7766_PACKET_LEN 24
 
 int CSE7766_TryToGetNextCSE7766Packet() {
+	static const byte cseHeader[2] = { 0x55, 0x5A };
 	int cs;
 	int i;
-	int c_garbage_consumed = 0;
-	//byte a;
+	int c_garbage_consumed;
 	byte checksum;
-	int CSE7766_PACKET_LEN = 24;
+	byte packet[CSE7766_PACKET_LEN];
 	byte header;
 
 	cs = UART_GetDataSize();
@@ -36,48 +38,49 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 	}
     header = UART_GetByte(0);
     // skip garbage data (should not happen)
-	while(cs > 0) {
-        //a = UART_GetByte(1);
-        if(UART_GetByte(0) != 0x55 || UART_GetByte(1) != 0x5A) {
-			UART_ConsumeBytes(1);
-			c_garbage_consumed++;
-			cs--;
-		} else {
-			break;
-		}
+	c_garbage_consumed = UART_FindHeader(0, cseHeader, sizeof(cseHeader));
+	if(c_garbage_consumed < 0) {
+		// keep last byte, it may be the first half of header
+		c_garbage_consumed = cs - 1;
 	}
 	if(c_garbage_consumed > 0){
+		UART_ConsumeBytes(c_garbage_consumed);
+		cs -= c_garbage_consumed;
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"Consumed %i unwanted non-header byte in CSE7766 buffer", c_garbage_consumed);
 	}
 	if(cs < CSE7766_PACKET_LEN) {
 		return 0;
 	}
-    //a = UART_GetByte(1);
-    if(UART_GetByte(0) != 0x55 || UART_GetByte(1) != 0x5A) {
+	UART_CopyBytes(0, packet, CSE7766_PACKET_LEN);
+    if(packet[0] != 0x55 || packet[1] != 0x5A) {
 		return 0;
 	}
 	checksum = 0;
 
 	for(i = 2; i < CSE7766_PACKET_LEN-1; i++) {
-        checksum += UART_GetByte(i);
+        checksum += packet[i];
     }
 
 #if 1
+	// with fast polling there are 20 packets per second
+#if ENABLE_BL_SAMPLES
+	if (!BL_Samples_IsFastPolling())
+#endif
 	{
 		char buffer_for_log[128];
 		char buffer2[32];
 		buffer_for_log[0] = 0;
 		for(i = 0; i < CSE7766_PACKET_LEN; i++) {
-            snprintf(buffer2, sizeof(buffer2), "%02X ", UART_GetByte(i));
+            snprintf(buffer2, sizeof(buffer2), "%02X ", packet[i]);
             strcat_safe(buffer_for_log,buffer2,sizeof(buffer_for_log));
 		}
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"CSE7766 received: %s", buffer_for_log);
 	}
 #endif
-	if(checksum != UART_GetByte(CSE7766_PACKET_LEN-1)) {
+	if(checksum != packet[CSE7766_PACKET_LEN-1]) {
         ADDLOG_INFO(LOG_FEATURE_ENERGYMETER,
                     "Skipping packet with bad checksum %02X wanted %02X\n",
-                    checksum, UART_GetByte(CSE7766_PACKET_LEN - 1));
+                    checksum, packet[CSE7766_PACKET_LEN - 1]);
         UART_ConsumeBytes(CSE7766_PACKET_LEN);
 		return 1;
 	}
@@ -137,9 +140,9 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 		backlog startDriver CSE7766; uartFakeHex 555A02FCD800062F00413200D7F2537B18023E9F7171FEEC
 		*/
 
-#define CSC_GetByte(x) ((unsigned long)UART_GetByte(x))
+#define CSC_GetByte(x) ((unsigned long)packet[x])
 
-        adjustement = UART_GetByte(20);
+        adjustement = packet[20];
         int vol_par =
 			CSC_GetByte(2) << 16 | CSC_GetByte(3) << 8 | CSC_GetByte(4);
         int cur_par =
@@ -147,7 +150,7 @@ int CSE7766_TryToGetNextCSE7766Packet() {
         int pow_par =
 			CSC_GetByte(14) << 16 | CSC_GetByte(15) << 8 | CSC_GetByte(16);
         float raw_unscaled_voltage =
-			CSC_GetByte(5) << 16 | CSC_GetByte(6) << 8 | UART_GetByte(7);
+			CSC_GetByte(5) << 16 | CSC_GetByte(6) << 8 | packet[7];
         float raw_unscaled_current =
 			CSC_GetByte(11) << 16 | CSC_GetByte(12) << 8 | CSC_GetByte(13);
         float raw_unscaled_power =
@@ -189,7 +192,7 @@ int CSE7766_TryToGetNextCSE7766Packet() {
         float voltage, current, power;
         PwrCal_Scale(raw_unscaled_voltage, raw_unscaled_current,
                      raw_unscaled_power, &voltage, &current, &power);
-        BL_ProcessUpdate(voltage, current, power, NAN, NAN);
+        BL_ProcessSample(BL_SENSORS_IX_0, voltage, current, power, NAN, NAN);
     }
 
 #if 0
@@ -219,9 +222,32 @@ void CSE7766_Init(void) {
 void CSE7766_RunEverySecond(void) {
     //addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"UART buffer size %i", UART_GetDataSize());
 
+#if ENABLE_BL_SAMPLES
+	if (BL_Samples_IsFastPolling()) {
+		// packets are parsed in quick tick, just publish what was read
+		BL_ProcessHeldSamples();
+		return;
+	}
+#endif
 	CSE7766_TryToGetNextCSE7766Packet();
 }
 
+#if ENABLE_BL_SAMPLES
+// chip sends packets by itself, every 50 ms, so parse all that came
+void CSE7766_RunQuickTick(void) {
+	int i;
+
+	if (!BL_Samples_IsFastPolling()) {
+		return;
+	}
+	for (i = 0; i < 8; i++) {
+		if (CSE7766_TryToGetNextCSE7766Packet() <= 0) {
+			break;
+		}
+	}
+}
+#endif
+
 // close ENABLE_DRIVER_CSE7766
 #endif
 
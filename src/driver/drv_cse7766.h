@@ -2,3 +2,4 @@
 
 void CSE7766_Init(void);
 void CSE7766_RunEverySecond(void);
+void CSE7766_RunQuickTick(void);
@@ -592,7 +592,7 @@ void TIME_AppendInformationToHTTPIndexPage(http_request_t *request, int bPreStat
 		sprintf(ntpinfo," (NTP-Server: %s)",CFG_GetNTPServer());
 	}
 #endif
-	if (TIME_IsTimeSynced()) hprintf255(request, "<h5>Local clock: %s"
+	if (TIME_IsTimeSynced()) hprintf255(request, "<h5>Local clock: <span id=\"vclock\">%s</span>"
 #if ENABLE_TIME_DST
 	"%s"
 #endif 
@@ -21,6 +21,9 @@ int TIME_Print_EventList();
 void TIME_setDeviceTime(uint32_t time);
 void TIME_setDeviceTimeOffset(int offs);
 int TIME_GetEventTime(int id);
+void TIME_RunEvents(unsigned int newTime, bool bTimeValid);
+// how many scheduled events were looked at so far, for selftests
+int TIME_GetCheckedEventsCount();
 int TIME_RemoveEvent(int id);
 int TIME_ClearEvents();
 void TIME_Init();
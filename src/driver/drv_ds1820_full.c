@@ -15,6 +15,7 @@
 #include "drv_local.h"
 #include "../httpserver/new_http.h"
 #include "../hal/hal_pins.h"
+#include "../quicktick.h"
 
 #define DEVSTR		"0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X"
 #define DEV2STR(T)	T[0],T[1],T[2],T[3],T[4],T[5],T[6],T[7]
@@ -23,13 +24,10 @@
 
 
 
-static uint8_t dsread = 0;
-static int Pin = -1;
-//static int t = -127;
-static int errcount = 0;
-static int lastconv; // secondsElapsed on last successfull reading
 static uint8_t ds18_family = 0;
 static int ds18_conversionPeriod = 0;
+// stable sensors are polled up to that many times less often than conversionPeriod
+static int ds18_maxIntervalFactor = 4;
 
 typedef uint8_t ScratchPad[9];
 typedef uint8_t DeviceAddress[8];		// we need to distinguish sensors by their address
@@ -42,9 +40,36 @@ typedef struct {
   unsigned short last_read[DS18B20MAX];
   short channel[DS18B20MAX];
   short GPIO[DS18B20MAX];
-
+  // scheduler state and statistics
+  unsigned short interval[DS18B20MAX];	// current polling interval in seconds
+  int nextRead[DS18B20MAX];		// g_secondsElapsed when sensor is due again
+  unsigned int reads[DS18B20MAX];		// successful scratchpad reads
+  unsigned int crcErrors[DS18B20MAX];
+  uint8_t retries[DS18B20MAX];
+  bool pending[DS18B20MAX];		// converted, waiting for scratchpad read
 } DS1820devices;
 
+// Convert-T is broadcast to the whole bus, then scratchpads of sensors
+// which were due are read one by one in quick ticks
+typedef enum {
+	DS18_BUS_IDLE,
+	DS18_BUS_CONVERTING,
+	DS18_BUS_READING,
+} ds18BusState_t;
+
+typedef struct {
+	uint8_t state;
+	unsigned int convStart;	// g_timeMs of Convert-T
+} ds18bus_t;
+
+// max conversion time (12 bit), used if conversion done bit can't be read (parasite power)
+#define DS18B20_CONV_TIMEOUT_MS	750
+// one scratchpad read is about 12ms of bit-banging
+#define DS18B20_READS_PER_TICK	1
+#define DS18B20_MAX_RETRIES	3
+// change smaller than that doesn't reset polling interval
+#define DS18B20_STABLE_DELTA	0.1f
+
 static int ds18_count = 0;		// detected number of devices
 
 uint8_t DS18B20_GPIO;	// the actual GPIO used (changes in case we have multiple GPIOs defined ...)
@@ -52,6 +77,7 @@ uint8_t DS18B20_GPIO;	// the actual GPIO used (changes in case we have multiple
 DeviceAddress ROM_NO;
 
 static DS1820devices ds18b20devices;
+static ds18bus_t ds18buses[DS18B20MAX_GPIOS];
 uint8_t DS18B20GPIOS[DS18B20MAX_GPIOS];
 uint8_t devices = 0;
 
@@ -67,6 +93,118 @@ int devstr2DeviceAddr(uint8_t *devaddr, const char *dev);
 bool ds18b20_getGPIO(const uint8_t* devaddr,uint8_t *GPIO);
 bool ds18b20_readScratchPad(const uint8_t* deviceAddress, uint8_t* scratchPad);
 
+#if WINDOWS
+// Simulated 1-Wire bus for selftests. It works on whole transactions
+// (Convert-T, read scratchpad) instead of bit timing.
+typedef struct {
+	DeviceAddress addr;
+	int pin;
+	float temp;
+	float converted;	// latched by last Convert-T, 85 after power on like real sensor
+	uint8_t config;
+	int crcErrors;		// that many next reads return bad CRC
+	unsigned int convStart;
+} ds18SimSensor_t;
+
+static ds18SimSensor_t ds18sim[DS18B20MAX];
+// -1 until first scan, which adds default fake sensors
+static int ds18simCount = -1;
+
+static int DS18_Sim_Add(int pin, const uint8_t *addr, float temp) {
+	ds18SimSensor_t *s;
+
+	if (ds18simCount < 0)
+		ds18simCount = 0;
+	if (ds18simCount >= DS18B20MAX)
+		return -1;
+	s = &ds18sim[ds18simCount];
+	memset(s, 0, sizeof(*s));
+	memcpy(s->addr, addr, 8);
+	s->pin = pin;
+	s->temp = temp;
+	s->converted = 85;
+	s->config = TEMP_12_BIT;
+	return ds18simCount++;
+}
+
+static void DS18_Sim_ConvertT(int pin) {
+	for (int i = 0; i < ds18simCount; i++) {
+		if (ds18sim[i].pin == pin) {
+			ds18sim[i].converted = ds18sim[i].temp;
+			ds18sim[i].convStart = g_timeMs;
+		}
+	}
+}
+
+static bool DS18_Sim_ConversionDone(int pin) {
+	for (int i = 0; i < ds18simCount; i++) {
+		// 94ms for 9 bit, doubled for every further bit
+		unsigned int convTime = 94 << ((ds18sim[i].config >> 5) & 3);
+		if (ds18sim[i].pin == pin && g_timeMs - ds18sim[i].convStart < convTime) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool DS18_Sim_ReadScratchPad(int pin, const uint8_t *addr, uint8_t *scratchPad) {
+	for (int i = 0; i < ds18simCount; i++) {
+		ds18SimSensor_t *s = &ds18sim[i];
+		if (s->pin != pin || memcmp(s->addr, addr, 8))
+			continue;
+		int16_t raw = (int16_t)(s->converted * 16.0f + (s->converted < 0 ? -0.5f : 0.5f));
+		// lower resolutions leave the lowest bits undefined
+		raw &= ~((1 << (3 - ((s->config >> 5) & 3))) - 1);
+		scratchPad[TEMP_LSB] = raw & 0xFF;
+		scratchPad[TEMP_MSB] = (raw >> 8) & 0xFF;
+		scratchPad[HIGH_ALARM_TEMP] = 0x4B;
+		scratchPad[LOW_ALARM_TEMP] = 0x46;
+		scratchPad[CONFIGURATION] = s->config;
+		scratchPad[INTERNAL_BYTE] = 0xFF;
+		scratchPad[COUNT_REMAIN] = 0x0C;
+		scratchPad[COUNT_PER_C] = 0x10;
+		scratchPad[SCRATCHPAD_CRC] = Crc8CQuick(scratchPad, 8);
+		if (s->crcErrors > 0) {
+			s->crcErrors--;
+			scratchPad[SCRATCHPAD_CRC] ^= 0x5A;
+		}
+		return true;
+	}
+	// no presence pulse
+	return false;
+}
+
+void DS1820_full_Sim_Clear() {
+	ds18simCount = 0;
+}
+
+int DS1820_full_Sim_AddSensor(int pin, const char *addr, float temp) {
+	DeviceAddress devaddr;
+
+	if (devstr2DeviceAddr(devaddr, addr) != 8)
+		return -1;
+	return DS18_Sim_Add(pin, devaddr, temp);
+}
+
+void DS1820_full_Sim_SetTemperature(int index, float temp) {
+	ds18sim[index].temp = temp;
+}
+
+void DS1820_full_Sim_InjectCRCErrors(int index, int count) {
+	ds18sim[index].crcErrors = count;
+}
+#endif
+
+// forget conversions in progress, sensors will be converted again when due
+static void DS18_ResetBuses() {
+	for (int b = 0; b < DS18B20MAX_GPIOS; b++) {
+		ds18buses[b].state = DS18_BUS_IDLE;
+	}
+	for (int i = 0; i < ds18_count; i++) {
+		ds18b20devices.pending[i] = false;
+		ds18b20devices.retries[i] = 0;
+	}
+}
 
 
 bool ds18b20_writeScratchPad(const uint8_t *deviceAddress, const uint8_t *scratchPad) {
@@ -162,15 +300,37 @@ static commandResult_t Cmd_DS18B20_SetResolution(const void* context, const char
 
 
 	//temperature conversion was interrupted
-	dsread = 0;
+	DS18_ResetBuses();
 
 	return CMD_RES_OK;
 }
 
 void ds18b20_requestConvertT(int GPIO) {
+#if WINDOWS
+	DS18_Sim_ConvertT(GPIO);
+#else
 	OWReset(GPIO);
 	OWWriteByte(GPIO,SKIP_ROM);
 	OWWriteByte(GPIO,CONVERT_T);
+#endif
+}
+
+// all sensors on bus have finished conversion
+static bool ds18b20_conversionDone(int GPIO) {
+#if WINDOWS
+	return DS18_Sim_ConversionDone(GPIO);
+#else
+	return DS1820TConversionDone(GPIO);
+#endif
+}
+
+static int ds18b20_getIndex(const uint8_t *devaddr) {
+	for (int i = 0; i < ds18_count; i++) {
+		if (!memcmp(devaddr, ds18b20devices.array[i], 8)) {
+			return i;
+		}
+	}
+	return -1;
 }
 
 
@@ -181,11 +341,18 @@ void ds18b20_requestConvertT(int GPIO) {
 //	 only GPIO pin for single DS1820
 //	 sensor address for multiple devices
 bool ds18b20_readScratchPad(const uint8_t *deviceAddress, uint8_t* scratchPad) {
-	if ( ! ds18b20_getGPIO(deviceAddress, &DS18B20_GPIO ) ) {
+	int idx = ds18b20_getIndex(deviceAddress);
+	if (idx < 0) {
 		DS1820_LOG(DEBUG, "No GPIO found for device - DS18B20_GPIO=%i", DS18B20_GPIO);
 		return false;
 	}
+	DS18B20_GPIO = ds18b20devices.GPIO[idx];
 	DS1820_LOG(DEBUG, "GPIO found for device - DS18B20_GPIO=%i", DS18B20_GPIO);
+#if WINDOWS
+	if (!DS18_Sim_ReadScratchPad(DS18B20_GPIO, deviceAddress, scratchPad)) {
+		return false;
+	}
+#else
 	// send the reset command and fail fast
 	int b = OWReset(DS18B20_GPIO);
 	if (b == 0) {
@@ -207,17 +374,23 @@ bool ds18b20_readScratchPad(const uint8_t *deviceAddress, uint8_t* scratchPad) {
 	for (uint8_t i = 0; i < 9; i++) {
 		scratchPad[i] = OWReadByte(DS18B20_GPIO);
 	}
+#endif
 	uint8_t crc = Crc8CQuick(scratchPad, 8);
 	if(crc != scratchPad[8])
 	{
-		DS1820_LOG(ERROR, "Read CRC=%x != calculated:%x (errcount=%i)", scratchPad[8], crc, errcount);
+		ds18b20devices.crcErrors[idx]++;
+		DS1820_LOG(ERROR, "Read CRC=%x != calculated:%x (errcount=%u)", scratchPad[8], crc, ds18b20devices.crcErrors[idx]);
 		DS1820_LOG(ERROR, "Scratchpad Data Read: " SPSTR,
 			SP2STR(scratchPad));
 
 		return false;
 	}
 
+#if WINDOWS
+	return true;
+#else
 	return OWReset(DS18B20_GPIO);
+#endif
 }
 
 
@@ -503,6 +676,12 @@ void insertArray(DS1820devices *a, DeviceAddress devaddr) {
 	a->last_read[ds18_count] = 0;
 	a->channel[ds18_count] = -1;
 	a->GPIO[ds18_count]=DS18B20_GPIO;
+	a->interval[ds18_count] = ds18_conversionPeriod;
+	a->nextRead[ds18_count] = 0;
+	a->reads[ds18_count] = 0;
+	a->crcErrors[ds18_count] = 0;
+	a->retries[ds18_count] = 0;
+	a->pending[ds18_count] = false;
 	ds18_count++;
 }
 
@@ -512,14 +691,22 @@ int DS18B20_fill_devicelist(int Pin)
 	DeviceAddress devaddr={0};
 	int ret=0;
 #if WINDOWS
-	// For Windows add some "fake" sensors with increasing addresses
+	// For Windows add some "fake" sensors with increasing addresses to simulated bus
 	// 28 FF AA BB CC DD EE 01, 28 FF AA BB CC DD EE 02, ...
-	devaddr[0]=0x28; devaddr[1]=0xFF; devaddr[2]=0xAA; devaddr[3]=0xBB;devaddr[4]=0xCC;devaddr[5]=0xDD;devaddr[6]=0xEE;
-	while (ds18_count < 1+(DS18B20MAX/2) ){
-		devaddr[7]=++ret;
+	if (ds18simCount < 0) {
+		devaddr[0]=0x28; devaddr[1]=0xFF; devaddr[2]=0xAA; devaddr[3]=0xBB;devaddr[4]=0xCC;devaddr[5]=0xDD;devaddr[6]=0xEE;
+		for (int i = 0; i < 1+(DS18B20MAX/2); i++) {
+			devaddr[7] = i + 1;
+			DS18_Sim_Add(Pin, devaddr, 20.0f + i / 10.0f);
+		}
+	}
+	for (int i = 0; i < ds18simCount && ds18_count < DS18B20MAX; i++) {
+		if (ds18sim[i].pin != Pin)
+			continue;
 		bk_printf("found device " DEVSTR " ",
-			DEV2STR(devaddr));
-		insertArray(&ds18b20devices,devaddr);
+			DEV2STR(ds18sim[i].addr));
+		insertArray(&ds18b20devices,ds18sim[i].addr);
+		ret++;
 	}
 #else
 	reset_search();
@@ -684,6 +871,7 @@ commandResult_t CMD_DS18B20_setsensor(const void *context, const char *cmd, cons
 
 void scan_sensors(){
 	ds18_count=0;
+	DS18_ResetBuses();
 	reset_search();
 	int i,j=0;
 	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
@@ -702,13 +890,26 @@ commandResult_t CMD_DS18B20_scansensors(const void *context, const char *cmd, co
 	return CMD_RES_OK;
 }
 
+commandResult_t CMD_DS18B20_stats(const void *context, const char *cmd, const char *args, int cmdFlags) {
+	for (int i = 0; i < ds18_count; i++) {
+		DS1820_LOG(INFO, "%s (" DEVSTR ") reads %u, CRC errors %u, interval %i s",
+			ds18b20devices.name[i], DEV2STR(ds18b20devices.array[i]),
+			ds18b20devices.reads[i], ds18b20devices.crcErrors[i], ds18b20devices.interval[i]);
+	}
+	return CMD_RES_OK;
+}
+
 
-// startDriver DS1820_full [conversionPeriod (seconds) - default 15]
+// startDriver DS1820_full [conversionPeriod (seconds) - default 15] [maxIntervalFactor - default 4]
 void DS1820_full_driver_Init()
 {
 	ds18_conversionPeriod = Tokenizer_GetArgIntegerDefault(1, 15);
-	lastconv = 0;
-	dsread = 0;
+	if (ds18_conversionPeriod < 1)
+		ds18_conversionPeriod = 1;
+	// 1 disables adaptive polling
+	ds18_maxIntervalFactor = Tokenizer_GetArgIntegerDefault(2, 4);
+	if (ds18_maxIntervalFactor < 1)
+		ds18_maxIntervalFactor = 1;
 	ds18_family = 0;
 	scan_sensors();
 
@@ -727,6 +928,11 @@ void DS1820_full_driver_Init()
 	//cmddetail:"fn":"CMD_DS18B20_scansensors","file":"driver/drv_ds1820_full.c","requires":"",
 	//cmddetail:"examples":"DS1820_FULL_scansensors"}
 	CMD_RegisterCommand("DS1820_FULL_scansensors", CMD_DS18B20_scansensors, NULL);
+	//cmddetail:{"name":"DS1820_FULL_stats","args":"-",
+	//cmddetail:"descr":"Prints successful reads, CRC errors and current polling interval of every DS1820 sensor",
+	//cmddetail:"fn":"CMD_DS18B20_stats","file":"driver/drv_ds1820_full.c","requires":"",
+	//cmddetail:"examples":"DS1820_FULL_stats"}
+	CMD_RegisterCommand("DS1820_FULL_stats", CMD_DS18B20_stats, NULL);
 
 	// no need to discover the "family" we know the address, the first byte is the family
 
@@ -918,94 +1124,145 @@ int http_fn_cfg_ds18b20(http_request_t* request)
 	return 0;	
 }
 
-void DS1820_full_OnEverySecond()
-{
-	// for now just find the pin used
-	Pin = PIN_FindPinIndexForRole(IOR_DS1820_IO, -1);
+static int ds18b20_getBus(int i) {
+	for (int b = 0; b < DS18B20MAX_GPIOS; b++) {
+		if (DS18B20GPIOS[b] == ds18b20devices.GPIO[i]) {
+			return b;
+		}
+	}
+	return -1;
+}
+
+static int ds18b20_findPending(int bus) {
+	for (int i = 0; i < ds18_count; i++) {
+		if (ds18b20devices.pending[i] && DS18B20GPIOS[bus] == ds18b20devices.GPIO[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void ds18b20_readPending(int i) {
+	ScratchPad scratchPad;
+	float t_float = DEVICE_DISCONNECTED_C;
+	int maxInterval;
 
-	// only if (at least one) pin is set
-	if(Pin < 0) {
-		DS1820_LOG(INFO, "No Pin found\r\n");
+	if (ds18b20_isConnected((const uint8_t*)ds18b20devices.array[i], scratchPad)) {
+		t_float = ds18b20_Scratchpat2TempC(scratchPad, ds18b20devices.array[i][0]);
+	}
+	DS1820_LOG(DEBUG, "Device %i (" DEVSTR ") reported %0.2f\r\n", i,
+		DEV2STR(ds18b20devices.array[i]), t_float);
+	if (t_float == DEVICE_DISCONNECTED_C) {
+		// retry in next quick tick, conversion result stays in scratchpad
+		if (++ds18b20devices.retries[i] > DS18B20_MAX_RETRIES) {
+			ds18b20devices.pending[i] = false;
+			ds18b20devices.retries[i] = 0;
+			ds18b20devices.interval[i] = ds18_conversionPeriod;
+			ds18b20devices.nextRead[i] = g_secondsElapsed + ds18_conversionPeriod;
+		}
 		return;
 	}
-	//Temperature measurement is done in two repeatable steps. 
-	// Step 1 - dsread = 0. Sensor requested to do temperature conversion.
-	//          That requires some time - 15-100-750ms, depending on sensor family/vendor.
-	//          However, time between steps is always one second.
-	// Step 2 - dsread = 1. Sensor finished conversion, requesting conversion result.
-
-	// request temp if conversion was requested two seconds after request
-	// if (dsread == 1 && g_secondsElapsed % 5 == 2) {
-	// better if we don't use parasitic power, we can check if conversion is ready
-		DS1820_LOG(DEBUG, ".. Pin %i found! dsread=%i \r\n",Pin,dsread);
-		if(dsread == 1){ 
-#if WINDOWS
-			bk_printf("Reading temperature from fake DS18B20 sensor(s)\r\n");
-			for (int i=0; i < ds18_count; i++) {
-				ds18b20devices.last_read[i] += 1 ;
-				errcount = 0;
-				float t_float = 20.0 + i/10.0 + (float)(g_secondsElapsed%100)/100.0;
-					ds18b20devices.lasttemp[i] = t_float;
-					ds18b20devices.last_read[i] = 0;
-					if (ds18b20devices.channel[i]>=0) CHANNEL_Set(ds18b20devices.channel[i], (int)(t_float*100), CHANNEL_SET_FLAG_SILENT);
-					lastconv = g_secondsElapsed;
-			}
-#else	// to #if WINDOWS
-			float t_float = -127;
-			const char * pinalias; 
-			char gpioname[10];
-			DS1820_LOG(INFO, "Reading temperature from %i DS18B20 sensor(s)\r\n",ds18_count);
-			for (int i=0; i < ds18_count; i++) {
-				pinalias = HAL_PIN_GetPinNameAlias(ds18b20devices.GPIO[i]);
-				if (! pinalias ) {
-					sprintf(gpioname,"GPIO %u",ds18b20devices.GPIO[i]);
-					pinalias = gpioname;
-				}
-				ds18b20devices.last_read[i] += 1 ;
-				errcount = 0;
-				t_float = -127;
-				while ( t_float == -127 && errcount++ < 5){
-					t_float = ds18b20_getTempC((const uint8_t*)ds18b20devices.array[i]);
-					DS1820_LOG(DEBUG, "Device %i (" DEVSTR ") reported %0.2f\r\n",i,
-						DEV2STR(ds18b20devices.array[i]),t_float);
-				}
-				if (t_float != -127){
-					ds18b20devices.lasttemp[i] = t_float;
-					ds18b20devices.last_read[i] = 0;
-					if (ds18b20devices.channel[i]>=0) CHANNEL_Set(ds18b20devices.channel[i], (int)(t_float*100), CHANNEL_SET_FLAG_SILENT);
-					lastconv = g_secondsElapsed;
-					DS1820_LOG(INFO, "Sensor " DEVSTR " on %s reported %0.2f\r\n",DEV2STR(ds18b20devices.array[i]),pinalias,t_float);
-				} else{
-					if (ds18b20devices.last_read[i] > 60) {
-						DS1820_LOG(ERROR, "No temperature read for over 60 seconds for"
-							" device %i (" DEVSTR " on %s)! Setting to -127°C!\r\n",i,
-							DEV2STR(ds18b20devices.array[i]),pinalias);
-						ds18b20devices.lasttemp[i] = -127;
-						dsread=0;
-					}
-				}
-			}
-#endif	// to #if WINDOWS		
-			dsread=0;
-		}
-		else{
-//			bk_printf("No tepms read! dsread=%i  -- isConversionComplete()=%i\r\n",dsread,isConversionComplete());
-//			DS1820_LOG(INFO, "No tepms read! dsread=%i  -- isConversionComplete()=%i\r\n",dsread,isConversionComplete());
-			for (int i=0; i < ds18_count; i++) {
-				ds18b20devices.last_read[i] += 1 ;
-			}
-			if(dsread == 0 && (g_secondsElapsed % ds18_conversionPeriod == 0 || lastconv == 0))
-			{
-				DS1820_LOG(INFO, "Starting conversion");
-				for (int i=0; i<DS18B20MAX_GPIOS; i++){
-					ds18b20_requestConvertT(DS18B20GPIOS[i]);
-				}
-				dsread = 1;
-				errcount = 0;
+	ds18b20devices.pending[i] = false;
+	ds18b20devices.retries[i] = 0;
+	ds18b20devices.reads[i]++;
+	// sensors that don't change are polled less often
+	maxInterval = ds18_conversionPeriod * ds18_maxIntervalFactor;
+	if (ds18b20devices.lasttemp[i] > DEVICE_DISCONNECTED_C
+		&& fabsf(t_float - ds18b20devices.lasttemp[i]) < DS18B20_STABLE_DELTA) {
+		ds18b20devices.interval[i] *= 2;
+		if (ds18b20devices.interval[i] > maxInterval)
+			ds18b20devices.interval[i] = maxInterval;
+	}
+	else {
+		ds18b20devices.interval[i] = ds18_conversionPeriod;
+	}
+	ds18b20devices.nextRead[i] = g_secondsElapsed + ds18b20devices.interval[i];
+	ds18b20devices.lasttemp[i] = t_float;
+	ds18b20devices.last_read[i] = 0;
+	if (ds18b20devices.channel[i]>=0) CHANNEL_Set(ds18b20devices.channel[i], (int)(t_float*100), CHANNEL_SET_FLAG_SILENT);
+	DS1820_LOG(INFO, "Sensor " DEVSTR " on GPIO %i reported %0.2f\r\n", DEV2STR(ds18b20devices.array[i]),
+		ds18b20devices.GPIO[i], t_float);
+}
+
+// Reads scratchpads of converted sensors, at most DS18B20_READS_PER_TICK
+// per call, so bit-banging doesn't block main loop for long
+void DS1820_full_RunQuickTick()
+{
+	int budget = DS18B20_READS_PER_TICK;
+	int i;
+
+	for (int b = 0; b < DS18B20MAX_GPIOS; b++) {
+		ds18bus_t *bus = &ds18buses[b];
+		if (bus->state == DS18_BUS_CONVERTING) {
+			// done bit is not driven with parasite power, so there is also a timeout
+			if (g_timeMs - bus->convStart < DS18B20_CONV_TIMEOUT_MS && !ds18b20_conversionDone(DS18B20GPIOS[b])) {
+				continue;
 			}
+			bus->state = DS18_BUS_READING;
+		}
+		if (bus->state != DS18_BUS_READING) {
+			continue;
+		}
+		while (budget > 0 && (i = ds18b20_findPending(b)) >= 0) {
+			ds18b20_readPending(i);
+			budget--;
 		}
+		if (ds18b20_findPending(b) < 0) {
+			bus->state = DS18_BUS_IDLE;
+		}
+	}
+}
 
+void DS1820_full_OnEverySecond()
+{
+	int staleSeconds;
+	bool due[DS18B20MAX_GPIOS] = { 0 };
+	int b;
+
+	// no read for that long means sensor is gone
+	staleSeconds = 2 * ds18_conversionPeriod * ds18_maxIntervalFactor;
+	if (staleSeconds < 60)
+		staleSeconds = 60;
+	for (int i = 0; i < ds18_count; i++) {
+		if (ds18b20devices.last_read[i] < 0xFFFF)
+			ds18b20devices.last_read[i]++;
+		if (ds18b20devices.last_read[i] > staleSeconds && ds18b20devices.lasttemp[i] > DEVICE_DISCONNECTED_C) {
+			DS1820_LOG(ERROR, "No temperature read for over %i seconds for"
+				" device %i (" DEVSTR " on GPIO %i)! Setting to -127°C!\r\n", staleSeconds, i,
+				DEV2STR(ds18b20devices.array[i]), ds18b20devices.GPIO[i]);
+			ds18b20devices.lasttemp[i] = DEVICE_DISCONNECTED_C;
+		}
+		b = ds18b20_getBus(i);
+		if (b < 0 || ds18buses[b].state != DS18_BUS_IDLE)
+			continue;
+		// buses list is made by scan, pin role may have been removed since
+		if (g_cfg.pins.roles[DS18B20GPIOS[b]] != IOR_DS1820_IO)
+			continue;
+		if (g_secondsElapsed >= ds18b20devices.nextRead[i]) {
+			// sensor will get its scratchpad read after conversion
+			ds18b20devices.pending[i] = true;
+			ds18b20devices.retries[i] = 0;
+			ds18b20devices.nextRead[i] = g_secondsElapsed + ds18b20devices.interval[i];
+			due[b] = true;
+		}
+	}
+	// one Convert-T for all sensors on bus
+	for (b = 0; b < DS18B20MAX_GPIOS; b++) {
+		if (due[b]) {
+			DS1820_LOG(DEBUG, "Starting conversion on GPIO %i", DS18B20GPIOS[b]);
+			ds18b20_requestConvertT(DS18B20GPIOS[b]);
+			ds18buses[b].state = DS18_BUS_CONVERTING;
+			ds18buses[b].convStart = g_timeMs;
+		}
+	}
+}
 
+#if WINDOWS
+void DS1820_full_Test_GetStats(int i, int *reads, int *crcErrors, int *interval) {
+	*reads = ds18b20devices.reads[i];
+	*crcErrors = ds18b20devices.crcErrors[i];
+	*interval = ds18b20devices.interval[i];
 }
+#endif
 
 #endif // to #if (ENABLE_DRIVER_DS1820_FULL)
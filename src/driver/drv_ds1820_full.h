@@ -3,6 +3,7 @@
 
 void DS1820_full_driver_Init();
 void DS1820_full_OnEverySecond();
+void DS1820_full_RunQuickTick();
 void DS1820_full_AppendInformationToHTTPIndexPage(http_request_t *request, int bPreState);
 
 #define DEVICE_DISCONNECTED_C -127
@@ -25,3 +26,12 @@ bool isConversionComplete();
 void reset_search();
 bool search(uint8_t *newAddr, bool search_mode, int Pin);
 char *DS1820_full_jsonSensors();
+
+#if WINDOWS
+// simulated 1-Wire bus, sensors are found by DS1820_FULL_scansensors or driver start
+void DS1820_full_Sim_Clear();
+int DS1820_full_Sim_AddSensor(int pin, const char *addr, float temp);
+void DS1820_full_Sim_SetTemperature(int index, float temp);
+void DS1820_full_Sim_InjectCRCErrors(int index, int count);
+void DS1820_full_Test_GetStats(int i, int *reads, int *crcErrors, int *interval);
+#endif
@@ -25,6 +25,7 @@
 #include "../new_pins.h"
 
 #include "drv_public.h"
+#include "drv_bl_samples.h"
 #include "drv_spi.h"
 
 
@@ -952,6 +953,11 @@ static void HLW8112_ScaleAndUpdate(HLW8112_Data_t* data) {
 	last_update_data.ib_rms = current_b;
 	last_update_data.pa = power_a;
 	last_update_data.pb = power_b;
+#if ENABLE_BL_SAMPLES
+	// channel A and B as two meters, same voltage
+	BL_Samples_Add(0, voltage / 1000.0f, current_a / 1000.0f, power_a / 1000.0f);
+	BL_Samples_Add(1, voltage / 1000.0f, current_b / 1000.0f, power_b / 1000.0f);
+#endif
 
 	HLW8112_SaveFlags_t save =  HLW8112_SAVE_NONE;
 	if (energy_a !=0  ) {
@@ -20,7 +20,11 @@
 // 3. then alexa accesses our XML pages here with GET
 // 4. and can change the binary state (0 or 1) with POST
 
+// four rendered replies, one after another, NUL separated
 static char *buffer_out = 0;
+static char *buffer_parts[4];
+// SSDP render version they were made for
+static int buffer_out_version = -1;
 static char *g_serial = 0;
 static char *g_userID = 0;
 static char *g_uid = 0;
@@ -58,8 +62,42 @@ const  char *hue_resp3 = "ST: urn:schemas-upnp-org:device:basic:1\r\n"
    "USN: uuid:%s\r\n"
    "\r\n";
 
+static void HUE_RenderAdverts() {
+	char *p;
+	int left, len;
+
+	if (buffer_out == 0) {
+		outBufferLen = strlen(hue_resp) + strlen(hue_resp1) + strlen(hue_resp2) + strlen(hue_resp3) + 256;
+		buffer_out = (char*)malloc(outBufferLen);
+		if (buffer_out == 0) {
+			return;
+		}
+	}
+	p = buffer_out;
+	left = outBufferLen;
+	// ARGUMENTS: first IP, then bridgeID
+	buffer_parts[0] = p;
+	len = snprintf(p, left, hue_resp, HAL_GetMyIPString(), g_bridgeID) + 1;
+	p += len;
+	left -= len;
+	// ARGUMENTS: uuid
+	buffer_parts[1] = p;
+	len = snprintf(p, left, hue_resp1, g_uid) + 1;
+	p += len;
+	left -= len;
+	// ARGUMENTS: uuid and uuid
+	buffer_parts[2] = p;
+	len = snprintf(p, left, hue_resp2, g_uid, g_uid) + 1;
+	p += len;
+	left -= len;
+	// ARGUMENTS: uuid
+	buffer_parts[3] = p;
+	snprintf(p, left, hue_resp3, g_uid);
+	buffer_out_version = DRV_SSDP_GetRenderVersion();
+}
+
 void DRV_HUE_Send_Advert_To(struct sockaddr_in *addr) {
-	//const char *useType;
+	int i;
 
 	if (g_uid == 0) {
 		// not running
@@ -68,38 +106,16 @@ void DRV_HUE_Send_Advert_To(struct sockaddr_in *addr) {
 
 	stat_searchesReceived++;
 
-	if (buffer_out == 0) {
-		outBufferLen = strlen(hue_resp) + 256;
-		buffer_out = (char*)malloc(outBufferLen);
-	}
-	{
-		// ARGUMENTS: first IP, then bridgeID
-		snprintf(buffer_out, outBufferLen, hue_resp, HAL_GetMyIPString(), g_bridgeID);
-
-		addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, "HUE - Sending[0] %s", buffer_out);
-		DRV_SSDP_SendReply(addr, buffer_out);
-	}
-	{
-		// ARGUMENTS: uuid
-		snprintf(buffer_out, outBufferLen, hue_resp1, g_uid);
-
-		addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, "HUE - Sending[1] %s", buffer_out);
-		DRV_SSDP_SendReply(addr, buffer_out);
+	if (buffer_out_version != DRV_SSDP_GetRenderVersion()) {
+		HUE_RenderAdverts();
 	}
-	{
-		// ARGUMENTS: uuid and uuid
-		snprintf(buffer_out, outBufferLen, hue_resp2, g_uid, g_uid);
-
-		addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, "HUE - Sending[2] %s", buffer_out);
-		DRV_SSDP_SendReply(addr, buffer_out);
+	if (buffer_out == 0) {
+		return;
 	}
-	{
-		// ARGUMENTS: uuid
-		snprintf(buffer_out, outBufferLen, hue_resp3, g_uid);
-
-		addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, "HUE - Sending[3] %s", buffer_out);
-		DRV_SSDP_SendReply(addr, buffer_out);
+	for (i = 0; i < 4; i++) {
+		DRV_SSDP_SendReply(addr, buffer_parts[i]);
 	}
+	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP, "HUE - sent replies");
 }
 
 
@@ -247,6 +263,8 @@ void HUE_Init() {
 	// uuid
 	snprintf(tmp, sizeof(tmp), "f6543a06-da50-11ba-8d8f-%s", g_serial);
 	g_uid = strdup(tmp);
+	// uid may have changed
+	buffer_out_version = -1;
 
 
 	//HTTP_RegisterCallback("/api", HTTP_ANY, HUE_APICall);
@@ -185,6 +185,7 @@ void DRV_MAX72XX_Init();
 void DRV_MAX72XX_Shutdown();
 int MAX72XXSingle_CountPixels(bool bOn);
 int MAX72XXSingle_GetScrollCount();
+int MAX72XXSingle_GetTransferCount();
 
 void EEPROM_Init();
 void EEPROM_OnEverySecond();
@@ -282,17 +283,41 @@ typedef struct softI2C_s
 	// I must somehow be able to tell which proto we have?
 	// short protocolType;
 	byte address8bit;
+	// statistics, see SoftI2C_Stats
+	unsigned int transactions;
+	unsigned int bytes;
+	unsigned int nacks;
+	// SCL cycles, start/stop count as one
+	unsigned int clocks;
 } softI2C_t;
 
+// one part of Soft_I2C_Transfer
+typedef struct softI2CMsg_s {
+	byte bRead;
+	byte *data;
+	int len;
+} softI2CMsg_t;
+
 void Soft_I2C_SetLow(uint8_t pin);
 void Soft_I2C_SetHigh(uint8_t pin);
 bool Soft_I2C_PreInit(softI2C_t *i2c);
+void Soft_I2C_Release(softI2C_t *i2c);
 bool Soft_I2C_WriteByte(softI2C_t *i2c, uint8_t value);
 bool Soft_I2C_Start(softI2C_t *i2c, uint8_t addr);
 void Soft_I2C_Start_Internal(softI2C_t *i2c);
 void Soft_I2C_Stop(softI2C_t *i2c);
 uint8_t Soft_I2C_ReadByte(softI2C_t *i2c, bool nack);
 void Soft_I2C_ReadBytes(softI2C_t *i2c, uint8_t *buf, int numOfBytes);
+bool Soft_I2C_Transfer(softI2C_t *i2c, uint8_t addr8bit, const softI2CMsg_t *msgs, int count);
+bool Soft_I2C_ReadRegs(softI2C_t *i2c, uint8_t addr8bit, uint8_t reg, uint8_t *data, int len);
+bool Soft_I2C_WriteRegs(softI2C_t *i2c, uint8_t addr8bit, uint8_t reg, const uint8_t *data, int len);
+#if WINDOWS
+int Soft_I2C_Sim_AddDevice(int pin_clk, int pin_data, int address7bit, int regWidth);
+void Soft_I2C_Sim_Clear();
+void Soft_I2C_Sim_SetRegister(int device, int reg, int value);
+int Soft_I2C_Sim_GetRegister(int device, int reg);
+bool Soft_I2C_Test_GetStats(int pin_clk, int pin_data, int *transactions, int *bytes, int *nacks, int *clocks);
+#endif
 
 // Shared LED driver
 commandResult_t CMD_LEDDriver_Map(const void *context, const char *cmd, const char *args, int flags);
@@ -3,6 +3,7 @@
 #include "drv_bl0937.h"
 #include "drv_bl0942.h"
 #include "drv_bl_shared.h"
+#include "drv_bl_samples.h"
 #include "drv_neo6m.h"
 #include "drv_cse7766.h"
 #include "drv_ir.h"
@@ -573,7 +574,11 @@ static driver_t g_drivers[] = {
 	BL0942_UART_Init,                        // Init
 	BL0942_UART_RunEverySecond,              // onEverySecond
 	BL09XX_AppendInformationToHTTPIndexPage, // appendInformationToHTTPIndexPage
+#if ENABLE_BL_SAMPLES
+	BL0942_UART_RunQuickTick,                // runQuickTick
+#else
 	NULL,                                    // runQuickTick
+#endif
 	NULL,                                    // stopFunction
 	NULL,                                    // onChannelChanged
 	NULL,                                    // onHassDiscovery
@@ -605,7 +610,11 @@ static driver_t g_drivers[] = {
 	BL0942_SPI_Init,                         // Init
 	BL0942_SPI_RunEverySecond,               // onEverySecond
 	BL09XX_AppendInformationToHTTPIndexPage, // appendInformationToHTTPIndexPage
+#if ENABLE_BL_SAMPLES
+	BL0942_SPI_RunQuickTick,                 // runQuickTick
+#else
 	NULL,                                    // runQuickTick
+#endif
 	NULL,                                    // stopFunction
 	NULL,                                    // onChannelChanged
 	NULL,                                    // onHassDiscovery
@@ -685,7 +694,11 @@ static driver_t g_drivers[] = {
 	CSE7766_Init,                            // Init
 	CSE7766_RunEverySecond,                  // onEverySecond
 	BL09XX_AppendInformationToHTTPIndexPage, // appendInformationToHTTPIndexPage
+#if ENABLE_BL_SAMPLES
+	CSE7766_RunQuickTick,                    // runQuickTick
+#else
 	NULL,                                    // runQuickTick
+#endif
 	NULL,                                    // stopFunction
 	NULL,                                    // onChannelChanged
 	NULL,                                    // onHassDiscovery
@@ -1301,7 +1314,7 @@ static driver_t g_drivers[] = {
 	DS1820_full_driver_Init,                 // Init
 	DS1820_full_OnEverySecond,               // onEverySecond
 	DS1820_full_AppendInformationToHTTPIndexPage, // appendInformationToHTTPIndexPage
-	NULL,                                    // runQuickTick
+	DS1820_full_RunQuickTick,                // runQuickTick
 	NULL,                                    // stopFunction
 	NULL,                                    // onChannelChanged
 	NULL,                                    // onHassDiscovery
@@ -1543,21 +1556,158 @@ static driver_t g_drivers[] = {
 };
 
 
-static const int g_numDrivers = sizeof(g_drivers) / sizeof(g_drivers[0]);
+#define DRV_NUM_DRIVERS (sizeof(g_drivers) / sizeof(g_drivers[0]))
+static const int g_numDrivers = DRV_NUM_DRIVERS;
 
-bool DRV_IsRunning(const char* name) {
+// running drivers that have given callback, in table order. Rebuilt when
+// a driver starts or stops, so dispatch doesn't walk the whole table.
+typedef struct driverList_s {
+	short count;
+	short ids[DRV_NUM_DRIVERS];
+} driverList_t;
+
+static driverList_t g_loadedList;
+static driverList_t g_everySecondList;
+static driverList_t g_quickTickList;
+static driverList_t g_channelChangedList;
+static driverList_t g_hassDiscoveryList;
+static driverList_t g_httpIndexList;
+// bit per driver ID, set while driver is running
+static unsigned int g_runningBits[(DRV_NUM_DRIVERS + 31) / 32];
+
+// time is measured in RTOS ticks, so callbacks shorter than a tick
+// show up only on some calls, but the sum is right on average
+typedef struct driverStats_s {
+	int quickTickCalls;
+	int quickTickTicks;
+	int quickTickMaxTicks;
+	int everySecondCalls;
+	int everySecondTicks;
+	int everySecondMaxTicks;
+} driverStats_t;
+
+static driverStats_t g_driverStats[DRV_NUM_DRIVERS];
+
+static void DRV_RebuildLists() {
+	driver_t *d;
 	int i;
 
+	g_loadedList.count = 0;
+	g_everySecondList.count = 0;
+	g_quickTickList.count = 0;
+	g_channelChangedList.count = 0;
+	g_hassDiscoveryList.count = 0;
+	g_httpIndexList.count = 0;
+	memset(g_runningBits, 0, sizeof(g_runningBits));
 	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (!stricmp(name, g_drivers[i].name)) {
-				return true;
-			}
+		d = &g_drivers[i];
+		if (!d->bLoaded) {
+			continue;
+		}
+		g_runningBits[i / 32] |= 1u << (i % 32);
+		g_loadedList.ids[g_loadedList.count++] = i;
+		if (d->onEverySecond) {
+			g_everySecondList.ids[g_everySecondList.count++] = i;
+		}
+		if (d->runQuickTick) {
+			g_quickTickList.ids[g_quickTickList.count++] = i;
+		}
+		if (d->onChannelChanged) {
+			g_channelChangedList.ids[g_channelChangedList.count++] = i;
+		}
+		if (d->onHassDiscovery) {
+			g_hassDiscoveryList.ids[g_hassDiscoveryList.count++] = i;
+		}
+		if (d->appendInformationToHTTPIndexPage) {
+			g_httpIndexList.ids[g_httpIndexList.count++] = i;
+		}
+	}
+	// list of drivers is shown on index page
+	HTTP_IndexStateChanged();
+}
+
+int DRV_FindDriver(const char* name) {
+	int i;
+
+	for (i = 0; i < g_numDrivers; i++) {
+		if (!stricmp(name, g_drivers[i].name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool DRV_IsRunningID(int id) {
+	if (id < 0 || id >= g_numDrivers) {
+		return false;
+	}
+	return (g_runningBits[id / 32] >> (id % 32)) & 1;
+}
+
+bool DRV_IsRunningCached(const char* name, int *cache) {
+	if (*cache == 0) {
+		*cache = DRV_FindDriver(name) + 1;
+		if (*cache == 0) {
+			// not in this build
+			*cache = -1;
+		}
+	}
+	return DRV_IsRunningID(*cache - 1);
+}
+
+bool DRV_IsAnyRunningCached(const char* const* names, int *cache, int count) {
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (DRV_IsRunningCached(names[i], &cache[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DRV_IsRunning(const char* name) {
+	int i;
+
+	// only running drivers are compared
+	for (i = 0; i < g_loadedList.count; i++) {
+		if (!stricmp(name, g_drivers[g_loadedList.ids[i]].name)) {
+			return true;
 		}
 	}
 	return false;
 }
 
+// drivers print their own HTML on index page, it may change at any time
+bool DRV_HasIndexPageInformation() {
+	return g_httpIndexList.count != 0;
+}
+
+#ifdef WINDOWS
+// simulator can't skip time while any driver is polled every quick tick
+bool DRV_HasRunningQuickTick() {
+	return g_quickTickList.count != 0;
+}
+
+int DRV_Test_GetQuickTickCalls(const char* name) {
+	int id = DRV_FindDriver(name);
+
+	if (id < 0) {
+		return -1;
+	}
+	return g_driverStats[id].quickTickCalls;
+}
+
+int DRV_Test_GetEverySecondCalls(const char* name) {
+	int id = DRV_FindDriver(name);
+
+	if (id < 0) {
+		return -1;
+	}
+	return g_driverStats[id].everySecondCalls;
+}
+#endif
+
 static SemaphoreHandle_t g_mutex = 0;
 
 bool DRV_Mutex_Take(int del) {
@@ -1577,16 +1727,23 @@ void DRV_Mutex_Free() {
 	xSemaphoreGive(g_mutex);
 }
 void DRV_OnEverySecond() {
-	int i;
+	driverStats_t *st;
+	portTickType start, spent;
+	int i, id;
 
 	if (DRV_Mutex_Take(100) == false) {
 		return;
 	}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].onEverySecond != 0) {
-				g_drivers[i].onEverySecond();
-			}
+	for (i = 0; i < g_everySecondList.count; i++) {
+		id = g_everySecondList.ids[i];
+		start = xTaskGetTickCount();
+		g_drivers[id].onEverySecond();
+		spent = xTaskGetTickCount() - start;
+		st = &g_driverStats[id];
+		st->everySecondCalls++;
+		st->everySecondTicks += spent;
+		if ((int)spent > st->everySecondMaxTicks) {
+			st->everySecondMaxTicks = spent;
 		}
 	}
 #ifndef OBK_DISABLE_ALL_DRIVERS
@@ -1596,16 +1753,23 @@ void DRV_OnEverySecond() {
 	DRV_Mutex_Free();
 }
 void DRV_RunQuickTick() {
-	int i;
+	driverStats_t *st;
+	portTickType start, spent;
+	int i, id;
 
 	if (DRV_Mutex_Take(0) == false) {
 		return;
 	}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].runQuickTick != 0) {
-				g_drivers[i].runQuickTick();
-			}
+	for (i = 0; i < g_quickTickList.count; i++) {
+		id = g_quickTickList.ids[i];
+		start = xTaskGetTickCount();
+		g_drivers[id].runQuickTick();
+		spent = xTaskGetTickCount() - start;
+		st = &g_driverStats[id];
+		st->quickTickCalls++;
+		st->quickTickTicks += spent;
+		if ((int)spent > st->quickTickMaxTicks) {
+			st->quickTickMaxTicks = spent;
 		}
 	}
 	DRV_Mutex_Free();
@@ -1616,12 +1780,8 @@ void DRV_OnChannelChanged(int channel, int iVal) {
 	//if(DRV_Mutex_Take(100)==false) {
 	//	return;
 	//}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].onChannelChanged != 0) {
-				g_drivers[i].onChannelChanged(channel, iVal);
-			}
-		}
+	for (i = 0; i < g_channelChangedList.count; i++) {
+		g_drivers[g_channelChangedList.ids[i]].onChannelChanged(channel, iVal);
 	}
 	//DRV_Mutex_Free();
 }
@@ -1643,10 +1803,13 @@ void DRV_StopDriver(const char* name) {
 	for (i = 0; i < g_numDrivers; i++) {
 		if (*name == '*' || !stricmp(g_drivers[i].name, name)) {
 			if (g_drivers[i].bLoaded) {
+				// take it out of the lists first, so nothing calls into it while it's freeing its state
+				g_drivers[i].bLoaded = false;
+				DRV_RebuildLists();
 				if (g_drivers[i].stopFunc != 0) {
 					g_drivers[i].stopFunc();
 				}
-				g_drivers[i].bLoaded = false;
+				memset(&g_driverStats[i], 0, sizeof(g_driverStats[i]));
 				addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Drv %s stopped.", g_drivers[i].name);
 			}
 			else {
@@ -1696,6 +1859,7 @@ void DRV_StartDriver(const char* name) {
 					g_drivers[i].initFunc();
 				}
 				g_drivers[i].bLoaded = true;
+				DRV_RebuildLists();
 				addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Started %s.", name);
 				bStarted = 1;
 				break;
@@ -1748,6 +1912,32 @@ static commandResult_t DRV_Stop(const void* context, const char* cmd, const char
 	return CMD_RES_OK;
 }
 
+// driverStats [reset]
+static commandResult_t DRV_Stats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	driverStats_t *st;
+	bool bReset;
+	int i, id;
+
+	Tokenizer_TokenizeString(args, 0);
+	bReset = Tokenizer_GetArgsCount() >= 1 && !stricmp(Tokenizer_GetArg(0), "reset");
+	if (DRV_Mutex_Take(100) == false) {
+		return CMD_RES_ERROR;
+	}
+	for (i = 0; i < g_loadedList.count; i++) {
+		id = g_loadedList.ids[i];
+		st = &g_driverStats[id];
+		addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "%s: quick tick %i calls, %i ms, max %i ms; every second %i calls, %i ms, max %i ms",
+			g_drivers[id].name,
+			st->quickTickCalls, (int)(st->quickTickTicks * portTICK_PERIOD_MS), (int)(st->quickTickMaxTicks * portTICK_PERIOD_MS),
+			st->everySecondCalls, (int)(st->everySecondTicks * portTICK_PERIOD_MS), (int)(st->everySecondMaxTicks * portTICK_PERIOD_MS));
+	}
+	if (bReset) {
+		memset(g_driverStats, 0, sizeof(g_driverStats));
+	}
+	DRV_Mutex_Free();
+	return CMD_RES_OK;
+}
+
 void DRV_Generic_Init() {
 	//cmddetail:{"name":"startDriver","args":"[DriverName]",
 	//cmddetail:"descr":"Starts driver",
@@ -1759,10 +1949,19 @@ void DRV_Generic_Init() {
 	//cmddetail:"fn":"DRV_Stop","file":"driver/drv_main.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("stopDriver", DRV_Stop, NULL);
+	//cmddetail:{"name":"driverStats","args":"[reset]",
+	//cmddetail:"descr":"Prints, for every running driver, how many times its quick tick and every second callbacks were called and how long they took in total and at most. With 'reset' counters are cleared after printing.",
+	//cmddetail:"fn":"DRV_Stats","file":"driver/drv_main.c","requires":"",
+	//cmddetail:"examples":"driverStats reset"}
+	CMD_RegisterCommand("driverStats", DRV_Stats, NULL);
 #ifndef OBK_DISABLE_ALL_DRIVERS
 	// init TIME unconditionally on start
 	TIME_Init();
 #endif
+#if ENABLE_BL_SAMPLES
+	// before any metering driver, so it can be set up in autoexec
+	BL_Samples_Init();
+#endif
 }
 
 void DRV_OnHassDiscovery(const char *topic) {
@@ -1771,19 +1970,14 @@ void DRV_OnHassDiscovery(const char *topic) {
 	if (DRV_Mutex_Take(100) == false) {
 		return;
 	}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].onHassDiscovery) {
-				g_drivers[i].onHassDiscovery(topic);
-			}
-		}
+	for (i = 0; i < g_hassDiscoveryList.count; i++) {
+		g_drivers[g_hassDiscoveryList.ids[i]].onHassDiscovery(topic);
 	}
 	DRV_Mutex_Free();
 
 }
 void DRV_AppendInformationToHTTPIndexPage(http_request_t* request, int bPreState) {
-	int i, j;
-	int c_active = 0;
+	int i;
 
 	if (DRV_Mutex_Take(100) == false) {
 		return;
@@ -1791,32 +1985,22 @@ void DRV_AppendInformationToHTTPIndexPage(http_request_t* request, int bPreState
 #ifndef OBK_DISABLE_ALL_DRIVERS
 	TIME_AppendInformationToHTTPIndexPage(request, bPreState);
 #endif
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			c_active++;
-			if (g_drivers[i].appendInformationToHTTPIndexPage) {
-				g_drivers[i].appendInformationToHTTPIndexPage(request, bPreState);
-			}
-		}
+	for (i = 0; i < g_httpIndexList.count; i++) {
+		g_drivers[g_httpIndexList.ids[i]].appendInformationToHTTPIndexPage(request, bPreState);
 	}
 	DRV_Mutex_Free();
 
 	if (bPreState == false) {
-		hprintf255(request, "<h5>%i drivers active", c_active);
-		if (c_active > 0) {
-			j = 0;// printed 0 names so far
+		hprintf255(request, "<h5>%i drivers active", g_loadedList.count);
+		if (g_loadedList.count > 0) {
 			// generate active drivers list in (  )
 			hprintf255(request, " (");
-			for (i = 0; i < g_numDrivers; i++) {
-				if (g_drivers[i].bLoaded) {
-					// if at least one name printed, add separator
-					if (j != 0) {
-						hprintf255(request, ", ");
-					}
-					hprintf255(request, g_drivers[i].name);
-					// one more name printed
-					j++;
+			for (i = 0; i < g_loadedList.count; i++) {
+				// if at least one name printed, add separator
+				if (i != 0) {
+					hprintf255(request, ", ");
 				}
+				hprintf255(request, g_drivers[g_loadedList.ids[i]].name);
 			}
 			hprintf255(request, ")");
 		}
@@ -1824,19 +2008,25 @@ void DRV_AppendInformationToHTTPIndexPage(http_request_t* request, int bPreState
 	}
 }
 
+#ifndef OBK_DISABLE_ALL_DRIVERS
+static const char* const g_powerDrivers[] = { "BL0937", "BL0942", "CSE7766", "TESTPOWER", "BL0942SPI", "RN8209" };
+// "HLW8112SPI" TODO messup ha config if enabled
+static int g_powerDriversCache[sizeof(g_powerDrivers) / sizeof(g_powerDrivers[0])];
+static const char* const g_sensorDrivers[] = { "SHT3X", "CHT83XX", "SGP", "AHT2X", "DS1820", "DS1820_full" };
+static int g_sensorDriversCache[sizeof(g_sensorDrivers) / sizeof(g_sensorDrivers[0])];
+static int g_batteryDriverCache;
+#endif
+
 bool DRV_IsMeasuringPower() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("BL0937") || DRV_IsRunning("BL0942")
-		|| DRV_IsRunning("CSE7766") || DRV_IsRunning("TESTPOWER")
-		|| DRV_IsRunning("BL0942SPI") || DRV_IsRunning("RN8209");
-		// || DRV_IsRunning("HLW8112SPI"); TODO messup ha config if enabled
+	return DRV_IsAnyRunningCached(g_powerDrivers, g_powerDriversCache, sizeof(g_powerDrivers) / sizeof(g_powerDrivers[0]));
 #else
 	return false;
 #endif
 }
 bool DRV_IsMeasuringBattery() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("Battery");
+	return DRV_IsRunningCached("Battery", &g_batteryDriverCache);
 #else
 	return false;
 #endif
@@ -1844,7 +2034,7 @@ bool DRV_IsMeasuringBattery() {
 
 bool DRV_IsSensor() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("SHT3X") || DRV_IsRunning("CHT83XX") || DRV_IsRunning("SGP") || DRV_IsRunning("AHT2X") || DRV_IsRunning("DS1820") || DRV_IsRunning("DS1820_full");
+	return DRV_IsAnyRunningCached(g_sensorDrivers, g_sensorDriversCache, sizeof(g_sensorDrivers) / sizeof(g_sensorDrivers[0]));
 #else
 	return false;
 #endif
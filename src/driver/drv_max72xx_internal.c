@@ -44,14 +44,20 @@ void MAX_FreeBuffer() {
 }
 void PORT_shiftOut(int dataPin, int clockPin, int bitOrder, int val, int totalBytes)
 {
-	int i;
+	int i, bit;
+	int last = -1;
 	int totalBits = totalBytes * 8;
 
 	for (i = 0; i < totalBits; i++) {
 		if (bitOrder == LSBFIRST)
-			HAL_PIN_SetOutputValue(dataPin, !!(val & (1 << i)));
+			bit = !!(val & (1 << i));
 		else
-			HAL_PIN_SetOutputValue(dataPin, !!(val & (1 << ((totalBits - 1) - i))));
+			bit = !!(val & (1 << ((totalBits - 1) - i)));
+		// data pin only changes when bit does
+		if (bit != last) {
+			HAL_PIN_SetOutputValue(dataPin, bit);
+			last = bit;
+		}
 
 		MAX72XX_DELAY
 		HAL_PIN_SetOutputValue(clockPin, HIGH);
@@ -61,6 +67,22 @@ void PORT_shiftOut(int dataPin, int clockPin, int bitOrder, int val, int totalBy
 }
 
 void SIM_SetMAX7219Pixels(byte *data, int size);
+// shifts whole spidata through the chain, each device latches its 2 bytes
+static void MAX72XX_sendChain(max72XX_t *led) {
+	int i;
+
+	MAX72XX_DELAY
+	HAL_PIN_SetOutputValue(led->port_cs, LOW);
+	MAX72XX_DELAY
+	for (i = led->maxDevices * 2; i > 0; i--)
+		PORT_shiftOut(led->port_mosi, led->port_clk, MSBFIRST, led->spidata[i - 1], 1);
+#if WINDOWS && !LINUX
+	SIM_SetMAX7219Pixels(led->led_status, led->maxDevices);
+#endif
+	MAX72XX_DELAY
+	HAL_PIN_SetOutputValue(led->port_cs, HIGH);
+	led->transfers++;
+}
 void MAX72XX_spiTransfer(max72XX_t *led, int adddr, unsigned char opcode, byte datta) {
 	if (led == 0) {
 		return;
@@ -75,16 +97,21 @@ void MAX72XX_spiTransfer(max72XX_t *led, int adddr, unsigned char opcode, byte d
 		led->spidata[i] = (byte)0;
 	led->spidata[offset + 1] = opcode;
 	led->spidata[offset] = datta;
-	MAX72XX_DELAY
-	HAL_PIN_SetOutputValue(led->port_cs, LOW);
-	MAX72XX_DELAY
-	for (i = maxbytes; i > 0; i--)
-		PORT_shiftOut(led->port_mosi, led->port_clk, MSBFIRST, led->spidata[i - 1], 1);
-#if WINDOWS && !LINUX
-	SIM_SetMAX7219Pixels(led->led_status, led->maxDevices);
-#endif
-	MAX72XX_DELAY
-	HAL_PIN_SetOutputValue(led->port_cs, HIGH);
+	if (opcode >= OP_DIGIT0 && opcode <= OP_DIGIT7) {
+		led->sent_status[adddr * 8 + opcode - OP_DIGIT0] = datta;
+	}
+	MAX72XX_sendChain(led);
+}
+// same row of all devices in one transfer
+static void MAX72XX_sendRow(max72XX_t *led, int row) {
+	int i;
+
+	for (i = 0; i < led->maxDevices; i++) {
+		led->spidata[i * 2 + 1] = OP_DIGIT0 + row;
+		led->spidata[i * 2] = led->led_status[i * 8 + row];
+		led->sent_status[i * 8 + row] = led->led_status[i * 8 + row];
+	}
+	MAX72XX_sendChain(led);
 }
 void MAX72XX_shutdown(max72XX_t *led, int addr, bool b) {
 	if (led == 0) {
@@ -149,6 +176,7 @@ void MAX72XX_free(max72XX_t *led) {
 	}
 	free(led->spidata);
 	free(led->led_status);
+	free(led->sent_status);
 	free(led);
 }
 int MAX72XX_countPixels(max72XX_t *led, bool bOn) {
@@ -179,17 +207,17 @@ void MAX72XX_refresh(max72XX_t *led) {
 		return;
 	}
 	int i;
-	//int mx;
-	//byte tmp;
-	int offset;
 	int row;
-	for (i = 0; i < led->maxDevices; i++)
+	for (row = 0; row < 8; row++)
 	{
-		for (row = 0; row < 8; row++)
+		for (i = 0; i < led->maxDevices; i++)
 		{
-			offset = i * 8;
-			MAX72XX_spiTransfer(led, i, row + 1, led->led_status[offset + row]);
+			if (led->led_status[i * 8 + row] != led->sent_status[i * 8 + row])
+				break;
 		}
+		// unchanged rows are not sent at all
+		if (i < led->maxDevices)
+			MAX72XX_sendRow(led, row);
 	}
 }
 byte Byte_ReverseBits(byte num)
@@ -396,6 +424,9 @@ void MAX72XX_setupPins(max72XX_t *led, int csi, int clki, int mosii, int maxDevi
 	led->maxDevices = maxDevices;
 	led->spidata = (byte*)malloc(maxDevices * 2);
 	led->led_status = (byte*)malloc(maxDevices * 8);
+	led->sent_status = (byte*)malloc(maxDevices * 8);
+	// MAX72XX_init clears devices, so that's what they show
+	memset(led->sent_status, 0, maxDevices * 8);
 	led->port_cs = csi;
 	led->port_clk = clki;
 	led->port_mosi = mosii;
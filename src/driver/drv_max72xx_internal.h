@@ -7,7 +7,11 @@ typedef struct max72XX_s {
 	byte maxDevices;
 	unsigned char *spidata;
 	byte *led_status;
+	// rows as last sent to devices, refresh sends only rows that differ
+	byte *sent_status;
 	int scrollCount;
+	// number of chain transfers, for selftests
+	int transfers;
 } max72XX_t;
 
 int MAX72XX_countPixels(max72XX_t *led, bool bOn);
@@ -396,6 +396,11 @@ int MAX72XXSingle_GetScrollCount() {
 		return 0;
 	return g_max->scrollCount;
 }
+int MAX72XXSingle_GetTransferCount() {
+	if (g_max == 0)
+		return 0;
+	return g_max->transfers;
+}
 static commandResult_t DRV_MAX72XX_Show(const void *context, const char *cmd, const char *args, int flags) {
 
 
@@ -32,27 +32,21 @@ static float g_mcp_userCalibrationDelta = 0.0f;
 
 void MCP9808_WriteReg16(uint8_t reg, uint16_t value)
 {
+	byte data[2];
+
 	if (reg > MCP9808_RES)
 		return;      //  see p.16
-	Soft_I2C_Start(&g_softI2C, g_addr);
-	Soft_I2C_WriteByte(&g_softI2C, reg);
-	Soft_I2C_WriteByte(&g_softI2C, value >> 8);
-	Soft_I2C_WriteByte(&g_softI2C, value & 0xFF);
-	Soft_I2C_Stop(&g_softI2C);
+	data[0] = value >> 8;
+	data[1] = value & 0xFF;
+	Soft_I2C_WriteRegs(&g_softI2C, g_addr, reg, data, 2);
 }
 uint16_t MCP9808_ReadReg16(uint8_t reg)
 {
 	byte reply[2];
 
-	Soft_I2C_Start(&g_softI2C, g_addr);
-	Soft_I2C_WriteByte(&g_softI2C, reg);
-	Soft_I2C_Stop(&g_softI2C);
-
-	rtos_delay_milliseconds(20);	//give the sensor time to do the conversion
-
-	Soft_I2C_Start(&g_softI2C, g_addr | 1);
-	Soft_I2C_ReadBytes(&g_softI2C, reply, 2);
-	Soft_I2C_Stop(&g_softI2C);
+	// sensor converts continuously, ambient temperature register always
+	// holds the last result, so no need to wait between pointer write and read
+	Soft_I2C_ReadRegs(&g_softI2C, g_addr, reg, reply, 2);
 
 	uint16_t val = reply[0] << 8;
 	val += reply[1];
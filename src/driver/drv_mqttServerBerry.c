@@ -167,24 +167,16 @@ static int be_ms_subscribe(bvm *vm) {
 
   const char *filter = be_tostring(vm, 1);
 
-  // Suspend the closure to get a closure ID
-  if (!be_getglobal(vm, "suspend_closure")) {
+  // Keep the closure alive, its ID is used to call it
+  int closureId = berrySuspendClosure(vm, 2);
+  if (closureId == 0) {
     be_return_nil(vm);
   }
-  be_pushvalue(vm, 2); // push the closure
-  be_call(vm, 1);      // call suspend_closure(closure)
-
-  if (!be_isint(vm, -2)) {
-    be_pop(vm, 2);
-    be_return_nil(vm);
-  }
-
-  int closureId = be_toint(vm, -2);
-  be_pop(vm, 2);
 
   // Create subscription entry
   berrySub_t *sub = (berrySub_t *)malloc(sizeof(berrySub_t));
   if (!sub) {
+    berryRemoveClosure(vm, closureId);
     be_return_nil(vm);
   }
   sub->topicFilter = strdup(filter);
@@ -210,6 +202,7 @@ static int be_ms_unsubscribe(bvm *vm) {
     if ((*pp)->closureId == id) {
       berrySub_t *victim = *pp;
       *pp = victim->next;
+      berryRemoveClosure(vm, victim->closureId);
       addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "MQTTS Berry: unsubscribed '%s'",
                 victim->topicFilter);
       free(victim->topicFilter);
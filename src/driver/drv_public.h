@@ -61,6 +61,19 @@ void DRV_StopDriver(const char* name);
 // right now only used by simulator
 void DRV_ShutdownAllDrivers();
 bool DRV_IsRunning(const char* name);
+// driver ID is stable, it's -1 if driver is not in this build
+int DRV_FindDriver(const char* name);
+bool DRV_IsRunningID(int id);
+// for hot paths, name is looked up on first call and cached in a zeroed int,
+// later calls only check a bit
+bool DRV_IsRunningCached(const char* name, int *cache);
+bool DRV_IsAnyRunningCached(const char* const* names, int *cache, int count);
+bool DRV_HasIndexPageInformation();
+#ifdef WINDOWS
+bool DRV_HasRunningQuickTick();
+int DRV_Test_GetQuickTickCalls(const char* name);
+int DRV_Test_GetEverySecondCalls(const char* name);
+#endif
 void DRV_OnChannelChanged(int channel, int iVal);
 #if PLATFORM_BK7231N
 void Strip_setMultiplePixel(uint32_t pixel, uint8_t *data, bool push);
@@ -74,6 +87,13 @@ void KP18058_Write(float *rgbcw);
 void DRV_DGR_OnLedDimmerChange(int iVal);
 void DRV_DGR_OnLedEnableAllChange(int iVal);
 void DRV_DGR_OnLedFinalColorsChange(byte rgbcw[5]);
+// returns number of pending packets
+int DGR_GetSendQueueStats(int *coalesced, int *dropped);
+#ifdef WINDOWS
+// sequence numbers of sent packets, in sending order
+int DGR_Test_GetSentSequences(int *out, int max);
+void DGR_Test_ClearSentSequences();
+#endif
 
 // OBK_POWER etc
 float DRV_GetReading(energySensor_t type);
@@ -9,8 +9,134 @@
 #include "drv_uart.h"
 #include "../httpserver/new_http.h"
 #include "../hal/hal_pins.h"
+#include "../hal/hal_generic.h"
 
 static int g_clk_period = SM2135_DELAY;
+// if set, clock period in microseconds, using calibrated HAL_Delay_us instead of nops
+static int g_clk_us = 0;
+
+// buses which called Soft_I2C_PreInit, for SoftI2C_Stats
+#define SOFT_I2C_MAX_BUSES 8
+static softI2C_t *g_softI2CBuses[SOFT_I2C_MAX_BUSES];
+static int g_softI2CNumBuses = 0;
+
+#if WINDOWS
+// Simulated I2C devices for selftests. A bus with device model on its pins
+// doesn't touch simulated pins, whole bytes go to the models.
+#define SOFT_I2C_SIM_MAX_DEVICES 4
+#define SOFT_I2C_SIM_REGS_SIZE 64
+
+typedef struct softI2CSimDevice_s {
+	short pin_clk;
+	short pin_data;
+	// 7 bit address
+	byte address;
+	// bytes per register, register pointer is written as first byte after address
+	byte regWidth;
+	byte regs[SOFT_I2C_SIM_REGS_SIZE];
+} softI2CSimDevice_t;
+
+static softI2CSimDevice_t g_simDevices[SOFT_I2C_SIM_MAX_DEVICES];
+static int g_simNumDevices = 0;
+// device selected by address byte after last start, -1 if nobody acked
+static int g_simCurrent = -1;
+static bool g_simRead;
+// next written byte is address, it selects device on pins of started bus
+static bool g_simAddressByte;
+static short g_simPinClk;
+static short g_simPinData;
+static bool g_simFirstByte;
+static int g_simByteIndex;
+
+static bool Soft_I2C_Sim_IsSimulated(softI2C_t *i2c) {
+	for (int i = 0; i < g_simNumDevices; i++) {
+		if (g_simDevices[i].pin_clk == i2c->pin_clk && g_simDevices[i].pin_data == i2c->pin_data)
+			return true;
+	}
+	return false;
+}
+
+static void Soft_I2C_Sim_Start(softI2C_t *i2c) {
+	g_simCurrent = -1;
+	g_simPinClk = i2c->pin_clk;
+	g_simPinData = i2c->pin_data;
+	g_simAddressByte = true;
+	g_simFirstByte = true;
+}
+
+static bool Soft_I2C_Sim_WriteByte(uint8_t value) {
+	softI2CSimDevice_t *d;
+
+	if (g_simAddressByte) {
+		g_simAddressByte = false;
+		for (int i = 0; i < g_simNumDevices; i++) {
+			if (g_simDevices[i].pin_clk == g_simPinClk && g_simDevices[i].pin_data == g_simPinData
+				&& g_simDevices[i].address == (value >> 1)) {
+				g_simCurrent = i;
+			}
+		}
+		g_simRead = value & 1;
+		return g_simCurrent >= 0;
+	}
+	if (g_simCurrent < 0 || g_simRead)
+		return false;
+	d = &g_simDevices[g_simCurrent];
+	if (g_simFirstByte) {
+		g_simByteIndex = value * d->regWidth;
+		g_simFirstByte = false;
+	}
+	else {
+		d->regs[g_simByteIndex % SOFT_I2C_SIM_REGS_SIZE] = value;
+		g_simByteIndex++;
+	}
+	return true;
+}
+
+static uint8_t Soft_I2C_Sim_ReadByte() {
+	// released bus reads as ones
+	if (g_simCurrent < 0 || !g_simRead)
+		return 0xFF;
+	return g_simDevices[g_simCurrent].regs[g_simByteIndex++ % SOFT_I2C_SIM_REGS_SIZE];
+}
+
+int Soft_I2C_Sim_AddDevice(int pin_clk, int pin_data, int address7bit, int regWidth) {
+	softI2CSimDevice_t *d;
+
+	if (g_simNumDevices >= SOFT_I2C_SIM_MAX_DEVICES)
+		return -1;
+	d = &g_simDevices[g_simNumDevices];
+	memset(d, 0, sizeof(*d));
+	d->pin_clk = pin_clk;
+	d->pin_data = pin_data;
+	d->address = address7bit;
+	d->regWidth = regWidth;
+	return g_simNumDevices++;
+}
+
+void Soft_I2C_Sim_Clear() {
+	g_simNumDevices = 0;
+	g_simCurrent = -1;
+}
+
+// registers are big endian, as on most sensors
+void Soft_I2C_Sim_SetRegister(int device, int reg, int value) {
+	softI2CSimDevice_t *d = &g_simDevices[device];
+
+	for (int i = 0; i < d->regWidth; i++) {
+		d->regs[(reg * d->regWidth + i) % SOFT_I2C_SIM_REGS_SIZE] = value >> (8 * (d->regWidth - 1 - i));
+	}
+}
+
+int Soft_I2C_Sim_GetRegister(int device, int reg) {
+	softI2CSimDevice_t *d = &g_simDevices[device];
+	int value = 0;
+
+	for (int i = 0; i < d->regWidth; i++) {
+		value = (value << 8) | d->regs[(reg * d->regWidth + i) % SOFT_I2C_SIM_REGS_SIZE];
+	}
+	return value;
+}
+#endif
 
 #if !PLATFORM_ESPIDF && !PLATFORM_XR806 && !PLATFORM_XR872 && !PLATFORM_ESP8266 && !PLATFORM_REALTEK_NEW && !PLATFORM_TXW81X
 void usleep(int r) //delay function do 10*r nops, because rtos_delay_milliseconds is too much
@@ -33,6 +159,16 @@ void Soft_I2C_SetHigh(uint8_t pin) {
 	HAL_PIN_Setup_Input_Pullup(pin);
 }
 
+// halves of clock period
+static void Soft_I2C_Delay(int halves) {
+	if (g_clk_us > 0) {
+		HAL_Delay_us(g_clk_us * halves / 2);
+	}
+	else {
+		usleep(g_clk_period * halves / 2);
+	}
+}
+
 static commandResult_t CMD_SoftI2C_SetClkPeriod(const void* context, const char* cmd, const char* args, int cmdFlags) {
 	Tokenizer_TokenizeString(args, 0);
 
@@ -44,15 +180,65 @@ static commandResult_t CMD_SoftI2C_SetClkPeriod(const void* context, const char*
 	}
 
 	g_clk_period = Tokenizer_GetArgInteger(0);
+	g_clk_us = 0;
+	return CMD_RES_OK;
+}
+
+static commandResult_t CMD_SoftI2C_SetClkUs(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	Tokenizer_TokenizeString(args, 0);
+
+	if (Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1)) {
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+
+	g_clk_us = Tokenizer_GetArgInteger(0);
+	return CMD_RES_OK;
+}
+
+static commandResult_t CMD_SoftI2C_Stats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	softI2C_t *i2c;
+
+	for (int i = 0; i < g_softI2CNumBuses; i++) {
+		i2c = g_softI2CBuses[i];
+		// start, stop and ack are one clock each
+		if (g_clk_us > 0) {
+			ADDLOG_INFO(LOG_FEATURE_I2C, "SoftI2C CLK %i DAT %i: %u transactions, %u bytes, %u NACKs, %u clocks (%u us)",
+				i2c->pin_clk, i2c->pin_data, i2c->transactions, i2c->bytes, i2c->nacks, i2c->clocks, i2c->clocks * g_clk_us);
+		}
+		else {
+			ADDLOG_INFO(LOG_FEATURE_I2C, "SoftI2C CLK %i DAT %i: %u transactions, %u bytes, %u NACKs, %u clocks",
+				i2c->pin_clk, i2c->pin_data, i2c->transactions, i2c->bytes, i2c->nacks, i2c->clocks);
+		}
+	}
 	return CMD_RES_OK;
 }
 
 bool Soft_I2C_PreInit(softI2C_t *i2c) {
+	int i;
+
 	//cmddetail:{"name":"SoftI2C_SetClkPeriod","args":"[period]",
 	//cmddetail:"descr":"Sets the clock period in number of nop delay cycles (times 10)",
 	//cmddetail:"fn":"CMD_SoftI2C_SetClkPeriod","file":"driver/drv_soft_i2c.c","requires":"",
 	//cmddetail:"examples":"SoftI2C_SetClkPeriod 50"}
 	CMD_RegisterCommand("SoftI2C_SetClkPeriod", CMD_SoftI2C_SetClkPeriod, NULL);
+	//cmddetail:{"name":"SoftI2C_SetClkUs","args":"[us]",
+	//cmddetail:"descr":"Sets the clock period in microseconds, using calibrated platform delay instead of nop loop. 0 goes back to SoftI2C_SetClkPeriod",
+	//cmddetail:"fn":"CMD_SoftI2C_SetClkUs","file":"driver/drv_soft_i2c.c","requires":"",
+	//cmddetail:"examples":"SoftI2C_SetClkUs 10"}
+	CMD_RegisterCommand("SoftI2C_SetClkUs", CMD_SoftI2C_SetClkUs, NULL);
+	//cmddetail:{"name":"SoftI2C_Stats","args":"",
+	//cmddetail:"descr":"Prints transactions, bytes, NACKs and clock cycles spent on every software I2C bus",
+	//cmddetail:"fn":"CMD_SoftI2C_Stats","file":"driver/drv_soft_i2c.c","requires":"",
+	//cmddetail:"examples":"SoftI2C_Stats"}
+	CMD_RegisterCommand("SoftI2C_Stats", CMD_SoftI2C_Stats, NULL);
+
+	for (i = 0; i < g_softI2CNumBuses; i++) {
+		if (g_softI2CBuses[i] == i2c)
+			break;
+	}
+	if (i == g_softI2CNumBuses && i < SOFT_I2C_MAX_BUSES) {
+		g_softI2CBuses[g_softI2CNumBuses++] = i2c;
+	}
 
 	HAL_PIN_SetOutputValue(i2c->pin_data, 0);
 	HAL_PIN_SetOutputValue(i2c->pin_clk, 0);
@@ -61,51 +247,123 @@ bool Soft_I2C_PreInit(softI2C_t *i2c) {
 	return (!((HAL_PIN_ReadDigitalInput(i2c->pin_data) == 0 || HAL_PIN_ReadDigitalInput(i2c->pin_clk) == 0)));
 }
 
+// bus memory is going to be freed, so it must not stay in SoftI2C_Stats
+void Soft_I2C_Release(softI2C_t *i2c) {
+	int i;
+
+	for (i = 0; i < g_softI2CNumBuses; i++) {
+		if (g_softI2CBuses[i] == i2c) {
+			g_softI2CBuses[i] = g_softI2CBuses[--g_softI2CNumBuses];
+			return;
+		}
+	}
+}
+
 bool Soft_I2C_WriteByte(softI2C_t *i2c, uint8_t value) {
 	uint8_t curr;
 	uint8_t ack;
+	int last = -1;
 
+	i2c->bytes++;
+	i2c->clocks += 9;
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		if (Soft_I2C_Sim_WriteByte(value))
+			return true;
+		i2c->nacks++;
+		return false;
+	}
+#endif
 	for (curr = 0x80; curr != 0; curr >>= 1) {
-		if (curr & value) {
+		// data line only changes when bit does
+		if ((curr & value) && last != 1) {
 			Soft_I2C_SetHigh(i2c->pin_data);
+			last = 1;
 		}
-		else {
+		else if (!(curr & value) && last != 0) {
 			Soft_I2C_SetLow(i2c->pin_data);
+			last = 0;
 		}
 		Soft_I2C_SetHigh(i2c->pin_clk);
-		usleep(g_clk_period);
+		Soft_I2C_Delay(2);
 		Soft_I2C_SetLow(i2c->pin_clk);
 	}
 	// get Ack or Nak
 	Soft_I2C_SetHigh(i2c->pin_data);
 	Soft_I2C_SetHigh(i2c->pin_clk);
-	usleep(g_clk_period / 2);
+	Soft_I2C_Delay(1);
 	ack = HAL_PIN_ReadDigitalInput(i2c->pin_data);
 	Soft_I2C_SetLow(i2c->pin_clk);
-	usleep(g_clk_period / 2);
+	Soft_I2C_Delay(1);
 	Soft_I2C_SetLow(i2c->pin_data);
+	if (ack) {
+		i2c->nacks++;
+	}
 	return (0 == ack);
 }
 
-void Soft_I2C_Start_Internal(softI2C_t *i2c) {
+static void Soft_I2C_StartCondition(softI2C_t *i2c) {
+	i2c->clocks++;
 	Soft_I2C_SetLow(i2c->pin_data);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 	Soft_I2C_SetLow(i2c->pin_clk);
 }
+
+void Soft_I2C_Start_Internal(softI2C_t *i2c) {
+	i2c->transactions++;
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		i2c->clocks++;
+		Soft_I2C_Sim_Start(i2c);
+		return;
+	}
+#endif
+	Soft_I2C_StartCondition(i2c);
+}
 bool Soft_I2C_Start(softI2C_t *i2c, uint8_t addr) {
-	Soft_I2C_SetLow(i2c->pin_data);
-	usleep(g_clk_period);
-	Soft_I2C_SetLow(i2c->pin_clk);
+	i2c->transactions++;
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		i2c->clocks++;
+		Soft_I2C_Sim_Start(i2c);
+		return Soft_I2C_WriteByte(i2c, addr);
+	}
+#endif
+	Soft_I2C_StartCondition(i2c);
 	return Soft_I2C_WriteByte(i2c,addr);
 }
 
+// start without stop before, bus stays ours
+static bool Soft_I2C_RepeatedStart(softI2C_t *i2c, uint8_t addr) {
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		i2c->clocks++;
+		Soft_I2C_Sim_Start(i2c);
+		return Soft_I2C_WriteByte(i2c, addr);
+	}
+#endif
+	Soft_I2C_SetHigh(i2c->pin_data);
+	Soft_I2C_Delay(1);
+	Soft_I2C_SetHigh(i2c->pin_clk);
+	Soft_I2C_Delay(2);
+	Soft_I2C_StartCondition(i2c);
+	return Soft_I2C_WriteByte(i2c, addr);
+}
+
 void Soft_I2C_Stop(softI2C_t *i2c) {
+	i2c->clocks++;
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		g_simCurrent = -1;
+		return;
+	}
+#endif
 	Soft_I2C_SetLow(i2c->pin_data);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 	Soft_I2C_SetHigh(i2c->pin_clk);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 	Soft_I2C_SetHigh(i2c->pin_data);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 }
 
 
@@ -125,10 +383,17 @@ uint8_t Soft_I2C_ReadByte(softI2C_t *i2c, bool nack)
 {
 	uint8_t val = 0;
 
+	i2c->bytes++;
+	i2c->clocks += 9;
+#if WINDOWS
+	if (Soft_I2C_Sim_IsSimulated(i2c)) {
+		return Soft_I2C_Sim_ReadByte();
+	}
+#endif
 	Soft_I2C_SetHigh(i2c->pin_data);
 	for (int i = 0; i < 8; i++)
 	{
-		usleep(g_clk_period);
+		Soft_I2C_Delay(2);
 		Soft_I2C_SetHigh(i2c->pin_clk);
 		val <<= 1;
 		if (HAL_PIN_ReadDigitalInput(i2c->pin_data))
@@ -146,11 +411,90 @@ uint8_t Soft_I2C_ReadByte(softI2C_t *i2c, bool nack)
 		Soft_I2C_SetLow(i2c->pin_data);
 	}
 	Soft_I2C_SetHigh(i2c->pin_clk);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 	Soft_I2C_SetLow(i2c->pin_clk);
-	usleep(g_clk_period);
+	Soft_I2C_Delay(2);
 	Soft_I2C_SetLow(i2c->pin_data);
 
 	return val;
 }
 
+// Runs all messages as one transaction, with a single stop at the end.
+// Adjacent messages in the same direction are coalesced into one burst,
+// a repeated start is only sent when direction changes.
+bool Soft_I2C_Transfer(softI2C_t *i2c, uint8_t addr8bit, const softI2CMsg_t *msgs, int count) {
+	bool bOk = true;
+	int i, j;
+
+	for (i = 0; i < count && bOk; i++) {
+		if (i == 0) {
+			bOk = Soft_I2C_Start(i2c, addr8bit | msgs[i].bRead);
+		}
+		else if (msgs[i].bRead != msgs[i - 1].bRead) {
+			bOk = Soft_I2C_RepeatedStart(i2c, addr8bit | msgs[i].bRead);
+		}
+		for (j = 0; j < msgs[i].len && bOk; j++) {
+			if (msgs[i].bRead) {
+				// NACK only on the last byte of the whole read burst
+				bool bLast = j == msgs[i].len - 1 && (i == count - 1 || !msgs[i + 1].bRead);
+				msgs[i].data[j] = Soft_I2C_ReadByte(i2c, bLast);
+			}
+			else {
+				bOk = Soft_I2C_WriteByte(i2c, msgs[i].data[j]);
+			}
+		}
+	}
+	Soft_I2C_Stop(i2c);
+	if (!bOk) {
+		// nobody answered - reads see the released bus, like the old byte-by-byte code did
+		for (i = 0; i < count; i++) {
+			if (msgs[i].bRead) {
+				memset(msgs[i].data, 0xFF, msgs[i].len);
+			}
+		}
+	}
+	return bOk;
+}
+
+// register pointer write and burst read in one transaction
+bool Soft_I2C_ReadRegs(softI2C_t *i2c, uint8_t addr8bit, uint8_t reg, uint8_t *data, int len) {
+	softI2CMsg_t msgs[2];
+
+	msgs[0].bRead = 0;
+	msgs[0].data = &reg;
+	msgs[0].len = 1;
+	msgs[1].bRead = 1;
+	msgs[1].data = data;
+	msgs[1].len = len;
+	return Soft_I2C_Transfer(i2c, addr8bit, msgs, 2);
+}
+
+bool Soft_I2C_WriteRegs(softI2C_t *i2c, uint8_t addr8bit, uint8_t reg, const uint8_t *data, int len) {
+	softI2CMsg_t msgs[2];
+
+	msgs[0].bRead = 0;
+	msgs[0].data = &reg;
+	msgs[0].len = 1;
+	msgs[1].bRead = 0;
+	msgs[1].data = (uint8_t*)data;
+	msgs[1].len = len;
+	return Soft_I2C_Transfer(i2c, addr8bit, msgs, 2);
+}
+
+#if WINDOWS
+bool Soft_I2C_Test_GetStats(int pin_clk, int pin_data, int *transactions, int *bytes, int *nacks, int *clocks) {
+	softI2C_t *i2c;
+
+	for (int i = 0; i < g_softI2CNumBuses; i++) {
+		i2c = g_softI2CBuses[i];
+		if (i2c->pin_clk == pin_clk && i2c->pin_data == pin_data) {
+			*transactions = i2c->transactions;
+			*bytes = i2c->bytes;
+			*nacks = i2c->nacks;
+			*clocks = i2c->clocks;
+			return true;
+		}
+	}
+	return false;
+}
+#endif
@@ -14,9 +14,15 @@
 #define MY_SPI_DELAY
 
 void SPI_Send(softSPI_t *spi, byte dataToSend) {
+	int last = -1;
 	for (int i = 0; i < 8; i++) {
+		int bit = (dataToSend >> (7 - i)) & 0x01;
 		MY_SPI_DELAY;
-		HAL_PIN_SetOutputValue(spi->mosi, (dataToSend >> (7 - i)) & 0x01);
+		// MOSI only changes when bit does
+		if (bit != last) {
+			HAL_PIN_SetOutputValue(spi->mosi, bit);
+			last = bit;
+		}
 		MY_SPI_DELAY;
 		HAL_PIN_SetOutputValue(spi->sck, 1);
 		MY_SPI_DELAY;
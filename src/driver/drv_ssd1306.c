@@ -18,6 +18,18 @@ static int ssd1306_addr = 0x3C;
 #define SSD1306_CMD  0x00
 #define SSD1306_DATA 0x40
 
+// 128x32, 4 pages of 8 pixel rows, one byte per column
+#define SSD1306_WIDTH 128
+#define SSD1306_PAGES 4
+
+// Drawing goes to RAM first, then changed columns of each page are sent
+// in one I2C transfer, instead of one transfer per byte.
+static byte g_fb[SSD1306_PAGES][SSD1306_WIDTH];
+// changed column range of each page, start > end means clean
+static byte g_dirtyStart[SSD1306_PAGES];
+static byte g_dirtyEnd[SSD1306_PAGES];
+// where next char goes, like display's own pointer did
+static byte g_curX, g_curPage;
 
 static void SSD1306_WriteCmd(byte c) {
 	Soft_I2C_Start(&g_softI2C, ssd1306_addr << 1);
@@ -26,23 +38,81 @@ static void SSD1306_WriteCmd(byte c) {
 	Soft_I2C_Stop(&g_softI2C);
 }
 
-static void SSD1306_WriteData(byte d) {
+static void SSD1306_WriteCmds(const byte *c, int len) {
+	int i;
+
+	Soft_I2C_Start(&g_softI2C, ssd1306_addr << 1);
+	Soft_I2C_WriteByte(&g_softI2C, SSD1306_CMD);
+	for (i = 0; i < len; i++) {
+		Soft_I2C_WriteByte(&g_softI2C, c[i]);
+	}
+	Soft_I2C_Stop(&g_softI2C);
+}
+
+static void SSD1306_WriteDataBurst(const byte *d, int len) {
+	int i;
+
 	Soft_I2C_Start(&g_softI2C, ssd1306_addr << 1);
 	Soft_I2C_WriteByte(&g_softI2C, SSD1306_DATA);
-	Soft_I2C_WriteByte(&g_softI2C, d);
+	for (i = 0; i < len; i++) {
+		Soft_I2C_WriteByte(&g_softI2C, d[i]);
+	}
 	Soft_I2C_Stop(&g_softI2C);
 }
 
+static void SSD1306_MarkDirty(int page, int x0, int x1) {
+	if (g_dirtyStart[page] > g_dirtyEnd[page]) {
+		g_dirtyStart[page] = x0;
+		g_dirtyEnd[page] = x1;
+		return;
+	}
+	if (x0 < g_dirtyStart[page])
+		g_dirtyStart[page] = x0;
+	if (x1 > g_dirtyEnd[page])
+		g_dirtyEnd[page] = x1;
+}
+
+static void SSD1306_PutByte(int x, int page, byte v) {
+	if (x < 0 || x >= SSD1306_WIDTH || page < 0 || page >= SSD1306_PAGES)
+		return;
+	if (g_fb[page][x] == v)
+		return;
+	g_fb[page][x] = v;
+	SSD1306_MarkDirty(page, x, x);
+}
+
+// sends changed part of each page, horizontal addressing mode is set in init
+void SSD1306_Flush() {
+	byte cmds[6];
+	int page;
+
+	for (page = 0; page < SSD1306_PAGES; page++) {
+		if (g_dirtyStart[page] > g_dirtyEnd[page])
+			continue;
+		cmds[0] = 0x21; // Set column range
+		cmds[1] = g_dirtyStart[page];
+		cmds[2] = g_dirtyEnd[page];
+		cmds[3] = 0x22; // Set page range
+		cmds[4] = page;
+		cmds[5] = page;
+		SSD1306_WriteCmds(cmds, sizeof(cmds));
+		SSD1306_WriteDataBurst(&g_fb[page][g_dirtyStart[page]], g_dirtyEnd[page] - g_dirtyStart[page] + 1);
+		g_dirtyStart[page] = 1;
+		g_dirtyEnd[page] = 0;
+	}
+}
+
 void SSD1306_Fill(byte v) {
-	int i;
-	SSD1306_WriteCmd(0x21); // Set column range
-	SSD1306_WriteCmd(0x00);
-	SSD1306_WriteCmd(0x7F);
-	SSD1306_WriteCmd(0x22); // Set page range (for 128x32: 0-3)
-	SSD1306_WriteCmd(0x00);
-	SSD1306_WriteCmd(0x03);
-	for (i = 0; i < 512; i++)
-		SSD1306_WriteData(v);
+	int page;
+
+	memset(g_fb, v, sizeof(g_fb));
+	for (page = 0; page < SSD1306_PAGES; page++) {
+		// display content is unknown here, so send it all
+		g_dirtyStart[page] = 0;
+		g_dirtyEnd[page] = SSD1306_WIDTH - 1;
+	}
+	g_curX = 0;
+	g_curPage = 0;
 }
 void SSD1306_SetOn(bool b) {
 	if (b) {
@@ -53,9 +123,8 @@ void SSD1306_SetOn(bool b) {
 	}
 }
 void SSD1306_SetPos(byte x, byte page) {
-	SSD1306_WriteCmd(0xB0 | page);
-	SSD1306_WriteCmd(0x00 | (x & 0x0F));
-	SSD1306_WriteCmd(0x10 | (x >> 4));
+	g_curX = x % SSD1306_WIDTH;
+	g_curPage = page % SSD1306_PAGES;
 }
 
 void SSD1306_DrawRect(byte x, byte y, byte w, byte h, byte fill) {
@@ -64,7 +133,6 @@ void SSD1306_DrawRect(byte x, byte y, byte w, byte h, byte fill) {
 	byte page_end = (y + h - 1) >> 3;
 
 	for (py = page_start; py <= page_end; py++) {
-		SSD1306_SetPos(x, py);
 		for (px = 0; px < w; px++) {
 
 			byte mask = 0x00;
@@ -79,7 +147,7 @@ void SSD1306_DrawRect(byte x, byte y, byte w, byte h, byte fill) {
 					mask = 0xFF;
 			}
 
-			SSD1306_WriteData(mask);
+			SSD1306_PutByte(x + px, py, mask);
 		}
 	}
 }
@@ -153,14 +221,16 @@ void SSD1306_WriteChar(char c) {
 	if (c < 32 || c > 90) c = 32; // Basic bounds check, map unknown to space
 	c -= 32; // Offset to match array index
 
-	Soft_I2C_Start(&g_softI2C, ssd1306_addr << 1);
-	Soft_I2C_WriteByte(&g_softI2C, SSD1306_DATA);
-
-	for (int i = 0; i < 5; i++) {
-		Soft_I2C_WriteByte(&g_softI2C, font5x7[(uint8_t)c][i]);
+	for (int i = 0; i < 6; i++) {
+		// 1px spacing between chars
+		SSD1306_PutByte(g_curX, g_curPage, i < 5 ? font5x7[(uint8_t)c][i] : 0x00);
+		// wraps to next page at the end of line, like the display does
+		g_curX++;
+		if (g_curX >= SSD1306_WIDTH) {
+			g_curX = 0;
+			g_curPage = (g_curPage + 1) % SSD1306_PAGES;
+		}
 	}
-	Soft_I2C_WriteByte(&g_softI2C, 0x00); // 1px spacing between chars
-	Soft_I2C_Stop(&g_softI2C);
 }
 
 void SSD1306_String(const char *str) {
@@ -190,6 +260,7 @@ commandResult_t SSD1306_Cmd_Print(const void* context, const char* cmd, const ch
 	}
 	const char *s = Tokenizer_GetArg(0);
 	SSD1306_String(s);
+	SSD1306_Flush();
 	return CMD_RES_OK;
 }
 commandResult_t SSD1306_Cmd_GoTo(const void* context, const char* cmd, const char* args, int cmdFlags) {
@@ -227,6 +298,7 @@ commandResult_t SSD1306_Cmd_Clear(const void* context, const char* cmd, const ch
 	}
 	int val = Tokenizer_GetArgInteger(0);
 	SSD1306_Fill(val);
+	SSD1306_Flush();
 	return CMD_RES_OK;
 }
 
@@ -244,6 +316,7 @@ commandResult_t SSD1306_Cmd_Rect(const void* context, const char* cmd, const cha
 	int h = Tokenizer_GetArgInteger(3);
 	int fill = Tokenizer_GetArgIntegerDefault(4, 0xff);
 	SSD1306_DrawRect(x, y, w, h, fill);
+	SSD1306_Flush();
 	return CMD_RES_OK;
 }
 // startDriver SSD1306 16 20 0x3C
@@ -267,6 +340,25 @@ goto again
 
 
 */
+static const byte g_initCmds[] = {
+	0xAE,
+	0xD5, 0x80,
+	0xA8, 0x1F,
+	0xD3, 0x00,
+	0x40,
+	0x8D, 0x14,
+	0x20, 0x00, // horizontal addressing, Flush relies on it
+	0xA1,
+	0xC8,
+	0xDA, 0x02,
+	0x81, 0x8F,
+	0xD9, 0xF1,
+	0xDB, 0x40,
+	0xA4,
+	0xA6,
+	0xAF,
+};
+
 void SSD1306_DRV_Init() {
 
 	g_softI2C.pin_clk = Tokenizer_GetPin(1, 16);
@@ -281,31 +373,8 @@ void SSD1306_DRV_Init() {
 
 	Soft_I2C_PreInit(&g_softI2C);
 
-	SSD1306_WriteCmd(0xAE);
-	SSD1306_WriteCmd(0xD5);
-	SSD1306_WriteCmd(0x80);
-	SSD1306_WriteCmd(0xA8);
-	SSD1306_WriteCmd(0x1F);
-	SSD1306_WriteCmd(0xD3);
-	SSD1306_WriteCmd(0x00);
-	SSD1306_WriteCmd(0x40);
-	SSD1306_WriteCmd(0x8D);
-	SSD1306_WriteCmd(0x14);
-	SSD1306_WriteCmd(0x20);
-	SSD1306_WriteCmd(0x00);
-	SSD1306_WriteCmd(0xA1);
-	SSD1306_WriteCmd(0xC8);
-	SSD1306_WriteCmd(0xDA);
-	SSD1306_WriteCmd(0x02);
-	SSD1306_WriteCmd(0x81);
-	SSD1306_WriteCmd(0x8F);
-	SSD1306_WriteCmd(0xD9);
-	SSD1306_WriteCmd(0xF1);
-	SSD1306_WriteCmd(0xDB);
-	SSD1306_WriteCmd(0x40);
-	SSD1306_WriteCmd(0xA4);
-	SSD1306_WriteCmd(0xA6);
-	SSD1306_WriteCmd(0xAF);
+	SSD1306_WriteCmds(g_initCmds, sizeof(g_initCmds));
 
 	SSD1306_Fill(0x00);
+	SSD1306_Flush();
 }
\ No newline at end of file
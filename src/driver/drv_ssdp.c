@@ -46,44 +46,147 @@ extern int Main_IsConnectedToWiFi();
 
 // allocated at first use, freed if stopped
 static char *advert_message = NULL;
-int advert_maxlen = 0;
 static char *udp_msgbuf = NULL;
 #define UDP_MSGBUF_LEN 500
 static char *notify_message = NULL;
-int notify_maxlen = 0;
+static int notify_len = 0;
 static char *http_message = NULL;
 int http_message_len = 0;
 
+// IP that replies were rendered for, they are rendered again when it changes
+static char g_ssdp_renderedIP[32];
+// incremented on every render, so Wemo and Hue know when to render theirs
+static int g_ssdp_renderVersion = 0;
 
 #define MAX_OBK_DEVICES 40
 #define OBK_DEVICE_TIMEOUT 60
+// devices are hashed by IP, so NOTIFY doesn't scan whole table
+#define OBK_DEVICE_BUCKETS 16
+// expiry wheel, one slot per second, must be larger than OBK_DEVICE_TIMEOUT
+#define OBK_DEVICE_WHEEL_SIZE 64
+
+// at most that many datagrams are handled in a quick tick
+#define SSDP_MAX_PACKETS_PER_TICK 8
+// during a multicast storm, datagrams above that are read and dropped unparsed
+#define SSDP_MAX_PACKETS_PER_SECOND 64
+// and searches above that are not answered
+#define SSDP_MAX_REPLIES_PER_SECOND 8
 
 typedef struct OBK_DEVICE_tag{
     uint32_t ip;
-    int timeout; // seconds
+    // g_ssdp_seconds value when device is forgotten
+    int expires;
+    // indexes into obkDevices, -1 ends the list
+    // free entries are linked with nextInBucket
+    short nextInBucket;
+    short nextInWheel;
 } OBK_DEVICE;
 
 static OBK_DEVICE obkDevices[MAX_OBK_DEVICES];
+static short obkBuckets[OBK_DEVICE_BUCKETS];
+// device is in slot of its expiry time at the moment it was linked there,
+// if it was refreshed since, it's moved when that slot comes up
+static short obkWheel[OBK_DEVICE_WHEEL_SIZE];
+static short obkFree;
+static int obkDeviceCount;
+static int g_ssdp_seconds = 0;
+
+static int g_ssdp_packetsThisSecond = 0;
+static int g_ssdp_repliesThisSecond = 0;
+static int stat_packetsReceived = 0;
+static int stat_packetsDropped = 0;
+static int stat_searchesReceived = 0;
+static int stat_repliesSent = 0;
+static int stat_repliesLimited = 0;
+static int stat_notifiesReceived = 0;
+static int stat_devicesNotAdded = 0;
+
+static int obkDeviceHash(uint32_t ip){
+    ip ^= ip >> 16;
+    ip ^= ip >> 8;
+    return ip & (OBK_DEVICE_BUCKETS - 1);
+}
 
-static void obkDeviceTick(uint32_t ip){
+static void obkDevicesClear(){
     int i;
+
+    memset(obkDevices, 0, sizeof(obkDevices));
     for (i = 0; i < MAX_OBK_DEVICES; i++){
+        obkDevices[i].nextInBucket = (i + 1 < MAX_OBK_DEVICES) ? i + 1 : -1;
+        obkDevices[i].nextInWheel = -1;
+    }
+    obkFree = 0;
+    for (i = 0; i < OBK_DEVICE_BUCKETS; i++){
+        obkBuckets[i] = -1;
+    }
+    for (i = 0; i < OBK_DEVICE_WHEEL_SIZE; i++){
+        obkWheel[i] = -1;
+    }
+    obkDeviceCount = 0;
+}
+
+static void obkDeviceLinkToWheel(int i){
+    int slot = obkDevices[i].expires % OBK_DEVICE_WHEEL_SIZE;
+
+    obkDevices[i].nextInWheel = obkWheel[slot];
+    obkWheel[slot] = i;
+}
+
+static void obkDeviceRemove(int i){
+    short *p = &obkBuckets[obkDeviceHash(obkDevices[i].ip)];
+
+    while (*p != i){
+        p = &obkDevices[*p].nextInBucket;
+    }
+    *p = obkDevices[i].nextInBucket;
+    addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"SSDP obk device gone 0x%08x", obkDevices[i].ip);
+    obkDevices[i].ip = 0;
+    obkDevices[i].nextInBucket = obkFree;
+    obkFree = i;
+    obkDeviceCount--;
+}
+
+static void obkDeviceTick(uint32_t ip){
+    int h = obkDeviceHash(ip);
+    int i;
+
+    for (i = obkBuckets[h]; i >= 0; i = obkDevices[i].nextInBucket){
         if (obkDevices[i].ip == ip){
-            obkDevices[i].timeout = OBK_DEVICE_TIMEOUT;
-            addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"SSDP obk device still present 0x%08x",ip);
-            break;
+            // stays in its wheel slot, moved later when that slot comes up
+            obkDevices[i].expires = g_ssdp_seconds + OBK_DEVICE_TIMEOUT;
+            return;
         }
     }
+    i = obkFree;
+    if (i < 0){
+        stat_devicesNotAdded++;
+        return;
+    }
+    obkFree = obkDevices[i].nextInBucket;
+    obkDevices[i].ip = ip;
+    obkDevices[i].expires = g_ssdp_seconds + OBK_DEVICE_TIMEOUT;
+    obkDevices[i].nextInBucket = obkBuckets[h];
+    obkBuckets[h] = i;
+    obkDeviceLinkToWheel(i);
+    obkDeviceCount++;
+    addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"SSDP new obk device 0x%08x",ip);
+}
 
-    if (i == MAX_OBK_DEVICES){
-        for (i = 0; i < MAX_OBK_DEVICES; i++){
-            if (obkDevices[i].ip == 0){
-                obkDevices[i].ip = ip;
-                obkDevices[i].timeout = OBK_DEVICE_TIMEOUT;
-                addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"SSDP new obk device 0x%08x",ip);
-                break;
-            }
+// called once a second, only devices in current slot are checked
+static void obkDevicesExpire(){
+    int slot = g_ssdp_seconds % OBK_DEVICE_WHEEL_SIZE;
+    int i, next;
+
+    i = obkWheel[slot];
+    obkWheel[slot] = -1;
+    while (i >= 0){
+        next = obkDevices[i].nextInWheel;
+        if (obkDevices[i].expires <= g_ssdp_seconds){
+            obkDeviceRemove(i);
+        } else {
+            obkDeviceLinkToWheel(i);
         }
+        i = next;
     }
 }
 
@@ -252,24 +355,6 @@ void DRV_SSDP_SendReply(struct sockaddr_in *addr, const char *message) {
 		sizeof(struct sockaddr)
 	);
 }
-static void DRV_SSDP_Send_Advert_To(struct sockaddr_in *addr) {
-    const char *myip = HAL_GetMyIPString();
-
-
-    if (!advert_message){
-        advert_maxlen = strlen(message_template) +  100;
-        advert_message = (char *)malloc(advert_maxlen+1);
-    }
-
-    snprintf(advert_message, advert_maxlen, message_template, 
-        myip, 
-        g_ssdp_uuid, 
-        g_ssdp_uuid);
-
-	DRV_SSDP_SendReply(addr,advert_message);
-
-	addLogAdv(LOG_DEBUG, LOG_FEATURE_HTTP,"DRV_SSDP_Send_Advert_To: sent message");
-}
 
 
 
@@ -288,8 +373,47 @@ static const char notify_template[] =
 "\r\n\r\n" \
 ;
 
+// replies only change with IP or uuid, so they are not formatted for every search.
+// Returns number of renders so far, Wemo and Hue render their replies again when it changes.
+int DRV_SSDP_GetRenderVersion() {
+    const char *myip = HAL_GetMyIPString();
+    int maxlen;
 
+    if (advert_message && notify_message && !strcmp(myip, g_ssdp_renderedIP)){
+        return g_ssdp_renderVersion;
+    }
+    if (!advert_message){
+        advert_message = (char *)malloc(strlen(message_template) + 100 + 1);
+    }
+    if (!notify_message){
+        notify_message = (char *)malloc(strlen(notify_template) + 100 + 1);
+    }
+    if (!advert_message || !notify_message){
+        return g_ssdp_renderVersion;
+    }
+    maxlen = strlen(message_template) + 100;
+    snprintf(advert_message, maxlen, message_template, 
+        myip, 
+        g_ssdp_uuid, 
+        g_ssdp_uuid);
+    maxlen = strlen(notify_template) + 100;
+    notify_len = snprintf(notify_message, maxlen, notify_template, myip, g_ssdp_uuid);
+    if (notify_len >= maxlen){
+        notify_len = maxlen - 1;
+    }
+    strcpy_safe(g_ssdp_renderedIP, myip, sizeof(g_ssdp_renderedIP));
+    g_ssdp_renderVersion++;
+    addLogAdv(LOG_DEBUG, LOG_FEATURE_HTTP,"SSDP replies rendered for %s", myip);
+    return g_ssdp_renderVersion;
+}
 
+static void DRV_SSDP_Send_Advert_To(struct sockaddr_in *addr) {
+    DRV_SSDP_GetRenderVersion();
+    if (!advert_message){
+        return;
+    }
+	DRV_SSDP_SendReply(addr,advert_message);
+}
 
 static void DRV_SSDP_Send_Notify() {
 	int nbytes;
@@ -306,26 +430,17 @@ static void DRV_SSDP_Send_Notify() {
     multicastaddr.sin_addr.s_addr = inet_addr(ssdp_group);
     multicastaddr.sin_port = htons(ssdp_port);
 
-    const char *myip = HAL_GetMyIPString();
-
+    DRV_SSDP_GetRenderVersion();
     if (!notify_message){
-        notify_maxlen = strlen(notify_template) +  100;
-        notify_message = (char *)malloc(notify_maxlen+1);
+        return;
     }
 
-    snprintf(notify_message, notify_maxlen, notify_template, myip, g_ssdp_uuid);
-
-    int len = strlen(notify_message);
-
-	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"DRV_SSDP_Send_Notify: space: %d msg:%d", strlen(notify_template) +  100, len);
-	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"DRV_SSDP_Send_Notify: \r%s", notify_message);
-
     // set up destination address
     //
     nbytes = sendto(
         g_ssdp_socket_receive,
         (const char*) notify_message,
-        len,
+        notify_len,
         0,
         (struct sockaddr*) &multicastaddr,
         sizeof(multicastaddr)
@@ -338,6 +453,86 @@ static void DRV_SSDP_Send_Notify() {
     }
 }
 
+// cached driver IDs, see DRV_IsRunningCached
+static int g_ssdp_wemoDriver = 0;
+static int g_ssdp_hueDriver = 0;
+
+static void DRV_SSDP_AnswerSearch(const char *msg, struct sockaddr_in *addr) {
+    /* we may get:
+    M-SEARCH * HTTP/1.1
+    HOST:239.255.255.250:1900
+    ST:upnp:rootdevice
+    MX:2
+    MAN:"ssdp:discover"
+    */
+    // we SHOULD be a little more specific!!!
+#if ENABLE_DRIVER_WEMO
+	if (DRV_IsRunningCached("WEMO", &g_ssdp_wemoDriver)) {
+		if (strcasestr(msg, "urn:belkin:device:**")) {
+			DRV_WEMO_Send_Advert_To(1, addr);
+			return;
+		}
+		else if (strcasestr(msg, "upnp:rootdevice")
+			|| strcasestr(msg, "ssdpsearch:all")
+			|| strcasestr(msg, "ssdp:all")) {
+			DRV_WEMO_Send_Advert_To(2, addr);
+			return;
+		}
+	}
+#endif
+#if ENABLE_DRIVER_HUE
+	if (DRV_IsRunningCached("HUE", &g_ssdp_hueDriver)) {
+		if (strcasestr(msg, ":device:basic:1")
+			|| strcasestr(msg, "upnp:rootdevice")
+			|| strcasestr(msg, "ssdpsearch:all")
+			|| strcasestr(msg, "ssdp:all")) {
+			addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP, "SSDP has received HUE PACKET");
+			DRV_HUE_Send_Advert_To(addr);
+			return;
+		}
+	}
+#endif
+	DRV_SSDP_Send_Advert_To(addr);
+}
+
+// msg must be NUL terminated
+static void DRV_SSDP_ProcessPacket(const char *msg, struct sockaddr_in *addr) {
+    const char *p;
+
+    stat_packetsReceived++;
+    if (g_ssdp_packetsThisSecond >= SSDP_MAX_PACKETS_PER_SECOND){
+        stat_packetsDropped++;
+        return;
+    }
+    g_ssdp_packetsThisSecond++;
+
+    // if search, then respond
+    if (!strncmp(msg, "M-SEARCH", 8)){
+        stat_searchesReceived++;
+        if (g_ssdp_repliesThisSecond >= SSDP_MAX_REPLIES_PER_SECOND){
+            stat_repliesLimited++;
+            return;
+        }
+        g_ssdp_repliesThisSecond++;
+        stat_repliesSent++;
+        // reply with our advert to the sender
+        DRV_SSDP_AnswerSearch(msg, addr);
+        return;
+    }
+
+    // our NOTIFTY like:
+    //"NOTIFY * HTTP/1.1\r\n" 
+    //"SERVER: OpenBk\r\n" 
+    if (!strncmp(msg, "NOTIFY", 6)){
+        stat_notifiesReceived++;
+        p = strchr(msg, '\n');
+        if (p && !strncmp(p + 1, "SERVER: OpenBk", 14)){
+            // add the device to the device list, or refresh its timeout
+            obkDeviceTick(*(uint32_t *)(&addr->sin_addr));
+        }
+    }
+}
+
 
 static const char *http_reply = 
 "<root>\r\n" \
@@ -409,20 +604,29 @@ static commandResult_t Cmd_obkDeviceList(const void *context, const char *cmd, c
     return CMD_RES_OK;
 }
 
+static commandResult_t Cmd_SSDP_Stats(const void *context, const char *cmd, const char *args, int cmdFlags){
+    addLogAdv(LOG_INFO, LOG_FEATURE_HTTP,"SSDP: packets %i, dropped %i, searches %i, replies %i, limited %i, notifies %i",
+        stat_packetsReceived, stat_packetsDropped, stat_searchesReceived,
+        stat_repliesSent, stat_repliesLimited, stat_notifiesReceived);
+    addLogAdv(LOG_INFO, LOG_FEATURE_HTTP,"SSDP: obk devices %i/%i, not added %i",
+        obkDeviceCount, MAX_OBK_DEVICES, stat_devicesNotAdded);
+    return CMD_RES_OK;
+}
+
 ///////////////////////////////////////////////
 // public functions, only used in drv_main
 
 
 void DRV_SSDP_Init()
 {
+    obkDevicesClear();
+
     if (!Main_IsConnectedToWiFi()){
         addLogAdv(LOG_INFO, LOG_FEATURE_HTTP,"DRV_SSDP_Init - no wifi, so await connection");
         DRV_SSDP_Active = 1;
         return;
     }
 
-    memset(obkDevices, 0, sizeof(obkDevices));
-
     addLogAdv(LOG_INFO, LOG_FEATURE_HTTP,"DRV_SSDP_Init");
     // like "e427ce1a-3e80-43d0-ad6f-89ec42e46363";
     snprintf(g_ssdp_uuid, sizeof(g_ssdp_uuid), "%08x-%04x-%04x-%04x-%04x%08x",
@@ -433,6 +637,17 @@ void DRV_SSDP_Init()
         (unsigned int)rand()&0xffff,
         (unsigned int)rand()
     );
+    // uuid changed, so render again
+    g_ssdp_renderedIP[0] = 0;
+    g_ssdp_packetsThisSecond = 0;
+    g_ssdp_repliesThisSecond = 0;
+    stat_packetsReceived = 0;
+    stat_packetsDropped = 0;
+    stat_searchesReceived = 0;
+    stat_repliesSent = 0;
+    stat_repliesLimited = 0;
+    stat_notifiesReceived = 0;
+    stat_devicesNotAdded = 0;
 
 	DRV_SSDP_CreateSocket_Receive();
     HTTP_RegisterCallback("/ssdp.xml", HTTP_GET, DRV_SSDP_Service_Http, 0);
@@ -441,6 +656,11 @@ void DRV_SSDP_Init()
 	//cmddetail:"fn":"Cmd_obkDeviceList","file":"driver/drv_ssdp.c","requires":"",
 	//cmddetail:"examples":""}
     CMD_RegisterCommand("obkDeviceList", Cmd_obkDeviceList, NULL);
+	//cmddetail:{"name":"SSDP_Stats","args":"",
+	//cmddetail:"descr":"Prints SSDP packet counters, including packets dropped and searches not answered because of rate limit.",
+	//cmddetail:"fn":"Cmd_SSDP_Stats","file":"driver/drv_ssdp.c","requires":"",
+	//cmddetail:"examples":""}
+    CMD_RegisterCommand("SSDP_Stats", Cmd_SSDP_Stats, NULL);
 
     HTTP_RegisterCallback("/obkdevicelist", HTTP_GET, http_rest_get_devicelist, 0);
 
@@ -449,6 +669,11 @@ void DRV_SSDP_Init()
 
 
 void DRV_SSDP_RunEverySecond() {
+    g_ssdp_seconds++;
+    g_ssdp_packetsThisSecond = 0;
+    g_ssdp_repliesThisSecond = 0;
+    obkDevicesExpire();
+
 	if (g_ssdp_socket_receive <= 0) {
 		return ;
 	}
@@ -459,115 +684,45 @@ void DRV_SSDP_RunEverySecond() {
         DRV_SSDP_Send_Notify();
         ssdp_timercount = 0;
     }
-
-    for (int i = 0; i < MAX_OBK_DEVICES; i++){
-        if (obkDevices[i].timeout){
-            obkDevices[i].timeout --;
-            if (!obkDevices[i].timeout){
-                obkDevices[i].ip = 0;
-            }
-        }
-    }
 }
 
 void DRV_SSDP_RunQuickTick() {
+    struct sockaddr_in addr;
+    socklen_t addrlen;
+    int nbytes, i;
 
 	if (g_ssdp_socket_receive <= 0) {
 		return ;
 	}
-    // now just enter a read-print loop
-    //
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-
     if (!udp_msgbuf){
         udp_msgbuf = (char *)malloc(UDP_MSGBUF_LEN+1);
+        if (!udp_msgbuf){
+            return;
+        }
     }
 
-    socklen_t addrlen = sizeof(addr);
-    int nbytes = recvfrom(
-        g_ssdp_socket_receive,
-        udp_msgbuf,
-        UDP_MSGBUF_LEN,
-        0,
-        (struct sockaddr *) &addr,
-        &addrlen
-    );
-    udp_msgbuf[UDP_MSGBUF_LEN] = 0;
-    if (nbytes <= 0) {
-        //addLogAdv(LOG_INFO, LOG_FEATURE_HTTP,"nothing");
-        return ;
-    }
-    // just so we can terminate for print
-    if (nbytes >= UDP_MSGBUF_LEN){
-        nbytes = UDP_MSGBUF_LEN-1;
-    }
-    addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"Received %i bytes from %s",nbytes,inet_ntoa(((struct sockaddr_in *)&addr)->sin_addr));
-    udp_msgbuf[nbytes] = 0;
-    addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"data: %s",udp_msgbuf);
-    udp_msgbuf[nbytes] = '\0';
-
-    /* we may get:
-    M-SEARCH * HTTP/1.1
-    HOST:239.255.255.250:1900
-    ST:upnp:rootdevice
-    MX:2
-    MAN:"ssdp:discover"
-    */
-
-    // if search, then respond
-    // we SHOULD be a little more specific!!!
-    if (!strncmp(udp_msgbuf, "M-SEARCH", 8)){
-        // reply with our advert to the sender
-        addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"Is MSEARCH - responding");
-#if ENABLE_DRIVER_WEMO
-		if (DRV_IsRunning("WEMO")) {
-			if (strcasestr(udp_msgbuf, "urn:belkin:device:**")) {
-				DRV_WEMO_Send_Advert_To(1, &addr);
-				return;
-			}
-			else if (strcasestr(udp_msgbuf, "upnp:rootdevice")
-				|| strcasestr(udp_msgbuf, "ssdpsearch:all")
-				|| strcasestr(udp_msgbuf, "ssdp:all")) {
-				DRV_WEMO_Send_Advert_To(2, &addr);
-				return;
-			}
-		}
-#endif
-#if ENABLE_DRIVER_HUE
-		if (DRV_IsRunning("HUE")) {
-			if (strcasestr(udp_msgbuf, ":device:basic:1")
-				|| strcasestr(udp_msgbuf, "upnp:rootdevice")
-				|| strcasestr(udp_msgbuf, "ssdpsearch:all")
-				|| strcasestr(udp_msgbuf, "ssdp:all")) {
-				addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, "SSDP has received HUE PACKET");
-				addLogAdv(LOG_ALL, LOG_FEATURE_HTTP, udp_msgbuf);
-				DRV_HUE_Send_Advert_To(&addr);
-				return;
-			}
-		}
-#endif
-		DRV_SSDP_Send_Advert_To(&addr);
-    }
-
-    // our NOTIFTY like:
-    //"NOTIFY * HTTP/1.1\r\n" 
-    //"SERVER: OpenBk\r\n" 
-    if (!strncmp(udp_msgbuf, "NOTIFY", 6)){
-        const char *p = udp_msgbuf;
-        while (*p && *p != '\n'){
-            p++;
+    // drain what has arrived since last tick, but don't stay here for too long
+    for (i = 0; i < SSDP_MAX_PACKETS_PER_TICK; i++){
+        memset(&addr, 0, sizeof(addr));
+        addrlen = sizeof(addr);
+        nbytes = recvfrom(
+            g_ssdp_socket_receive,
+            udp_msgbuf,
+            UDP_MSGBUF_LEN,
+            0,
+            (struct sockaddr *) &addr,
+            &addrlen
+        );
+        if (nbytes <= 0) {
+            return ;
         }
-        if (*p == '\n'){
-            p++;
-            if (!strncmp(p, "SERVER: OpenBk", 14)){
-                addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP,"NOTIFY from a peer device");
-                // add the device to the device list, or set timeout to 0
-                obkDeviceTick(*(uint32_t *)(&((struct sockaddr_in *)&addr)->sin_addr));
-            }
+        // just so we can terminate for print
+        if (nbytes >= UDP_MSGBUF_LEN){
+            nbytes = UDP_MSGBUF_LEN-1;
         }
+        udp_msgbuf[nbytes] = 0;
+        DRV_SSDP_ProcessPacket(udp_msgbuf, &addr);
     }
-
 }
 
 
@@ -596,7 +751,51 @@ void DRV_SSDP_Shutdown(){
         free(http_message);
         http_message = NULL;
     }
+    g_ssdp_renderedIP[0] = 0;
+}
+
+#if WINDOWS
+// selftest feeds recorded packets here, as if they came from the socket
+void DRV_SSDP_Test_InjectPacket(const char *msg, const char *fromIP) {
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(fromIP);
+    // port 0, so replies are never really sent anywhere
+    addr.sin_port = 0;
+    DRV_SSDP_ProcessPacket(msg, &addr);
+}
+
+void DRV_SSDP_Test_GetStats(int *received, int *dropped, int *searches, int *replies, int *limited) {
+    *received = stat_packetsReceived;
+    *dropped = stat_packetsDropped;
+    *searches = stat_searchesReceived;
+    *replies = stat_repliesSent;
+    *limited = stat_repliesLimited;
+}
+
+int DRV_SSDP_Test_GetDevicesCount() {
+    return obkDeviceCount;
+}
+
+bool DRV_SSDP_Test_HasDevice(const char *ip) {
+    uint32_t a = inet_addr(ip);
+    int i;
+
+    for (i = obkBuckets[obkDeviceHash(a)]; i >= 0; i = obkDevices[i].nextInBucket){
+        if (obkDevices[i].ip == a){
+            return true;
+        }
+    }
+    return false;
 }
 
+const char *DRV_SSDP_Test_GetAdvert() {
+    DRV_SSDP_GetRenderVersion();
+    return advert_message;
+}
+#endif
+
 // end public
 ///////////////////////////////////////////////
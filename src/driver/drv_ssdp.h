@@ -6,6 +6,16 @@ void DRV_SSDP_RunEverySecond();
 void DRV_SSDP_RunQuickTick();
 void DRV_SSDP_Shutdown();
 void DRV_SSDP_SendReply(struct sockaddr_in *addr, const char *message);
+// changes when SSDP replies are rendered again, for example after IP change
+int DRV_SSDP_GetRenderVersion();
+
+#if WINDOWS
+void DRV_SSDP_Test_InjectPacket(const char *msg, const char *fromIP);
+void DRV_SSDP_Test_GetStats(int *received, int *dropped, int *searches, int *replies, int *limited);
+int DRV_SSDP_Test_GetDevicesCount();
+bool DRV_SSDP_Test_HasDevice(const char *ip);
+const char *DRV_SSDP_Test_GetAdvert();
+#endif
 
 
 
@@ -11,6 +11,7 @@
 #include "lwip/ip_addr.h"
 #include "lwip/inet.h"
 #include "../httpserver/new_http.h"
+#include "../quicktick.h"
 
 static const char* dgr_group = "239.255.250.250";
 static int dgr_port = 4447;
@@ -34,32 +35,59 @@ void DRV_DGR_Dump(byte *message, int len);
 // Used to send all DGR on quick tick 
 // (instead of doing it in-place, from MQTT callback etc)
 //
-// TODO: MUTEX !!!!!
+// Packets are kept in a fixed pool used as a FIFO ring, so nothing is malloced.
+// While a packet waits for its turn, a newer packet of the same kind (power,
+// brightness, RGBCW, fixed color) for the same group replaces it in place,
+// so dragging a dimmer does not flood the group with stale values.
+// Sending is paced by a token bucket - up to DGR_SEND_BURST packets at once,
+// then DGR_SEND_RATE packets per second.
 //
 // Maximum number of bytes in pendings DGR packet
 #define MAX_DGR_PACKET 128
-// limits the total number of dgrPacket_t we can alloc
+// size of the packet pool
 #define MAX_DGR_QUEUE_SIZE 8
+// token bucket
+#define DGR_SEND_BURST 4
+#define DGR_SEND_RATE 20
+
+// kinds of queued packets, packets of the same kind and group supersede older ones
+#define DGR_KIND_GENERIC		0
+#define DGR_KIND_POWER			1
+#define DGR_KIND_BRIGHTNESS		2
+#define DGR_KIND_RGBCW			3
+#define DGR_KIND_FIXEDCOLOR		4
 
 typedef struct dgrPacket_s {
-	struct dgrPacket_s *next;
 	byte buffer[MAX_DGR_PACKET];
 	byte length;
+	byte kind;
 } dgrPacket_t;
 
-// the list is not allocated before first use
-dgrPacket_t *dgr_pending = 0;
-int dgr_total_alloced_queue_size = 0;
+static dgrPacket_t g_dgrPool[MAX_DGR_QUEUE_SIZE];
+static int g_dgrPoolFirst = 0;
+static int g_dgrPoolCount = 0;
+// in milli-tokens, so partial refills are not lost
+static int g_dgrSendTokens = DGR_SEND_BURST * 1000;
+static int g_dgr_stat_coalesced = 0;
+static int g_dgr_stat_dropped = 0;
 
 static SemaphoreHandle_t g_mutex = 0;
 
+// packet starts with "TASMOTA_DGR" followed by NULL terminated group name
+static bool DGR_IsSameGroup(const byte *a, const byte *b) {
+	return strcmp((const char*)a, (const char*)b) == 0;
+}
+
 // Adds a packet to DGR send queue. Can be called from anywhere, MQTT callback, etc.
 // We don't send UDP DGR packets directly from MQTT callback, because it would crash device in some cases....
-void DGR_AddToSendQueue(byte *data, int len) {
+static void DGR_AddToSendQueueEx(byte *data, int len, int kind) {
 	dgrPacket_t *p;
 	bool taken;
+	int i;
+
 	if(len > MAX_DGR_PACKET) {
 		addLogAdv(LOG_INFO, LOG_FEATURE_DGR, "DGR_AddToSendQueue: DGR packet too long - %i",len);
+		g_dgr_stat_dropped++;
 		return;
 	}	
 	if (g_mutex == 0)
@@ -68,36 +96,93 @@ void DGR_AddToSendQueue(byte *data, int len) {
 	}
 	taken = xSemaphoreTake(g_mutex, 10);
 	if (taken == false) {
+		g_dgr_stat_dropped++;
 		return;
 	}
-	p = dgr_pending;
-	while(p) {
-		if(p->length == 0) {
-			// this packet can be reused
-			break;
+	if (kind != DGR_KIND_GENERIC) {
+		for (i = 0; i < g_dgrPoolCount; i++) {
+			dgrPacket_t *o = &g_dgrPool[(g_dgrPoolFirst + i) % MAX_DGR_QUEUE_SIZE];
+			if (o->kind == kind && DGR_IsSameGroup(o->buffer, data)) {
+				// not sent yet, so remove it, newer state goes to the tail,
+				// queue order must stay the sequence order or receivers drop packets
+				for (; i < g_dgrPoolCount - 1; i++) {
+					g_dgrPool[(g_dgrPoolFirst + i) % MAX_DGR_QUEUE_SIZE] =
+						g_dgrPool[(g_dgrPoolFirst + i + 1) % MAX_DGR_QUEUE_SIZE];
+				}
+				g_dgrPoolCount--;
+				g_dgr_stat_coalesced++;
+				break;
+			}
 		}
-		p = p->next;
 	}
-	if(p == 0) {
-		if (dgr_total_alloced_queue_size >= MAX_DGR_QUEUE_SIZE) {
-			addLogAdv(LOG_INFO, LOG_FEATURE_DGR, "DGR_AddToSendQueue: DGR queue grew to big, will drop packet");
-			return;
-		}
-		dgr_total_alloced_queue_size++;
-		p = malloc(sizeof(dgrPacket_t));
-		p->next = dgr_pending;
-		dgr_pending = p;
+	if (g_dgrPoolCount >= MAX_DGR_QUEUE_SIZE) {
+		addLogAdv(LOG_INFO, LOG_FEATURE_DGR, "DGR_AddToSendQueue: DGR queue grew to big, will drop packet");
+		g_dgr_stat_dropped++;
+		xSemaphoreGive(g_mutex);
+		return;
 	}
+	p = &g_dgrPool[(g_dgrPoolFirst + g_dgrPoolCount) % MAX_DGR_QUEUE_SIZE];
+	g_dgrPoolCount++;
 	p->length = len;
+	p->kind = kind;
 	memcpy(p->buffer,data,len);
 	xSemaphoreGive(g_mutex);
 }
+#ifdef WINDOWS
+// sequence numbers of last sent packets, for selftest
+#define DGR_TEST_MAX_SENT 16
+static int g_dgrTestSent[DGR_TEST_MAX_SENT];
+static int g_dgrTestSentCount = 0;
+
+static void DGR_Test_OnSent(dgrPacket_t *p) {
+	int ofs;
+	uint16_t seq;
+
+	// header and group name are one NULL terminated string, followed by sequence
+	ofs = strlen((const char*)p->buffer) + 1;
+	if (ofs + 2 > p->length || g_dgrTestSentCount >= DGR_TEST_MAX_SENT) {
+		return;
+	}
+	memcpy(&seq, p->buffer + ofs, 2);
+	g_dgrTestSent[g_dgrTestSentCount++] = seq;
+}
+int DGR_Test_GetSentSequences(int *out, int max) {
+	int i;
+
+	for (i = 0; i < g_dgrTestSentCount && i < max; i++) {
+		out[i] = g_dgrTestSent[i];
+	}
+	return i;
+}
+void DGR_Test_ClearSentSequences() {
+	g_dgrTestSentCount = 0;
+}
+#endif
+void DGR_AddToSendQueue(byte *data, int len) {
+	DGR_AddToSendQueueEx(data, len, DGR_KIND_GENERIC);
+}
+int DGR_GetSendQueueStats(int *coalesced, int *dropped) {
+	if (coalesced)
+		*coalesced = g_dgr_stat_coalesced;
+	if (dropped)
+		*dropped = g_dgr_stat_dropped;
+	return g_dgrPoolCount;
+}
 void DGR_FlushSendQueue() {
 	dgrPacket_t *p;
     struct sockaddr_in addr;
 	int nbytes;
 	bool taken;
 
+	// refill token bucket
+	g_dgrSendTokens += g_deltaTimeMS * DGR_SEND_RATE;
+	if (g_dgrSendTokens > DGR_SEND_BURST * 1000) {
+		g_dgrSendTokens = DGR_SEND_BURST * 1000;
+	}
+	if (g_dgrPoolCount == 0 || g_dgrSendTokens < 1000) {
+		return;
+	}
+
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = inet_addr(dgr_group);
@@ -111,32 +196,24 @@ void DGR_FlushSendQueue() {
 	if (taken == false) {
 		return;
 	}
-	p = dgr_pending;
-	while(p) {
-		if(p->length != 0) {
-			g_dgr_stat_sent++;
-			nbytes = sendto(
-				g_dgr_socket_send,
-			   (const char*) p->buffer,
-				p->length,
-				0,
-				(struct sockaddr*) &addr,
-				sizeof(addr)
-			);
-#if 0
-			rtos_delay_milliseconds(1);
-			nbytes = sendto(
-				g_dgr_socket_send,
-			   (const char*) p->buffer,
-				p->length,
-				0,
-				(struct sockaddr*) &addr,
-				sizeof(addr)
-			);
+	while(g_dgrPoolCount > 0 && g_dgrSendTokens >= 1000) {
+		p = &g_dgrPool[g_dgrPoolFirst];
+		g_dgr_stat_sent++;
+#ifdef WINDOWS
+		DGR_Test_OnSent(p);
 #endif
-			p->length = 0;
-		}
-		p = p->next;
+		nbytes = sendto(
+			g_dgr_socket_send,
+		   (const char*) p->buffer,
+			p->length,
+			0,
+			(struct sockaddr*) &addr,
+			sizeof(addr)
+		);
+		p->length = 0;
+		g_dgrPoolFirst = (g_dgrPoolFirst + 1) % MAX_DGR_QUEUE_SIZE;
+		g_dgrPoolCount--;
+		g_dgrSendTokens -= 1000;
 	}
 	xSemaphoreGive(g_mutex);
 
@@ -163,7 +240,7 @@ void DRV_DGR_CreateSocket_Send() {
     }
 	addLogAdv(LOG_INFO, LOG_FEATURE_DGR,"DRV_DGR_CreateSocket_Send: socket created");
 }
-void DRV_DGR_Send_Generic(byte *message, int len) {
+static void DRV_DGR_Send_GenericEx(byte *message, int len, int kind) {
 	// if this send is as a result of use RXing something, 
 	// don't send it....
 	if (g_inCmdProcessing){
@@ -174,9 +251,12 @@ void DRV_DGR_Send_Generic(byte *message, int len) {
 
 	// This is here only because sending UDP from MQTT callback crashes BK for me
 	// So instead, we are making a queue which is sent in quick tick
-	DGR_AddToSendQueue(message, len);
+	DGR_AddToSendQueueEx(message, len, kind);
 	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_DGR, "DGR adds to queue %i",len);
 }
+void DRV_DGR_Send_Generic(byte *message, int len) {
+	DRV_DGR_Send_GenericEx(message, len, DGR_KIND_GENERIC);
+}
 
 void DRV_DGR_Dump(byte *message, int len){
 	char tmp[100];
@@ -200,7 +280,7 @@ void DRV_DGR_Send_Power(const char *groupName, int channelValues, int numChannel
 
 	len = DGR_Quick_FormatPowerState(message,sizeof(message),groupName,g_dgr_send_seq, 0,channelValues, numChannels);
 
-	DRV_DGR_Send_Generic(message,len);
+	DRV_DGR_Send_GenericEx(message, len, DGR_KIND_POWER);
 }
 void DRV_DGR_Send_Brightness(const char *groupName, byte brightness){
 	int len;
@@ -213,7 +293,7 @@ void DRV_DGR_Send_Brightness(const char *groupName, byte brightness){
 
 	len = DGR_Quick_FormatBrightness(message,sizeof(message),groupName,g_dgr_send_seq, 0, brightness);
 
-	DRV_DGR_Send_Generic(message,len);
+	DRV_DGR_Send_GenericEx(message, len, DGR_KIND_BRIGHTNESS);
 }
 void DRV_DGR_Send_RGBCW(const char *groupName, byte *rgbcw){
 	int len;
@@ -226,7 +306,7 @@ void DRV_DGR_Send_RGBCW(const char *groupName, byte *rgbcw){
 
 	len = DGR_Quick_FormatRGBCW(message,sizeof(message),groupName,g_dgr_send_seq, 0, rgbcw[0],rgbcw[1],rgbcw[2],rgbcw[3],rgbcw[4]);
 
-	DRV_DGR_Send_Generic(message,len);
+	DRV_DGR_Send_GenericEx(message, len, DGR_KIND_RGBCW);
 }
 void DRV_DGR_Send_FixedColor(const char *groupName, int colorIndex) {
 	int len;
@@ -239,7 +319,7 @@ void DRV_DGR_Send_FixedColor(const char *groupName, int colorIndex) {
 
 	len = DGR_Quick_FormatFixedColor(message, sizeof(message), groupName, g_dgr_send_seq, 0, colorIndex);
 
-	DRV_DGR_Send_Generic(message, len);
+	DRV_DGR_Send_GenericEx(message, len, DGR_KIND_FIXEDCOLOR);
 }
 void DRV_DGR_CreateSocket_Receive() {
 
@@ -560,13 +640,17 @@ void DRV_DGR_Shutdown()
 	dgr_retry_time_left = 5;
 	g_inCmdProcessing = 0;
 	g_dgr_send_seq = 0;
+	g_dgrPoolFirst = 0;
+	g_dgrPoolCount = 0;
+	g_dgrSendTokens = DGR_SEND_BURST * 1000;
 }
 
 void DRV_DGR_AppendInformationToHTTPIndexPage(http_request_t* request, int bPreState) {
 	if (bPreState){
 		return;
 	}
-	hprintf255(request, "<h4>DGR received: %i, send: %i</h4>", g_dgr_stat_received, g_dgr_stat_sent);
+	hprintf255(request, "<h4>DGR received: %i, send: %i, coalesced: %i, dropped: %i</h4>",
+		g_dgr_stat_received, g_dgr_stat_sent, g_dgr_stat_coalesced, g_dgr_stat_dropped);
 }
 // DGR_SendPower testSocket 1 1
 // DGR_SendPower stringGroupName integerChannelValues integerChannelsCount
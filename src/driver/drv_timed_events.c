@@ -3,6 +3,7 @@
 #include "../libraries/obktime/obktime.h"	// for time functions
 
 #include <math.h>
+#include <limits.h>
 
 #include "../new_common.h"
 #include "../new_cfg.h"
@@ -31,12 +32,28 @@ typedef struct clockEvent_s {
 #define SUNSET_FLAG (1 << 1)
 #endif
 	int id;
+	// order of adding, so events at the same second run in a stable order
+	unsigned int seq;
 	char *command;
 	struct clockEvent_s *next;
 } clockEvent_t;
 
 clockEvent_t *clock_events = 0;
 
+// Events sorted by second of day, so each second only events due in it are
+// checked, instead of whole list. Rebuilt lazily when events were added,
+// removed or moved (sunrise/sunset recalculation, DST fix). Cursor remembers
+// where next second starts, so normal ticking doesn't even need a search.
+static clockEvent_t **clock_eventsIndex = 0;
+static int clock_eventsIndexCount = 0;
+static int clock_eventsIndexAlloc = 0;
+static bool clock_eventsIndexDirty = false;
+static int clock_eventsCursor = 0;
+static int clock_eventsCursorTime = -1;
+static unsigned int clock_eventsNextSeq = 0;
+// for selftests, number of index entries looked at
+static int clock_eventsChecked = 0;
+
 #if ENABLE_TIME_SUNRISE_SUNSET
 /* Sunrise/sunset algorithm, somewhat based on https://edwilliams.org/sunrise_sunset_algorithm.htm and tasmota code */
 const float pi2 = (M_PI * 2);
@@ -168,58 +185,135 @@ void TIME_CalculateSunset(byte *outHour, byte *outMinute) {
 }
 #endif
 
-void TIME_RunEventsForSecond(time_t runTime) {
+static int TIME_GetEventSecondOfDay(const clockEvent_t *e) {
+	return (int)e->hour * 3600 + (int)e->minute * 60 + (int)e->second;
+}
+
+static int TIME_CompareEvents(const void *a, const void *b) {
+	const clockEvent_t *ea = *(const clockEvent_t**)a;
+	const clockEvent_t *eb = *(const clockEvent_t**)b;
+	int diff;
+
+	diff = TIME_GetEventSecondOfDay(ea) - TIME_GetEventSecondOfDay(eb);
+	if (diff) {
+		return diff;
+	}
+	if (ea->seq == eb->seq) {
+		return 0;
+	}
+	// newest first, same order as list walk always had
+	return ea->seq > eb->seq ? -1 : 1;
+}
+
+static void TIME_RebuildEventsIndex() {
 	clockEvent_t *e;
-	
-/*
-	struct tm *ltm;
-
-	// NOTE: on windows, you need _USE_32BIT_TIME_T 
-	ltm = gmtime(&runTime);
-	
-	if (ltm == 0) {
-		return;
+	clockEvent_t **n;
+	int count;
+
+	clock_eventsIndexDirty = false;
+	clock_eventsCursorTime = -1;
+	count = 0;
+	for (e = clock_events; e; e = e->next) {
+		count++;
+	}
+	if (count > clock_eventsIndexAlloc) {
+		n = (clockEvent_t**)realloc(clock_eventsIndex, count * sizeof(clockEvent_t*));
+		if (n == 0) {
+			// try again next time
+			clock_eventsIndexDirty = true;
+			clock_eventsIndexCount = 0;
+			return;
+		}
+		clock_eventsIndex = n;
+		clock_eventsIndexAlloc = count;
+	}
+	count = 0;
+	for (e = clock_events; e; e = e->next) {
+		if (e->command) {
+			clock_eventsIndex[count++] = e;
+		}
+	}
+	clock_eventsIndexCount = count;
+	qsort(clock_eventsIndex, count, sizeof(clockEvent_t*), TIME_CompareEvents);
+}
+
+// first index entry at secondOfDay with seq < belowSeq, events of a second are newest first
+static int TIME_FindEvent(int secondOfDay, unsigned int belowSeq) {
+	int lo, hi, mid, t;
+
+	if (belowSeq == UINT_MAX && secondOfDay == clock_eventsCursorTime) {
+		return clock_eventsCursor;
+	}
+	lo = 0;
+	hi = clock_eventsIndexCount;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		t = TIME_GetEventSecondOfDay(clock_eventsIndex[mid]);
+		if (t < secondOfDay || (t == secondOfDay && clock_eventsIndex[mid]->seq >= belowSeq)) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
 	}
-*/
+	return lo;
+}
+
+void TIME_RunEventsForSecond(time_t runTime) {
+	clockEvent_t *e;
+	unsigned int seqLimit, seq;
+	int secondOfDay;
+	int i;
+
 	TimeComponents tc=calculateComponents(runTime);
-	e = clock_events;
+	secondOfDay = tc.hour * 3600 + tc.minute * 60 + tc.second;
 
-	while (e) {
-		if (e->command) {
-			// base check
-//			if (e->hour == ltm->tm_hour && e->second == ltm->tm_sec && e->minute == ltm->tm_min) {
-			if (e->hour == tc.hour && e->second == tc.second && e->minute == tc.minute) {
-				// weekday check
-//				if (BIT_CHECK(e->weekDayFlags, ltm->tm_wday)) {
-				if (BIT_CHECK(e->weekDayFlags, tc.wday)) {
+	if (clock_eventsIndexDirty) {
+		TIME_RebuildEventsIndex();
+	}
+	// events added by commands run now will wait for their next time
+	seqLimit = clock_eventsNextSeq;
+	i = TIME_FindEvent(secondOfDay, UINT_MAX);
+	while (i < clock_eventsIndexCount) {
+		e = clock_eventsIndex[i];
+		clock_eventsChecked++;
+		if (TIME_GetEventSecondOfDay(e) != secondOfDay) {
+			break;
+		}
+		i++;
+		// weekday check
+		if (e->seq >= seqLimit || !BIT_CHECK(e->weekDayFlags, tc.wday)) {
+			continue;
+		}
+		// command may remove this event, or add and remove others
+		seq = e->seq;
 #if ENABLE_TIME_SUNRISE_SUNSET
-					if (e->sunflags) {	// no need to check for sunrise/sunset here. If sunflags != 0, it's either of them!!
-/*
-						if (e->lastDay != ltm->tm_wday) {
-							e->lastDay = ltm->tm_wday;  // stop any further sun events today 
-							dusk2Dawn(&sun_data, e->sunflags, &e->hour, &e->minute,
-								calc_day_offset(ltm->tm_wday + 1, e->weekDayFlags));  // setup for tomorrow
-							CMD_ExecuteCommand(e->command, 0);
-							}
-*/
-						if (e->lastDay != tc.wday) {
-							e->lastDay = tc.wday;  /* stop any further sun events today */
-							dusk2Dawn(&sun_data, e->sunflags, &e->hour, &e->minute,
-								calc_day_offset(tc.wday + 1, e->weekDayFlags));  /* setup for tomorrow */
-							CMD_ExecuteCommand(e->command, 0);
-							}
-
-						else {
-							e->lastDay = -1;  /* mark with anything but a valid day of week */
-							}
-						}
-					else
-#endif
-					CMD_ExecuteCommand(e->command, 0);
-				}
+		if (e->sunflags) {	// no need to check for sunrise/sunset here. If sunflags != 0, it's either of them!!
+			if (e->lastDay != tc.wday) {
+				e->lastDay = tc.wday;  /* stop any further sun events today */
+				dusk2Dawn(&sun_data, e->sunflags, &e->hour, &e->minute,
+					calc_day_offset(tc.wday + 1, e->weekDayFlags));  /* setup for tomorrow */
+				clock_eventsIndexDirty = true;
+				CMD_ExecuteCommand(e->command, 0);
+			}
+			else {
+				e->lastDay = -1;  /* mark with anything but a valid day of week */
 			}
 		}
-		e = e->next;
+		else
+#endif
+		CMD_ExecuteCommand(e->command, 0);
+		if (clock_eventsIndexDirty) {
+			TIME_RebuildEventsIndex();
+			i = TIME_FindEvent(secondOfDay, seq);
+		}
+	}
+	// next second starts where this one ended
+	clock_eventsCursor = i;
+	clock_eventsCursorTime = secondOfDay + 1;
+	if (clock_eventsCursorTime >= 24 * 3600) {
+		clock_eventsCursor = 0;
+		clock_eventsCursorTime = 0;
 	}
 }
 #if ENABLE_TIME_SUNRISE_SUNSET && ENABLE_TIME_DST
@@ -239,6 +333,7 @@ void fix_DSTforEvents(int minutes){
 		}
 		e = e->next;
 	}
+	clock_eventsIndexDirty = true;
 }
 #endif
 void TIME_RunEvents(unsigned int newTime, bool bTimeValid) {
@@ -293,10 +388,12 @@ void TIME_AddEvent(int hour, int minute, int second, int weekDayFlags, int id, c
 	newEvent->sunflags = sunflags;
 #endif
 	newEvent->id = id;
+	newEvent->seq = clock_eventsNextSeq++;
 	newEvent->command = strdup(command);
 	newEvent->next = clock_events;
 
 	clock_events = newEvent;
+	clock_eventsIndexDirty = true;
 }
 int TIME_RemoveEvent(int id) {
 	int ret = 0;
@@ -314,6 +411,7 @@ int TIME_RemoveEvent(int id) {
 			free(curr->command);
 			free(curr);
 			ret++;
+			clock_eventsIndexDirty = true;
 			if (prev == NULL) {
 				curr = clock_events;
 			}
@@ -468,6 +566,10 @@ int TIME_GetEventTime(int id) {
 	return -1;
 }
 
+int TIME_GetCheckedEventsCount() {
+	return clock_eventsChecked;
+}
+
 int TIME_Print_EventList() {
 	clockEvent_t* e;
 	int t;
@@ -520,6 +622,12 @@ int TIME_ClearEvents() {
 		free(p);
 	}
 	clock_events = 0;
+	free(clock_eventsIndex);
+	clock_eventsIndex = 0;
+	clock_eventsIndexAlloc = 0;
+	clock_eventsIndexCount = 0;
+	clock_eventsIndexDirty = false;
+	clock_eventsCursorTime = -1;
 	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "Removed %i events", t);
 	return t;
 }
@@ -185,6 +185,13 @@ typedef struct tuyaMCUMapping_s {
 } tuyaMCUMapping_t;
 
 tuyaMCUMapping_t* g_tuyaMappings = 0;
+// Direct lookup tables for mappings, so state reports with many dpIds
+// don't have to walk the list for every dpId. The list above is still
+// the owner of mappings and is used for iteration.
+// dpId is a byte, so table has 256 entries (allocated on first mapping)
+#define TUYAMCU_MAX_DPID 256
+static tuyaMCUMapping_t** g_tuyaMappingsByID = 0;
+static tuyaMCUMapping_t* g_tuyaMappingsByChannel[CHANNEL_MAX];
 
 /**
  * Dimmer range
@@ -317,6 +324,11 @@ bool TUYAMCU_SendFromQueue() {
 tuyaMCUMapping_t* TuyaMCU_FindDefForID(int dpId) {
 	tuyaMCUMapping_t* cur;
 
+	if (dpId < 0 || dpId >= TUYAMCU_MAX_DPID)
+		return 0;
+	if (g_tuyaMappingsByID)
+		return g_tuyaMappingsByID[dpId];
+	// table was not allocated (out of memory?), fall back to list
 	cur = g_tuyaMappings;
 	while (cur) {
 		if (cur->dpId == dpId)
@@ -329,6 +341,9 @@ tuyaMCUMapping_t* TuyaMCU_FindDefForID(int dpId) {
 tuyaMCUMapping_t* TuyaMCU_FindDefForChannel(int channel) {
 	tuyaMCUMapping_t* cur;
 
+	if (channel >= 0 && channel < CHANNEL_MAX)
+		return g_tuyaMappingsByChannel[channel];
+	// out of table range, this is rare
 	cur = g_tuyaMappings;
 	while (cur) {
 		if (cur->channel == channel)
@@ -338,9 +353,36 @@ tuyaMCUMapping_t* TuyaMCU_FindDefForChannel(int channel) {
 	return 0;
 }
 
+// rebuild lookup tables from list; for channels, first mapping in list wins,
+// same as linear search did
+static void TuyaMCU_RebuildMappingIndex() {
+	tuyaMCUMapping_t* cur;
+
+	if (g_tuyaMappingsByID) {
+		memset(g_tuyaMappingsByID, 0, sizeof(tuyaMCUMapping_t*) * TUYAMCU_MAX_DPID);
+	}
+	memset(g_tuyaMappingsByChannel, 0, sizeof(g_tuyaMappingsByChannel));
+	cur = g_tuyaMappings;
+	while (cur) {
+		if (g_tuyaMappingsByID) {
+			g_tuyaMappingsByID[cur->dpId] = cur;
+		}
+		if (cur->channel >= 0 && cur->channel < CHANNEL_MAX && g_tuyaMappingsByChannel[cur->channel] == 0) {
+			g_tuyaMappingsByChannel[cur->channel] = cur;
+		}
+		cur = cur->next;
+	}
+}
+
 tuyaMCUMapping_t* TuyaMCU_MapIDToChannel(int dpId, int dpType, int channel, int obkFlags, float mul, int inv, float delta, float delta2, float delta3) {
 	tuyaMCUMapping_t* cur;
 
+	if (g_tuyaMappingsByID == 0) {
+		g_tuyaMappingsByID = (tuyaMCUMapping_t**)malloc(sizeof(tuyaMCUMapping_t*) * TUYAMCU_MAX_DPID);
+		if (g_tuyaMappingsByID) {
+			memset(g_tuyaMappingsByID, 0, sizeof(tuyaMCUMapping_t*) * TUYAMCU_MAX_DPID);
+		}
+	}
 	cur = TuyaMCU_FindDefForID(dpId);
 
 	if (cur == 0) {
@@ -361,6 +403,7 @@ tuyaMCUMapping_t* TuyaMCU_MapIDToChannel(int dpId, int dpType, int channel, int
 	cur->inv = inv;
 	cur->prevValue = 0;
 	cur->channel = channel;
+	TuyaMCU_RebuildMappingIndex();
 	return cur;
 }
 
@@ -375,15 +418,15 @@ void TuyaMCU_SetHeartbeatCounter(int v) {
 // 55AA     00      00      0000   xx   00
 
 #define MIN_TUYAMCU_PACKET_SIZE (2+1+1+2+1)
+static const byte g_tuyaMCUHeader[2] = { 0x55, 0xAA };
 int UART_TryToGetNextTuyaPacket(byte* out, int maxSize) {
 	int cs;
 	int len, i;
-	int c_garbage_consumed = 0;
-	byte a, b, version, command, lena, lenb;
-	char printfSkipDebug[256];
-	char buffer2[8];
-
-	printfSkipDebug[0] = 0;
+	int c_garbage_consumed;
+	byte hdr[MIN_TUYAMCU_PACKET_SIZE - 1];
+	byte skipped[64];
+	char printfSkipDebug[sizeof(skipped) * 3 + 1];
+	int skippedCnt;
 
 	cs = UART_GetDataSize();
 
@@ -391,48 +434,38 @@ int UART_TryToGetNextTuyaPacket(byte* out, int maxSize) {
 		return 0;
 	}
 	// skip garbage data (should not happen)
-	while (cs > 0) {
-		a = UART_GetByte(0);
-		b = UART_GetByte(1);
-		if (a != 0x55 || b != 0xAA) {
-			UART_ConsumeBytes(1);
-			if (c_garbage_consumed + 2 < sizeof(printfSkipDebug)) {
-				snprintf(buffer2, sizeof(buffer2), "%02X ", a);
-				strcat_safe(printfSkipDebug, buffer2, sizeof(printfSkipDebug));
-			}
-			c_garbage_consumed++;
-			cs--;
-		}
-		else {
-			break;
-		}
+	c_garbage_consumed = UART_FindHeader(0, g_tuyaMCUHeader, sizeof(g_tuyaMCUHeader));
+	if (c_garbage_consumed < 0) {
+		// no full header, but keep last byte as it may be the first half of it
+		c_garbage_consumed = cs - 1;
 	}
 	if (c_garbage_consumed > 0) {
+		skippedCnt = UART_CopyBytes(0, skipped, c_garbage_consumed < (int)sizeof(skipped) ? c_garbage_consumed : (int)sizeof(skipped));
+		printfSkipDebug[0] = 0;
+		for (i = 0; i < skippedCnt; i++) {
+			snprintf(printfSkipDebug + i * 3, 4, "%02X ", skipped[i]);
+		}
+		UART_ConsumeBytes(c_garbage_consumed);
+		cs -= c_garbage_consumed;
 		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "Consumed %i unwanted non-header byte in Tuya MCU buffer", c_garbage_consumed);
 		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "Skipped data (part) %s", printfSkipDebug);
 	}
 	if (cs < MIN_TUYAMCU_PACKET_SIZE) {
 		return 0;
 	}
-	a = UART_GetByte(0);
-	b = UART_GetByte(1);
-	if (a != 0x55 || b != 0xAA) {
+	// header version command lenght
+	UART_CopyBytes(0, hdr, sizeof(hdr));
+	if (hdr[0] != 0x55 || hdr[1] != 0xAA) {
 		return 0;
 	}
-	version = UART_GetByte(2);
-	command = UART_GetByte(3);
-	lena = UART_GetByte(4); // hi
-	lenb = UART_GetByte(5); // lo
-	len = lenb | lena >> 8;
+	len = hdr[5] | hdr[4] >> 8;
 	// now check if we have received whole packet
 	len += 2 + 1 + 1 + 2 + 1; // header 2 bytes, version, command, lenght, chekcusm
 	if (cs >= len) {
 		int ret;
 		// can packet fit into the buffer?
 		if (len <= maxSize) {
-			for (i = 0; i < len; i++) {
-				out[i] = UART_GetByte(i);
-			}
+			UART_CopyBytes(0, out, len);
 			ret = len;
 		}
 		else {
@@ -562,6 +595,191 @@ void TuyaMCU_SendEnum(uint8_t id, uint32_t value)
 	TuyaMCU_SendState(id, DP_TYPE_ENUM, (uint8_t*)(&value));
 }
 
+/**
+ * Coalescing of DP updates caused by channel changes
+ *
+ * When many linked channels change at once (scene, CHANNEL_SetAll), updates are
+ * collected for tuyaMcu_setCoalesceWindow milliseconds. Updates to the same dpId
+ * collapse to the latest value and all pending dpIds are sent in a single 0x06 frame.
+ * Next frame is held until MCU answers the previous one with a state report
+ * (or until timeout derived from the observed answer latency), so slow MCUs are not flooded.
+ * Pending list grows while the held frame waits, it has at most one entry per dpId.
+ */
+#define TUYAMCU_COALESCE_MIN_DPS	32
+#define TUYAMCU_COALESCE_MAX_DPS	256
+#define TUYAMCU_ACK_TIMEOUT_DEFAULT	300
+#define TUYAMCU_ACK_TIMEOUT_MIN		100
+#define TUYAMCU_ACK_TIMEOUT_MAX		2000
+
+typedef struct tuyaMCUPendingDP_s {
+	byte dpId;
+	byte dpType;
+	byte len;
+	byte data[4];
+} tuyaMCUPendingDP_t;
+
+static tuyaMCUPendingDP_t *g_tuyaPendingDPs = 0;
+static int g_tuyaPendingDPCount = 0;
+static int g_tuyaPendingDPAlloc = 0;
+// 0 = disabled, every update is sent at once
+static int g_tuyaCoalesceWindowMS = 0;
+// time since first pending update was added
+static int g_tuyaCoalesceTimeMS = 0;
+// time since last coalesced frame was sent, -1 if not waiting for answer
+static int g_tuyaAckWaitMS = -1;
+// averaged MCU answer latency, 0 if not measured yet
+static int g_tuyaAckLatencyMS = 0;
+static int g_tuyaCoalesceMerged = 0;
+static int g_tuyaCoalesceFrames = 0;
+
+static int TuyaMCU_GetAckTimeout() {
+	int timeout;
+
+	if (g_tuyaAckLatencyMS <= 0)
+		return TUYAMCU_ACK_TIMEOUT_DEFAULT;
+	timeout = g_tuyaAckLatencyMS * 2;
+	if (timeout < TUYAMCU_ACK_TIMEOUT_MIN)
+		timeout = TUYAMCU_ACK_TIMEOUT_MIN;
+	if (timeout > TUYAMCU_ACK_TIMEOUT_MAX)
+		timeout = TUYAMCU_ACK_TIMEOUT_MAX;
+	return timeout;
+}
+
+static void TuyaMCU_FlushPendingDPs() {
+	int payload_len = 0;
+	int next;
+	int i;
+
+	if (g_tuyaPendingDPCount == 0)
+		return;
+	for (i = 0; i < g_tuyaPendingDPCount; i++) {
+		next = TuyaMCU_AppendStateInternal(g_tuyaMCUpayloadBuffer, g_tuyaMCUpayloadBufferSize, payload_len,
+			g_tuyaPendingDPs[i].dpId, g_tuyaPendingDPs[i].dpType, g_tuyaPendingDPs[i].data, g_tuyaPendingDPs[i].len);
+		// buffer full, rest will go in the next frame
+		if (next == 0)
+			break;
+		payload_len = next;
+	}
+	if (payload_len == 0) {
+		// should not happen, but don't get stuck on it
+		g_tuyaPendingDPCount = 0;
+		return;
+	}
+	addLogAdv(LOG_DEBUG, LOG_FEATURE_TUYAMCU, "Sending %i coalesced dpIds in one frame", i);
+	TuyaMCU_SendCommandWithData(TUYA_CMD_SET_DP, g_tuyaMCUpayloadBuffer, payload_len);
+	g_tuyaPendingDPCount -= i;
+	memmove(g_tuyaPendingDPs, g_tuyaPendingDPs + i, g_tuyaPendingDPCount * sizeof(tuyaMCUPendingDP_t));
+	g_tuyaCoalesceFrames++;
+	g_tuyaCoalesceTimeMS = 0;
+	g_tuyaAckWaitMS = 0;
+}
+
+// called when MCU reports state, which it does as an answer to 0x06
+static void TuyaMCU_OnStateReportForCoalesce() {
+	if (g_tuyaAckWaitMS < 0)
+		return;
+	if (g_tuyaAckLatencyMS <= 0)
+		g_tuyaAckLatencyMS = g_tuyaAckWaitMS;
+	else
+		g_tuyaAckLatencyMS = (g_tuyaAckLatencyMS * 3 + g_tuyaAckWaitMS) / 4;
+	g_tuyaAckWaitMS = -1;
+}
+
+static void TuyaMCU_RunCoalesce() {
+	if (g_tuyaAckWaitMS >= 0) {
+		g_tuyaAckWaitMS += g_deltaTimeMS;
+		// MCU did not answer, don't hold updates forever
+		if (g_tuyaAckWaitMS > TuyaMCU_GetAckTimeout()) {
+			g_tuyaAckWaitMS = -1;
+		}
+	}
+	if (g_tuyaPendingDPCount == 0)
+		return;
+	g_tuyaCoalesceTimeMS += g_deltaTimeMS;
+	if (g_tuyaCoalesceTimeMS < g_tuyaCoalesceWindowMS)
+		return;
+	if (g_tuyaAckWaitMS >= 0)
+		return;
+	TuyaMCU_FlushPendingDPs();
+}
+
+static bool TuyaMCU_GrowPendingDPs() {
+	tuyaMCUPendingDP_t *n;
+	int alloc;
+
+	alloc = g_tuyaPendingDPAlloc ? g_tuyaPendingDPAlloc * 2 : TUYAMCU_COALESCE_MIN_DPS;
+	if (alloc > TUYAMCU_COALESCE_MAX_DPS)
+		alloc = TUYAMCU_COALESCE_MAX_DPS;
+	if (alloc <= g_tuyaPendingDPAlloc)
+		return false;
+	n = (tuyaMCUPendingDP_t*)realloc(g_tuyaPendingDPs, alloc * sizeof(tuyaMCUPendingDP_t));
+	if (n == 0)
+		return false;
+	g_tuyaPendingDPs = n;
+	g_tuyaPendingDPAlloc = alloc;
+	return true;
+}
+
+// Sends bool/enum/value dpId, or queues it for coalescing if enabled
+static void TuyaMCU_QueueState(uint8_t id, uint8_t type, uint32_t value) {
+	tuyaMCUPendingDP_t *dp;
+	int i;
+
+	if (g_tuyaCoalesceWindowMS <= 0) {
+		switch (type) {
+		case DP_TYPE_BOOL:
+			TuyaMCU_SendBool(id, value != 0);
+			break;
+		case DP_TYPE_ENUM:
+			TuyaMCU_SendEnum(id, value);
+			break;
+		default:
+			TuyaMCU_SendValue(id, value);
+			break;
+		}
+		return;
+	}
+	dp = 0;
+	for (i = 0; i < g_tuyaPendingDPCount; i++) {
+		if (g_tuyaPendingDPs[i].dpId == id) {
+			dp = &g_tuyaPendingDPs[i];
+			g_tuyaCoalesceMerged++;
+			break;
+		}
+	}
+	if (dp == 0) {
+		// MCU is idle, so a full list can go now, but previous frame waiting for
+		// answer must not be followed by another one
+		if (g_tuyaPendingDPCount >= g_tuyaPendingDPAlloc && g_tuyaAckWaitMS < 0) {
+			TuyaMCU_FlushPendingDPs();
+		}
+		if (g_tuyaPendingDPCount >= g_tuyaPendingDPAlloc && TuyaMCU_GrowPendingDPs() == false) {
+			addLogAdv(LOG_ERROR, LOG_FEATURE_TUYAMCU, "No memory for pending dpIds, sending them now");
+			TuyaMCU_FlushPendingDPs();
+			// not even one fits into the frame
+			if (g_tuyaPendingDPCount >= g_tuyaPendingDPAlloc)
+				return;
+		}
+		if (g_tuyaPendingDPCount == 0) {
+			g_tuyaCoalesceTimeMS = 0;
+		}
+		dp = &g_tuyaPendingDPs[g_tuyaPendingDPCount++];
+		dp->dpId = id;
+	}
+	dp->dpType = type;
+	if (type == DP_TYPE_VALUE) {
+		dp->len = 4;
+		dp->data[0] = (value >> 24) & 0xFF;
+		dp->data[1] = (value >> 16) & 0xFF;
+		dp->data[2] = (value >> 8) & 0xFF;
+		dp->data[3] = value & 0xFF;
+	}
+	else {
+		dp->len = 1;
+		dp->data[0] = (type == DP_TYPE_BOOL) ? (value != 0) : (value & 0xFF);
+	}
+}
+
 static uint16_t convertHexStringtoBytes(uint8_t* dest, char src[], uint16_t src_len) {
 	char hexbyte[3];
 	uint16_t i;
@@ -1244,15 +1462,9 @@ void TuyaMCU_OnChannelChanged(int channel, int iVal) {
 	switch (mapping->dpType)
 	{
 	case DP_TYPE_BOOL:
-		TuyaMCU_SendBool(mapping->dpId, mappediVal != 0);
-		break;
-
 	case DP_TYPE_ENUM:
-		TuyaMCU_SendEnum(mapping->dpId, mappediVal);
-		break;
-
 	case DP_TYPE_VALUE:
-		TuyaMCU_SendValue(mapping->dpId, mappediVal);
+		TuyaMCU_QueueState(mapping->dpId, mapping->dpType, mappediVal);
 		break;
 
 	default:
@@ -2130,6 +2342,7 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 
 		
 	case TUYA_CMD_STATE:
+		TuyaMCU_OnStateReportForCoalesce();
 		TuyaMCU_ParseStateMessage(data + 6, len - 6);
 		state_updated = true;
 		g_sendQueryStatePackets = 0;
@@ -2266,6 +2479,24 @@ commandResult_t TuyaMCU_FakePacket(const void* context, const char* cmd, const c
 	return CMD_RES_OK;
 }
 
+// tuyaMcu_setCoalesceWindow 50
+// Without argument, just prints current coalescing stats
+commandResult_t Cmd_TuyaMCU_SetCoalesceWindow(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	Tokenizer_TokenizeString(args, 0);
+
+	if (Tokenizer_GetArgsCount() >= 1) {
+		g_tuyaCoalesceWindowMS = Tokenizer_GetArgInteger(0);
+		if (g_tuyaCoalesceWindowMS <= 0) {
+			// disabled, don't keep anything back
+			g_tuyaCoalesceWindowMS = 0;
+			TuyaMCU_FlushPendingDPs();
+		}
+	}
+	addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "Coalesce window %i ms, MCU latency %i ms, %i frames sent, %i updates merged, %i pending",
+		g_tuyaCoalesceWindowMS, g_tuyaAckLatencyMS, g_tuyaCoalesceFrames, g_tuyaCoalesceMerged, g_tuyaPendingDPCount);
+	return CMD_RES_OK;
+}
+
 commandResult_t Cmd_TuyaMCU_SetBatteryAckDelay(const void* context, const char* cmd, const char* args, int cmdFlags) {
 	int delay;
 
@@ -2586,6 +2817,7 @@ void TuyaMCU_RunStateMachine_BatteryPowered() {
 int timer_send = 0;
 void TuyaMCU_RunFrame() {
 	TuyaMCU_RunReceive();
+	TuyaMCU_RunCoalesce();
 
 
 	if (timer_send > 0) {
@@ -2716,6 +2948,20 @@ void TuyaMCU_Shutdown() {
 		tmp = nxt;
 	}
 	g_tuyaMappings = NULL;
+	g_tuyaPendingDPCount = 0;
+	if (g_tuyaPendingDPs) {
+		free(g_tuyaPendingDPs);
+		g_tuyaPendingDPs = NULL;
+		g_tuyaPendingDPAlloc = 0;
+	}
+	g_tuyaCoalesceWindowMS = 0;
+	g_tuyaAckWaitMS = -1;
+	g_tuyaAckLatencyMS = 0;
+	if (g_tuyaMappingsByID) {
+		free(g_tuyaMappingsByID);
+		g_tuyaMappingsByID = NULL;
+	}
+	memset(g_tuyaMappingsByChannel, 0, sizeof(g_tuyaMappingsByChannel));
 
 	// free the tuyaMCUpayloadBuffer
 	if (g_tuyaMCUpayloadBuffer) {
@@ -2863,6 +3109,12 @@ void TuyaMCU_Init()
 	//cmddetail:"fn":"Cmd_TuyaMCU_SetBatteryAckDelay","file":"driver/drv_tuyaMCU.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("tuyaMcu_setBatteryAckDelay", Cmd_TuyaMCU_SetBatteryAckDelay, NULL);
+
+	//cmddetail:{"name":"tuyaMcu_setCoalesceWindow","args":"[WindowMS]",
+	//cmddetail:"descr":"Enables coalescing of dpId updates caused by channel changes. Updates within given window (in milliseconds) are merged and sent in one frame, next frame waits for MCU answer. 0 disables (default). Without argument, prints stats.",
+	//cmddetail:"fn":"Cmd_TuyaMCU_SetCoalesceWindow","file":"driver/drv_tuyaMCU.c","requires":"",
+	//cmddetail:"examples":"tuyaMcu_setCoalesceWindow 50"}
+	CMD_RegisterCommand("tuyaMcu_setCoalesceWindow", Cmd_TuyaMCU_SetCoalesceWindow, NULL);
 	
 	//cmddetail:{"name":"tuyaMcu_enableAutoSend","args":"[0/1]",
 	//cmddetail:"descr":"Enable or disable automatic sending of commands to TuyaMCU during boot/initialization. Use 0 to disable, 1 to enable.",
@@ -43,11 +43,13 @@ typedef struct {
   int g_uart_init_counter;
 // used to detect uart manual mode
   int g_uart_manualInitCounter;
+// optional, called after bytes were appended, may be called from UART interrupt
+  void (*onReceive)(void);
 } uartbuf_t;
 
-static uartbuf_t uartbuf[UART_BUF_CNT] = { {0,0,0,0,0,-1}
+static uartbuf_t uartbuf[UART_BUF_CNT] = { {0,0,0,0,0,-1,0}
   #if UART_BUF_CNT == 2
-    , { 0,0,0,0,0,-1 } 
+    , { 0,0,0,0,0,-1,0 } 
   #endif
   };
 
@@ -121,6 +123,96 @@ void UART_ConsumeBytes(int idx) {
   UART_ConsumeBytesEx(fuartindex, idx);
 }
 
+int UART_PeekBytesEx(int auartindex, int idx, int len, uartSpan_t *span) {
+  uartbuf_t* fuartbuf = UART_GetBufFromPort(auartindex);
+  int avail = UART_GetDataSizeEx(auartindex) - idx;
+  int start, first;
+
+  span->len[0] = span->len[1] = 0;
+  span->data[0] = span->data[1] = 0;
+  if (avail <= 0 || len <= 0)
+    return 0;
+  if (len > avail)
+    len = avail;
+  start = (fuartbuf->g_recvBufOut + idx) % fuartbuf->g_recvBufSize;
+  first = fuartbuf->g_recvBufSize - start;
+  if (first > len)
+    first = len;
+  span->data[0] = fuartbuf->g_recvBuf + start;
+  span->len[0] = first;
+  if (len > first) {
+    // wrapped part starts at the beginning of the buffer
+    span->data[1] = fuartbuf->g_recvBuf;
+    span->len[1] = len - first;
+  }
+  return len;
+}
+
+int UART_PeekBytes(int idx, int len, uartSpan_t *span) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  return UART_PeekBytesEx(fuartindex, idx, len, span);
+}
+
+int UART_CopyBytesEx(int auartindex, int idx, byte *out, int len) {
+  uartSpan_t span;
+  len = UART_PeekBytesEx(auartindex, idx, len, &span);
+  memcpy(out, span.data[0], span.len[0]);
+  if (span.len[1])
+    memcpy(out + span.len[0], span.data[1], span.len[1]);
+  return len;
+}
+
+int UART_CopyBytes(int idx, byte *out, int len) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  return UART_CopyBytesEx(fuartindex, idx, out, len);
+}
+
+int UART_ReadBytesEx(int auartindex, byte *out, int len) {
+  len = UART_CopyBytesEx(auartindex, 0, out, len);
+  UART_ConsumeBytesEx(auartindex, len);
+  return len;
+}
+
+int UART_ReadBytes(byte *out, int len) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  return UART_ReadBytesEx(fuartindex, out, len);
+}
+
+int UART_FindHeaderEx(int auartindex, int idx, const byte *hdr, int hdrLen) {
+  uartbuf_t* fuartbuf = UART_GetBufFromPort(auartindex);
+  // header can only start at positions where whole header still fits
+  int limit = UART_GetDataSizeEx(auartindex) - hdrLen + 1;
+
+  while (idx < limit) {
+    int start = (fuartbuf->g_recvBufOut + idx) % fuartbuf->g_recvBufSize;
+    int run = fuartbuf->g_recvBufSize - start;
+    const byte *p;
+    int cand, i;
+
+    if (run > limit - idx)
+      run = limit - idx;
+    p = (const byte*)memchr(fuartbuf->g_recvBuf + start, hdr[0], run);
+    if (p == 0) {
+      idx += run;
+      continue;
+    }
+    cand = idx + (int)(p - (fuartbuf->g_recvBuf + start));
+    for (i = 1; i < hdrLen; i++) {
+      if (UART_GetByteEx(auartindex, cand + i) != hdr[i])
+        break;
+    }
+    if (i == hdrLen)
+      return cand;
+    idx = cand + 1;
+  }
+  return -1;
+}
+
+int UART_FindHeader(int idx, const byte *hdr, int hdrLen) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  return UART_FindHeaderEx(fuartindex, idx, hdr, hdrLen);
+}
+
 void UART_AppendByteToReceiveRingBufferEx(int auartindex, int rc) {
   uartbuf_t* fuartbuf = UART_GetBufFromPort(auartindex);
   if (fuartbuf->g_recvBufSize <= 0) {
@@ -148,6 +240,8 @@ void UART_AppendByteToReceiveRingBufferEx(int auartindex, int rc) {
       fuartbuf->g_recvBufOut++;
       fuartbuf->g_recvBufOut %= fuartbuf->g_recvBufSize;
     }
+    if (fuartbuf->onReceive)
+      fuartbuf->onReceive();
 }
 
 void UART_AppendByteToReceiveRingBuffer(int rc) {
@@ -155,6 +249,63 @@ void UART_AppendByteToReceiveRingBuffer(int rc) {
   UART_AppendByteToReceiveRingBufferEx(fuartindex, rc);
 }
 
+// bulk version of the above, for DMA/FIFO drains; same overflow policy
+void UART_AppendBytesToReceiveRingBufferEx(int auartindex, const byte *data, int len) {
+  uartbuf_t* fuartbuf = UART_GetBufFromPort(auartindex);
+  int capacity, used, first;
+
+  if (len <= 0)
+    return;
+  if (fuartbuf->g_recvBufSize <= 0) {
+      addLogAdv(LOG_ERROR, LOG_FEATURE_DRV, "UART %i not initialized",auartindex);
+      UART_InitReceiveRingBufferEx(auartindex,UART_DEFAULT_BUFIZE);
+  }
+  capacity = fuartbuf->g_recvBufSize - 1;
+  used = UART_GetDataSizeEx(auartindex);
+#ifdef UART_ALWAYSFIRSTBYTES
+  // old style, bytes that do not fit are ignored
+  if (len > capacity - used)
+    len = capacity - used;
+  if (len <= 0)
+    return;
+#else
+  // new style, only the last g_recvBufSize-1 bytes can survive
+  if (len > capacity) {
+    data += len - capacity;
+    len = capacity;
+  }
+#endif
+  first = fuartbuf->g_recvBufSize - fuartbuf->g_recvBufIn;
+  if (first > len)
+    first = len;
+  memcpy(fuartbuf->g_recvBuf + fuartbuf->g_recvBufIn, data, first);
+  if (len > first)
+    memcpy(fuartbuf->g_recvBuf, data + first, len - first);
+  fuartbuf->g_recvBufIn = (fuartbuf->g_recvBufIn + len) % fuartbuf->g_recvBufSize;
+  // drop oldest bytes that were overwritten
+  if (used + len > capacity) {
+    fuartbuf->g_recvBufOut = (fuartbuf->g_recvBufOut + used + len - capacity) % fuartbuf->g_recvBufSize;
+  }
+  if (fuartbuf->onReceive)
+    fuartbuf->onReceive();
+}
+
+void UART_AppendBytesToReceiveRingBuffer(const byte *data, int len) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  UART_AppendBytesToReceiveRingBufferEx(fuartindex, data, len);
+}
+
+// lets a driver sleep until data comes instead of polling, NULL to remove
+void UART_SetReceiveCallbackEx(int auartindex, void (*cb)(void)) {
+  uartbuf_t* fuartbuf = UART_GetBufFromPort(auartindex);
+  fuartbuf->onReceive = cb;
+}
+
+void UART_SetReceiveCallback(void (*cb)(void)) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  UART_SetReceiveCallbackEx(fuartindex, cb);
+}
+
 void UART_SendByteEx(int auartindex, byte b) {
 #ifdef UART_2_UARTS_CONCURRENT
   HAL_UART_SendByteEx(auartindex, b);
@@ -168,6 +319,21 @@ void UART_SendByte(byte b) {
   UART_SendByteEx(fuartindex, b);
 }
 
+void UART_SendBytesEx(int auartindex, const byte *data, int len) {
+  if (len <= 0)
+    return;
+#ifdef UART_2_UARTS_CONCURRENT
+  HAL_UART_SendBytesEx(auartindex, data, len);
+#else
+  HAL_UART_SendBytes(data, len);
+#endif
+}
+
+void UART_SendBytes(const byte *data, int len) {
+  int fuartindex = UART_GetSelectedPortIndex();
+  UART_SendBytesEx(fuartindex, data, len);
+}
+
 commandResult_t CMD_UART_Send_Hex(const void *context, const char *cmd, const char *args, int cmdFlags) {
     if (!(*args)) {
 		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "CMD_UART_Send_Hex: requires 1 argument (hex string, like FFAABB00CCDD");
@@ -11,7 +11,11 @@ int UART_GetDataSize();
 byte UART_GetByte(int idx);
 void UART_ConsumeBytes(int idx);
 void UART_AppendByteToReceiveRingBuffer(int rc);
+void UART_AppendBytesToReceiveRingBuffer(const byte *data, int len);
 void UART_SendByte(byte b);
+void UART_SendBytes(const byte *data, int len);
+// cb is called after bytes were added to receive buffer, may be from interrupt
+void UART_SetReceiveCallback(void (*cb)(void));
 int UART_InitUART(int baud, int parity, bool hwflowc);
 void UART_AddCommands();
 void UART_RunEverySecond();
@@ -21,6 +25,26 @@ int get_g_uart_init_counter();
 // used to get selected port from config - OBK_FLAG_USE_SECONDARY_UART
 int UART_GetSelectedPortIndex();
 
+//---------------------------------------------------
+// Bulk ring buffer access for protocol drivers.
+// Ring buffer data is stored in at most two contiguous
+// parts (before and after wrap), so instead of calling
+// UART_GetByte for each byte you can get both parts at once.
+//---------------------------------------------------
+typedef struct uartSpan_s {
+	const byte *data[2];
+	int len[2];
+} uartSpan_t;
+
+// zero copy view of up to len bytes starting at idx, returns total bytes in span
+int UART_PeekBytes(int idx, int len, uartSpan_t *span);
+// copies up to len bytes starting at idx, without consuming them
+int UART_CopyBytes(int idx, byte *out, int len);
+// copies up to len bytes from the start and consumes them
+int UART_ReadBytes(byte *out, int len);
+// returns index of first full header occurrence at or after idx, or -1
+int UART_FindHeader(int idx, const byte *hdr, int hdrLen);
+
 //---------------------------------------------------
 // XJIKKA 20241123 new routines with uart index param 
 // BEKEN platform only (yet)
@@ -35,11 +59,18 @@ int UART_GetSelectedPortIndex();
 int UART_GetBufIndexFromPort(int aport);
 void UART_InitReceiveRingBufferEx(int auartindex, int size);
 void UART_AppendByteToReceiveRingBufferEx(int auartindex, int rc);
+void UART_AppendBytesToReceiveRingBufferEx(int auartindex, const byte *data, int len);
 int UART_GetReceiveRingBufferSizeEx(int auartindex);
 int UART_GetDataSizeEx(int auartindex);
 byte UART_GetByteEx(int auartindex, int idx);
 void UART_ConsumeBytesEx(int auartindex, int idx);
+int UART_PeekBytesEx(int auartindex, int idx, int len, uartSpan_t *span);
+int UART_CopyBytesEx(int auartindex, int idx, byte *out, int len);
+int UART_ReadBytesEx(int auartindex, byte *out, int len);
+int UART_FindHeaderEx(int auartindex, int idx, const byte *hdr, int hdrLen);
 void UART_SendByteEx(int auartindex, byte b);
+void UART_SendBytesEx(int auartindex, const byte *data, int len);
+void UART_SetReceiveCallbackEx(int auartindex, void (*cb)(void));
 int UART_InitUARTEx(int auartindex, int baud, int parity, bool hwflowc);
 void UART_LogBufState(int auartindex);
 
@@ -12,6 +12,8 @@
 
 #define DEFAULT_BUF_SIZE		512
 #define DEFAULT_UART_TCP_PORT	8888
+// UART bytes wait that long for more to come, so they go in one TCP packet
+#define DEFAULT_FLUSH_MS		2
 #define INVALID_SOCK			-1
 #ifndef UTCP_DEBUG
 #define UTCP_DEBUG				0
@@ -25,6 +27,7 @@ extern int Main_HasWiFiConnected();
 static uint16_t buf_size = DEFAULT_BUF_SIZE;
 static int g_conn_channel = -1;
 static int g_baudRate = 115200;
+static int g_flushMs = DEFAULT_FLUSH_MS;
 static int listen_sock = INVALID_SOCK;
 static int client_sock = INVALID_SOCK;
 static xTaskHandle g_start_thread = NULL;
@@ -32,62 +35,117 @@ static xTaskHandle g_trx_thread = NULL;
 static xTaskHandle g_rx_thread = NULL;
 static xTaskHandle g_tx_thread = NULL;
 static bool rx_closed, tx_closed;
-static byte* g_utcpBuf = 0;
+// given by UART receive callback, TX thread sleeps on it instead of polling
+static SemaphoreHandle_t g_uartDataSem = NULL;
+
+// counters for UartTCPStats
+static uint32_t g_bytesToTCP = 0;
+static uint32_t g_bytesToUART = 0;
+static uint32_t g_tcpSends = 0;
+// from first UART byte of a packet seen to its TCP send
+static uint32_t g_latencySumMs = 0;
+static uint32_t g_latencyMaxMs = 0;
 
 void Start_UART_TCP(void* arg);
 void UART_TCP_Deinit();
 
-static void UTCP_TX_Thd(void* param)
+static uint32_t UTCP_GetTimeMs()
 {
-	int client_fd = *(int*)param;
+	return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
 
-	while(1)
-	{
-		int ret = 0;
-		int delay = 0;
-		memset(g_utcpBuf, 0, buf_size);
-		int len = UART_GetDataSize();
+// called from UART interrupt
+static void UTCP_OnUARTReceive()
+{
+	xSemaphoreGiveFromISR(g_uartDataSem, NULL);
+}
 
-		if(client_fd == INVALID_SOCK) goto exit;
-		while(len < buf_size && delay < 10)
-		{
-			rtos_delay_milliseconds(1);
-			len = UART_GetDataSize();
-			delay++;
-		}
+// sleeps until UART gets more data or ms pass
+static void UTCP_WaitForUART(int ms)
+{
+	TickType_t ticks = (ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
 
-		if(len > 0)
-		{
-			for(int i = 0; i < len; i++)
-			{
-				g_utcpBuf[i] = UART_GetByte(i);
-			}
-			UART_ConsumeBytes(len);
+	if(ticks == 0) ticks = 1;
+	xSemaphoreTake(g_uartDataSem, ticks);
+}
+
+// sends both parts of ring buffer straight from it, without copying
+static int UTCP_SendSpan(int client_fd, int len)
+{
+	uartSpan_t span;
+	int i, ret, sent = 0;
+
+	UART_PeekBytes(0, len, &span);
+	for(i = 0; i < 2 && span.len[i] > 0; i++)
+	{
 #if UTCP_DEBUG
-			char data[len * 2];
-			char* p = data;
-			for(int i = 0; i < len; i++)
-			{
-				sprintf(p, "%02X", g_utcpBuf[i]);
-				p += 2;
-			}
-			ADDLOG_EXTRADEBUG(LOG_FEATURE_DRV, "%d bytes UART RX->TCP TX: %s", len, data);
-#endif
-			ret = send(client_fd, g_utcpBuf, len, 0);
+		char data[span.len[i] * 2 + 1];
+		char* p = data;
+		for(int j = 0; j < span.len[i]; j++)
+		{
+			sprintf(p, "%02X", span.data[i][j]);
+			p += 2;
 		}
-		else
+		ADDLOG_EXTRADEBUG(LOG_FEATURE_DRV, "%d bytes UART RX->TCP TX: %s", span.len[i], data);
+#endif
+		ret = send(client_fd, span.data[i], span.len[i], 0);
+		if(ret <= 0)
+			return -1;
+		UART_ConsumeBytes(ret);
+		sent += ret;
+		// rest goes in next loop
+		if(ret < span.len[i])
+			break;
+	}
+	return sent;
+}
+
+static void UTCP_TX_Thd(void* param)
+{
+	int client_fd = *(int*)param;
+	bool bWaiting = false;
+	uint32_t firstSeen = 0;
+	uint32_t now, latency;
+	int len, ret;
+
+	if(client_fd == INVALID_SOCK) goto exit;
+	while(1)
+	{
+		len = UART_GetDataSize();
+		if(len == 0)
 		{
 			if(rx_closed)
 			{
 				goto exit;
 			}
+			// wake up sometimes to see if RX side closed
+			UTCP_WaitForUART(100);
 			continue;
 		}
-
-		if(ret <= 0)
+		now = UTCP_GetTimeMs();
+		if(!bWaiting)
+		{
+			bWaiting = true;
+			firstSeen = now;
+		}
+		// like Nagle, don't send a packet per byte while more keeps coming
+		if(len < buf_size && (int)(now - firstSeen) < g_flushMs)
+		{
+			UTCP_WaitForUART(g_flushMs - (int)(now - firstSeen));
+			continue;
+		}
+		if(len > buf_size) len = buf_size;
+		ret = UTCP_SendSpan(client_fd, len);
+		if(ret < 0)
 			goto exit;
 
-		rtos_delay_milliseconds(5);
+		latency = UTCP_GetTimeMs() - firstSeen;
+		g_latencySumMs += latency;
+		if(latency > g_latencyMaxMs)
+			g_latencyMaxMs = latency;
+		g_bytesToTCP += ret;
+		g_tcpSends++;
+		bWaiting = false;
 	}
 
 exit:
@@ -100,17 +158,32 @@ static void UTCP_RX_Thd(void* param)
 {
 	int client_fd = *(int*)param;
 	unsigned char buffer[1024];
+	struct timeval tv;
+	fd_set readfds;
 
 	while(1)
 	{
 		int ret = 0;
 
 		if(client_fd == INVALID_SOCK) goto exit;
-		ret = recv(client_fd, buffer, sizeof(buffer), 0);
+		// sleep until there is data, wake up sometimes to see if TX side closed
+		FD_ZERO(&readfds);
+		FD_SET(client_fd, &readfds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		ret = select(client_fd + 1, &readfds, NULL, NULL, &tv);
+		if(ret == 0)
+		{
+			if(tx_closed)
+				goto exit;
+			continue;
+		}
+		if(ret > 0)
+			ret = recv(client_fd, buffer, sizeof(buffer), 0);
 		if(ret > 0)
 		{
 #if UTCP_DEBUG
-			char data[ret * 2];
+			char data[ret * 2 + 1];
 			char* p = data;
 			for(int i = 0; i < ret; i++)
 			{
@@ -119,26 +192,16 @@ static void UTCP_RX_Thd(void* param)
 			}
 			ADDLOG_EXTRADEBUG(LOG_FEATURE_DRV, "%d bytes TCP RX->UART TX: %s", ret, data);
 #endif
-			for(int i = 0; i < ret; i++)
-			{
-				UART_SendByte(buffer[i]);
-			}
-		}
-		else if(tx_closed)
-		{
-			goto exit;
+			UART_SendBytes(buffer, ret);
+			g_bytesToUART += ret;
+			continue;
 		}
 
 		// ret == -1 and socket error == EAGAIN when no data received for nonblocking
 		if((ret == -1) && (errno == EAGAIN))
 			continue;
-		else if(ret <= 0)
-		{
-			ADDLOG_DEBUG(LOG_FEATURE_DRV, "ret: %i, errno: %i", ret, errno);
-			goto exit;
-		}
-
-		rtos_delay_milliseconds(5);
+		ADDLOG_DEBUG(LOG_FEATURE_DRV, "ret: %i, errno: %i", ret, errno);
+		goto exit;
 	}
 
 exit:
@@ -275,8 +338,7 @@ error:
 void Start_UART_TCP(void* arg)
 {
 	UART_TCP_Deinit();
-
-	g_utcpBuf = (byte*)os_malloc(buf_size);
+	UART_SetReceiveCallback(UTCP_OnUARTReceive);
 
 	OSStatus err = rtos_create_thread(&g_trx_thread, BEKEN_APPLICATION_PRIORITY,
 		"UART_TCP_TRX",
@@ -290,8 +352,34 @@ void Start_UART_TCP(void* arg)
 	rtos_suspend_thread(NULL);
 }
 
-// startDriver UartTCP [baudrate] [buffer size] [connection channel] [hw flow control]
+static commandResult_t CMD_UART_TCP_Flush(const void* context, const char* cmd, const char* args, int cmdFlags)
+{
+	Tokenizer_TokenizeString(args, 0);
+	if(Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1))
+	{
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+	g_flushMs = Tokenizer_GetArgInteger(0);
+	if(g_flushMs < 0) g_flushMs = 0;
+	return CMD_RES_OK;
+}
+
+static commandResult_t CMD_UART_TCP_Stats(const void* context, const char* cmd, const char* args, int cmdFlags)
+{
+	ADDLOG_INFO(LOG_FEATURE_DRV, "UART->TCP %u bytes in %u sends, latency avg %u ms max %u ms, TCP->UART %u bytes",
+		g_bytesToTCP, g_tcpSends, g_tcpSends ? g_latencySumMs / g_tcpSends : 0, g_latencyMaxMs, g_bytesToUART);
+	Tokenizer_TokenizeString(args, 0);
+	if(Tokenizer_GetArgIntegerDefault(0, 0))
+	{
+		g_bytesToTCP = g_bytesToUART = g_tcpSends = 0;
+		g_latencySumMs = g_latencyMaxMs = 0;
+	}
+	return CMD_RES_OK;
+}
+
+// startDriver UartTCP [baudrate] [buffer size] [connection channel] [hw flow control] [flush ms]
 // connection is for led, -1 if not used.
+// flush ms is how long UART bytes may wait for more, 0 sends them as soon as seen.
 // Sample:
 // startDriver UartTCP 115200 8192
 // Then connect to 8888
@@ -304,9 +392,25 @@ void UART_TCP_Init()
 	buf_size = reqbufsize > 16384 ? 16384 : reqbufsize;
 	g_conn_channel = Tokenizer_GetArgIntegerDefault(3, -1);
 	int flowcontrol = Tokenizer_GetArgIntegerDefault(4, 0);
+	g_flushMs = Tokenizer_GetArgIntegerDefault(5, DEFAULT_FLUSH_MS);
+
+	//cmddetail:{"name":"UartTCPFlush","args":"[Milliseconds]",
+	//cmddetail:"descr":"Sets how long UART bytes wait for more before being sent over TCP. Lower is less latency, higher is fewer and bigger packets. 0 sends at once.",
+	//cmddetail:"fn":"CMD_UART_TCP_Flush","file":"driver/drv_uart_tcp.c","requires":"ENABLE_DRIVER_UART_TCP",
+	//cmddetail:"examples":"UartTCPFlush 10"}
+	CMD_RegisterCommand("UartTCPFlush", CMD_UART_TCP_Flush, NULL);
+	//cmddetail:{"name":"UartTCPStats","args":"[Reset]",
+	//cmddetail:"descr":"Prints bytes bridged both ways and UART to TCP latency. Pass 1 to reset counters after printing.",
+	//cmddetail:"fn":"CMD_UART_TCP_Stats","file":"driver/drv_uart_tcp.c","requires":"ENABLE_DRIVER_UART_TCP",
+	//cmddetail:"examples":"UartTCPStats 1"}
+	CMD_RegisterCommand("UartTCPStats", CMD_UART_TCP_Stats, NULL);
 
 	UART_InitUART(g_baudRate, 0, flowcontrol > 0 ? true : false);
 	UART_InitReceiveRingBuffer(buf_size * 2);
+	if(g_uartDataSem == NULL)
+	{
+		g_uartDataSem = xSemaphoreCreateBinary();
+	}
 
 	if(g_start_thread != NULL)
 	{
@@ -342,10 +446,9 @@ void UART_TCP_Deinit()
 		rtos_delete_thread(&g_tx_thread);
 		g_tx_thread = NULL;
 	}
-	if(g_utcpBuf) free(g_utcpBuf);
-
 	if(listen_sock != INVALID_SOCK) close(listen_sock);
 	if(client_sock != INVALID_SOCK) close(client_sock);
+	UART_SetReceiveCallback(NULL);
 }
 
 #endif
\ No newline at end of file
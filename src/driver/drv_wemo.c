@@ -155,15 +155,43 @@ const char *g_wemo_response_2_fmt =
 static char *g_serial = 0;
 static char *g_uid = 0;
 static int outBufferLen = 0;
-static char *buffer_out = 0;
+// rendered replies to searches for urn:Belkin:device:** and upnp:rootdevice
+static char *buffer_out[2] = { 0, 0 };
+// SSDP render version they were made for
+static int buffer_out_version = -1;
 static int stat_searchesReceived = 0;
 static int stat_setupXMLVisits = 0;
 static int stat_metaServiceXMLVisits = 0;
 static int stat_eventsReceived = 0;
 static int stat_eventServiceXMLVisits = 0;
 
-void DRV_WEMO_Send_Advert_To(int mode, struct sockaddr_in *addr) {
+static void WEMO_RenderAdverts() {
 	const char *useType;
+	int i;
+
+	if (outBufferLen == 0) {
+		outBufferLen = strlen(g_wemo_msearch) + 256;
+	}
+	for (i = 0; i < 2; i++) {
+		if (buffer_out[i] == 0) {
+			buffer_out[i] = (char*)malloc(outBufferLen);
+			if (buffer_out[i] == 0) {
+				return;
+			}
+		}
+		if (i == 0) {
+			useType = "urn:Belkin:device:**";
+		}
+		else {
+			useType = "upnp:rootdevice";
+		}
+		snprintf(buffer_out[i], outBufferLen, g_wemo_msearch, HAL_GetMyIPString(), useType, g_uid, useType);
+	}
+	buffer_out_version = DRV_SSDP_GetRenderVersion();
+}
+
+void DRV_WEMO_Send_Advert_To(int mode, struct sockaddr_in *addr) {
+	int idx = (mode == 1) ? 0 : 1;
 
 	if (g_uid == 0) {
 		// not running
@@ -172,23 +200,14 @@ void DRV_WEMO_Send_Advert_To(int mode, struct sockaddr_in *addr) {
 
 	stat_searchesReceived++;
 
-	if (mode == 1) {
-		useType = "urn:Belkin:device:**";
-	}
-	else {
-		useType = "upnp:rootdevice";
+	if (buffer_out_version != DRV_SSDP_GetRenderVersion()) {
+		WEMO_RenderAdverts();
 	}
-
-	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP, "WEMO - sends reply %s",useType);
-
-	if (buffer_out == 0) {
-		outBufferLen = strlen(g_wemo_msearch) + 256;
-		buffer_out = (char*)malloc(outBufferLen);
+	if (buffer_out[idx] == 0) {
+		return;
 	}
-	snprintf(buffer_out, outBufferLen, g_wemo_msearch, HAL_GetMyIPString(), useType, g_uid, useType);
-
-	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP, "WEMO - Sending %s", buffer_out);
-	DRV_SSDP_SendReply(addr, buffer_out);
+	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_HTTP, "WEMO - sends reply %i", mode);
+	DRV_SSDP_SendReply(addr, buffer_out[idx]);
 }
 
 void WEMO_AppendInformationToHTTPIndexPage(http_request_t* request, int bPreState) {
@@ -312,6 +331,8 @@ void WEMO_Init() {
 
 	g_serial = strdup(serial);
 	g_uid = strdup(uid);
+	// uid may have changed
+	buffer_out_version = -1;
 
 	HTTP_RegisterCallback("/upnp/control/basicevent1", HTTP_POST, WEMO_BasicEvent1, 0);
 	HTTP_RegisterCallback("/eventservice.xml", HTTP_GET, WEMO_EventService, 0);
@@ -188,7 +188,8 @@ char *http_buf = (void *)0;
 
 void otarequest(const char *urlin){
   httprequest_t *request = &httprequest;
-  if (request->state == 1){
+  // memset below would unlink it from the client queue
+  if (request->state == 1 || HTTPClient_IsRequestBusy(request)){
     addLogAdv(LOG_INFO, LOG_FEATURE_OTA,"********************http in progress, not starting another");
     return;
   }
@@ -28,6 +28,11 @@ void HAL_UART_SendByteEx(int auartindex, byte b)
 	bk_send_byte(bk_port_from_portindex(auartindex), b);
 }
 
+void HAL_UART_SendBytesEx(int auartindex, const byte *data, int len)
+{
+	bk_uart_send(bk_port_from_portindex(auartindex), data, len);
+}
+
 int HAL_UART_InitEx(int auartindex, int baud, int parity, bool hwflowc, int txOverride, int rxOverride)
 {
     bk_uart_config_t config;
@@ -3,6 +3,14 @@
 void __attribute__((weak)) HAL_UART_SendByte(byte b)
 {
 
+}
+void __attribute__((weak)) HAL_UART_SendBytes(const byte *data, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		HAL_UART_SendByte(data[i]);
+	}
 }
 int __attribute__((weak)) HAL_UART_Init(int baud, int parity, bool hwflowc, int txOverride, int rxOverride)
 {
@@ -7,10 +7,13 @@
 
 #ifdef UART_2_UARTS_CONCURRENT
 void HAL_UART_SendByteEx(int auartindex, byte b);
+void HAL_UART_SendBytesEx(int auartindex, const byte *data, int len);
 
 int HAL_UART_InitEx(int auartindex, int baud, int parity, bool hwflowc, int txOverride, int rxOverride);
 #else
 void HAL_UART_SendByte(byte b);
+// platforms without bulk write get a loop over HAL_UART_SendByte
+void HAL_UART_SendBytes(const byte *data, int len);
 
 int HAL_UART_Init(int baud, int parity, bool hwflowc, int txOverride, int rxOverride);
 #endif
\ No newline at end of file
@@ -18,12 +18,17 @@ int g_simulatedPinStates[PLATFORM_GPIO_MAX];
 int g_simulatedPWMs[PLATFORM_GPIO_MAX];
 simulatedPinMode_t g_pinModes[PLATFORM_GPIO_MAX];
 int g_simulatedADCValues[PLATFORM_GPIO_MAX];
+OBKInterruptHandler g_simulatedHandlers[PLATFORM_GPIO_MAX];
+OBKInterruptType g_simulatedInterruptModes[PLATFORM_GPIO_MAX];
+int g_simulatedDigitalReads[PLATFORM_GPIO_MAX];
 
 void SIM_Hack_ClearSimulatedPinRoles() {
 	memset(g_simulatedPinStates, 0, sizeof(g_simulatedPinStates));
 	memset(g_simulatedPWMs, 0, sizeof(g_simulatedPWMs));
 	memset(g_pinModes, 0, sizeof(g_pinModes));
 	memset(g_simulatedADCValues, 0, sizeof(g_simulatedADCValues));
+	memset(g_simulatedHandlers, 0, sizeof(g_simulatedHandlers));
+	memset(g_simulatedDigitalReads, 0, sizeof(g_simulatedDigitalReads));
 }
 
 static int adcToGpio[] = {
@@ -57,7 +62,24 @@ int HAL_ADC_Read(int pinNumber) {
 	return g_simulatedADCValues[pinNumber];
 }
 void SIM_SetSimulatedPinValue(int pinIndex, bool bHigh) {
+	OBKInterruptType mode;
+	bool bWasHigh;
+
+	bWasHigh = g_simulatedPinStates[pinIndex] != 0;
 	g_simulatedPinStates[pinIndex] = bHigh;
+	if (g_simulatedHandlers[pinIndex] == 0 || bWasHigh == bHigh) {
+		return;
+	}
+	// like a real GPIO interrupt, handler runs right at the edge
+	mode = g_simulatedInterruptModes[pinIndex];
+	if (mode == INTERRUPT_CHANGE || (mode == INTERRUPT_RISING && bHigh)
+		|| (mode == INTERRUPT_FALLING && !bHigh)) {
+		g_simulatedHandlers[pinIndex](pinIndex);
+	}
+}
+// lets tests check that pins are not polled
+int SIM_GetDigitalReadsCount(int pinIndex) {
+	return g_simulatedDigitalReads[pinIndex];
 }
 bool SIM_GetSimulatedPinValue(int pinIndex) {
 	return g_simulatedPinStates[pinIndex];
@@ -198,6 +220,7 @@ void HAL_PIN_SetOutputValue(int index, int iVal) {
 }
 
 int HAL_PIN_ReadDigitalInput(int index) {
+	g_simulatedDigitalReads[index]++;
 	return g_simulatedPinStates[index];
 }
 void HAL_PIN_Setup_Input_Pullup(int index) {
@@ -233,10 +256,11 @@ unsigned int HAL_GetGPIOPin(int index) {
 }
 
 void HAL_AttachInterrupt(int pinIndex, OBKInterruptType mode, OBKInterruptHandler function) {
-
+	g_simulatedInterruptModes[pinIndex] = mode;
+	g_simulatedHandlers[pinIndex] = function;
 }
 void HAL_DetachInterrupt(int pinIndex) {
-
+	g_simulatedHandlers[pinIndex] = 0;
 }
 
 
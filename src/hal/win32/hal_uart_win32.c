@@ -13,6 +13,19 @@ void HAL_UART_SendByte(byte b)
 	//addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU,"%02X", b);
 }
 
+void HAL_UART_SendBytes(const byte *data, int len)
+{
+	void SIM_AppendUARTBytes(const byte *data, int len);
+	int i;
+
+	SIM_AppendUARTBytes(data, len);
+#if 1
+	for (i = 0; i < len; i++) {
+		printf("%02X", data[i]);
+	}
+#endif
+}
+
 int HAL_UART_Init(int baud, int parity, bool hwflowc, int txOverride, int rxOverride)
 {
 	return 1;
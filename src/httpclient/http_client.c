@@ -18,6 +18,7 @@
 void httpclient_freeMemory(httprequest_t *request);
 static int g_httpClientTestFailPoint = HTTPCLIENT_TEST_FAIL_NONE;
 static int g_httpClientTestSkipAsyncThread = 0;
+static int g_httpClientTestHoldQueue = 0;
 static httprequest_t *g_httpClientTestLastRequest = 0;
 
 void HTTPClient_Test_SetFailPoint(int failPoint) {
@@ -26,6 +27,9 @@ void HTTPClient_Test_SetFailPoint(int failPoint) {
 void HTTPClient_Test_SetSkipAsyncThread(int bSkip) {
 	g_httpClientTestSkipAsyncThread = bSkip;
 }
+void HTTPClient_Test_SetHoldQueue(int bHold) {
+	g_httpClientTestHoldQueue = bHold;
+}
 httprequest_t *HTTPClient_Test_GetLastRequest(void) {
 	return g_httpClientTestLastRequest;
 }
@@ -39,13 +43,13 @@ void HTTPClient_Test_FreeLastRequest(void) {
 	}
 }
 static void *HTTPClient_Test_Malloc(int failPoint, size_t size) {
-	if (g_httpClientTestFailPoint == failPoint) {
+	if (failPoint != HTTPCLIENT_TEST_FAIL_NONE && g_httpClientTestFailPoint == failPoint) {
 		return 0;
 	}
 	return malloc(size);
 }
 static char *HTTPClient_Test_ExpandingStrdup(int failPoint, const char *s) {
-	if (g_httpClientTestFailPoint == failPoint) {
+	if (failPoint != HTTPCLIENT_TEST_FAIL_NONE && g_httpClientTestFailPoint == failPoint) {
 		return 0;
 	}
 	return CMD_ExpandingStrdup(s);
@@ -743,6 +747,7 @@ int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_
     int crlf_pos;
     iotx_time_t timer;
     char *crlf_ptr;
+    int minor = 0;
 
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
@@ -759,11 +764,13 @@ int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_
     data[crlf_pos] = '\0';
 
     /* Parse HTTP response */
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
+    if (sscanf(data, "HTTP/%*d.%d %d %*[^\r\n]", &minor, &(client->response_code)) != 2) {
         /* Cannot match string, error */
         ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "Not a correct HTTP answer: %s", data);
         return ERROR_HTTP_UNRESOLVED_DNS;
     }
+    // HTTP/1.0 server closes connection unless told otherwise
+    client_data->is_close = (minor == 0);
 
     if ((client->response_code < 200) || (client->response_code >= 400)) {
         /* Did not return a 2xx code; TODO fetch headers/(&data?) anyway and implement a mean of writing/reading headers */
@@ -827,6 +834,8 @@ int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_
                     client_data->response_content_len = 0;
                     client_data->retrieve_len = 0;
                 }
+            } else if (!stricmp(key, "Connection")) {
+                client_data->is_close = !stricmp(value, "close");
             }
             memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
             len -= (crlf_pos + 2);
@@ -1052,9 +1061,123 @@ iotx_err_t iotx_post(
 //
 //    	ADDLOG_INFO(LOG_FEATURE_HTTP_CLIENT, s);
 //}
-static void httprequest_thread( beken_thread_arg_t arg )
+// Requests are executed one by one by a single worker thread, so a burst of
+// SendGet/SendPost doesn't create a thread (and a stack) per request.
+// Worker is started with the first request and exits when queue is empty
+// and no keep-alive connection is left open.
+#define HTTPCLIENT_QUEUE_MAX		8
+#define HTTPCLIENT_MAX_CONNECTIONS	2
+// close idle connection before server does, most servers keep it for 5 seconds or more
+#define HTTPCLIENT_KEEPALIVE_MS		4000
+
+typedef struct httpclientConnection_s {
+	char host[HTTPCLIENT_MAX_HOST_LEN];
+	int port;
+	utils_network_t net;
+	unsigned int lastUsed;
+} httpclientConnection_t;
+
+extern unsigned int g_timeMs;
+
+static SemaphoreHandle_t g_httpClientMutex = 0;
+static httprequest_t *g_httpClientQueue = 0;
+// caller owned request being run by worker, already out of the queue,
+// self freeing ones are never sent twice so they are not tracked
+static httprequest_t *g_httpClientInFlight = 0;
+static int g_httpClientWorkerRunning = 0;
+static httpclient_stats_t g_httpClientStats;
+// only touched by worker thread
+static httpclientConnection_t g_httpClientConnections[HTTPCLIENT_MAX_CONNECTIONS];
+
+int HTTPClient_CB_Data(struct httprequest_t_tag *request);
+
+static bool HTTPClient_Mutex_Take(int del) {
+	if (g_httpClientMutex == 0) {
+		g_httpClientMutex = xSemaphoreCreateMutex();
+	}
+	return xSemaphoreTake(g_httpClientMutex, del) == pdTRUE;
+}
+static void HTTPClient_Mutex_Free() {
+	xSemaphoreGive(g_httpClientMutex);
+}
+
+void HTTPClient_GetStats(httpclient_stats_t *stats) {
+	*stats = g_httpClientStats;
+}
+
+// Take kept-alive connection to given host, if there is one still open.
+// Connection is removed from the pool while request uses it.
+static bool HTTPClient_Pool_Take(const char *host, int port, const char *ca_crt, utils_network_t *net) {
+	httpclientConnection_t *c;
+	int i;
+
+	if (ca_crt) {
+		return false;
+	}
+	for (i = 0; i < HTTPCLIENT_MAX_CONNECTIONS; i++) {
+		c = &g_httpClientConnections[i];
+		if (c->net.handle == 0 || c->port != port || strcmp(c->host, host)) {
+			continue;
+		}
+		if (HAL_TCP_IsAlive(c->net.handle) == 0) {
+			ADDLOG_INFO(LOG_FEATURE_HTTP_CLIENT, "kept connection to %s was closed by server", host);
+			c->net.doDisconnect(&c->net);
+			c->net.handle = 0;
+			return false;
+		}
+		*net = c->net;
+		c->net.handle = 0;
+		return true;
+	}
+	return false;
+}
+// Keep connection for next request, replacing the least recently used one if pool is full.
+static void HTTPClient_Pool_Put(const char *host, int port, utils_network_t *net) {
+	httpclientConnection_t *c;
+	int i;
+
+	c = &g_httpClientConnections[0];
+	for (i = 0; i < HTTPCLIENT_MAX_CONNECTIONS; i++) {
+		if (g_httpClientConnections[i].net.handle == 0) {
+			c = &g_httpClientConnections[i];
+			break;
+		}
+		if (g_httpClientConnections[i].lastUsed < c->lastUsed) {
+			c = &g_httpClientConnections[i];
+		}
+	}
+	if (c->net.handle) {
+		c->net.doDisconnect(&c->net);
+	}
+	strcpy_safe(c->host, host, sizeof(c->host));
+	c->port = port;
+	c->net = *net;
+	c->net.pHostAddress = c->host;
+	c->lastUsed = g_timeMs;
+}
+// returns number of connections still open
+static int HTTPClient_Pool_CloseIdle() {
+	httpclientConnection_t *c;
+	int i, open;
+
+	open = 0;
+	for (i = 0; i < HTTPCLIENT_MAX_CONNECTIONS; i++) {
+		c = &g_httpClientConnections[i];
+		if (c->net.handle == 0) {
+			continue;
+		}
+		if (g_timeMs - c->lastUsed > HTTPCLIENT_KEEPALIVE_MS) {
+			c->net.doDisconnect(&c->net);
+			c->net.handle = 0;
+			continue;
+		}
+		open++;
+	}
+	return open;
+}
+
+static void httprequest_run(httprequest_t *request)
 {
-    httprequest_t *request = (httprequest_t *)arg;
     iotx_time_t timer;
     int ret = 0;
     char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
@@ -1067,25 +1190,18 @@ static void httprequest_thread( beken_thread_arg_t arg )
     httpclient_data_t *client_data = &request->client_data;
     int method = request->method;
     int timeout_ms = request->timeout;
-
-    //addLog("start request thread");
-    //rtos_delay_milliseconds(500);
-
+    bool bReused;
+    bool bAborted = false;
+    bool bKeepAlive = false;
 
     if (header && header[0]){
         HTTPClient_SetCustomHeader(client, header);  //Sets the custom header if needed.
     }
 
-    //addLog("after HTTPClient_SetCustomHeader");
-    //rtos_delay_milliseconds(500);
-
-
     request->state = 0;
 
     if (0 == client->net.handle) {
         //Establish connection if no.
-        //addLog("before httpclient_parse_host");
-        //rtos_delay_milliseconds(500);
     	ret = httpclient_parse_host(url, host, &port, sizeof(host));
 
         if (ret != SUCCESS_RETURN){
@@ -1097,38 +1213,44 @@ static void httprequest_thread( beken_thread_arg_t arg )
         }
 
     	ADDLOG_INFO(LOG_FEATURE_HTTP_CLIENT, "host: '%s', port: %d", host, port);
-        //rtos_delay_milliseconds(500);
-
-    	iotx_net_init(&client->net, host, port, ca_crt);
-        //addLog("after iotx_net_init");
-        //rtos_delay_milliseconds(500);
 
-    	ret = httpclient_connect(client);
-        //addLog("after httpclient_connect %d", ret);
-        //rtos_delay_milliseconds(500);
-    	if (0 != ret) {
-            ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient_connect is error,ret = %d", ret);
-            httpclient_close(client);
-            request->state = -1;
-            if (request->data_callback){
-                request->data_callback(request);
+        bReused = HTTPClient_Pool_Take(host, port, ca_crt, &client->net);
+        while (1) {
+            if (bReused == false) {
+                iotx_net_init(&client->net, host, port, ca_crt);
+                ret = httpclient_connect(client);
+                if (0 != ret) {
+                    ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient_connect is error,ret = %d", ret);
+                    httpclient_close(client);
+                    request->state = -1;
+                    if (request->data_callback){
+                        request->data_callback(request);
+                    }
+                    goto exit;
+                }
+            }
+            ret = httpclient_send_request(client, url, method, client_data);
+            if (0 == ret) {
+                break;
             }
-            goto exit;
-    	}
-
-        ret = httpclient_send_request(client, url, method, client_data);
-        if (0 != ret) {
             ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient_send_request is error,ret = %d", ret);
             httpclient_close(client);
-            request->state = -1;
-            if (request->data_callback){
-                request->data_callback(request);
+            if (bReused == false) {
+                request->state = -1;
+                if (request->data_callback){
+                    request->data_callback(request);
+                }
+                goto exit;
             }
-            goto exit;
+            // kept connection went stale, try again with a new one
+            bReused = false;
+        }
+        if (bReused) {
+            g_httpClientStats.reused++;
+        } else {
+            g_httpClientStats.connects++;
         }
     }
-    //addLog("httpclient_connect ret = %d", ret);
-    //rtos_delay_milliseconds(500);
     request->state = 0;  // start
     request->client_data.response_buf_filled = 0;
     if (request->data_callback){
@@ -1138,16 +1260,11 @@ static void httprequest_thread( beken_thread_arg_t arg )
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
 
-    //addLog("rx buflen %d", client_data->response_buf_len);
-    //rtos_delay_milliseconds(500);
-
     if ((NULL != client_data->response_buf)
          && (0 != client_data->response_buf_len)) {
         do {
             // parse headers, fill client_data->response_buf up to max client_data->response_buf_len-1
             ret = httpclient_recv_response(client, iotx_time_left(&timer), client_data);
-            //addLog("httpclient_recv_response is ret = %d is_more %d", ret, client_data->is_more);
-            //rtos_delay_milliseconds(500);
             if (ret < 0) {
                 ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient_recv_response is error,ret = %d", ret);
                 httpclient_close(client);
@@ -1160,66 +1277,245 @@ static void httprequest_thread( beken_thread_arg_t arg )
             }
             request->state = 1;
             if (request->data_callback){
-                //addLog("calling callback");
-                //rtos_delay_milliseconds(500);
                 if (request->data_callback(request)){
                     // abort on user request
                     // close & leave
+                    bAborted = true;
                     break;
                 }
             }
         } while (client_data->is_more);
     } else {
-		// must read out somewhere data, otherwise lwip will fail at lwip_close and it wont free socket
-		// and then it will soon run out of the sockets and break networking
-		int c_read;
-		int ret;
-		c_read = 0;
-		do {
-			ret = client->net.doRead(&client->net, host, sizeof(host), iotx_time_left(&timer));
-			if(ret>0)
-				c_read += ret;
-		} while(ret > 0);
-        ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient - no response buff, skipped %i",c_read);
+		// Headers are still parsed, so we know where the response ends and can keep the connection.
+		// Body is read into temporary buffer and dropped.
+		char *scratch;
+
+		scratch = (char*)os_malloc(HTTPCLIENT_CHUNK_SIZE);
+		ret = -1;
+		if (scratch) {
+			client_data->response_buf = scratch;
+			client_data->response_buf_len = HTTPCLIENT_CHUNK_SIZE;
+			do {
+				ret = httpclient_recv_response(client, iotx_time_left(&timer), client_data);
+			} while (ret >= 0 && client_data->is_more);
+			client_data->response_buf = 0;
+			client_data->response_buf_len = 0;
+			client_data->response_buf_filled = 0;
+			os_free(scratch);
+		}
+		if (ret < 0) {
+			// must read out somewhere data, otherwise lwip will fail at lwip_close and it wont free socket
+			// and then it will soon run out of the sockets and break networking
+			int c_read;
+			c_read = 0;
+			do {
+				ret = client->net.doRead(&client->net, host, sizeof(host), iotx_time_left(&timer));
+				if(ret>0)
+					c_read += ret;
+			} while(ret > 0);
+			ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "httpclient - no response buff, skipped %i",c_read);
+			ret = -1;
+		}
     }
+    // keep connection only if whole response was read and server didn't ask to close it
+    bKeepAlive = ret >= 0 && bAborted == false && host[0] && client->net.handle
+        && client_data->is_more == false && client_data->is_chunked == false
+        && client_data->response_content_len != (uint32_t)-1 && client_data->is_close == false
+        && ca_crt == NULL;
 exit:
-    //addLog("close http channel");
-    httpclient_close(client);
+    if (bKeepAlive) {
+        HTTPClient_Pool_Put(host, port, &client->net);
+        client->net.handle = 0;
+    } else {
+        httpclient_close(client);
+    }
     request->state = 2;  // complete
     request->client_data.response_buf_filled = 0;
     if (request->data_callback){
         request->data_callback(request);
     }
+    g_httpClientStats.completed++;
 	// free if required
 	httpclient_freeMemory(request);
-    // remove this thread
-    rtos_delete_thread( NULL );
-    return;
 }
 
+static void httprequest_worker(beken_thread_arg_t arg)
+{
+	httprequest_t *request;
+
+	while (1) {
+		request = 0;
+		if (HTTPClient_Mutex_Take(100)) {
+			request = g_httpClientQueue;
+			if (request) {
+				g_httpClientQueue = request->next;
+				g_httpClientStats.queueDepth--;
+				if ((request->flags & HTTPREQUEST_FLAG_FREE_SELFONDONE) == 0) {
+					g_httpClientInFlight = request;
+				}
+			}
+			else if (HTTPClient_Pool_CloseIdle() == 0) {
+				// nothing to do, new request will start worker again
+				g_httpClientWorkerRunning = 0;
+				HTTPClient_Mutex_Free();
+				break;
+			}
+			HTTPClient_Mutex_Free();
+		}
+		if (request) {
+			httprequest_run(request);
+			// others check it under lock, so it can't be cleared without it
+			while (HTTPClient_Mutex_Take(100) == false) {
+			}
+			g_httpClientInFlight = 0;
+			HTTPClient_Mutex_Free();
+		}
+		else {
+			rtos_delay_milliseconds(50);
+		}
+	}
+	// remove this thread
+	rtos_delete_thread(NULL);
+}
+
+// Simple GETs made by SendGet are identical if they fetch the same URL
+// to the same target, only one of them needs to be sent.
+static bool HTTPClient_IsSameGet(httprequest_t *a, httprequest_t *b) {
+	if (a->method != HTTPCLIENT_GET || b->method != HTTPCLIENT_GET) {
+		return false;
+	}
+	if (a->data_callback != b->data_callback) {
+		return false;
+	}
+	if (a->data_callback != 0 && a->data_callback != HTTPClient_CB_Data) {
+		return false;
+	}
+	if (a->header || b->header || a->ca_crt || b->ca_crt) {
+		return false;
+	}
+	if (a->port != b->port || strcmp(a->url, b->url) || strcmp(a->targetFile, b->targetFile)) {
+		return false;
+	}
+	if (strcmp(a->cmdToRun ? a->cmdToRun : "", b->cmdToRun ? b->cmdToRun : "")) {
+		return false;
+	}
+	return true;
+}
+
+// caller must hold mutex
+static bool HTTPClient_IsBusy_Locked(httprequest_t *request) {
+	httprequest_t *p;
+
+	if (request == g_httpClientInFlight) {
+		return true;
+	}
+	for (p = g_httpClientQueue; p; p = p->next) {
+		if (p == request) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HTTPClient_IsRequestBusy(httprequest_t *request) {
+	bool bBusy;
+
+	if (HTTPClient_Mutex_Take(500) == false) {
+		// can't tell, so don't let caller touch it
+		return true;
+	}
+	bBusy = HTTPClient_IsBusy_Locked(request);
+	HTTPClient_Mutex_Free();
+	return bBusy;
+}
+
+static int HTTPClient_Queue_Add(httprequest_t *request) {
+	httprequest_t **p;
+	bool bStart;
+	OSStatus err;
+
+	if (HTTPClient_Mutex_Take(500) == false) {
+		ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "HTTP client queue is busy");
+		return -1;
+	}
+	// same struct again, eg. static one, linking it twice would corrupt the queue
+	if (HTTPClient_IsBusy_Locked(request)) {
+		HTTPClient_Mutex_Free();
+		ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "%s is already queued or running", request->url);
+		return -1;
+	}
+	for (p = &g_httpClientQueue; *p; p = &(*p)->next) {
+		if (HTTPClient_IsSameGet(*p, request)) {
+			g_httpClientStats.coalesced++;
+			HTTPClient_Mutex_Free();
+			ADDLOG_INFO(LOG_FEATURE_HTTP_CLIENT, "%s is already queued", request->url);
+			httpclient_freeMemory(request);
+			return 0;
+		}
+	}
+	if (g_httpClientStats.queueDepth >= HTTPCLIENT_QUEUE_MAX) {
+		g_httpClientStats.dropped++;
+		HTTPClient_Mutex_Free();
+		ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "HTTP client queue is full, dropping %s", request->url);
+		return -1;
+	}
+	request->next = 0;
+	*p = request;
+	g_httpClientStats.queueDepth++;
+	if (g_httpClientStats.queueDepth > g_httpClientStats.queuePeak) {
+		g_httpClientStats.queuePeak = g_httpClientStats.queueDepth;
+	}
+	bStart = g_httpClientWorkerRunning == 0;
+#ifdef WINDOWS
+	if (g_httpClientTestHoldQueue) {
+		bStart = false;
+	}
+#endif
+	if (bStart) {
+		g_httpClientWorkerRunning = 1;
+	}
+	HTTPClient_Mutex_Free();
+
+	if (bStart) {
+		err = rtos_create_thread(NULL, BEKEN_APPLICATION_PRIORITY,
+			"httprequest",
+			(beken_thread_function_t)httprequest_worker,
+			0x800,
+			(beken_thread_arg_t)0);
+		if (err != kNoErr) {
+			// request stays queued, next one will try to start worker again
+			ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "create \"httprequest\" thread failed!");
+			g_httpClientWorkerRunning = 0;
+		}
+	}
+	return 0;
+}
+
+#ifdef WINDOWS
+void HTTPClient_Test_ClearQueue(void) {
+	httprequest_t *request;
+
+	while (g_httpClientQueue) {
+		request = g_httpClientQueue;
+		g_httpClientQueue = request->next;
+		g_httpClientStats.queueDepth--;
+		httpclient_freeMemory(request);
+	}
+	memset(&g_httpClientStats, 0, sizeof(g_httpClientStats));
+}
+#endif
+
 
 //////////////////////////////////////
 // our async stuff
 int HTTPClient_Async_SendGeneric(httprequest_t *request){
-    OSStatus err = kNoErr;
 #ifdef WINDOWS
 	g_httpClientTestLastRequest = request;
 	if (g_httpClientTestSkipAsyncThread) {
 		return 0;
 	}
 #endif
-    err = rtos_create_thread( NULL, BEKEN_APPLICATION_PRIORITY,
-									"httprequest",
-									(beken_thread_function_t)httprequest_thread,
-									0x800,
-									(beken_thread_arg_t)request );
-    if(err != kNoErr)
-    {
-       ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT, "create \"httprequest\" thread failed!");
-       return -1;
-    }
-
-    return 0;
+	return HTTPClient_Queue_Add(request);
 }
 
 static int HTTPClient_Async_SendPreparedRequest(httprequest_t *request) {
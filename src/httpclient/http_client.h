@@ -77,6 +77,7 @@ typedef struct {
 typedef struct {
     bool is_more; /**< Indicates if more data needs to be retrieved. */
     bool is_chunked; /**< Response data is encoded in portions/chunks.*/
+    bool is_close; /**< Server will close the connection after this response. */
     int retrieve_len; /**< Content length to be retrieved (total). */
     uint32_t response_content_len; /**< Response content length. (total)*/
     uint32_t post_buf_len; /**< Post data length. */
@@ -116,11 +117,23 @@ typedef struct httprequest_t_tag{
     httpclient_data_t client_data;
 	char targetFile[32];
     void *usercontext; // anything you like
+    struct httprequest_t_tag *next; // used by request queue
 } httprequest_t;
 
+typedef struct httpclient_stats_s {
+	int queueDepth; // requests waiting for worker now
+	int queuePeak;
+	int dropped; // rejected because queue was full
+	int coalesced; // GETs merged with identical queued one
+	int connects; // new TCP connections
+	int reused; // requests sent over kept-alive connection
+	int completed;
+} httpclient_stats_t;
+
 
 /**
  * @brief            This function executes a request on a given URL. It returns immediately and calls back with state and data.
+ *                   Requests are queued and executed one by one by a single worker thread, which keeps connections alive for reuse.
  * @param[in]        request is a pointer to the #httprequest_t.
  * @return           .
  * @par              HTTPClient_Async_SendGeneric Post Example
@@ -166,6 +179,9 @@ int HTTPClient_Async_SendGeneric(httprequest_t *request);
 int HTTPClient_Async_SendGet(const char *url_in, const char *tgFile, const char *postGetCommand);
 int HTTPClient_Async_SendPost(const char *url_in, int http_port, const char *content_type, const char *post_content, const char *post_header);
 void HTTPClient_SetCustomHeader(httpclient_t *client, const char *header);
+void HTTPClient_GetStats(httpclient_stats_t *stats);
+// true while request is queued or being run, it must not be modified or sent again
+bool HTTPClient_IsRequestBusy(httprequest_t *request);
 
 #ifdef WINDOWS
 enum {
@@ -179,6 +195,8 @@ void HTTPClient_Test_SetSkipAsyncThread(int bSkip);
 httprequest_t *HTTPClient_Test_GetLastRequest(void);
 void HTTPClient_Test_ClearLastRequest(void);
 void HTTPClient_Test_FreeLastRequest(void);
+void HTTPClient_Test_SetHoldQueue(int bHold);
+void HTTPClient_Test_ClearQueue(void);
 #endif
 
 #ifdef __cplusplus
@@ -13,6 +13,138 @@
 #include "lwip/netdb.h"
 #endif
 
+// Small cache of resolved addresses, so requests sent every few seconds
+// to the same host don't do a DNS query each time.
+// Entry is dropped when connecting to the cached address fails.
+// Used by HTTP client worker and other threads (eg. OpenWeatherMap), so it's locked.
+#define DNS_CACHE_SIZE		4
+#define DNS_CACHE_HOST_LEN	64
+#define DNS_CACHE_TTL_MS	(5 * 60 * 1000)
+
+typedef struct dnsCacheEntry_s {
+    char host[DNS_CACHE_HOST_LEN];
+    struct sockaddr_in addr;
+    unsigned int stamp;
+} dnsCacheEntry_t;
+
+static dnsCacheEntry_t g_dnsCache[DNS_CACHE_SIZE];
+static SemaphoreHandle_t g_dnsCacheMutex = 0;
+extern unsigned int g_timeMs;
+
+static bool DNS_Cache_Mutex_Take()
+{
+    if (g_dnsCacheMutex == 0) {
+        g_dnsCacheMutex = xSemaphoreCreateMutex();
+    }
+    return xSemaphoreTake(g_dnsCacheMutex, 100) == pdTRUE;
+}
+
+static void DNS_Cache_Mutex_Free()
+{
+    xSemaphoreGive(g_dnsCacheMutex);
+}
+
+// caller must hold mutex
+static dnsCacheEntry_t *DNS_Cache_Find(const char *host)
+{
+    int i;
+
+    for (i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (g_dnsCache[i].host[0] && !strcmp(g_dnsCache[i].host, host)) {
+            if (g_timeMs - g_dnsCache[i].stamp > DNS_CACHE_TTL_MS) {
+                g_dnsCache[i].host[0] = 0;
+                return NULL;
+            }
+            return &g_dnsCache[i];
+        }
+    }
+    return NULL;
+}
+
+// copies cached address of host, false if there is none
+static bool DNS_Cache_Get(const char *host, struct sockaddr_in *addr)
+{
+    dnsCacheEntry_t *e;
+
+    if (DNS_Cache_Mutex_Take() == false) {
+        return false;
+    }
+    e = DNS_Cache_Find(host);
+    if (e) {
+        memcpy(addr, &e->addr, sizeof(*addr));
+    }
+    DNS_Cache_Mutex_Free();
+    return e != NULL;
+}
+
+static void DNS_Cache_Remove(const char *host)
+{
+    dnsCacheEntry_t *e;
+
+    if (DNS_Cache_Mutex_Take() == false) {
+        return;
+    }
+    e = DNS_Cache_Find(host);
+    if (e) {
+        e->host[0] = 0;
+    }
+    DNS_Cache_Mutex_Free();
+}
+
+static void DNS_Cache_Add(const char *host, const struct sockaddr *addr)
+{
+    dnsCacheEntry_t *e;
+    int i;
+
+    if (strlen(host) >= DNS_CACHE_HOST_LEN) {
+        return;
+    }
+    if (DNS_Cache_Mutex_Take() == false) {
+        return;
+    }
+    // replace the oldest one
+    e = &g_dnsCache[0];
+    for (i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (g_dnsCache[i].host[0] == 0) {
+            e = &g_dnsCache[i];
+            break;
+        }
+        if (g_timeMs - g_dnsCache[i].stamp > g_timeMs - e->stamp) {
+            e = &g_dnsCache[i];
+        }
+    }
+    strcpy(e->host, host);
+    memcpy(&e->addr, addr, sizeof(e->addr));
+    e->stamp = g_timeMs;
+    DNS_Cache_Mutex_Free();
+}
+
+static uintptr_t HAL_TCP_EstablishCached(const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    int fd;
+
+    // not locked while connecting, that can take long
+    if (DNS_Cache_Get(host, &addr) == false) {
+        return 0;
+    }
+    addr.sin_port = htons(port);
+
+    fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT,"create socket error %i",fd);
+        return 0;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        lwip_close(fd);
+        // maybe address has changed, resolve it again
+        DNS_Cache_Remove(host);
+        return 0;
+    }
+    ADDLOG_INFO(LOG_FEATURE_HTTP_CLIENT, "HAL_TCP_Establish: cached address for %s, fd=%i", host, fd);
+    return (uintptr_t)fd;
+}
+
 uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
 {
     struct addrinfo hints;
@@ -22,6 +154,11 @@ uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
     int rc = 0;
     char service[6];
 
+    rc = HAL_TCP_EstablishCached(host, port);
+    if (rc != 0) {
+        return (uintptr_t)rc;
+    }
+
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET; //only IPv4
     hints.ai_socktype = SOCK_STREAM;
@@ -50,6 +187,7 @@ uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
 
         if (connect(fd, cur->ai_addr, cur->ai_addrlen) == 0) {
             rc = fd;
+            DNS_Cache_Add(host, cur->ai_addr);
             break;
         }
 
@@ -111,6 +249,25 @@ int32_t HAL_TCP_Destroy(uintptr_t fd)
 }
 
 
+// Idle keep-alive connection has nothing to read,
+// readable socket means that server has closed it (or sent something unexpected).
+int32_t HAL_TCP_IsAlive(uintptr_t fd)
+{
+    fd_set sets;
+    struct timeval timeout;
+
+    FD_ZERO( &sets );
+    FD_SET(fd, &sets);
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+
+    if (select(fd + 1, &sets, NULL, NULL, &timeout) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+
 int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t timeout_ms)
 {
 #if 0
@@ -194,28 +351,30 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
 #else
     int ret, err_code,data_over;
     uint32_t len_recv;
-    uint64_t t_end, t_left;
+    uint32_t t_left;
+    iotx_time_t t_end;
     fd_set sets;
     struct timeval timeout;
 
-    t_end = utils_time_get_ms( ) + timeout_ms ;
+    // HTTP client serves all requests from a single worker and keeps connections open,
+    // so it can't wait forever for a server that stopped sending - whole read,
+    // not each select, is bounded by timeout_ms
+    utils_time_countdown_ms(&t_end, timeout_ms);
     len_recv = 0;
     err_code = 0;
 
     data_over = 0;
 
     do {
-        t_left = utils_time_left(t_end, utils_time_get_ms());
-/*        if (0 == t_left && bk_http_ptr->do_data == 0) {
-            break;
-        }*/
         FD_ZERO( &sets );
         FD_SET(fd, &sets);
 
+        // 0 when deadline passed, select then only polls
+        t_left = iotx_time_left(&t_end);
         timeout.tv_sec = t_left / 1000;
         timeout.tv_usec = (t_left % 1000) * 1000;
 
-        ret = select(fd + 1, &sets, NULL, NULL, NULL);
+        ret = select(fd + 1, &sets, NULL, NULL, &timeout);
         if ( FD_ISSET( fd, &sets ) )
         {
             if (ret > 0) {
@@ -258,6 +417,12 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
        }
        else
        {
+            if (ret < 0) {
+                ADDLOG_ERROR(LOG_FEATURE_HTTP_CLIENT,"select-recv fail");
+                err_code = -2;
+            }
+            // timeout
+            break;
        }
     }while(/*(bk_http_ptr->do_data == 1 && len_recv < bk_http_ptr->http_total) || */((len_recv < len) && (0 == data_over)));
 #endif
@@ -0,0 +1,392 @@
+#include "../new_common.h"
+#include "../obk_config.h"
+
+#if ENABLE_HTTP_EVENTS
+
+#include "lwip/sockets.h"
+#include "../logging/logging.h"
+#include "http_fns.h"
+#include "http_events.h"
+
+// Server-Sent Events on /events. Browser keeps the connection open and gets:
+//   event: channel, data: {"ch":1,"val":100} - on every channel change
+//   event: state, data: <version> - when index state (index?state=1&v=) has changed
+//   event: vstate, data: {"vclock":"..."} - clock, RSSI etc, left out of state version
+//   event: log, data: <line> - only with /events?log=1
+// so open pages don't have to poll. Each client has its own bounded queue,
+// if it can't keep up, the oldest queued events are dropped.
+
+#define HTTP_EVENTS_MAX_CLIENTS 3
+#define HTTP_EVENTS_QUEUE_SIZE 1024
+// comment sent to idle clients, so a dead connection gets noticed
+#define HTTP_EVENTS_KEEPALIVE_SECONDS 15
+// don't spend too long in a quick tick if log is busy
+#define HTTP_EVENTS_MAX_LOG_READS 4
+
+#if WINDOWS
+#define EVENTS_WOULDBLOCK() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#define EVENTS_WOULDBLOCK() (errno == EWOULDBLOCK || errno == EAGAIN)
+#endif
+#ifdef MSG_NOSIGNAL
+#define EVENTS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define EVENTS_SEND_FLAGS 0
+#endif
+
+typedef struct httpEventsClient_s {
+	bool bUsed;
+	// headers were sent, events can be queued and sent
+	bool bReady;
+	bool bLog;
+	// first queued event is partially sent, so it can't be dropped
+	bool bPartial;
+	int fd;
+	// always NUL terminated
+	char *queue;
+	int queueLen;
+	int dropped;
+	int idleSeconds;
+} httpEventsClient_t;
+
+static httpEventsClient_t g_eventsClients[HTTP_EVENTS_MAX_CLIENTS];
+// not locked, it's only a hint to skip work when nobody listens
+static int g_eventsNumClients = 0;
+static SemaphoreHandle_t g_eventsMutex = 0;
+static unsigned int g_eventsStateVersion = 0;
+// last sent values of clock, RSSI etc, see http_getIndexVolatileState
+static char g_eventsVolatileState[192];
+static char g_eventsLogLine[192];
+static int g_eventsLogLineLen = 0;
+
+static bool Events_Mutex_Take(int del) {
+	if (g_eventsMutex == 0) {
+		g_eventsMutex = xSemaphoreCreateMutex();
+	}
+	return xSemaphoreTake(g_eventsMutex, del) == pdTRUE;
+}
+
+static void Events_Mutex_Free() {
+	xSemaphoreGive(g_eventsMutex);
+}
+
+// returns length of first event in p, including the blank line ending it
+static int Events_FindEnd(const char *p, int len) {
+	int i;
+
+	for (i = 1; i < len; i++) {
+		if (p[i - 1] == '\n' && p[i] == '\n') {
+			return i + 1;
+		}
+	}
+	return -1;
+}
+
+static void Events_RemoveClient(httpEventsClient_t *c) {
+	// fd 0 is a fake client of unit tests
+	if (c->fd != 0 && c->bReady) {
+		lwip_close(c->fd);
+	}
+	free(c->queue);
+	memset(c, 0, sizeof(*c));
+	g_eventsNumClients--;
+}
+
+// called with mutex taken
+static void Events_Push(httpEventsClient_t *c, const char *ev, int len) {
+	int first, skip;
+
+	while (c->queueLen + len > HTTP_EVENTS_QUEUE_SIZE) {
+		// drop the oldest event that is not being sent
+		skip = 0;
+		if (c->bPartial) {
+			skip = Events_FindEnd(c->queue, c->queueLen);
+		}
+		first = skip < 0 ? -1 : Events_FindEnd(c->queue + skip, c->queueLen - skip);
+		if (first < 0) {
+			// only partially sent event left, so drop the new one
+			c->dropped++;
+			return;
+		}
+		memmove(c->queue + skip, c->queue + skip + first, c->queueLen - skip - first);
+		c->queueLen -= first;
+		c->dropped++;
+	}
+	memcpy(c->queue + c->queueLen, ev, len);
+	c->queueLen += len;
+	c->queue[c->queueLen] = 0;
+}
+
+static void Events_Broadcast(const char *type, const char *data, bool bLog) {
+	char ev[256];
+	int len, i;
+
+	len = snprintf(ev, sizeof(ev), "event: %s\ndata: %s\n\n", type, data);
+	if (len >= (int)sizeof(ev)) {
+		len = sizeof(ev) - 1;
+		ev[len - 2] = '\n';
+		ev[len - 1] = '\n';
+	}
+	if (!Events_Mutex_Take(100)) {
+		return;
+	}
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		if (!g_eventsClients[i].bReady)
+			continue;
+		if (bLog && !g_eventsClients[i].bLog)
+			continue;
+		Events_Push(&g_eventsClients[i], ev, len);
+	}
+	Events_Mutex_Free();
+}
+
+// called with mutex taken
+static void Events_Send(httpEventsClient_t *c) {
+	int res;
+
+	// unit test clients just keep everything queued
+	if (c->queueLen == 0 || c->fd == 0) {
+		return;
+	}
+	res = send(c->fd, c->queue, c->queueLen, EVENTS_SEND_FLAGS);
+	if (res < 0) {
+		if (!EVENTS_WOULDBLOCK()) {
+			Events_RemoveClient(c);
+		}
+		return;
+	}
+	c->bPartial = !(res >= 2 && c->queue[res - 2] == '\n' && c->queue[res - 1] == '\n');
+	memmove(c->queue, c->queue + res, c->queueLen - res);
+	c->queueLen -= res;
+	c->queue[c->queueLen] = 0;
+	if (c->queueLen == 0) {
+		c->bPartial = false;
+	}
+	c->idleSeconds = 0;
+}
+
+static void Events_DrainLog() {
+	char buf[128];
+	int n, i, reads;
+
+	for (reads = 0; reads < HTTP_EVENTS_MAX_LOG_READS; reads++) {
+		n = LOG_GetEventsData(buf, sizeof(buf));
+		if (n <= 0) {
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (buf[i] == '\r') {
+				continue;
+			}
+			if (buf[i] == '\n') {
+				g_eventsLogLine[g_eventsLogLineLen] = 0;
+				if (g_eventsLogLineLen) {
+					Events_Broadcast("log", g_eventsLogLine, true);
+				}
+				g_eventsLogLineLen = 0;
+				continue;
+			}
+			// longer lines are cut
+			if (g_eventsLogLineLen < (int)sizeof(g_eventsLogLine) - 1) {
+				g_eventsLogLine[g_eventsLogLineLen++] = buf[i];
+			}
+		}
+	}
+}
+
+static bool Events_HasLogClient() {
+	int i;
+
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		if (g_eventsClients[i].bUsed && g_eventsClients[i].bLog)
+			return true;
+	}
+	return false;
+}
+
+static int http_fn_events(http_request_t *request) {
+	httpEventsClient_t *c = 0;
+	char tmp[8];
+	char ev[32];
+	bool bLog;
+	int i;
+
+	bLog = http_getArg(request->url, "log", tmp, sizeof(tmp)) && atoi(tmp);
+	// reserve a slot first, events go there only after headers are sent
+	if (Events_Mutex_Take(100)) {
+		for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+			if (g_eventsClients[i].bUsed == false) {
+				c = &g_eventsClients[i];
+				c->queue = (char*)malloc(HTTP_EVENTS_QUEUE_SIZE + 1);
+				if (c->queue == 0) {
+					c = 0;
+					break;
+				}
+				if (bLog && !Events_HasLogClient()) {
+					LOG_ResetEventsCursor();
+					g_eventsLogLineLen = 0;
+				}
+				c->queue[0] = 0;
+				c->bUsed = true;
+				c->bLog = bLog;
+				c->fd = request->fd;
+				g_eventsNumClients++;
+				break;
+			}
+		}
+		Events_Mutex_Free();
+	}
+	if (c == 0) {
+		// EventSource doesn't reconnect after error status, page keeps polling
+		request->responseCode = 503;
+		http_setup(request, httpMimeTypeText);
+		poststr(request, "Too many event clients");
+		poststr(request, NULL);
+		return 0;
+	}
+	http_setup_ex(request, "text/event-stream", "Cache-Control: no-cache\r\n");
+	// if connection drops, browser retries after that many ms
+	poststr(request, "retry: 5000\n\n");
+	if (g_eventsStateVersion) {
+		snprintf(ev, sizeof(ev), "event: state\ndata: %08X\n\n", g_eventsStateVersion);
+		poststr(request, ev);
+	}
+	poststr(request, NULL);
+
+	if (request->fd != 0) {
+		lwip_fcntl(request->fd, F_SETFL, O_NONBLOCK);
+	}
+	// socket is ours now, server must not close it
+	request->bDetached = 1;
+	Events_Mutex_Take(100);
+	c->bReady = true;
+	Events_Mutex_Free();
+	return 0;
+}
+
+void HTTP_Events_Init() {
+	HTTP_RegisterCallback("/events", HTTP_GET, http_fn_events, 1);
+}
+
+int HTTP_Events_GetClientsCount() {
+	return g_eventsNumClients;
+}
+
+// something to send or log to forward, so quick ticks can't be skipped
+int HTTP_Events_HasQuickTickWork() {
+	int i;
+
+	if (g_eventsNumClients == 0) {
+		return 0;
+	}
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		if (!g_eventsClients[i].bReady)
+			continue;
+		if (g_eventsClients[i].bLog)
+			return 1;
+		if (g_eventsClients[i].queueLen && g_eventsClients[i].fd != 0)
+			return 1;
+	}
+	return 0;
+}
+
+void HTTP_Events_OnChannelChanged(int ch, int iVal) {
+	char data[32];
+
+	if (g_eventsNumClients == 0) {
+		return;
+	}
+	snprintf(data, sizeof(data), "{\"ch\":%i,\"val\":%i}", ch, iVal);
+	Events_Broadcast("channel", data, false);
+}
+
+void HTTP_Events_RunQuickTick() {
+	int i;
+
+	if (g_eventsNumClients == 0) {
+		return;
+	}
+	if (Events_HasLogClient()) {
+		Events_DrainLog();
+	}
+	if (!Events_Mutex_Take(10)) {
+		return;
+	}
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		if (g_eventsClients[i].bReady) {
+			Events_Send(&g_eventsClients[i]);
+		}
+	}
+	Events_Mutex_Free();
+}
+
+void HTTP_Events_OnEverySecond() {
+	httpEventsClient_t *c;
+	unsigned int version;
+	char data[sizeof(g_eventsVolatileState)];
+	char tmp[16];
+	int i, res;
+
+	if (g_eventsNumClients == 0) {
+		return;
+	}
+	version = http_getIndexStateVersion();
+	if (version != g_eventsStateVersion) {
+		g_eventsStateVersion = version;
+		snprintf(data, sizeof(data), "%08X", version);
+		Events_Broadcast("state", data, false);
+	}
+	// they are not part of the version, page updates them in place
+	http_getIndexVolatileState(data, sizeof(data));
+	if (strcmp(data, g_eventsVolatileState)) {
+		strcpy(g_eventsVolatileState, data);
+		Events_Broadcast("vstate", data, false);
+	}
+	if (!Events_Mutex_Take(100)) {
+		return;
+	}
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		c = &g_eventsClients[i];
+		if (!c->bReady || c->fd == 0) {
+			continue;
+		}
+		// client doesn't send anything after its request, anything it does is dropped;
+		// 0 means it has closed the connection, other errors than would block mean it's broken
+		res = recv(c->fd, tmp, sizeof(tmp), 0);
+		if (res == 0 || (res < 0 && !EVENTS_WOULDBLOCK())) {
+			Events_RemoveClient(c);
+			continue;
+		}
+		c->idleSeconds++;
+		if (c->idleSeconds >= HTTP_EVENTS_KEEPALIVE_SECONDS && c->queueLen == 0) {
+			// comment line, ignored by browser
+			Events_Push(c, ":\n\n", 3);
+		}
+	}
+	Events_Mutex_Free();
+}
+
+const char *HTTP_Events_Test_GetQueue(int index) {
+	if (!g_eventsClients[index].bUsed) {
+		return 0;
+	}
+	return g_eventsClients[index].queue;
+}
+
+int HTTP_Events_Test_GetDropped(int index) {
+	return g_eventsClients[index].dropped;
+}
+
+void HTTP_Events_Test_Clear() {
+	int i;
+
+	for (i = 0; i < HTTP_EVENTS_MAX_CLIENTS; i++) {
+		if (g_eventsClients[i].bUsed) {
+			Events_RemoveClient(&g_eventsClients[i]);
+		}
+	}
+	g_eventsStateVersion = 0;
+	g_eventsVolatileState[0] = 0;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __HTTP_EVENTS_H__
+#define __HTTP_EVENTS_H__
+
+#include "new_http.h"
+
+// Server-Sent Events stream, see http_events.c
+void HTTP_Events_Init();
+void HTTP_Events_RunQuickTick();
+void HTTP_Events_OnEverySecond();
+void HTTP_Events_OnChannelChanged(int ch, int iVal);
+int HTTP_Events_GetClientsCount();
+int HTTP_Events_HasQuickTickWork();
+
+// for unit tests
+const char *HTTP_Events_Test_GetQueue(int index);
+int HTTP_Events_Test_GetDropped(int index);
+void HTTP_Events_Test_Clear();
+
+#endif
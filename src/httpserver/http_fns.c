@@ -21,6 +21,7 @@
 #include <time.h>
 #include "../driver/drv_ntp.h"
 #include "../driver/drv_deviceclock.h"		// to set clock via Javascript in pmntp
+#include "../libraries/obktime/obktime.h"	// for TS2STR
 #include "../driver/drv_local.h"
 #ifdef PLATFORM_BEKEN
 #include "start_type_pub.h"
@@ -250,7 +251,192 @@ int http_fn_pmntp(http_request_t* request) {
 // If given bit is set, then given channel is hidden
 extern int g_hiddenChannels;
 
+static int http_fn_index_page(http_request_t* request);
+
+static unsigned int g_indexStateChanges;
+
+// for drivers that print their own values on index page, they call it when those have changed
+void HTTP_IndexStateChanged() {
+	g_indexStateChanges++;
+}
+
+static unsigned int http_addToIndexStateVersion(unsigned int crc, int value) {
+	return HTTP_CRC32Update(crc, (const unsigned char*)&value, sizeof(value));
+}
+
+static unsigned int http_addStrToIndexStateVersion(unsigned int crc, const char* s) {
+	if (s == 0) {
+		return http_addToIndexStateVersion(crc, 0);
+	}
+	return HTTP_CRC32Update(crc, (const unsigned char*)s, strlen(s) + 1);
+}
+
+// Version of index state is CRC of things the page is built from, page script sends
+// the version it shows and if nothing has changed since then, reply has empty body.
+// Values that change on their own all the time (clock, RSSI, ...) are not part of it,
+// see http_getIndexVolatileState. Nothing is rendered here, it's cheap to call often.
+// HTML printed by drivers and Berry has no model to hash, so while there is any,
+// version changes every second and state is refreshed as often as before.
+unsigned int http_getIndexStateVersion() {
+	unsigned int crc = 0;
+	float value;
+	int i;
+
+	for (i = 0; i < CHANNEL_MAX; i++) {
+		value = CHANNEL_GetFloat(i);
+		crc = HTTP_CRC32Update(crc, (const unsigned char*)&value, sizeof(value));
+		crc = http_addToIndexStateVersion(crc, CHANNEL_GetType(i));
+		if (CHANNEL_HasLabel(i)) {
+			crc = http_addStrToIndexStateVersion(crc, CHANNEL_GetLabel(i));
+		}
+	}
+	crc = http_addToIndexStateVersion(crc, g_hiddenChannels);
+#if ENABLE_LED_BASIC
+	char tmpA[16];
+
+	crc = http_addToIndexStateVersion(crc, LED_GetEnableAll());
+	crc = http_addToIndexStateVersion(crc, LED_GetMode());
+	value = LED_GetDimmer();
+	crc = HTTP_CRC32Update(crc, (const unsigned char*)&value, sizeof(value));
+	value = LED_GetTemperature();
+	crc = HTTP_CRC32Update(crc, (const unsigned char*)&value, sizeof(value));
+	LED_GetBaseColorString(tmpA);
+	crc = http_addStrToIndexStateVersion(crc, tmpA);
+#endif
+	crc = http_addToIndexStateVersion(crc, g_indexStateChanges);
+	crc = http_addToIndexStateVersion(crc, RepeatingEvents_GetActiveCount());
+	crc = http_addToIndexStateVersion(crc, EventHandlers_GetActiveCount());
+#if defined(WINDOWS) || defined(PLATFORM_BEKEN)
+	crc = http_addToIndexStateVersion(crc, CMD_GetCountActiveScriptThreads());
+#endif
+	crc = http_addToIndexStateVersion(crc, g_cfg.changeCounter);
+	crc = http_addToIndexStateVersion(crc, g_cfg.otaCounter);
+	crc = http_addToIndexStateVersion(crc, g_bootFailures);
+	crc = http_addToIndexStateVersion(crc, Main_HasWiFiConnected());
+	crc = http_addToIndexStateVersion(crc, TIME_IsTimeSynced());
+#if ENABLE_MQTT
+	crc = http_addStrToIndexStateVersion(crc, CFG_GetMQTTHost());
+	crc = http_addToIndexStateVersion(crc, mqtt_reconnect > 0);
+	crc = http_addToIndexStateVersion(crc, Main_HasMQTTConnected());
+	crc = http_addToIndexStateVersion(crc, MQTT_GetConnectResult());
+	crc = http_addStrToIndexStateVersion(crc, MQTT_GetStatusMessage());
+#endif
+#if ENABLE_PING_WATCHDOG
+	crc = http_addStrToIndexStateVersion(crc, CFG_GetPingHost());
+	crc = http_addToIndexStateVersion(crc, CFG_GetPingDisconnectedSecondsToRestart());
+#endif
+	crc = http_addToIndexStateVersion(crc, OTA_GetProgress());
+	crc = http_addToIndexStateVersion(crc, OTA_GetTotalBytes());
+	if (CFG_HasFlag(OBK_FLAG_HTTP_PINMONITOR)) {
+		for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
+			if ((PIN_GetPinRoleForPinIndex(i) == IOR_None) && (i != 0) && (i != 1)) {
+				crc = http_addToIndexStateVersion(crc, HAL_PIN_ReadDigitalInput(i));
+			}
+		}
+	}
+#ifndef OBK_DISABLE_ALL_DRIVERS
+	if (DRV_HasIndexPageInformation()) {
+		crc = http_addToIndexStateVersion(crc, g_secondsElapsed);
+	}
+#endif
+#if ENABLE_OBK_BERRY
+	if (CMD_Berry_HasEventHandlers(CMD_EVENT_ON_HTTP)) {
+		crc = http_addToIndexStateVersion(crc, g_secondsElapsed);
+	}
+#endif
+	return crc;
+}
+
+#if ENABLE_PING_WATCHDOG
+static void http_formatPingWatchDogState(char* o, int maxLen) {
+	if (g_startPingWatchDogAfter > 0) {
+		snprintf(o, maxLen, "will start in %i!", g_startPingWatchDogAfter);
+	}
+	else {
+		snprintf(o, maxLen, "%i lost, %i ok, last reply was %is ago!",
+			PingWatchDog_GetTotalLost(), PingWatchDog_GetTotalReceived(), g_timeSinceLastPingReply);
+	}
+}
+#endif
+
+static void http_formatWifiStrength(char* o, int maxLen) {
+	int rssi = HAL_GetWifiStrength();
+	snprintf(o, maxLen, "%s (%idBm)", str_rssi[wifi_rssi_scale(rssi)], rssi);
+}
+
+#if ENABLE_MQTT
+static void http_formatMQTTStats(char* o, int maxLen) {
+	snprintf(o, maxLen, "CONN: %d PUB: %d RECV: %d ERR: %d", MQTT_GetConnectEvents(),
+		MQTT_GetPublishEventCounter(), MQTT_GetReceivedEventCounter(), MQTT_GetPublishErrorCounter());
+}
+#endif
+
+static void http_addIndexVolatileValue(char* o, int maxLen, const char* id, const char* value) {
+	int len = strlen(o);
+
+	snprintf(o + len, maxLen - len, "%s\"%s\":\"%s\"", len > 1 ? "," : "", id, value);
+}
+
+// JSON with values of index page elements that are left out of state version,
+// keys are ids of their spans, e.g. {"vtemp":"41.0","vrssi":"Good (-60dBm)"}
+void http_getIndexVolatileState(char* o, int maxLen) {
+	char tmpA[64];
+
+	strcpy(o, "{");
+#ifndef OBK_DISABLE_ALL_DRIVERS
+	if (TIME_IsTimeSynced()) {
+		http_addIndexVolatileValue(o, maxLen, "vclock", TS2STR(TIME_GetCurrentTime(), TIME_FORMAT_LONG));
+	}
+#endif
+#ifndef NO_CHIP_TEMPERATURE
+	snprintf(tmpA, sizeof(tmpA), "%.1f", g_wifi_temperature);
+	http_addIndexVolatileValue(o, maxLen, "vtemp", tmpA);
+#endif
+#if ENABLE_PING_WATCHDOG
+	http_formatPingWatchDogState(tmpA, sizeof(tmpA));
+	http_addIndexVolatileValue(o, maxLen, "vping", tmpA);
+#endif
+	if (Main_HasWiFiConnected()) {
+		http_formatWifiStrength(tmpA, sizeof(tmpA));
+		http_addIndexVolatileValue(o, maxLen, "vrssi", tmpA);
+	}
+#if ENABLE_MQTT
+	if (CFG_GetMQTTHost()[0]) {
+		http_formatMQTTStats(tmpA, sizeof(tmpA));
+		http_addIndexVolatileValue(o, maxLen, "vmqtt", tmpA);
+	}
+#endif
+	strncat(o, "}", maxLen - strlen(o) - 1);
+}
+
+static int http_fn_index_state(http_request_t* request, const char* clientVersion) {
+	char headers[256];
+	char version[12];
+	int len;
+
+	snprintf(version, sizeof(version), "%08X", http_getIndexStateVersion());
+	len = snprintf(headers, sizeof(headers), "Cache-Control: no-cache\r\nX-State-Version: %s\r\nX-State-Volatile: ", version);
+	http_getIndexVolatileState(headers + len, sizeof(headers) - len - 2);
+	strcat(headers, "\r\n");
+	http_setup_ex(request, httpMimeTypeHTML, headers);
+	if (strcmp(version, clientVersion)) {
+		return http_fn_index_page(request);
+	}
+	poststr(request, NULL);
+	return 0;
+}
+
 int http_fn_index(http_request_t* request) {
+	char tmpA[16];
+
+	if (http_getArg(request->url, "state", tmpA, sizeof(tmpA)) && http_getArg(request->url, "v", tmpA, sizeof(tmpA))) {
+		return http_fn_index_state(request, tmpA);
+	}
+	http_setup(request, httpMimeTypeHTML);	//Add mimetype regardless of the request
+	return http_fn_index_page(request);
+}
+
+static int http_fn_index_page(http_request_t* request) {
 	int j, i, ch1, ch2;
 	char tmpA[128];
 	int bRawPWMs;
@@ -276,7 +462,6 @@ int http_fn_index(http_request_t* request) {
 		}
 #endif
 	}
-	http_setup(request, httpMimeTypeHTML);	//Add mimetype regardless of the request
 
 	// use ?state URL parameter to only request current state
 	if (!http_getArg(request->url, "state", tmpA, sizeof(tmpA))) {
@@ -935,26 +1120,21 @@ int http_fn_index(http_request_t* request) {
   // display temperature - thanks to giedriuslt
   // only in Normal mode, and if boot is not failing
 #ifndef NO_CHIP_TEMPERATURE
-	hprintf255(request, "<h5>Chip temperature: %.1f°C</h5>", g_wifi_temperature);
+	hprintf255(request, "<h5>Chip temperature: <span id=\"vtemp\">%.1f</span>°C</h5>", g_wifi_temperature);
 #endif
 
 #if ENABLE_PING_WATCHDOG
 	inputName = CFG_GetPingHost();
 	if (inputName && *inputName && CFG_GetPingDisconnectedSecondsToRestart()) {
 		hprintf255(request, "<h5>Ping watchdog (%s) - ", inputName);
-		if (g_startPingWatchDogAfter > 0) {
-			hprintf255(request, "will start in %i!</h5>", g_startPingWatchDogAfter);
-		}
-		else {
-			hprintf255(request, "%i lost, %i ok, last reply was %is ago!</h5>",
-				PingWatchDog_GetTotalLost(), PingWatchDog_GetTotalReceived(), g_timeSinceLastPingReply);
-		}
+		http_formatPingWatchDogState(tmpA, sizeof(tmpA));
+		hprintf255(request, "<span id=\"vping\">%s</span></h5>", tmpA);
 	}
 #endif
 	if (Main_HasWiFiConnected())
 	{
-		int rssi = HAL_GetWifiStrength();
-		hprintf255(request, "<h5>Wifi RSSI: %s (%idBm)</h5>", str_rssi[wifi_rssi_scale(rssi)], rssi);
+		http_formatWifiStrength(tmpA, sizeof(tmpA));
+		hprintf255(request, "<h5>Wifi RSSI: <span id=\"vrssi\">%s</span></h5>", tmpA);
 	}
 #if PLATFORM_BEKEN
 	/*
@@ -1089,8 +1269,8 @@ typedef enum {
 		hprintf255(request, "<h5>MQTT State: <span style=\"color:%s\">%s</span> RES: %d(%s)<br>", colorStr,
 			stateStr, MQTT_GetConnectResult(), get_error_name(MQTT_GetConnectResult()));
 		hprintf255(request, "MQTT ErrMsg: %s <br>", (MQTT_GetStatusMessage() != NULL) ? MQTT_GetStatusMessage() : "");
-		hprintf255(request, "MQTT Stats: CONN: %d PUB: %d RECV: %d ERR: %d </h5>", MQTT_GetConnectEvents(),
-			MQTT_GetPublishEventCounter(), MQTT_GetReceivedEventCounter(), MQTT_GetPublishErrorCounter());
+		http_formatMQTTStats(tmpA, sizeof(tmpA));
+		hprintf255(request, "MQTT Stats: <span id=\"vmqtt\">%s</span> </h5>", tmpA);
 	}
 #endif
 	/* Format current PINS input state for all unused pins */
@@ -3231,6 +3411,7 @@ const char* g_obk_flagNames[] = {
 	"[HTTP] Hide ON/OFF for relays (only red/green buttons)",
 	"[MQTT] Never add GET suffix",
 	"[WiFi] (RTL/BK/BL602) Enhanced fast connect by saving AP data to flash (preferable with Flag 37 & static ip). Quick reset 3 times to connect normally",
+	"[BTN] Read buttons and digital inputs from GPIO edge interrupts instead of polling them every tick (if platform supports it)",
 	"error",
 	"error",
 	"error",
@@ -23,6 +23,8 @@ int http_fn_cfg(http_request_t* request);
 int http_fn_cfg_pins(http_request_t* request);
 int http_fn_cfg_ping(http_request_t* request);
 int http_fn_index(http_request_t* request);
+unsigned int http_getIndexStateVersion();
+void http_getIndexVolatileState(char* o, int maxLen);
 int http_fn_testmsg(http_request_t* request);
 int http_fn_ota_exec(http_request_t* request);
 int http_fn_ota(http_request_t* request);
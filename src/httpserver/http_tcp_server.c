@@ -57,10 +57,12 @@ static void tcp_client_thread(beken_thread_arg_t arg)
 	char* buf = NULL;
 	char* reply = NULL;
 	int replyBufferSize = REPLY_BUFFER_SIZE;
+	http_request_t request;
 	//int res;
 	//char reply[8192];
 
   //my_fd = fd;
+	memset(&request, 0, sizeof(request));
 	rtos_delay_milliseconds(20);
 
 	reply = (char*)os_malloc(replyBufferSize);
@@ -71,9 +73,6 @@ static void tcp_client_thread(beken_thread_arg_t arg)
 		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client failed to malloc buffer");
 		goto exit;
 	}
-	http_request_t request;
-	memset(&request, 0, sizeof(request));
-
 	request.fd = fd;
 	request.received = buf;
 	request.receivedLenmax = INCOMING_BUFFER_SIZE - 2;
@@ -137,7 +136,8 @@ exit:
 	if (reply != NULL)
 		os_free(reply);
 
-	lwip_close(fd);
+	if (!request.bDetached)
+		lwip_close(fd);
 
 #if DISABLE_SEPARATE_THREAD_FOR_EACH_TCP_CLIENT
 
@@ -91,6 +91,7 @@ void HTTPServer_RunQuickTick() {
     int recvbuflen = DEFAULT_BUFLEN;
     SOCKET ClientSocket = INVALID_SOCKET;
 	int len, iSendResult;
+	int bDetached = 0;
 
 	// Accept a client socket
 	ClientSocket = accept(ListenSocket, NULL, NULL);
@@ -146,6 +147,7 @@ void HTTPServer_RunQuickTick() {
 
 				//printf("HTTP Server for Windows: Bytes received: %d \n", iResult);
 				len = HTTP_ProcessPacket(&request);
+				bDetached = request.bDetached;
 
 				if(len > 0) {
 					printf("Bytes rremaining tosend %d\n", len);
@@ -176,6 +178,10 @@ void HTTPServer_RunQuickTick() {
 			}
 			break;
 		} while (1);
+		// socket was taken by handler, like event stream
+		if (bDetached) {
+			return;
+		}
 		//byte zero = 0;
 		//send(ClientSocket, &zero, 0, 0);
 		//Sleep(50);
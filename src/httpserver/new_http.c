@@ -303,6 +303,11 @@ bool http_checkUrlBase(const char *base, const char *fileName)
 }
 
 void http_setup(http_request_t *request, const char *type)
+{
+	http_setup_ex(request, type, NULL);
+}
+// extraHeaders, if given, is a set of "Name: value\r\n" lines
+void http_setup_ex(http_request_t *request, const char *type, const char *extraHeaders)
 {
 	hprintf255(request, httpHeader, request->responseCode, type);
 	poststr(request, "\r\n"); // next header
@@ -321,6 +326,10 @@ void http_setup(http_request_t *request, const char *type)
 	poststr(request, "Transfer-Encoding: chunked");
 #endif
 	poststr(request, "\r\n");
+	if (extraHeaders)
+	{
+		poststr(request, extraHeaders);
+	}
 	poststr(request, "Connection: close");
 	poststr(request, "\r\n"); // end headers with double CRLF
 	poststr(request, "\r\n");
@@ -350,17 +359,13 @@ void http_html_start(http_request_t *request, const char *pagename)
 	poststr(request, "</title>");
 	poststr(request, htmlShortcutIcon);
 	poststr(request, htmlHeadMeta);
-	poststr(request, htmlHeadStyle);
+	hprintf255(request, "<link rel=\"stylesheet\" href=\"/obk.css?v=%08X\">", HTTP_GetStaticFileVersion("obk.css"));
 	poststr(request, "</head>");
 	poststr(request, htmlBodyStart);
 	poststr(request, CFG_GetDeviceName());
 	poststr(request, htmlBodyStart2);
 }
 
-const char pageScriptPart1[] = "<script type='text/javascript'>var firstTime,lastTime,onlineFor,req=null,onlineForEl=null,getElement=e=>document.getElementById(e);function showState(){clearTimeout(firstTime),clearTimeout(lastTime),null!=req&&req.abort(),(e=getElement(\"state\"))&&((req=new XMLHttpRequest).onreadystatechange=()=>{4==req.readyState&&\"OK\"==req.statusText&&(\"SELECT\"!=document.activeElement.tagName&&(\"INPUT\"!=document.activeElement.tagName||\"number\"!=document.activeElement.type&&\"color\"!=document.activeElement.type)&&(e.innerHTML=req.responseText),clearTimeout(firstTime),clearTimeout(lastTime),lastTime=setTimeout(showState,";
-const char pageScriptPart2[] = "))},req.open(\"GET\",\"index?state=1\",!0),req.send()),firstTime=setTimeout(showState,";
-const char pageScriptPart3[] = ")}function fmtUpTime(e){var t,n,o=Math.floor(e/86400);return e%=86400,t=Math.floor(e/3600),e%=3600,n=Math.floor(e/60),e=e%60,0<o?o+` days, ${t} hours, ${n} minutes and ${e} seconds`:0<t?t+` hours, ${n} minutes and ${e} seconds`:0<n?n+` minutes and ${e} seconds`:`just ${e} seconds`}function updateOnlineFor(){onlineForEl.textContent=fmtUpTime(++onlineFor)}function onLoad(){(onlineForEl=getElement(\"onlineFor\"))&&(onlineFor=parseInt(onlineForEl.dataset.initial,10))&&setInterval(updateOnlineFor,1e3),showState()}function submitTemperature(e){var t=getElement(\"form132\");getElement(\"kelvin132\").value=Math.round(1e6/parseInt(e.value)),t.submit()}window.addEventListener(\"load\",onLoad),history.replaceState(null,\"\",window.location.pathname.slice(1)),setTimeout(()=>{var e=getElement(\"changed\");e&&(e.innerHTML=\"\")},5e3);</script>";
-
 void http_html_end(http_request_t *request)
 {
 	char upTimeStr[128];
@@ -384,11 +389,132 @@ void http_html_end(http_request_t *request)
 #endif
 
 	poststr(request, htmlBodyEnd);
-	poststr(request, pageScriptPart1);
-	hprintf255(request, "%i", g_indexAutoRefreshInterval);
-	poststr(request, pageScriptPart2);
-	hprintf255(request, "%i", g_indexAutoRefreshInterval);
-	poststr(request, pageScriptPart3);
+	hprintf255(request, "<script src=\"/obk.js?v=%08X\" data-refresh=\"%i\"></script>",
+		HTTP_GetStaticFileVersion("obk.js"), g_indexAutoRefreshInterval);
+}
+
+// obk.css and obk.js are served as separate files, so browser can cache them
+// instead of getting them again with every page. URLs carry the content CRC,
+// so a firmware with changed script/style gets new URLs.
+typedef struct httpStaticFile_s {
+	const char *name;
+	const char *mimeType;
+	const char *plain;
+	const unsigned char *gz;
+	int gzLen;
+	// filled on first use
+	int plainLen;
+	unsigned int crc;
+	bool bGzValid;
+} httpStaticFile_t;
+
+// defined below generated regions, because they need sizeof of gzipped data
+extern httpStaticFile_t g_httpStaticFiles[];
+extern int g_httpNumStaticFiles;
+
+// continues CRC returned by previous call, start with 0
+unsigned int HTTP_CRC32Update(unsigned int crc, const unsigned char *data, int len)
+{
+	int i;
+
+	crc = ~crc;
+
+	while (len--)
+	{
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+unsigned int HTTP_CRC32(const unsigned char *data, int len)
+{
+	return HTTP_CRC32Update(0, data, len);
+}
+
+static httpStaticFile_t *HTTP_FindStaticFile(const char *urlStr)
+{
+	httpStaticFile_t *f;
+	const unsigned char *t;
+	int i;
+
+	for (i = 0; i < g_httpNumStaticFiles; i++)
+	{
+		f = &g_httpStaticFiles[i];
+		if (!http_checkUrlBase(urlStr, f->name))
+			continue;
+		if (f->plainLen == 0)
+		{
+			f->plainLen = strlen(f->plain);
+			f->crc = HTTP_CRC32((const unsigned char *)f->plain, f->plainLen);
+			// gzip trailer is CRC32 and size of uncompressed data. If text field was
+			// edited by hand without running gulp, gzipped one is stale, so don't use it
+			t = f->gz + f->gzLen - 8;
+			f->bGzValid = f->gzLen > 18 &&
+				f->crc == (t[0] | (t[1] << 8) | (t[2] << 16) | ((unsigned int)t[3] << 24)) &&
+				f->plainLen == (t[4] | (t[5] << 8) | (t[6] << 16) | (t[7] << 24));
+			if (!f->bGzValid)
+			{
+				ADDLOG_ERROR(LOG_FEATURE_HTTP, "%s: gzipped data doesn't match, run gulp", f->name);
+			}
+		}
+		return f;
+	}
+	return 0;
+}
+
+unsigned int HTTP_GetStaticFileVersion(const char *name)
+{
+	httpStaticFile_t *f = HTTP_FindStaticFile(name);
+
+	return f ? f->crc : 0;
+}
+
+int HTTP_ServeStaticFile(http_request_t *request, const char *urlStr)
+{
+	httpStaticFile_t *f;
+	const char *accept;
+	const char *match;
+	char headers[160];
+	char etag[16];
+	bool bGz;
+
+	f = HTTP_FindStaticFile(urlStr);
+	if (f == 0)
+		return 0;
+	accept = http_getHeader(request, "Accept-Encoding");
+	bGz = f->bGzValid && accept && strstr(accept, "gzip");
+	// gzipped and plain are different representations, so they have different tags
+	snprintf(etag, sizeof(etag), "\"%08X%s\"", f->crc, bGz ? "g" : "");
+	snprintf(headers, sizeof(headers),
+		"Cache-Control: public, max-age=31536000, immutable\r\n"
+		"ETag: %s\r\n"
+		"Vary: Accept-Encoding\r\n"
+		"%s",
+		etag, bGz ? "Content-Encoding: gzip\r\n" : "");
+	match = http_getHeader(request, "If-None-Match");
+	if (match && strstr(match, etag))
+	{
+		request->responseCode = HTTP_RESPONSE_NOT_MODIFIED;
+		http_setup_ex(request, f->mimeType, headers);
+	}
+	else
+	{
+		http_setup_ex(request, f->mimeType, headers);
+		if (bGz)
+		{
+			postany(request, (const char *)f->gz, f->gzLen);
+		}
+		else
+		{
+			postany(request, f->plain, f->plainLen);
+		}
+	}
+	poststr(request, NULL);
+	return 1;
 }
 
 const char *http_checkArg(const char *p, const char *n)
@@ -519,6 +645,26 @@ int http_getArgInteger(const char *base, const char *name)
 	return atoi(tmp);
 }
 
+const char *http_getHeader(http_request_t *request, const char *name)
+{
+	int i;
+	int len = strlen(name);
+	const char *p;
+
+	for (i = 0; i < request->numheaders; i++)
+	{
+		p = request->headers[i];
+		if (!my_strnicmp(p, name, len) && p[len] == ':')
+		{
+			p += len + 1;
+			while (*p == ' ')
+				p++;
+			return p;
+		}
+	}
+	return 0;
+}
+
 const char *htmlPinRoleNames[] = {
 	" ",
 	"Rel",
@@ -726,6 +872,23 @@ int postany(http_request_t *request, const char *str, int len)
 #endif
 }
 
+// Sends len bytes that caller has already put into reply buffer right after
+// replylen, so big bodies don't have to be copied again through postany.
+// Like postany, keeps them in buffer for unit tests without socket.
+int http_sendReplyTail(http_request_t *request, int len)
+{
+	request->replylen += len;
+	// fd will be NULL for unit tests where HTTP packet is faked locally
+	if (request->fd == 0)
+	{
+		return request->replylen;
+	}
+	len = send(request->fd, request->reply, request->replylen, 0);
+	request->reply[0] = 0;
+	request->replylen = 0;
+	return len < 0 ? -1 : 0;
+}
+
 // add some more output safely, sending if necessary.
 // call with str == NULL to force send.
 int poststr(http_request_t *request, const char *str)
@@ -957,6 +1120,8 @@ int HTTP_ProcessPacket(http_request_t *request)
 		return http_fn_testmsg(request);
 	if (http_checkUrlBase(urlStr, "index"))
 		return http_fn_index(request);
+	if (HTTP_ServeStaticFile(request, urlStr))
+		return 0;
 
 	if (http_checkUrlBase(urlStr, "about"))
 		return http_fn_about(request);
@@ -1061,9 +1226,83 @@ See https://github.com/openshwprojects/OpenBK7231T_App/blob/main/BUILDING.md for
 */
 
 // region_start htmlHeadStyle
-const char htmlHeadStyle[] = "<style>div,fieldset,input,select{padding:5px;font-size:1em;margin:0 0 .2em}fieldset{background:#4f4f4f}p{margin:.5em 0}input{width:100%;box-sizing:border-box;-webkit-box-sizing:border-box;-moz-box-sizing:border-box;background:#ddd;color:#000}form{margin-bottom:.5em}input[type=checkbox],input[type=radio]{width:1em;margin-right:6px;vertical-align:-1px}input[type=range]{width:99%}select{width:100%;background:#ddd;color:#000}textarea{resize:vertical;width:98%;height:318px;padding:5px;overflow:auto;background:#1f1f1f;color:#65c115}body{text-align:center;font-family:verdana,sans-serif}body,h1 a{background:#21333e;color:#eaeaea}td{padding:0}button,input[type=submit]{border:0;border-radius:.3rem;background:#1fa3ec;color:#faffff;line-height:2.4rem;font-size:1.2rem;cursor:pointer}input[type=submit]{width:100%;transition-duration:.4s}input[type=submit]:hover{background:#0e70a4}.bred{background:#d43535!important}.bred:hover{background:#931f1f!important}.bgrn{background:#47c266!important}.bgrn:hover{background:#5aaf6f!important}a{color:#1fa3ec;text-decoration:none}.p{float:left;text-align:left}.q{float:right;text-align:right}.r{border-radius:.3em;padding:2px;margin:6px 2px;background:linear-gradient(90deg,#ffa000,#a6d1ff)}.hf{display:none}.hdiv{width:95%;white-space:nowrap}.hele{width:210px;display:inline-block;margin-left:2px}div#state{padding:0}div#changed{padding:0;height:23px}div#main{text-align:left;display:inline-block;color:#eaeaea;min-width:340px;max-width:800px}table{table-layout:fixed;width:100%}.disp-none{display:none}.disp-inline{display:inline-block}.safe{color:red}form.indent{padding-left:16px}li{margin:5px 0}.off,.on{text-align:center;font-size:54px}.on{font-weight:700}</style>";
+const char htmlHeadStyle[] = "div,fieldset,input,select{padding:5px;font-size:1em;margin:0 0 .2em}fieldset{background:#4f4f4f}p{margin:.5em 0}input{width:100%;box-sizing:border-box;-webkit-box-sizing:border-box;-moz-box-sizing:border-box;background:#ddd;color:#000}form{margin-bottom:.5em}input[type=checkbox],input[type=radio]{width:1em;margin-right:6px;vertical-align:-1px}input[type=range]{width:99%}select{width:100%;background:#ddd;color:#000}textarea{resize:vertical;width:98%;height:318px;padding:5px;overflow:auto;background:#1f1f1f;color:#65c115}body{text-align:center;font-family:verdana,sans-serif}body,h1 a{background:#21333e;color:#eaeaea}td{padding:0}button,input[type=submit]{border:0;border-radius:.3rem;background:#1fa3ec;color:#faffff;line-height:2.4rem;font-size:1.2rem;cursor:pointer}input[type=submit]{width:100%;transition-duration:.4s}input[type=submit]:hover{background:#0e70a4}.bred{background:#d43535!important}.bred:hover{background:#931f1f!important}.bgrn{background:#47c266!important}.bgrn:hover{background:#5aaf6f!important}a{color:#1fa3ec;text-decoration:none}.p{float:left;text-align:left}.q{float:right;text-align:right}.r{border-radius:.3em;padding:2px;margin:6px 2px;background:linear-gradient(90deg,#ffa000,#a6d1ff)}.hf{display:none}.hdiv{width:95%;white-space:nowrap}.hele{width:210px;display:inline-block;margin-left:2px}div#state{padding:0}div#changed{padding:0;height:23px}div#main{text-align:left;display:inline-block;color:#eaeaea;min-width:340px;max-width:800px}table{table-layout:fixed;width:100%}.disp-none{display:none}.disp-inline{display:inline-block}.safe{color:red}form.indent{padding-left:16px}li{margin:5px 0}.off,.on{text-align:center;font-size:54px}.on{font-weight:700}";
 // region_end htmlHeadStyle
 
+// region_start htmlHeadStyleGz
+const unsigned char htmlHeadStyleGz[] = {
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x75,0x55,0x61,0x8f,0xa3,0x2c,0x10,0xfe,0x2b,0xbd,0x34,0x9b,0xdc,0x25,0x4a,0xb0,0xd6,0xee,0x2e,0xe6,0xfd,0x25,
+0x97,0xfd,0x30,0xca,0xa0,0x64,0x15,0x78,0x11,0x5b,0x7a,0x86,0xff,0x7e,0xc1,0xea,0x9e,0x6d,0xba,0x21,0x69,0xca,0xc0,0xcc,0xf3,0xcc,0x33,0x33,0xc8,0xe5,0x39,0x11,
+0x12,0x3b,0x3e,0xa0,0x4b,0xa4,0x32,0xa3,0x4b,0x06,0xec,0xb0,0x76,0x93,0x01,0xce,0xa5,0x6a,0x58,0x61,0x7c,0x29,0xb4,0x72,0xe9,0x20,0xff,0x20,0xcb,0xb0,0x2f,0x7b,
+0xb0,0x8d,0x54,0x8c,0xee,0xe8,0x8e,0x1c,0xb0,0x0f,0xab,0xff,0x54,0x41,0xfd,0xd9,0x58,0x3d,0x2a,0xce,0xf6,0x47,0x11,0x57,0x30,0xd3,0x72,0x9b,0x14,0xd8,0xef,0x68,
+0x98,0x21,0xa6,0x8b,0xe4,0xae,0x65,0x19,0xa5,0x2f,0x65,0xa5,0x7d,0x8c,0x1c,0x91,0x2a,0x6d,0x39,0xda,0xb4,0xd2,0xbe,0x4c,0x2f,0x58,0x7d,0x4a,0x97,0x7e,0x73,0xda,
+0xeb,0x3f,0xdf,0x1c,0x6d,0x29,0x70,0xce,0xcb,0x5a,0x77,0xda,0xb2,0x3d,0xa5,0x34,0x08,0x6d,0xfb,0x85,0x4d,0x5a,0x69,0xe7,0x74,0x3f,0x93,0xba,0x51,0xfa,0xed,0xae,
+0x06,0xff,0xab,0x5b,0xac,0x3f,0x2b,0xed,0x3f,0x92,0x8d,0xd1,0x02,0x97,0xfa,0x63,0xe5,0xfc,0x95,0x7f,0x6a,0x65,0xd3,0x3a,0x76,0x32,0xbe,0x3c,0xa3,0x75,0xb2,0x86,
+0x2e,0x85,0x4e,0x36,0x8a,0xa5,0x99,0xf1,0xe1,0x2e,0x80,0x6a,0x70,0x0d,0xf0,0xfe,0xfe,0x12,0x16,0x85,0xb7,0x2a,0x7c,0x4f,0xdb,0xa1,0x77,0x60,0x11,0x26,0x8b,0x73,
+0x05,0x56,0xb0,0x72,0x89,0xf7,0xf6,0x52,0xb6,0x38,0x53,0xc9,0xb3,0x37,0xe3,0xcb,0x6d,0xdd,0xf4,0x19,0xad,0xe8,0xf4,0x85,0xc1,0xe8,0xf4,0x1d,0x48,0x26,0xe2,0x5a,
+0x71,0x4e,0x45,0x9d,0x65,0x45,0xa8,0x34,0xbf,0x4e,0x11,0x6f,0x49,0xa4,0x46,0xe5,0xd0,0xde,0xaa,0x2f,0xa0,0x97,0xdd,0x35,0xa2,0x73,0x50,0x90,0x0c,0xa0,0x86,0x74,
+0x40,0x2b,0xc5,0xec,0x95,0xb4,0xd9,0x0e,0xee,0xea,0x7f,0xc8,0xf2,0x3c,0xc7,0x15,0x00,0x21,0xae,0xe0,0xf8,0x57,0x5b,0xd1,0x50,0x8d,0xce,0x69,0xb5,0x55,0x7a,0x18,
+0xab,0x5e,0xba,0x8f,0xe9,0x56,0x4f,0x46,0xcb,0xa5,0xb0,0xb1,0x02,0xe3,0xc0,0x48,0x6e,0xb1,0x7f,0xc8,0x02,0x72,0xac,0x57,0x10,0x01,0x42,0x08,0x51,0x76,0x52,0x61,
+0xba,0x48,0x72,0x20,0xc7,0xe8,0xb3,0xe9,0x5f,0x72,0x88,0x86,0x7a,0xb4,0x83,0xb6,0xcc,0x68,0x19,0x33,0x0c,0x4f,0x38,0x6c,0x8a,0xe3,0x2c,0xa8,0x41,0x3a,0xa9,0x55,
+0xca,0x47,0x0b,0xf1,0x0f,0x23,0xc7,0xe1,0x89,0x17,0x6b,0xa3,0xe2,0x77,0x3a,0x50,0x7c,0xa5,0x70,0x0c,0xa4,0xb2,0xc8,0xef,0x0e,0xf8,0x31,0x2f,0xf2,0xe2,0x87,0xec,
+0x8d,0xb6,0x0e,0x94,0xbb,0x5d,0x79,0x12,0xe1,0x3d,0x8f,0xa5,0xba,0xbb,0xd8,0x58,0x75,0x3f,0x6c,0xaf,0xf5,0xe1,0x74,0x7a,0xbc,0xf2,0x24,0x56,0x01,0x20,0x4e,0xdb,
+0x58,0x30,0x2d,0xe2,0x2d,0x52,0xce,0xd5,0xe7,0x58,0xeb,0x25,0x4f,0xa5,0x15,0x06,0x62,0x26,0xd1,0x69,0x70,0xac,0x43,0xe1,0xca,0x4d,0x83,0xc4,0x7d,0x20,0xff,0x2f,
+0xa7,0xf3,0x40,0x6c,0x8f,0x67,0x43,0x20,0x76,0x7a,0xac,0x23,0xf6,0x5f,0x6d,0x7a,0x30,0x7e,0x7d,0x50,0x4e,0xc6,0xef,0xe2,0x76,0x43,0x38,0xd6,0x12,0x6c,0xda,0x44,
+0x4f,0x54,0xee,0xe7,0x3b,0xe5,0xd8,0x24,0x7b,0x21,0x80,0x52,0x9a,0xec,0xe1,0xc4,0x33,0x21,0x7e,0x05,0xd2,0x8a,0x89,0xcb,0xc1,0x74,0x70,0x5d,0x18,0xb7,0x5c,0x9e,
+0xd7,0x89,0x2b,0x5e,0xca,0x4b,0x2b,0x1d,0xa6,0x83,0x81,0x1a,0x99,0xd2,0x17,0x0b,0x26,0x90,0x16,0x3b,0x5c,0xae,0x1c,0x32,0x6a,0x7c,0xb9,0x46,0x90,0x6a,0x6e,0xa1,
+0xaa,0xd3,0xf5,0xe7,0x3a,0xec,0x31,0xd3,0xc8,0x35,0x70,0x79,0xde,0x0f,0x0e,0x1c,0x6e,0x3a,0x39,0xda,0xea,0x36,0x4e,0xf9,0xa6,0xbf,0xd7,0xa9,0x3c,0xe4,0x8b,0x57,
+0x0f,0x52,0x4d,0x0f,0xe2,0x3d,0xc7,0xbc,0x1b,0x9a,0xb2,0x97,0x2a,0xbd,0xd1,0xcc,0x8f,0x74,0x56,0xcb,0x2f,0xfb,0x37,0x4a,0x8d,0x0f,0x0e,0xaa,0x0e,0xa7,0xf9,0x37,
+0xed,0xe0,0xaa,0x47,0xc7,0x84,0xf4,0xc8,0xcb,0x7f,0x2d,0x1c,0x48,0xc4,0x49,0xa3,0x34,0x0f,0x3a,0xcd,0xf6,0x1b,0xf8,0xf4,0x8c,0x4b,0x20,0x03,0x08,0x5c,0x9a,0xc4,
+0x22,0x9f,0x5f,0x51,0x22,0x15,0x47,0xf5,0xf5,0x89,0xb8,0x89,0x93,0x9d,0x8c,0x0f,0x9d,0x5c,0xdf,0xfb,0xc2,0xf8,0x1d,0x0d,0x44,0x0b,0x91,0x10,0xad,0xbe,0x7b,0x55,
+0xe6,0x99,0x2c,0x8e,0xc6,0x87,0x78,0x69,0x36,0x5d,0x6e,0xb2,0xbd,0x52,0x1a,0xfe,0x02,0xb0,0xd4,0x79,0x7e,0x9d,0x06,0x00,0x00
+};
+// region_end htmlHeadStyleGz
+
+// region_start pageScript
+const char pageScript[] = "var firstTime,lastTime,onlineFor,req=null,onlineForEl=null,stateVersion=\"0\",refreshInterval=parseInt(document.currentScript.dataset.refresh,10)||1e3,events=null,getElement=e=>document.getElementById(e);function stateInterval(){return events&&1==events.readyState?3e4:refreshInterval}function applyVolatile(e){var t,n,o;try{t=JSON.parse(e)}catch(e){return}for(n in t)(o=getElement(n))&&(o.textContent=t[n])}function showState(){clearTimeout(firstTime),clearTimeout(lastTime),null!=req&&req.abort();var t=getElement(\"state\");t&&((req=new XMLHttpRequest).onreadystatechange=()=>{var e;4==req.readyState&&\"OK\"==req.statusText&&(e=document.activeElement,req.responseText.length&&\"SELECT\"!=e.tagName&&(\"INPUT\"!=e.tagName||\"number\"!=e.type&&\"color\"!=e.type)&&(t.innerHTML=req.responseText,stateVersion=req.getResponseHeader(\"X-State-Version\")||\"0\"),applyVolatile(req.getResponseHeader(\"X-State-Volatile\")),clearTimeout(firstTime),clearTimeout(lastTime),lastTime=setTimeout(showState,stateInterval()))},req.open(\"GET\",\"index?state=1&v=\"+stateVersion,!0),req.send(),firstTime=setTimeout(showState,stateInterval()))}function fmtUpTime(e){var t,n,o=Math.floor(e/86400);return e%=86400,t=Math.floor(e/3600),e%=3600,n=Math.floor(e/60),e=e%60,0<o?o+` days, ${t} hours, ${n} minutes and ${e} seconds`:0<t?t+` hours, ${n} minutes and ${e} seconds`:0<n?n+` minutes and ${e} seconds`:`just ${e} seconds`}function updateOnlineFor(){onlineForEl.textContent=fmtUpTime(++onlineFor)}function onLoad(){(onlineForEl=getElement(\"onlineFor\"))&&(onlineFor=parseInt(onlineForEl.dataset.initial,10))&&setInterval(updateOnlineFor,1e3),window.EventSource&&getElement(\"state\")&&((events=new EventSource(\"/events\")).addEventListener(\"state\",e=>{e.data!=stateVersion&&showState()}),events.addEventListener(\"vstate\",e=>applyVolatile(e.data))),showState()}function submitTemperature(e){var t=getElement(\"form132\");getElement(\"kelvin132\").value=Math.round(1e6/parseInt(e.value)),t.submit()}window.addEventListener(\"load\",onLoad),history.replaceState(null,\"\",window.location.pathname.slice(1)),setTimeout(()=>{var e=getElement(\"changed\");e&&(e.innerHTML=\"\")},5e3);";
+// region_end pageScript
+
+// region_start pageScriptGz
+const unsigned char pageScriptGz[] = {
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x8d,0x55,0x6b,0x6f,0xdb,0x36,0x14,0xfd,0x2b,0x0a,0xd1,0x08,0xbc,0x30,0xab,0xc8,0x73,0x16,0x0c,0x75,0x99,0x00,
+0x2b,0xbc,0x25,0x5b,0x1e,0x43,0xe3,0x16,0x05,0x86,0x01,0x61,0xa4,0xeb,0x58,0x9b,0x4c,0x2a,0xe4,0x95,0x13,0xc3,0xf6,0x7f,0x1f,0x28,0xd9,0x7a,0x78,0xc5,0xda,0x6f,
+0xd4,0xb9,0xe7,0xf2,0x3e,0x79,0xb4,0x54,0x36,0x98,0x65,0xd6,0xd1,0x34,0x5b,0xa0,0xc8,0xd5,0xee,0x60,0x74,0x9e,0x69,0xfc,0xc5,0x58,0x61,0xf1,0x59,0xea,0x32,0xcf,
+0x5b,0x68,0x92,0xd7,0x80,0x23,0x45,0xf8,0x19,0xad,0xcb,0x8c,0x96,0x2c,0x66,0xc2,0xe2,0xcc,0xa2,0x9b,0x5f,0x69,0x42,0xbb,0x54,0xb9,0x2c,0x94,0x75,0x78,0xa5,0x89,
+0xa7,0x26,0x29,0x17,0xa8,0x29,0x4a,0x4a,0x6b,0x51,0xd3,0x7d,0x62,0xb3,0x82,0xa2,0x54,0x91,0x72,0x48,0xd1,0xce,0x4f,0x0c,0x63,0xd8,0x6c,0x86,0x38,0x12,0xb8,0x44,
+0x4d,0xae,0x8e,0xf2,0x84,0x34,0xc9,0xd1,0x7b,0x4b,0x94,0xe7,0xcd,0x4d,0x2d,0xfc,0xf3,0xea,0x2a,0xe5,0x08,0xe3,0x59,0xa9,0x13,0xca,0x8c,0x0e,0xaa,0xbc,0xf6,0x49,
+0x70,0x58,0x5b,0xa4,0xd2,0xea,0xa0,0xbe,0x34,0x0c,0x87,0x52,0xd6,0xc7,0xc8,0xa2,0x4a,0x57,0xf7,0x9e,0x7d,0x31,0xc2,0xd3,0x77,0x07,0xe9,0x6f,0x9b,0x0b,0x55,0x51,
+0xe4,0xab,0xcf,0x26,0x57,0x94,0xe5,0xc8,0x11,0xd6,0x4b,0x65,0x03,0x12,0x5a,0x98,0x31,0xd9,0xd5,0x9a,0xe4,0x6f,0xf7,0x77,0xb7,0x51,0x55,0x2d,0x47,0xd8,0x26,0x8a,
+0x92,0xb9,0xa7,0xd5,0x81,0xb7,0x33,0x63,0xb9,0x0e,0x32,0x1d,0x10,0x70,0x23,0xdb,0xc4,0xb9,0x06,0x08,0x43,0x6e,0x22,0xc2,0x57,0xfa,0x60,0x34,0xf9,0x1a,0xe9,0x4f,
+0xfd,0x17,0xb4,0xa1,0xdd,0xdc,0xbc,0x54,0x19,0x72,0x58,0x27,0x39,0x2a,0xeb,0xa7,0x63,0x4a,0xe2,0xcd,0xcc,0x40,0xf4,0xf0,0xfd,0x04,0x41,0xf8,0xee,0x1d,0x49,0x8b,
+0xcf,0x61,0x68,0xf1,0x39,0x52,0x8f,0xc6,0x12,0x87,0x71,0x95,0x7b,0x37,0x0b,0x56,0xf5,0x8b,0xc1,0x98,0xc2,0x90,0xf3,0x6a,0xdc,0xf8,0x12,0x7c,0xb9,0xb9,0xbe,0x24,
+0x2a,0x3e,0xe2,0x73,0x89,0x8e,0x20,0x32,0xba,0xea,0x56,0xc5,0x4d,0xe6,0x4a,0x3f,0xa1,0xe4,0x20,0xcf,0xab,0x56,0xe0,0xf8,0x54,0xfa,0x40,0x9d,0x86,0x86,0x21,0xbb,
+0xfb,0x9d,0xd5,0xa8,0xf7,0x29,0xdd,0x14,0x5f,0x7d,0x00,0x94,0xcd,0x08,0x55,0x42,0xd9,0x12,0x77,0x69,0x88,0xda,0xdf,0x15,0x46,0x3b,0xf4,0xdc,0x28,0x47,0xfd,0x44,
+0xf3,0x30,0x64,0xf7,0x93,0xeb,0xc9,0x87,0x29,0x3b,0x92,0x18,0x91,0x7a,0xba,0x55,0x0b,0x0c,0x43,0xce,0xae,0x6e,0xff,0xf8,0xd4,0x03,0x37,0x1b,0xa6,0xcb,0xc5,0x23,
+0xda,0x1a,0x5c,0x15,0x3e,0x89,0xc4,0xe4,0xa6,0x05,0x7c,0xbb,0x29,0xca,0xb4,0x46,0x7b,0x39,0xbd,0xb9,0x96,0x87,0x31,0xfb,0x2b,0xed,0xad,0x4f,0x48,0x1f,0x77,0x84,
+0x4b,0x54,0x29,0x5a,0xce,0xbe,0xbc,0xad,0x2a,0x7c,0xbb,0xa3,0x31,0xd8,0x6c,0x58,0xcc,0x40,0xf4,0xb7,0xe4,0x5b,0xce,0x3b,0x1e,0x83,0x83,0xf9,0x7d,0x7b,0xae,0xfb,
+0x93,0x74,0x48,0x7b,0x6b,0xb3,0x26,0xe2,0x60,0xf9,0x01,0xb6,0x55,0x67,0x4d,0x81,0x9a,0xb3,0x5f,0x27,0x53,0x26,0x58,0xa6,0x53,0x7c,0xbd,0xa8,0x88,0x72,0x18,0x2e,
+0x25,0x1b,0x74,0xcb,0x16,0x47,0x31,0x54,0x2e,0x0e,0x75,0xca,0x41,0x34,0x09,0x7d,0x6f,0xbc,0x66,0x77,0x67,0x0b,0xfa,0x54,0x78,0x8f,0xde,0x93,0x91,0x37,0x8a,0xe6,
+0xd1,0x2c,0x37,0xc6,0x72,0x3c,0xf9,0xe9,0xec,0x34,0x8e,0x61,0xbc,0x7f,0xa2,0xc7,0xb2,0x02,0x04,0xf5,0x59,0xa3,0xb3,0x38,0x06,0x81,0xc7,0xd2,0x1f,0x84,0xee,0x1b,
+0xcf,0xbc,0x49,0xe2,0xf1,0x59,0x2c,0xe2,0xf7,0xe6,0xc2,0x0c,0x1e,0x82,0x54,0xad,0x9c,0x08,0xde,0xac,0x69,0x1b,0xcc,0x4d,0x69,0xab,0xb3,0xde,0x06,0x8b,0x4c,0x97,
+0x84,0x2e,0x50,0x3a,0x0d,0xde,0xac,0x71,0x1b,0x38,0x4c,0x8c,0x4e,0xdd,0xc3,0xbb,0xf8,0x3d,0x5d,0xd0,0xe0,0xe1,0xbb,0xd9,0xfa,0x42,0x0f,0x1e,0xfe,0x87,0xf1,0xf0,
+0x77,0xe9,0xa8,0x8f,0xb5,0x7d,0x29,0x8b,0x54,0x11,0xde,0xed,0xe5,0x94,0xc3,0xba,0x23,0xad,0x3d,0x31,0x68,0x3b,0x38,0x18,0x34,0x9c,0x4e,0x87,0x8d,0xbe,0x36,0x2a,
+0xe5,0xb0,0xe6,0x5d,0x71,0xee,0xbe,0xed,0x06,0x67,0xb5,0xd6,0xec,0x3f,0x5b,0x6d,0xee,0xc6,0xde,0x0b,0x72,0xa6,0x33,0xca,0x54,0xee,0x05,0x19,0xc2,0xd0,0x21,0x35,
+0x03,0x3e,0xc8,0x5d,0x0c,0x71,0x04,0xe2,0x25,0xd3,0xa9,0x79,0x89,0x26,0x5e,0x55,0xef,0x4d,0x69,0x13,0x0c,0xc3,0xaf,0x08,0x8c,0x97,0x97,0xbd,0xb2,0xe3,0x4b,0xd0,
+0xa1,0x73,0x76,0x52,0x1b,0x18,0x40,0xa4,0xd2,0xb4,0x32,0x5d,0x67,0x8e,0x50,0xfb,0x47,0x53,0xfb,0x0b,0x94,0xe7,0x6b,0xac,0x72,0x3c,0x92,0xdd,0x8d,0x0d,0xc3,0x8e,
+0x4a,0x6e,0x61,0xf7,0xf7,0xf8,0xca,0x3d,0xcb,0xf6,0xa2,0x03,0x49,0xaf,0x6e,0x05,0x00,0xd1,0xbd,0xa9,0x15,0xe1,0xf2,0x71,0x91,0xd1,0x14,0x17,0x05,0x5a,0x45,0xa5,
+0x6d,0x17,0xba,0xd7,0xeb,0x99,0xb1,0x8b,0xe1,0xe8,0x07,0x06,0xe3,0x2e,0xfa,0x0f,0xe6,0xcb,0x4c,0x57,0x78,0xb4,0x54,0x79,0x89,0xf5,0xf6,0x5a,0x53,0xea,0x94,0x0f,
+0xf1,0xec,0xa4,0x99,0x04,0xd6,0x76,0x00,0x41,0x51,0x1d,0x92,0xc3,0x76,0xd7,0xdb,0xff,0x16,0x93,0x1b,0x95,0x32,0x51,0x6f,0x00,0x88,0x79,0xe6,0xc8,0xd8,0x55,0x64,
+0xb1,0xc8,0x55,0x82,0x75,0x09,0xd5,0xff,0x93,0xb1,0xfd,0x7c,0x72,0x93,0x28,0x5f,0x4f,0x54,0x28,0x9a,0x6b,0xb5,0xc0,0xc8,0xe5,0x59,0x82,0x7c,0xe8,0xeb,0x6e,0xdf,
+0x76,0x2b,0xeb,0xbd,0xea,0x6a,0xd1,0x4f,0x19,0x8c,0xbd,0xfc,0x62,0x47,0x45,0x19,0x83,0xad,0xf8,0x11,0x47,0x30,0xfe,0x17,0xbf,0xdd,0xb0,0xee,0x4d,0x08,0x00,0x00
+};
+// region_end pageScriptGz
+
 // region_start ha_discovery_script
 const char ha_discovery_script[] = "<script type='text/javascript'>function send_ha_disc(){var e=new XMLHttpRequest;e.open(\"GET\",\"/ha_discovery?prefix=\"+document.getElementById(\"ha_disc_topic\").value,!1),e.onload=function(){200===e.status?alert(e.responseText):404===e.status&&alert(\"Error invoking ha_discovery\")},e.onerror=function(){alert(\"Error invoking ha_discovery\")},e.send()}</script>";
 // region_end ha_discovery_script
+
+httpStaticFile_t g_httpStaticFiles[] = {
+	{ "obk.css", httpMimeTypeCSS, htmlHeadStyle, htmlHeadStyleGz, sizeof(htmlHeadStyleGz), 0, 0, false },
+	{ "obk.js", httpMimeTypeJavascript, pageScript, pageScriptGz, sizeof(pageScriptGz), 0, 0, false },
+};
+int g_httpNumStaticFiles = sizeof(g_httpStaticFiles) / sizeof(g_httpStaticFiles[0]);
@@ -10,6 +10,7 @@ extern const char httpMimeTypeBinary[];
 extern const char httpMimeTypeXML[];
 extern const char httpMimeTypeCSS[];           // CSS MIME type
 extern const char httpMimeTypeJavascript[];   // JS MIME type
+extern const char httpCorsHeaders[];
 
 extern const char htmlShortcutIcon[];
 extern const char htmlDoctype[];
@@ -28,7 +29,10 @@ extern const char pageScript[];
 extern const char ha_discovery_script[];
 
 #define HTTP_RESPONSE_OK 200
+#define HTTP_RESPONSE_PARTIAL_CONTENT 206
+#define HTTP_RESPONSE_NOT_MODIFIED 304
 #define HTTP_RESPONSE_NOT_FOUND 404
+#define HTTP_RESPONSE_RANGE_NOT_SATISFIABLE 416
 #define HTTP_RESPONSE_SERVER_ERROR 500
 
 #define MAX_QUERY 16
@@ -56,6 +60,8 @@ typedef struct http_request_tag {
 	int replylen;
 	int replymaxlen;
 	int fd;
+	// handler keeps the socket open (see http_events.c), server must not close it
+	int bDetached;
 
 	// user variables used to build JSON data
 	int userCounter;
@@ -64,6 +70,7 @@ typedef struct http_request_tag {
 
 int HTTP_ProcessPacket(http_request_t* request);
 void http_setup(http_request_t* request, const char* type);
+void http_setup_ex(http_request_t* request, const char* type, const char* extraHeaders);
 void http_setup_gz(http_request_t* request, const char* type);
 void http_html_start(http_request_t* request, const char* pagename);
 void http_html_end(http_request_t* request);
@@ -71,12 +78,21 @@ int poststr(http_request_t* request, const char* str);
 void poststr_escaped(http_request_t* request, char* str);
 void poststr_escapedForJSON(http_request_t* request, char* str);
 int postany(http_request_t* request, const char* str, int len);
+int http_sendReplyTail(http_request_t* request, int len);
 void misc_formatUpTimeString(int totalSeconds, char* o);
 // void HTTP_AddBuildFooter(http_request_t *request);
 // void HTTP_AddHeader(http_request_t *request);
 int http_getRawArg(const char* base, const char* name, char* o, int maxSize);
 int http_getArg(const char* base, const char* name, char* o, int maxSize);
 int http_getArgInteger(const char* base, const char* name);
+// returns value of given request header (without name and colon), or NULL
+const char* http_getHeader(http_request_t* request, const char* name);
+unsigned int HTTP_CRC32(const unsigned char* data, int len);
+unsigned int HTTP_CRC32Update(unsigned int crc, const unsigned char* data, int len);
+unsigned int HTTP_GetStaticFileVersion(const char* name);
+int HTTP_ServeStaticFile(http_request_t* request, const char* urlStr);
+// see http_getIndexStateVersion
+void HTTP_IndexStateChanged();
 
 // poststr with format - for results LESS THAN 128
 int hprintf255(http_request_t* request, const char* fmt, ...);
@@ -58,7 +58,9 @@ static void tcp_client_thread(tcp_thread_t* arg)
 	char* buf = NULL;
 	char* reply = NULL;
 	int replyBufferSize = REPLY_BUFFER_SIZE;
+	http_request_t request;
 
+	memset(&request, 0, sizeof(request));
 	reply = (char*)os_malloc(replyBufferSize);
 	buf = (char*)os_malloc(INCOMING_BUFFER_SIZE);
 
@@ -67,9 +69,6 @@ static void tcp_client_thread(tcp_thread_t* arg)
 		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client failed to malloc buffer");
 		goto exit;
 	}
-	http_request_t request;
-	memset(&request, 0, sizeof(request));
-
 	request.fd = fd;
 	request.received = buf;
 	request.receivedLenmax = INCOMING_BUFFER_SIZE - 2;
@@ -132,7 +131,10 @@ exit:
 	if(reply != NULL)
 		os_free(reply);
 
-	lwip_close(fd);
+	if(!request.bDetached)
+	{
+		lwip_close(fd);
+	}
 	arg->isCompleted = true;
 #if PLATFORM_RDA5981
 	arg->thread = NULL;
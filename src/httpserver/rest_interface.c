@@ -67,6 +67,9 @@ static int http_rest_get_flash_advanced(http_request_t* request);
 static int http_rest_post_flash_advanced(http_request_t* request);
 
 static int http_rest_get_info(http_request_t* request);
+#if ENABLE_OBK_BERRY
+static int http_rest_get_berry(http_request_t* request);
+#endif
 static int http_rest_get_bt_scan(http_request_t* request);
 
 static int http_rest_post_channels(http_request_t* request);
@@ -157,6 +160,11 @@ static int http_rest_get(http_request_t* request) {
 	if (!strcmp(request->url, "api/info")) {
 		return http_rest_get_info(request);
 	}
+#if ENABLE_OBK_BERRY
+	if (!strcmp(request->url, "api/berry")) {
+		return http_rest_get_berry(request);
+	}
+#endif
 #if ENABLE_BT_PROXY
 	if (!strcmp(request->url, "api/bt_scan")) {
 		return http_rest_get_bt_scan(request);
@@ -456,10 +464,123 @@ static int http_rest_run_lfs_file(http_request_t* request) {
 	return 0;
 }
 
+// littlefs never rewrites file data in place, so a changed file gets a new head block.
+// Small files are inlined in their directory entry and have no block,
+// but they fit in the first 128 bytes, which are covered by CRC.
+static void http_lfs_makeETag(lfs_file_t* file, char* out, int maxLen) {
+	char tmp[128];
+	uint32_t crc;
+	uint32_t head;
+	int size;
+	int len;
+
+	size = lfs_file_size(&lfs, file);
+	len = lfs_file_read(&lfs, file, tmp, sizeof(tmp));
+	crc = lfs_crc(0xffffffff, tmp, len > 0 ? len : 0);
+	lfs_file_rewind(&lfs, file);
+	head = (file->flags & LFS_F_INLINE) ? 0 : file->ctz.head;
+	snprintf(out, maxLen, "\"%x-%x-%x\"", size, (unsigned int)head, (unsigned int)crc);
+}
+
+// Only a single range is supported: "bytes=a-b", "bytes=a-" or "bytes=-n".
+// Returns 1 for a valid range, 0 if whole file should be sent, -1 if range can't be satisfied.
+static int http_lfs_parseRange(const char* value, int total, int* start, int* end) {
+	int a, b;
+
+	if (value == 0 || strncmp(value, "bytes=", 6) || strchr(value, ',')) {
+		return 0;
+	}
+	value += 6;
+	if (*value == '-') {
+		// last n bytes, empty file has none
+		b = atoi(value + 1);
+		if (b <= 0 || total == 0) {
+			return -1;
+		}
+		if (b > total) {
+			b = total;
+		}
+		*start = total - b;
+		*end = total - 1;
+		return 1;
+	}
+	if (sscanf(value, "%d-%d", &a, &b) != 2) {
+		if (sscanf(value, "%d-", &a) != 1) {
+			return 0;
+		}
+		b = total - 1;
+	}
+	if (a < 0 || a >= total || b < a) {
+		return -1;
+	}
+	if (b >= total) {
+		b = total - 1;
+	}
+	*start = a;
+	*end = b;
+	return 1;
+}
+
+static void http_lfs_setup(http_request_t* request, const char* mimetype, bool isGzip,
+	const char* etag, int start, int end, int total) {
+	hprintf255(request, httpHeader, request->responseCode, mimetype);
+	poststr(request, "\r\n");
+	poststr(request, httpCorsHeaders);
+	poststr(request, "\r\n");
+	if (isGzip) {
+		poststr(request, "Content-Encoding: gzip\r\n");
+		// precompressed web app assets rarely change, let browser keep them for a day
+		poststr(request, "Cache-Control: max-age=86400\r\n");
+	}
+	else {
+		// browser must ask, but gets 304 if file is the same
+		poststr(request, "Cache-Control: no-cache\r\n");
+	}
+	hprintf255(request, "ETag: %s\r\n", etag);
+	poststr(request, "Accept-Ranges: bytes\r\n");
+	if (request->responseCode == HTTP_RESPONSE_PARTIAL_CONTENT) {
+		hprintf255(request, "Content-Range: bytes %i-%i/%i\r\n", start, end, total);
+	}
+	else if (request->responseCode == HTTP_RESPONSE_RANGE_NOT_SATISFIABLE) {
+		hprintf255(request, "Content-Range: bytes */%i\r\n", total);
+	}
+	if (request->responseCode != HTTP_RESPONSE_NOT_MODIFIED) {
+		hprintf255(request, "Content-Length: %i\r\n", end - start + 1);
+	}
+	poststr(request, "Connection: close\r\n\r\n");
+}
+
+// Sends headers, then reads file straight into the reply buffer and sends it,
+// without copying it again through postany.
+static int http_lfs_streamFile(http_request_t* request, lfs_file_t* file, int start, int end) {
+	int left;
+	int room;
+	int len;
+	int total = 0;
+
+	if (start > 0) {
+		lfs_file_seek(&lfs, file, start, LFS_SEEK_SET);
+	}
+	left = end - start + 1;
+	// flush headers, reply buffer is then free for file data
+	poststr(request, NULL);
+	while (left > 0) {
+		room = request->replymaxlen - request->replylen - 1;
+		if (room <= 0)
+			break;
+		len = lfs_file_read(&lfs, file, request->reply + request->replylen, left < room ? left : room);
+		if (len <= 0)
+			break;
+		if (http_sendReplyTail(request, len) < 0)
+			break;
+		left -= len;
+		total += len;
+	}
+	return total;
+}
+
 static int http_rest_get_lfs_file(http_request_t* request) {
 	char* fpath;
-	char* buff;
-	int len;
 	int lfsres;
 	int total = 0;
 	lfs_file_t* file;
@@ -477,7 +598,6 @@ static int http_rest_get_lfs_file(http_request_t* request) {
 
 	fpath = os_malloc(strlen(request->url) - strlen("api/lfs/") + 1);
 
-	buff = os_malloc(1024);
 	file = os_malloc(sizeof(lfs_file_t));
 	memset(file, 0, sizeof(lfs_file_t));
 
@@ -592,24 +712,35 @@ static int http_rest_get_lfs_file(http_request_t* request) {
 				}
 			}
 
-			if (isGzip) {
-				http_setup_gz(request, mimetype);
+			char etag[32];
+			const char* match;
+			int size, start, end, range;
+
+			size = lfs_file_size(&lfs, file);
+			start = 0;
+			end = size - 1;
+			http_lfs_makeETag(file, etag, sizeof(etag));
+			match = http_getHeader(request, "If-None-Match");
+			range = http_lfs_parseRange(http_getHeader(request, "Range"), size, &start, &end);
+			if (match && strstr(match, etag)) {
+				request->responseCode = HTTP_RESPONSE_NOT_MODIFIED;
+				http_lfs_setup(request, mimetype, isGzip, etag, 0, 0, size);
 			}
-			else {
-				http_setup(request, mimetype);
+			else if (range < 0) {
+				request->responseCode = HTTP_RESPONSE_RANGE_NOT_SATISFIABLE;
+				http_lfs_setup(request, mimetype, isGzip, etag, 0, -1, size);
 			}
-			//#if ENABLE_OBK_BERRY
-			//			http_runBerryFile(request, fpath);
-			//#else
-			do {
-				len = lfs_file_read(&lfs, file, buff, 1024);
-				total += len;
-				if (len) {
-					//ADDLOG_DEBUG(LOG_FEATURE_API, "%d bytes read", len);
-					postany(request, buff, len);
+			else {
+				if (range > 0) {
+					request->responseCode = HTTP_RESPONSE_PARTIAL_CONTENT;
 				}
-			} while (len > 0);
-			//#endif
+				http_lfs_setup(request, mimetype, isGzip, etag, start, end, size);
+				//#if ENABLE_OBK_BERRY
+				//			http_runBerryFile(request, fpath);
+				//#else
+				total = http_lfs_streamFile(request, file, start, end);
+				//#endif
+			}
 			lfs_file_close(&lfs, file);
 			ADDLOG_DEBUG(LOG_FEATURE_API, "%d total bytes read", total);
 		}
@@ -623,7 +754,6 @@ static int http_rest_get_lfs_file(http_request_t* request) {
 	poststr(request, NULL);
 	if (fpath) os_free(fpath);
 	if (file) os_free(file);
-	if (buff) os_free(buff);
 	return 0;
 }
 bool HTTP_checkLFSOverride(http_request_t* request, const char *ext) {
@@ -636,13 +766,10 @@ bool HTTP_checkLFSOverride(http_request_t* request, const char *ext) {
 	if (fix) {
 		*fix = 0;
 	}
-	lfs_file_t* file;
-	file = os_malloc(sizeof(lfs_file_t));
-	memset(file,0, sizeof(lfs_file_t));
-	int lfsres = lfs_file_open(&lfs, file, tmp, LFS_O_RDONLY);
-	if (lfsres == 0) {
-		lfs_file_close(&lfs, file);
-		free(file);
+	// stat is enough to know if the file is there, no need to open it twice
+	struct lfs_info info;
+	int lfsres = lfs_stat(&lfs, tmp, &info);
+	if (lfsres == 0 && info.type == LFS_TYPE_REG) {
 		strcpy_safe(tmp, "api/lfs/", sizeof(tmp));
 		strcat_safe(tmp, request->url, sizeof(tmp));
 		strcat_safe(tmp, ext, sizeof(tmp));
@@ -654,7 +781,6 @@ bool HTTP_checkLFSOverride(http_request_t* request, const char *ext) {
 		// "api/run/", 8)) {
 		return 1;
 	}
-	free(file);
 	return 0;
 }
 static int http_rest_get_lfs_delete(http_request_t* request) {
@@ -1044,6 +1170,18 @@ static int http_rest_post_logconfig(http_request_t* request) {
 /////////////////////////////////////////////////
 
 
+#if ENABLE_OBK_BERRY
+static int http_rest_get_berry(http_request_t* request) {
+	char tmp[256];
+
+	Berry_GetMemStatsJSON(tmp, sizeof(tmp));
+	http_setup(request, httpMimeTypeJson);
+	poststr(request, tmp);
+	poststr(request, NULL);
+	return 0;
+}
+#endif
+
 static int http_rest_get_info(http_request_t* request) {
 	char macstr[3 * 6 + 1];
 	long int* pAllGenericFlags = (long int*)&g_cfg.genericFlags;
@@ -1,44 +1,73 @@
-//The content of this file get set into htmlHeadStyle (new_http.cs)
+//The content of this file get set into pageScript and pageScriptGz (new_http.c)
+//It's served as static obk.js, refresh interval comes from data-refresh of the script tag
 
 var firstTime,
 	lastTime,
 	req = null;
 var onlineFor;
 var onlineForEl = null;
+// version of state HTML currently shown, server sends empty body if it's still the same
+var stateVersion = "0";
+var refreshInterval = parseInt(document.currentScript.dataset.refresh, 10) || 1000;
+// with event stream open, server says when state has changed, so polling is only a fallback
+var events = null;
 
 var getElement = (id) => document.getElementById(id);
 
-// refresh status section every 3 seconds
+function stateInterval() {
+	return events && events.readyState == 1 ? 3e4 : refreshInterval;
+}
+
+// values that change all the time are not part of state version, server sends
+// them as JSON with ids of their elements as keys
+function applyVolatile(json) {
+	var values, id, el;
+	try {
+		values = JSON.parse(json);
+	} catch (e) {
+		return;
+	}
+	for (id in values) {
+		el = getElement(id);
+		if (el) {
+			el.textContent = values[id];
+		}
+	}
+}
+
+// refresh status section every refreshInterval
 function showState() {
 	clearTimeout(firstTime);
 	clearTimeout(lastTime);
 	if (req != null) {
 		req.abort();
 	}
+	var stateEl = getElement("state");
+	if (!stateEl) {
+		return;
+	}
 	req = new XMLHttpRequest();
 	req.onreadystatechange = () => {
 		// somehow status was 0 on Windows, but "OK" works on both Beken and Windows
 		if (req.readyState == 4 && req.statusText == "OK") {
+			var focused = document.activeElement;
 			if (
-				!(
-					document.activeElement.tagName == "SELECT" &&
-					(document.activeElement.tagName == "INPUT" &&
-					(document.activeElement.type == "number" || document.activeElement.type == "color"))
-				)
+				req.responseText.length &&
+				focused.tagName != "SELECT" &&
+				(focused.tagName != "INPUT" || (focused.type != "number" && focused.type != "color"))
 			) {
-				var stateEl = getElement("state");
-				if (stateEl) {
-					stateEl.innerHTML = req.responseText;
-				}
+				stateEl.innerHTML = req.responseText;
+				stateVersion = req.getResponseHeader("X-State-Version") || "0";
 			}
+			applyVolatile(req.getResponseHeader("X-State-Volatile"));
 			clearTimeout(firstTime);
 			clearTimeout(lastTime);
-			lastTime = setTimeout(showState, 3e3);
+			lastTime = setTimeout(showState, stateInterval());
 		}
 	};
-	req.open("GET", "index?state=1", true);
+	req.open("GET", "index?state=1&v=" + stateVersion, true);
 	req.send();
-	firstTime = setTimeout(showState, 3e3);
+	firstTime = setTimeout(showState, stateInterval());
 }
 
 function fmtUpTime(totalSeconds) {
@@ -76,6 +105,15 @@ function onLoad() {
 		}
 	}
 
+	if (window.EventSource && getElement("state")) {
+		events = new EventSource("/events");
+		events.addEventListener("state", (e) => {
+			if (e.data != stateVersion) {
+				showState();
+			}
+		});
+		events.addEventListener("vstate", (e) => applyVolatile(e.data));
+	}
 	showState();
 }
 
@@ -150,6 +150,7 @@ static struct tag_logMemory {
 	int tailserial;
 	int tailtcp;
 	int tailhttp;
+	int tailevents;
 #if ENABLE_LITTLEFS && ENABLE_LOG2LFS
 	int taillfs;
 #endif
@@ -282,9 +283,9 @@ static void initLog(void)
 {
 	bk_printf("Entering initLog()...\r\n");
 #if ENABLE_LITTLEFS && ENABLE_LOG2LFS
-	logMemory.head = logMemory.tailserial = logMemory.tailtcp = logMemory.tailhttp = logMemory.taillfs = 0;
+	logMemory.head = logMemory.tailserial = logMemory.tailtcp = logMemory.tailhttp = logMemory.tailevents = logMemory.taillfs = 0;
 #else
-	logMemory.head = logMemory.tailserial = logMemory.tailtcp = logMemory.tailhttp = 0;
+	logMemory.head = logMemory.tailserial = logMemory.tailtcp = logMemory.tailhttp = logMemory.tailevents = 0;
 #endif
 	logMemory.mutex = xSemaphoreCreateMutex();
 	initialised = 1;
@@ -497,6 +498,10 @@ void addLogAdv(int level, int feature, const char* fmt, ...)
 		{
 			logMemory.tailhttp = (logMemory.tailhttp + 1) % LOGSIZE;
 		}
+		if (logMemory.tailevents == logMemory.head)
+		{
+			logMemory.tailevents = (logMemory.tailevents + 1) % LOGSIZE;
+		}
 #if ENABLE_LITTLEFS && ENABLE_LOG2LFS
 		if (logMemory.taillfs == logMemory.head)
 		{
@@ -623,6 +628,17 @@ static int getHttp(char* buff, int buffsize) {
 	//printf("got tcp: %d:%s\r\n", len,buff);
 	return len;
 }
+
+// log cursor of HTTP event stream (/events?log=1)
+int LOG_GetEventsData(char* buff, int buffsize) {
+	return getData(buff, buffsize, &logMemory.tailevents);
+}
+// skip what was logged before first client has subscribed
+void LOG_ResetEventsCursor() {
+	if (!initialised)
+		return;
+	logMemory.tailevents = logMemory.head;
+}
 #if ENABLE_LITTLEFS && ENABLE_LOG2LFS
 
 // Startup log filename, chosen when the thread first opens the file.
@@ -193,6 +193,11 @@ int MQTT_Post_Received(const char *topic, int topiclen, const unsigned char *dat
 #endif
 	return 1;
 }
+#ifdef WINDOWS
+bool MQTT_HasPendingReceived() {
+	return mqtt_rx_buffer_tail != mqtt_rx_buffer_head;
+}
+#endif
 int MQTT_Post_Received_Str(const char *topic, const char *data) {
 	return MQTT_Post_Received(topic, strlen(topic), (const unsigned char*)data, strlen(data));
 }
@@ -1281,7 +1286,6 @@ static int MQTT_do_connect(mqtt_client_t* client)
 	// host name/ip
 	if (NULL != hostEntry)
 	{
-#ifndef LINUX
 		if (hostEntry->h_addr_list && hostEntry->h_addr_list[0]) {
 			int len = hostEntry->h_length;
 			if (len > 4) {
@@ -1291,7 +1295,6 @@ static int MQTT_do_connect(mqtt_client_t* client)
 			memcpy(&mqtt_ip, hostEntry->h_addr_list[0], len);
 		}
 		else 
-#endif
 		{
 			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_host resolves no addresses?");
 			snprintf(mqtt_status_message, sizeof(mqtt_status_message), "mqtt_host resolves no addresses?");
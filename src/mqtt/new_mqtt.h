@@ -25,6 +25,9 @@ extern mqtt_client_t* mqtt_client;
 
 void MQTT_init();
 int MQTT_RunQuickTick();
+#ifdef WINDOWS
+bool MQTT_HasPendingReceived();
+#endif
 int MQTT_RunEverySecondUpdate();
 void MQTT_BroadcastTasmotaTeleSTATE();
 void MQTT_BroadcastTasmotaTeleSENSOR();
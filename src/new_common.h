@@ -423,6 +423,11 @@ typedef int OSStatus;
 
 int rtos_delay_milliseconds(int sec);
 int delay_ms(int sec);
+// FreeRTOS stubs, see win_rtos_stub.c
+int xTaskGetTickCount();
+int xSemaphoreCreateMutex();
+int xSemaphoreTake(int semaphore, int blockTime);
+int xSemaphoreGive(int semaphore);
 
 enum {
 	kNoErr = 0,
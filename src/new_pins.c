@@ -6,6 +6,7 @@
 #include "quicktick.h"
 #include "new_cfg.h"
 #include "httpserver/new_http.h"
+#include "httpserver/http_events.h"
 #include "logging/logging.h"
 #include "mqtt/new_mqtt.h"
 // Commands register, execution API and cmd tokenizer
@@ -148,6 +149,52 @@ static short g_times[PLATFORM_GPIO_MAX];
 static short g_times2[PLATFORM_GPIO_MAX];
 static byte g_lastValidState[PLATFORM_GPIO_MAX];
 
+// OBK_FLAG_BTN_EDGE_EVENTS - buttons and digital inputs are not read every tick,
+// GPIO interrupt pushes level changes into a queue and PIN_ticks replays them.
+// Only for platforms where HAL_AttachInterrupt can report both edges,
+// BK7231 reports only one, so interrupt is re-armed for opposite edge every time.
+#if defined(WINDOWS) || defined(PLATFORM_W800) || defined(PLATFORM_W600) || defined(PLATFORM_LN882H) \
+	|| defined(PLATFORM_TR6260) || defined(PLATFORM_TXW81X)
+#define PIN_EDGE_EVENTS 1
+#define PIN_EDGE_REARM 0
+#elif defined(PLATFORM_BEKEN)
+#define PIN_EDGE_EVENTS 1
+#define PIN_EDGE_REARM 1
+#else
+#define PIN_EDGE_EVENTS 0
+#endif
+// elsewhere there is no ms clock safe to read in interrupt,
+// so events get time of tick that handles them
+#if defined(PLATFORM_BEKEN) || defined(WINDOWS)
+#define PIN_EDGE_TIMESTAMPS 1
+#else
+#define PIN_EDGE_TIMESTAMPS 0
+#endif
+// must be power of two
+#define PIN_EDGE_QUEUE_SIZE 64
+// edge pins are still read that often, in case an edge was missed
+#define PIN_EDGE_RESYNC_MS 1000
+
+typedef struct pinEdgeEvent_s {
+	byte pin;
+	byte level;
+	uint32_t time;
+} pinEdgeEvent_t;
+
+// single producer (interrupt) and single consumer (PIN_ticks), no lock needed
+static pinEdgeEvent_t g_edgeQueue[PIN_EDGE_QUEUE_SIZE];
+static volatile int g_edgeHead = 0;
+static volatile int g_edgeTail = 0;
+static volatile byte g_edgeOverflow = 0;
+// pin is in edge mode, g_edgeLevel is its last raw level
+static byte g_edgeMode[PLATFORM_GPIO_MAX];
+static byte g_edgeLevel[PLATFORM_GPIO_MAX];
+// time up to which state machine of pin was run
+static uint32_t g_edgePinTime[PLATFORM_GPIO_MAX];
+static int g_edgeResyncTime = 0;
+
+static void PIN_SetEdgeMode(int index, bool bOn);
+
 
 // a bitfield indicating which GPI are inputs.
 // could be used to control edge triggered interrupts...
@@ -758,7 +805,14 @@ bool BTN_ShouldInvert(int index) {
 	return false;
 }
 static uint8_t PIN_ReadDigitalInputValue_WithInversionIncluded(int index) {
-	uint8_t iVal = HAL_PIN_ReadDigitalInput(index);
+	uint8_t iVal;
+
+	if (g_edgeMode[index]) {
+		iVal = g_edgeLevel[index];
+	}
+	else {
+		iVal = HAL_PIN_ReadDigitalInput(index);
+	}
 
 	// support inverted button
 	if (BTN_ShouldInvert(index)) {
@@ -982,6 +1036,8 @@ void PIN_SetPinRoleForPinIndex(int index, int role) {
 
 		// remove from active inputs
 		setGPIActive(index, 0, 0);
+		// PIN_ticks sets it up again if new role can use it
+		PIN_SetEdgeMode(index, false);
 
 		switch (g_cfg.pins.roles[index])
 		{
@@ -1387,6 +1443,9 @@ static void Channel_OnChanged(int ch, int prevValue, int iFlags) {
 			MQTT_ChannelPublish(ch, 0);
 		}
 	}
+#endif
+#if ENABLE_HTTP_EVENTS
+	HTTP_Events_OnChannelChanged(ch, iVal);
 #endif
 	// Simple event - it just says that there was a change
 	EventHandlers_FireEvent(CMD_EVENT_CHANNEL_ONCHANGE, ch);
@@ -2185,12 +2244,277 @@ void PIN_set_wifi_led(int value) {
 static uint32_t g_time = 0;
 static uint32_t g_last_time = 0;
 static int activepoll_time = 0; // time to keep polling active until
+static int g_inputDebounceMS = 250;
+
+static bool PIN_IsButtonRole(int role) {
+	switch (role) {
+	case IOR_Button: case IOR_Button_n:
+	case IOR_Button_pd: case IOR_Button_pd_n:
+	case IOR_Button_ToggleAll: case IOR_Button_ToggleAll_n:
+	case IOR_Button_NextColor: case IOR_Button_NextColor_n:
+	case IOR_Button_NextDimmer: case IOR_Button_NextDimmer_n:
+	case IOR_Button_NextTemperature: case IOR_Button_NextTemperature_n:
+	case IOR_Button_ScriptOnly: case IOR_Button_ScriptOnly_n:
+	case IOR_SmartButtonForLEDs: case IOR_SmartButtonForLEDs_n:
+#if ENABLE_DRIVER_SHUTTERS
+	case IOR_Button_ShutterUp: case IOR_Button_ShutterDown:
+#endif
+		return true;
+	}
+	return false;
+}
+// debounced inputs handled by PIN_DigitalInput_Handler
+static bool PIN_IsDigitalInputRole(int role) {
+	switch (role) {
+	case IOR_DigitalInput: case IOR_DigitalInput_n:
+	case IOR_DigitalInput_NoPup: case IOR_DigitalInput_NoPup_n:
+	case IOR_DoorSensorWithDeepSleep: case IOR_DoorSensorWithDeepSleep_NoPup:
+	case IOR_DoorSensorWithDeepSleep_pd:
+	case IOR_ToggleChannelOnToggle: case IOR_ToggleChannelOnToggle_pd:
+		return true;
+	}
+	return false;
+}
+static void PIN_DigitalInput_OnChange(int i, int value) {
+	int role = g_cfg.pins.roles[i];
+
+	if (role == IOR_ToggleChannelOnToggle || role == IOR_ToggleChannelOnToggle_pd) {
+		if (!CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL)) {
+			CHANNEL_Toggle(g_cfg.pins.channels[i]);
+			EventHandlers_FireEvent(CMD_EVENT_PIN_ONTOGGLE, i);
+		}
+		else {
+			addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Child lock!");
+		}
+	}
+	else if (CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL) == false) {
+		CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
+	}
+}
+static void PIN_DigitalInput_Handler(int i, uint32_t t_diff) {
+	int value;
+
+	// read pin digital value (and already invert it if needed)
+	value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
+
+	// debouncing
+	if (value) {
+		if (g_times[i] > g_inputDebounceMS) {
+			if (g_lastValidState[i] != value) {
+				// became up
+				g_lastValidState[i] = value;
+				PIN_DigitalInput_OnChange(i, value);
+			}
+		}
+		else {
+			g_times[i] += t_diff;
+		}
+		g_times2[i] = 0;
+	}
+	else {
+		if (g_times2[i] > g_inputDebounceMS) {
+			if (g_lastValidState[i] != value) {
+				// became down
+				g_lastValidState[i] = value;
+				PIN_DigitalInput_OnChange(i, value);
+			}
+		}
+		else {
+			g_times2[i] += t_diff;
+		}
+		g_times[i] = 0;
+	}
+}
+
+#if PIN_EDGE_REARM
+static void PIN_ArmEdgeInterrupt(int index, int level);
+#endif
+
+static void PIN_EdgeInterruptHandler(int gpio) {
+	int next;
+	byte level;
+
+	level = HAL_PIN_ReadDigitalInput(gpio);
+#if PIN_EDGE_REARM
+	PIN_ArmEdgeInterrupt(gpio, level);
+#endif
+	next = (g_edgeHead + 1) & (PIN_EDGE_QUEUE_SIZE - 1);
+	if (next == g_edgeTail) {
+		// PIN_ticks will read all edge pins
+		g_edgeOverflow = 1;
+		return;
+	}
+	g_edgeQueue[g_edgeHead].pin = gpio;
+	g_edgeQueue[g_edgeHead].level = level;
+#if PIN_EDGE_TIMESTAMPS
+	g_edgeQueue[g_edgeHead].time = rtos_get_time();
+#endif
+	g_edgeHead = next;
+}
+#if PIN_EDGE_REARM
+static void PIN_ArmEdgeInterrupt(int index, int level) {
+	HAL_AttachInterrupt(index, level ? INTERRUPT_FALLING : INTERRUPT_RISING, PIN_EdgeInterruptHandler);
+}
+#else
+static void PIN_ArmEdgeInterrupt(int index) {
+	HAL_AttachInterrupt(index, INTERRUPT_CHANGE, PIN_EdgeInterruptHandler);
+}
+#endif
+static bool PIN_Edge_IsEnabled() {
+	return PIN_EDGE_EVENTS && g_enable_pins && CFG_HasFlag(OBK_FLAG_BTN_EDGE_EVENTS);
+}
+static void PIN_SetEdgeMode(int index, bool bOn) {
+	if (g_edgeMode[index] == bOn) {
+		return;
+	}
+	if (bOn == false) {
+		HAL_DetachInterrupt(index);
+		g_edgeMode[index] = 0;
+		return;
+	}
+	g_edgeLevel[index] = HAL_PIN_ReadDigitalInput(index);
+#if PIN_EDGE_REARM
+	PIN_ArmEdgeInterrupt(index, g_edgeLevel[index]);
+#else
+	PIN_ArmEdgeInterrupt(index);
+#endif
+	// change before interrupt was attached is caught by resync
+	g_edgePinTime[index] = g_time;
+	g_edgeMode[index] = 1;
+}
+// nothing will happen on edge pin until its level changes
+static bool PIN_Edge_IsIdle(int i) {
+	pinButton_s* handle;
+	int value;
+
+	value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
+	if (PIN_IsButtonRole(g_cfg.pins.roles[i])) {
+		handle = &g_buttons[i];
+		return handle->state == 0 && handle->debounce_cnt == 0
+			&& value == handle->button_level && handle->button_level != handle->active_level;
+	}
+	if (value != g_lastValidState[i]) {
+		return false;
+	}
+	return (value ? g_times2[i] : g_times[i]) == 0;
+}
+// ms after which debounce, click or hold timing of edge pin fires at current level
+static int PIN_Edge_GetNextStep(int i) {
+	pinButton_s* handle;
+	int value, step, left, counter;
+
+	value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
+	if (PIN_IsButtonRole(g_cfg.pins.roles[i])) {
+		handle = &g_buttons[i];
+		step = 0x7fff;
+		if (value != handle->button_level) {
+			step = BTN_DEBOUNCE_MS - handle->debounce_cnt;
+		}
+		switch (handle->state) {
+		case 1:
+			left = BTN_LONG_MS + 1 - handle->ticks;
+			break;
+		case 2:
+			left = BTN_SHORT_MS + 1 - handle->ticks;
+			break;
+		case 5:
+			left = BTN_HOLD_REPEAT_MS + 1 - handle->holdRepeatTicks;
+			break;
+		default:
+			left = step;
+			break;
+		}
+		if (left < step) {
+			step = left;
+		}
+		return step < 1 ? 1 : step;
+	}
+	if (value == g_lastValidState[i]) {
+		return 0x7fff;
+	}
+	counter = value ? g_times[i] : g_times2[i];
+	if (counter > g_inputDebounceMS) {
+		return 0;
+	}
+	return g_inputDebounceMS + 1 - counter;
+}
+// runs state machine of edge pin up to given time, split where timing fires,
+// so result doesn't depend on how often PIN_ticks runs
+static void PIN_Edge_Advance(int i, uint32_t until) {
+	int ms, step;
+
+	ms = (int)(until - g_edgePinTime[i]);
+	if (ms <= 0) {
+		return;
+	}
+	g_edgePinTime[i] = until;
+	while (PIN_Edge_IsIdle(i) == false) {
+		step = PIN_Edge_GetNextStep(i);
+		if (step > ms) {
+			if (ms == 0) {
+				break;
+			}
+			step = ms;
+		}
+		if (PIN_IsButtonRole(g_cfg.pins.roles[i])) {
+			PIN_Input_Handler(i, step);
+		}
+		else {
+			PIN_DigitalInput_Handler(i, step);
+		}
+		ms -= step;
+	}
+}
+static void PIN_Edge_ProcessQueue() {
+	pinEdgeEvent_t ev;
+
+	while (g_edgeTail != g_edgeHead) {
+		ev = g_edgeQueue[g_edgeTail];
+		g_edgeTail = (g_edgeTail + 1) & (PIN_EDGE_QUEUE_SIZE - 1);
+		if (ev.pin >= PLATFORM_GPIO_MAX || g_edgeMode[ev.pin] == 0) {
+			continue;
+		}
+#if PIN_EDGE_TIMESTAMPS
+		// left from before pin was set up
+		if ((int)(ev.time - g_edgePinTime[ev.pin]) < 0) {
+			continue;
+		}
+		if ((int)(ev.time - g_time) > 0) {
+			ev.time = g_time;
+		}
+#else
+		ev.time = g_time;
+#endif
+		// old level lasted until the edge
+		PIN_Edge_Advance(ev.pin, ev.time);
+		g_edgeLevel[ev.pin] = ev.level;
+	}
+}
+// queue overflowed or an edge was missed, read pins again
+static void PIN_Edge_Resync() {
+	int i, level;
+
+	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
+		if (g_edgeMode[i] == 0) {
+			continue;
+		}
+		level = HAL_PIN_ReadDigitalInput(i);
+		if (level != g_edgeLevel[i]) {
+			PIN_Edge_Advance(i, g_time);
+			g_edgeLevel[i] = level;
+#if PIN_EDGE_REARM
+			PIN_ArmEdgeInterrupt(i, level);
+#endif
+		}
+	}
+}
 
 //  background ticks, timer repeat invoking interval defined by PIN_TMR_DURATION.
 void PIN_ticks(void* param)
 {
 	int i;
-	int value;
+	int role;
+	bool bEdgeEvents;
 
 
 	PIN_ApplyCounterDeltas();
@@ -2211,12 +2535,20 @@ void PIN_ticks(void* param)
 	BTN_LONG_MS = (g_cfg.buttonLongPress * 100);
 	BTN_HOLD_REPEAT_MS = (g_cfg.buttonHoldRepeat * 100);
 
-	int debounceMS;
 	if (CFG_HasFlag(OBK_FLAG_BTN_INSTANTTOUCH)) {
-		debounceMS = 100;
+		g_inputDebounceMS = 100;
 	}
 	else {
-		debounceMS = 250;
+		g_inputDebounceMS = 250;
+	}
+
+	bEdgeEvents = PIN_Edge_IsEnabled();
+	PIN_Edge_ProcessQueue();
+	g_edgeResyncTime += t_diff;
+	if (g_edgeOverflow || g_edgeResyncTime >= PIN_EDGE_RESYNC_MS) {
+		g_edgeOverflow = 0;
+		g_edgeResyncTime = 0;
+		PIN_Edge_Resync();
 	}
 
 	int activepins = 0;
@@ -2224,14 +2556,19 @@ void PIN_ticks(void* param)
 
 	for (i = 0; i < PLATFORM_GPIO_MAX; i++)
 	{
+		role = g_cfg.pins.roles[i];
+		// follows flag and role changes
+		PIN_SetEdgeMode(i, bEdgeEvents && (PIN_IsButtonRole(role) || PIN_IsDigitalInputRole(role)));
+
 		// note pins which are active - i.e. would not trigger an edge interrupt on change.
 		// if we have any, then we must poll until none
 		// TODO: this will only be used when GPI interrupt triggeringis used.
 		// but it's useful info anyway...
+		// edge pins are skipped, their level comes from interrupts
 
 		if (i >= 32)
 		{
-			if (g_gpio_index_map[1] & (1 << (i - 32)))
+			if ((g_gpio_index_map[1] & (1 << (i - 32))) && g_edgeMode[i] == 0)
 			{
 				uint32_t level = 1;
 				if (g_gpio_edge_map[1] & (1 << (i - 32))) {
@@ -2249,7 +2586,7 @@ void PIN_ticks(void* param)
 			}
 		}
 		else {
-			if (g_gpio_index_map[0] & (1 << i))
+			if ((g_gpio_index_map[0] & (1 << i)) && g_edgeMode[i] == 0)
 			{
 				uint32_t level = 1;
 				if (g_gpio_edge_map[0] & (1 << i)) {
@@ -2282,104 +2619,15 @@ void PIN_ticks(void* param)
 		}
 		else
 #endif
-			if (g_cfg.pins.roles[i] == IOR_Button || g_cfg.pins.roles[i] == IOR_Button_n
-				|| g_cfg.pins.roles[i] == IOR_Button_pd || g_cfg.pins.roles[i] == IOR_Button_pd_n
-				|| g_cfg.pins.roles[i] == IOR_Button_ToggleAll || g_cfg.pins.roles[i] == IOR_Button_ToggleAll_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextColor || g_cfg.pins.roles[i] == IOR_Button_NextColor_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextDimmer || g_cfg.pins.roles[i] == IOR_Button_NextDimmer_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextTemperature || g_cfg.pins.roles[i] == IOR_Button_NextTemperature_n
-				|| g_cfg.pins.roles[i] == IOR_Button_ScriptOnly || g_cfg.pins.roles[i] == IOR_Button_ScriptOnly_n
-				|| g_cfg.pins.roles[i] == IOR_SmartButtonForLEDs || g_cfg.pins.roles[i] == IOR_SmartButtonForLEDs_n
-#if ENABLE_DRIVER_SHUTTERS
-				|| g_cfg.pins.roles[i] == IOR_Button_ShutterUp || g_cfg.pins.roles[i] == IOR_Button_ShutterDown
-#endif
-				) {
+			if (g_edgeMode[i]) {
+				PIN_Edge_Advance(i, g_time);
+			}
+			else if (PIN_IsButtonRole(role)) {
 				//addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL,"Test hold %i",i);
 				PIN_Input_Handler(i, t_diff);
 			}
-			else if (g_cfg.pins.roles[i] == IOR_DigitalInput || g_cfg.pins.roles[i] == IOR_DigitalInput_n
-				||
-				g_cfg.pins.roles[i] == IOR_DigitalInput_NoPup || g_cfg.pins.roles[i] == IOR_DigitalInput_NoPup_n
-				|| g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep || g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep_NoPup
-				|| g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep_pd) {
-
-				// read pin digital value (and already invert it if needed)
-				value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
-
-#if 0
-				CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-#else
-				// debouncing
-				if (value) {
-					if (g_times[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							// became up
-							g_lastValidState[i] = value;
-							if (CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL) == false) {
-								CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-							}
-						}
-					}
-					else {
-						g_times[i] += t_diff;
-					}
-					g_times2[i] = 0;
-				}
-				else {
-					if (g_times2[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							// became down
-							g_lastValidState[i] = value;
-							if (CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL) == false) {
-								CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-							}
-						}
-					}
-					else {
-						g_times2[i] += t_diff;
-					}
-					g_times[i] = 0;
-				}
-
-#endif
-			}
-			else if (g_cfg.pins.roles[i] == IOR_ToggleChannelOnToggle
-				|| g_cfg.pins.roles[i] == IOR_ToggleChannelOnToggle_pd) {
-				value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
-			
-				if (value) {
-					if (g_times[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							g_lastValidState[i] = value;
-			
-							if (!CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL)) {
-								CHANNEL_Toggle(g_cfg.pins.channels[i]);
-								EventHandlers_FireEvent(CMD_EVENT_PIN_ONTOGGLE, i);
-							} else {
-								addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Child lock!");
-							}
-						}
-					} else {
-						g_times[i] += t_diff;
-					}
-					g_times2[i] = 0;
-				} else {
-					if (g_times2[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							g_lastValidState[i] = value;
-			
-							if (!CFG_HasFlag(OBK_FLAG_BUTTON_DISABLE_ALL)) {
-								CHANNEL_Toggle(g_cfg.pins.channels[i]);
-								EventHandlers_FireEvent(CMD_EVENT_PIN_ONTOGGLE, i);
-							} else {
-								addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Child lock!");
-							}
-						}
-					} else {
-						g_times2[i] += t_diff;
-					}
-					g_times[i] = 0;
-				}
+			else if (PIN_IsDigitalInputRole(role)) {
+				PIN_DigitalInput_Handler(i, t_diff);
 			}
 	}
 
@@ -2423,6 +2671,45 @@ void PIN_ticks(void* param)
 	}
 
 }
+#ifdef WINDOWS
+// simulator can skip time only if no pin needs per-tick work
+bool PIN_NeedsQuickTick() {
+	bool bEdgeEvents;
+	int i;
+	int role;
+
+	if (activepoll_time) {
+		return true;
+	}
+	if (g_edgeHead != g_edgeTail) {
+		return true;
+	}
+	bEdgeEvents = PIN_Edge_IsEnabled();
+	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
+		if (g_counterDeltas[i]) {
+			return true;
+		}
+		role = g_cfg.pins.roles[i];
+		if (role == IOR_LED_WIFI || role == IOR_LED_WIFI_n) {
+			return true;
+		}
+		if (PIN_IsButtonRole(role) || PIN_IsDigitalInputRole(role)) {
+			// idle edge pin waits for interrupt, but if flag was just cleared,
+			// PIN_ticks must run to switch it back to polling
+			if (bEdgeEvents && g_edgeMode[i] && PIN_Edge_IsIdle(i)) {
+				continue;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+// next PIN_ticks must see only its own frame time
+void PIN_SkipIdleTime() {
+	g_time = rtos_get_time();
+	g_last_time = g_time;
+}
+#endif
 const char* g_channelTypeNames[] = {
 	"Default",
 	"Error",
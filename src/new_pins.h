@@ -1401,8 +1401,9 @@ typedef struct pinsState_s {
 #define OBK_FLAG_HTTP_NO_ONOFF_WORDS				49
 #define OBK_FLAG_MQTT_NEVERAPPENDGET				50
 #define OBK_FLAG_WIFI_ENHANCED_FAST_CONNECT			51
+#define OBK_FLAG_BTN_EDGE_EVENTS					52
 
-#define OBK_TOTAL_FLAGS 52
+#define OBK_TOTAL_FLAGS 53
 
 #define LOGGER_FLAG_MQTT_DEDUPER					1
 #define LOGGER_FLAG_POWER_SAVE						2
@@ -1753,6 +1754,10 @@ extern int g_initialPinStates;
 #define CHANNEL_SET_FLAG_SILENT		4
 
 void PIN_ticks(void* param);
+#ifdef WINDOWS
+bool PIN_NeedsQuickTick();
+void PIN_SkipIdleTime();
+#endif
 
 void PIN_DeepSleep_SetWakeUpEdge(int pin, byte edgeCode);
 void PIN_DeepSleep_SetAllWakeUpEdges(byte edgeCode);
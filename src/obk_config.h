@@ -33,6 +33,7 @@
 #define ENABLE_HTTP_FLAGS						1
 #define ENABLE_HTTP_STARTUP						1
 #define ENABLE_HTTP_PING						1
+#define ENABLE_HTTP_EVENTS						1
 #define ENABLE_LED_BASIC						1
 
 // for debugging: Enable logging startup to LFS (only if LFS is present)
@@ -103,6 +104,7 @@
 //#define ENABLE_DRIVER_SM16703P					1
 //#define ENABLE_DRIVER_PIXELANIM					1
 #undef ENABLE_HTTP_MAC
+#undef ENABLE_HTTP_EVENTS
 //#define ENABLE_DRIVER_DCF77					1
 
 #elif PLATFORM_W800
@@ -658,6 +660,8 @@
 #define ENABLE_DRIVER_DS1820					1
 #define ENABLE_DRIVER_TUYAMCU					1
 #define ENABLE_DRIVER_MDNS						1
+// few sockets, held open event streams would leave none for HTTP
+#undef ENABLE_HTTP_EVENTS
 
 //#define ENABLE_DRIVER_DCF77					1
 
@@ -675,6 +679,7 @@
 #define ENABLE_LITTLEFS							1
 #define ENABLE_NTP 								1
 #undef ENABLE_HTTP_MAC
+#undef ENABLE_HTTP_EVENTS
 #undef ENABLE_LED_BASIC
 
 #elif PLATFORM_RDA5981
@@ -769,6 +774,11 @@
 // #define ENABLE_BL_MOVINGAVG					1
 #endif
 
+// sample ring and 1s/1m/15m statistics of power metering, see EnergySamples command
+#if ENABLE_BL_SHARED || ENABLE_DRIVER_HLW8112SPI
+#define ENABLE_BL_SAMPLES						1
+#endif
+
 // ensure that there would be no conflicts
 #if ENABLE_DRIVER_IRREMOTEESP
 #undef ENABLE_DRIVER_IR
@@ -7,3 +7,8 @@
 
 extern unsigned int g_deltaTimeMS;
 extern unsigned int g_timeMs;
+
+#ifdef WINDOWS
+int QuickTick_GetIdleFrames(int maxFrames, int frameMS);
+void QuickTick_SkipIdleFrames(int frames, int frameMS);
+#endif
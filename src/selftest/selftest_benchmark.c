@@ -0,0 +1,279 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../driver/drv_local.h"
+#include "../mqtt/new_mqtt.h"
+#include "../logging/logging.h"
+#include "../devicegroups/deviceGroups_public.h"
+
+#if LINUX
+#include <unistd.h>
+#include <time.h>
+#include <malloc.h>
+#else
+#include <io.h>
+#include <windows.h>
+#include <crtdbg.h>
+#endif
+
+// Micro-benchmarks of hot paths, run with:
+// win_main -benchmark [-benchmarkJSON results.json]
+// Every case starts from SIM_ClearOBK and does a fixed number of
+// operations with fixed inputs, so runs are comparable between builds.
+
+void TuyaMCU_ProcessIncoming(const byte* data, int len);
+int MQTT_process_received();
+
+typedef struct benchCase_s {
+	const char *name;
+	void (*setup)();
+	void (*run)(int iteration);
+	int iterations;
+} benchCase_t;
+
+typedef struct benchResult_s {
+	double nsPerOp;
+	double opsPerSec;
+	long peakHeap;
+} benchResult_t;
+
+static long long Bench_GetTimeNS() {
+#if LINUX
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (long long)(now.QuadPart * (1000000000.0 / freq.QuadPart));
+#endif
+}
+// bytes currently allocated, -1 if not known
+static long Bench_GetHeapInUse() {
+#if LINUX && defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+	struct mallinfo2 mi = mallinfo2();
+#else
+	struct mallinfo mi = mallinfo();
+#endif
+	return (long)mi.uordblks;
+#elif !LINUX && defined(_DEBUG)
+	_CrtMemState state;
+	_CrtMemCheckpoint(&state);
+	return (long)state.lSizes[_NORMAL_BLOCK];
+#else
+	return -1;
+#endif
+}
+
+// OBK logs everything to stdout in simulator, so it's muted while cases run
+static int g_benchStdout = -1;
+
+static void Bench_MuteStdout() {
+	FILE *nul;
+
+	fflush(stdout);
+#if LINUX
+	nul = fopen("/dev/null", "w");
+	g_benchStdout = dup(1);
+	dup2(fileno(nul), 1);
+#else
+	nul = fopen("NUL", "w");
+	g_benchStdout = _dup(1);
+	_dup2(_fileno(nul), 1);
+#endif
+	fclose(nul);
+}
+static void Bench_RestoreStdout() {
+	if (g_benchStdout < 0)
+		return;
+	fflush(stdout);
+#if LINUX
+	dup2(g_benchStdout, 1);
+	close(g_benchStdout);
+#else
+	_dup2(g_benchStdout, 1);
+	_close(g_benchStdout);
+#endif
+	g_benchStdout = -1;
+}
+
+//
+// Cases
+//
+static void Bench_Setup_Empty() {
+}
+static void Bench_Run_ExecuteCommand(int i) {
+	CMD_ExecuteCommand((i & 1) ? "setChannel 1 5" : "setChannel 1 6", 0);
+}
+static void Bench_Setup_Expression() {
+	CMD_ExecuteCommand("setChannel 1 15", 0);
+	CMD_ExecuteCommand("setChannel 2 4", 0);
+}
+static void Bench_Run_Expression(int i) {
+	CMD_EvaluateExpression("($CH1*10+$CH2)/2-1", 0);
+}
+static void Bench_Run_Tokenizer(int i) {
+	Tokenizer_TokenizeString("chart_setVar 0 \"Room T\" \"axtemp\" 1 2 3", TOKENIZER_ALLOW_QUOTES);
+}
+static void Bench_Setup_LogFiltered() {
+	CMD_ExecuteCommand("loglevel 1", 0);
+}
+static void Bench_Run_Log(int i) {
+	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Benchmark %i value %f", i, 1.5f);
+}
+static void Bench_Setup_LogFormatted() {
+	CMD_ExecuteCommand("loglevel 6", 0);
+}
+static char g_benchTopic[64];
+static void Bench_Setup_MQTT() {
+	snprintf(g_benchTopic, sizeof(g_benchTopic), "cmnd/%s/setChannel", CFG_GetMQTTClientId());
+}
+static void Bench_Run_MQTT(int i) {
+	MQTT_Post_Received_Str(g_benchTopic, (i & 1) ? "1 5" : "1 6");
+	MQTT_process_received();
+}
+static void Bench_Setup_HTTP() {
+	PIN_SetPinRoleForPinIndex(9, IOR_Relay);
+	PIN_SetPinChannelForPinIndex(9, 1);
+	PIN_SetPinRoleForPinIndex(24, IOR_PWM);
+	PIN_SetPinChannelForPinIndex(24, 2);
+}
+static void Bench_Run_HTTP_IndexState(int i) {
+	Test_FakeHTTPClientPacket_GET("index?state=1");
+}
+static void Bench_Run_HTTP_Status(int i) {
+	Test_FakeHTTPClientPacket_GET("cm?cmnd=STATUS");
+}
+static void Bench_Setup_TuyaMCU() {
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 1 bool 1", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 2", 0);
+}
+static void Bench_Run_TuyaMCU(int i) {
+	// dpId 1 bool and dpId 2 value in one report
+	static const byte packet[] = {
+		0x55, 0xAA, 0x03, 0x07, 0x00, 0x0D,
+		0x01, 0x01, 0x00, 0x01, 0x01,
+		0x02, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x14,
+		0x36
+	};
+	TuyaMCU_ProcessIncoming(packet, sizeof(packet));
+}
+static byte g_benchDGR[64];
+static int g_benchDGRLen;
+static void Bench_Setup_DGR() {
+	CFG_DeviceGroups_SetName("benchGroup");
+	CFG_DeviceGroups_SetRecvFlags(DGR_SHARE_POWER);
+	CMD_ExecuteCommand("startDriver DGR", 0);
+	DGR_SpoofNextDGRPacketSource("192.168.0.123");
+}
+static void Bench_Run_DGR(int i) {
+	// new sequence every time, so packet is not ignored as a repeat
+	g_benchDGRLen = DGR_Quick_FormatPowerState(g_benchDGR, sizeof(g_benchDGR), "benchGroup", i + 1, 0, i & 1, 1);
+	DGR_ProcessIncomingPacket((char*)g_benchDGR, g_benchDGRLen);
+}
+static void Bench_Setup_Strip() {
+	CMD_ExecuteCommand("startDriver SM16703P", 0);
+	CMD_ExecuteCommand("SM16703P_Init 256 GRBW", 0);
+}
+static void Bench_Run_Strip(int i) {
+	Strip_setPixel(i & 255, i & 0xFF, (i >> 1) & 0xFF, (i >> 2) & 0xFF, 0, (i >> 3) & 0xFF);
+}
+
+static benchCase_t g_benchCases[] = {
+	{ "CMD_ExecuteCommand", Bench_Setup_Empty, Bench_Run_ExecuteCommand, 200000 },
+	{ "CMD_EvaluateExpression", Bench_Setup_Expression, Bench_Run_Expression, 200000 },
+	{ "Tokenizer_TokenizeString", Bench_Setup_Empty, Bench_Run_Tokenizer, 500000 },
+	{ "addLogAdv (filtered)", Bench_Setup_LogFiltered, Bench_Run_Log, 1000000 },
+	{ "addLogAdv (formatted)", Bench_Setup_LogFormatted, Bench_Run_Log, 100000 },
+	{ "MQTT receive and process", Bench_Setup_MQTT, Bench_Run_MQTT, 100000 },
+	{ "HTTP /index?state=1", Bench_Setup_HTTP, Bench_Run_HTTP_IndexState, 5000 },
+	{ "HTTP /cm?cmnd=STATUS", Bench_Setup_HTTP, Bench_Run_HTTP_Status, 5000 },
+	{ "TuyaMCU_ProcessIncoming", Bench_Setup_TuyaMCU, Bench_Run_TuyaMCU, 100000 },
+	{ "DGR_Parse", Bench_Setup_DGR, Bench_Run_DGR, 100000 },
+	{ "Strip_setPixel", Bench_Setup_Strip, Bench_Run_Strip, 2000000 },
+};
+static const int g_numBenchCases = sizeof(g_benchCases) / sizeof(g_benchCases[0]);
+
+static void Bench_RunCase(benchCase_t *c, benchResult_t *r) {
+	long long start, took;
+	long base, cur;
+	int warmup;
+	int i;
+
+	SIM_ClearOBK(0);
+	srand(1234);
+	c->setup();
+	// let drivers start, same as unit tests do
+	Sim_RunFrames(5, false);
+
+	warmup = c->iterations / 10;
+	for (i = 0; i < warmup; i++) {
+		c->run(i);
+	}
+	base = Bench_GetHeapInUse();
+	r->peakHeap = 0;
+	start = Bench_GetTimeNS();
+	for (i = 0; i < c->iterations; i++) {
+		c->run(i);
+		if ((i & 1023) == 0 && base >= 0) {
+			cur = Bench_GetHeapInUse() - base;
+			if (cur > r->peakHeap)
+				r->peakHeap = cur;
+		}
+	}
+	took = Bench_GetTimeNS() - start;
+	if (base >= 0) {
+		cur = Bench_GetHeapInUse() - base;
+		if (cur > r->peakHeap)
+			r->peakHeap = cur;
+	}
+	else {
+		r->peakHeap = -1;
+	}
+	if (took <= 0)
+		took = 1;
+	r->nsPerOp = (double)took / c->iterations;
+	r->opsPerSec = 1000000000.0 / r->nsPerOp;
+}
+
+int SIM_RunBenchmarks(const char *jsonPath) {
+	benchResult_t results[sizeof(g_benchCases) / sizeof(g_benchCases[0])];
+	FILE *f;
+	int i;
+
+	printf("%-28s %12s %14s %12s\n", "Case", "ns/op", "ops/s", "peak heap");
+	for (i = 0; i < g_numBenchCases; i++) {
+		Bench_MuteStdout();
+		Bench_RunCase(&g_benchCases[i], &results[i]);
+		Bench_RestoreStdout();
+		printf("%-28s %12.1f %14.0f %12ld\n", g_benchCases[i].name,
+			results[i].nsPerOp, results[i].opsPerSec, results[i].peakHeap);
+	}
+	Bench_MuteStdout();
+	SIM_ClearOBK(0);
+	Bench_RestoreStdout();
+
+	if (jsonPath == 0) {
+		return 0;
+	}
+	f = fopen(jsonPath, "w");
+	if (f == 0) {
+		printf("Failed to open %s\n", jsonPath);
+		return 1;
+	}
+	fprintf(f, "[\n");
+	for (i = 0; i < g_numBenchCases; i++) {
+		fprintf(f, "  {\"name\":\"%s\",\"iterations\":%i,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,\"peak_heap\":%ld}%s\n",
+			g_benchCases[i].name, g_benchCases[i].iterations, results[i].nsPerOp,
+			results[i].opsPerSec, results[i].peakHeap, (i + 1 < g_numBenchCases) ? "," : "");
+	}
+	fprintf(f, "]\n");
+	fclose(f);
+	printf("Results written to %s\n", jsonPath);
+	return 0;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../berry/be_run.h"
 
 
 void Test_Berry_VarLifeSpan() {
@@ -204,6 +205,114 @@ void Test_Berry_SetTimeout() {
 	SELFTEST_ASSERT_CHANNEL(1, 1);
 
 
+}
+void Test_Berry_ClosureHandles() {
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	int startStackSize = Berry_GetStackSizeTotal();
+	CMD_ExecuteCommand("setChannel 1 0", 0);
+	CMD_ExecuteCommand("setChannel 2 0", 0);
+
+	// handlers are kept per event code
+	CMD_ExecuteCommand("berry addEventHandler(\"OnClick\", 5, def(arg) addChannel(1, 1) end)", 0);
+	CMD_ExecuteCommand("berry addEventHandler(\"OnClick\", 6, def(arg) addChannel(1, 10) end)", 0);
+	SELFTEST_ASSERT(Berry_Test_GetEventHandlersCount(CMD_EVENT_PIN_ONCLICK) == 2);
+	SELFTEST_ASSERT(Berry_Test_GetEventHandlersCount(CMD_EVENT_PIN_ONDBLCLICK) == 0);
+	CMD_Berry_RunEventHandlers_IntInt(CMD_EVENT_PIN_ONCLICK, 6, 0);
+	SELFTEST_ASSERT_CHANNEL(1, 10);
+
+	// handler added by a handler doesn't run in the same dispatch
+	CMD_ExecuteCommand("berry addEventHandler(\"OnClick\", 8, def(arg) addChannel(1, 1000); addEventHandler(\"OnClick\", 8, def(arg) addChannel(2, 1) end); end)", 0);
+	CMD_Berry_RunEventHandlers_IntInt(CMD_EVENT_PIN_ONCLICK, 8, 0);
+	SELFTEST_ASSERT_CHANNEL(1, 1010);
+	SELFTEST_ASSERT_CHANNEL(2, 0);
+	CMD_Berry_RunEventHandlers_IntInt(CMD_EVENT_PIN_ONCLICK, 8, 0);
+	SELFTEST_ASSERT_CHANNEL(1, 2010);
+	SELFTEST_ASSERT_CHANNEL(2, 1);
+	SELFTEST_ASSERT(Berry_Test_GetEventHandlersCount(CMD_EVENT_PIN_ONCLICK) == 5);
+	SELFTEST_ASSERT(berryGetClosuresCount() == 5);
+
+	// timers run by deadline, not by order of adding
+	CMD_ExecuteCommand("setChannel 1 0", 0);
+	CMD_ExecuteCommand("setChannel 2 0", 0);
+	CMD_ExecuteCommand("berry t1 = setTimeout(def() setChannel(2, 300) end, 300)", 0);
+	CMD_ExecuteCommand("berry t2 = setTimeout(def() setChannel(2, 100) end, 100)", 0);
+	CMD_ExecuteCommand("berry t3 = setInterval(def() addChannel(1, 1) end, 200)", 0);
+	SELFTEST_ASSERT(Berry_Test_GetTimersCount() == 3);
+	SELFTEST_ASSERT(berryGetClosuresCount() == 8);
+	Berry_RunThreads(150);
+	SELFTEST_ASSERT_CHANNEL(2, 100);
+	SELFTEST_ASSERT(Berry_Test_GetTimersCount() == 2);
+	Berry_RunThreads(100);
+	SELFTEST_ASSERT_CHANNEL(1, 1);
+	Berry_RunThreads(100);
+	SELFTEST_ASSERT_CHANNEL(2, 300);
+	SELFTEST_ASSERT(Berry_Test_GetTimersCount() == 1);
+
+	// cancelled timer frees its closure, its stale ID doesn't match a new timer
+	CMD_ExecuteCommand("berry cancel(t3)", 0);
+	SELFTEST_ASSERT(Berry_Test_GetTimersCount() == 0);
+	SELFTEST_ASSERT(berryGetClosuresCount() == 5);
+	CMD_ExecuteCommand("berry t4 = setInterval(def() addChannel(2, 1) end, 100)", 0);
+	CMD_ExecuteCommand("berry cancel(t3)", 0);
+	Berry_RunThreads(100);
+	SELFTEST_ASSERT_CHANNEL(2, 301);
+	// interval cancelling itself
+	CMD_ExecuteCommand("berry t5 = setInterval(def() addChannel(1, 10); cancel(t5); end, 50)", 0);
+	Berry_RunThreads(50);
+	Berry_RunThreads(50);
+	Berry_RunThreads(50);
+	SELFTEST_ASSERT_CHANNEL(1, 11);
+	SELFTEST_ASSERT(Berry_Test_GetTimersCount() == 1);
+	SELFTEST_ASSERT(Berry_GetStackSizeTotal() == startStackSize);
+}
+void Test_Berry_MemPool() {
+	berryPoolStats_t st;
+	char tmp[256];
+	int collections, idle, lastPause, maxPause;
+	int idleBefore;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	// small objects come from the pool
+	CMD_ExecuteCommand("berry x = []; for i: 0 .. 99 x.push(str(i)) end", 0);
+	berryPool_GetStats(&st);
+	SELFTEST_ASSERT(st.poolUsedBytes > 0);
+	SELFTEST_ASSERT(st.liveBytes == st.poolUsedBytes + st.heapBytes);
+
+	// garbage is collected from the quick tick while nothing is scheduled
+	CMD_ExecuteCommand("BerryMem 0 1", 0);
+	Berry_GetGCStats(&collections, &idleBefore, &lastPause, &maxPause);
+	CMD_ExecuteCommand("berry for i: 0 .. 499 y = \"garbage\" + str(i) end", 0);
+	Berry_RunThreads(1000);
+	Berry_GetGCStats(&collections, &idle, &lastPause, &maxPause);
+	SELFTEST_ASSERT(idle == idleBefore + 1);
+	// nothing new to collect
+	Berry_RunThreads(1000);
+	Berry_GetGCStats(&collections, &idle, &lastPause, &maxPause);
+	SELFTEST_ASSERT(idle == idleBefore + 1);
+	CMD_ExecuteCommand("BerryMem 0 4096", 0);
+
+	// allocation over the limit throws, VM keeps working
+	berryPool_GetStats(&st);
+	sprintf(tmp, "BerryMem %i", st.liveBytes + 8192);
+	CMD_ExecuteCommand(tmp, 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("berry b = bytes(); b.resize(30000)", 0) == CMD_RES_ERROR);
+	berryPool_GetStats(&st);
+	SELFTEST_ASSERT(st.failedAllocs > 0);
+	CMD_ExecuteCommand("BerryMem 0", 0);
+	CMD_ExecuteCommand("berry setChannel(1, size(x))", 0);
+	SELFTEST_ASSERT_CHANNEL(1, 100);
+	Berry_GetMemStatsJSON(tmp, sizeof(tmp));
+	SELFTEST_ASSERT(strstr(tmp, "\"limit\":0,") != 0);
+
+	// everything is given back when VM is stopped
+	CMD_ExecuteCommand("stopBerry", 0);
+	berryPool_GetStats(&st);
+	SELFTEST_ASSERT(st.liveBytes == 0);
+	SELFTEST_ASSERT(st.poolSize == 0);
 }
 void Test_Berry_Import() {
     int i;
@@ -1537,6 +1646,8 @@ void Test_Berry() {
     Test_Berry_CancelThread();
 	Test_Berry_SetInterval();
 	Test_Berry_SetTimeout();
+	Test_Berry_ClosureHandles();
+	Test_Berry_MemPool();
     Test_Berry_Import();
     Test_Berry_ThreadCleanup();
     Test_Berry_AutoloadModule();
@@ -0,0 +1,59 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+
+void Test_Charts() {
+	// reset whole device
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("startDriver charts", 0);
+	// 8 raw samples, 2 vars, 1 axis, 4 minute and 2 hour samples
+	CMD_ExecuteCommand("chart_create 8 2 1 4 2", 0);
+	CMD_ExecuteCommand("chart_setVar 0 \"Temperature\" \"ax\"", 0);
+	CMD_ExecuteCommand("chart_setVar 1 \"Humidity\" \"ax\"", 0);
+	CMD_ExecuteCommand("chart_setAxis 0 \"ax\" 0 \"Value\"", 0);
+
+	Test_FakeHTTPClientPacket_GET("chart_data");
+	SELFTEST_ASSERT_HTML_REPLY("{\"tier\":0,\"period\":0,\"t0\":0,\"dt\":[],\"v\":[[],[]]}");
+
+	CMD_ExecuteCommand("chart_add 1725606000 20 50", 0);
+	CMD_ExecuteCommand("chart_add 1725606030 22 52.5", 0);
+	CMD_ExecuteCommand("chart_add 1725606060 30 60", 0);
+
+	// raw samples, times are delta encoded
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=0");
+	SELFTEST_ASSERT_HTML_REPLY("{\"tier\":0,\"period\":0,\"t0\":1725606000,\"dt\":[0,30,30],\"v\":[[20,22,30],[50,52.5,60]]}");
+	// first minute is done, second is still accumulating
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=1");
+	SELFTEST_ASSERT_HTML_REPLY("{\"tier\":1,\"period\":60,\"t0\":1725606000,\"dt\":[0,60],"
+		"\"min\":[[20,30],[50,60]],\"avg\":[[21,30],[51.25,60]],\"max\":[[22,30],[52.5,60]]}");
+	// hour is still accumulating
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=2");
+	SELFTEST_ASSERT_HTML_REPLY("{\"tier\":2,\"period\":3600,\"t0\":1725606000,\"dt\":[0],"
+		"\"min\":[[20],[50]],\"avg\":[[24],[54.17]],\"max\":[[30],[60]]}");
+
+	// overflow minute tier, only last 4 minutes + current one are kept
+	for (int i = 2; i < 8; i++) {
+		CMD_ExecuteCommand(va("chart_add %i %i 0", 1725606000 + i * 60, i), 0);
+	}
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=1");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("\"t0\":1725606180,\"dt\":[0,60,60,60,60]");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("\"avg\":[[3,4,5,6,7],[0,0,0,0,0]]");
+
+	// no such tier, raw is sent
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=5");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("{\"tier\":0,");
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=3");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("{\"tier\":0,");
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=-1");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("{\"tier\":0,");
+	Test_FakeHTTPClientPacket_GET("chart_data?tier=-2147483648");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("{\"tier\":0,");
+
+	// index page only has the script, not the samples
+	Test_FakeHTTPClientPacket_GET("index");
+	SELFTEST_ASSERT_HTML_REPLY_CONTAINS("/chart_data?tier=");
+	SELFTEST_ASSERT_HTML_REPLY_NOT_CONTAINS("chartdata0");
+}
+
+
+#endif
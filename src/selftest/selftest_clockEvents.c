@@ -2,6 +2,7 @@
 
 #include "selftest_local.h"
 #include "../driver/drv_ntp.h"
+#include "../driver/drv_deviceclock.h"
 
 static void ResetEventsAndChannels(int eventsCleared) {
 	SELFTEST_ASSERT(TIME_ClearEvents() == eventsCleared);
@@ -15,6 +16,62 @@ static void ResetEventsAndChannels(int eventsCleared) {
 	SELFTEST_ASSERT_CHANNEL(3, 0);
 }
 
+// thousands of events must not make every second slower
+static void Test_ClockEvents_Many() {
+	char buffer[64];
+	unsigned int simTime;
+	int i, checked, fired;
+
+	ResetEventsAndChannels(TIME_Print_EventList());
+
+	// one event every 29 seconds of the day, and more of them at 14:00:00
+	for (i = 0; i < 2979; i++) {
+		snprintf(buffer, sizeof(buffer), "addClockEvent %i 0xff %i addChannel 1 1", i * 29, 10000 + i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	for (i = 0; i < 20; i++) {
+		snprintf(buffer, sizeof(buffer), "addClockEvent 14:00:00 0xff %i addChannel 2 1", 20000 + i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	// events due at the same second run newest first, so this one is removed before it runs
+	CMD_ExecuteCommand("addClockEvent 14:00:01 0xff 30001 addChannel 3 10", 0);
+	CMD_ExecuteCommand("addClockEvent 14:00:01 0xff 30000 backlog removeClockEvent 30001; addChannel 3 1", 0);
+	// this one removes itself
+	CMD_ExecuteCommand("addClockEvent 14:00:02 0xff 30002 backlog removeClockEvent 30002; addChannel 3 100", 0);
+	SELFTEST_ASSERT(TIME_Print_EventList() == 2979 + 20 + 3);
+
+	// 13:54:30, run 1000 seconds
+	simTime = 1681998870;
+	TIME_RunEvents(simTime, true);
+	checked = TIME_GetCheckedEventsCount();
+	for (i = 1; i <= 1000; i++) {
+		TIME_RunEvents(simTime + i, true);
+	}
+	checked = TIME_GetCheckedEventsCount() - checked;
+	// events due in 13:54:30 - 14:11:09, that's seconds 50070 - 51069 of the day
+	fired = 51069 / 29 - 50069 / 29;
+	SELFTEST_ASSERT_CHANNEL(1, fired);
+	SELFTEST_ASSERT_CHANNEL(2, 20);
+	SELFTEST_ASSERT_CHANNEL(3, 101);
+	SELFTEST_ASSERT(TIME_Print_EventList() == 2979 + 20 + 1);
+	// at most one look past due events per second
+	SELFTEST_ASSERT(checked <= fired + 20 + 3 + 1000);
+
+	ResetEventsAndChannels(2979 + 20 + 1);
+
+	// newest first, older event runs last
+	CMD_ExecuteCommand("addClockEvent 14:00:00 0xff 1 setChannel 1 1", 0);
+	CMD_ExecuteCommand("addClockEvent 14:00:00 0xff 2 setChannel 1 2", 0);
+	CMD_ExecuteCommand("addClockEvent 14:00:00 0xff 3 setChannel 2 $CH1", 0);
+	// time going back only resets, then seconds up to 14:00:00 are run
+	TIME_RunEvents(simTime + 329, true);
+	TIME_RunEvents(simTime + 331, true);
+	SELFTEST_ASSERT_CHANNEL(1, 1);
+	SELFTEST_ASSERT_CHANNEL(2, 0);
+
+	ResetEventsAndChannels(3);
+}
+
 void Test_ClockEvents() {
 	// reset whole device
 	SIM_ClearOBK(0);
@@ -141,6 +198,8 @@ void Test_ClockEvents() {
 	SELFTEST_ASSERT_CHANNEL(2, 20);
 	SELFTEST_ASSERT_CHANNEL(3, 30);
 	SELFTEST_ASSERT_CHANNEL(4, 53);
+
+	Test_ClockEvents_Many();
 }
 
 #endif
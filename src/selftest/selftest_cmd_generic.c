@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../driver/drv_uart.h"
 
 void Test_Events() {
 	// reset whole device
@@ -130,6 +131,12 @@ void Test_Events() {
 	SELFTEST_ASSERT_CHANNEL(10, 4);
 }
 
+static int g_uartReceiveCalls;
+
+static void Test_UART_OnReceive() {
+	g_uartReceiveCalls++;
+}
+
 void Test_UART() {
 	int USED_BUFFER_SIZE = 123;
 	UART_InitReceiveRingBuffer(USED_BUFFER_SIZE);
@@ -176,6 +183,79 @@ void Test_UART() {
 		SELFTEST_ASSERT(realSize == reportedSize);
 		next++;
 	}
+	// bulk operations
+	byte data[200];
+	byte check[200];
+	uartSpan_t span;
+	static const byte hdr[2] = { 0x55, 0xAA };
+	for (int i = 0; i < (int)sizeof(data); i++) {
+		data[i] = i;
+	}
+	UART_InitReceiveRingBuffer(USED_BUFFER_SIZE);
+	// move read pointer near the end, so next data wraps
+	UART_AppendBytesToReceiveRingBuffer(data, 100);
+	UART_ConsumeBytes(100);
+	UART_AppendBytesToReceiveRingBuffer(data, 50);
+	SELFTEST_ASSERT(UART_GetDataSize() == 50);
+	SELFTEST_ASSERT(UART_PeekBytes(0, 50, &span) == 50);
+	SELFTEST_ASSERT(span.len[0] == USED_BUFFER_SIZE - 100);
+	SELFTEST_ASSERT(span.len[0] + span.len[1] == 50);
+	SELFTEST_ASSERT(span.data[1][0] == USED_BUFFER_SIZE - 100);
+	for (int i = 0; i < 50; i++) {
+		SELFTEST_ASSERT(UART_GetByte(i) == i);
+	}
+	SELFTEST_ASSERT(UART_CopyBytes(10, check, 100) == 40);
+	SELFTEST_ASSERT(check[0] == 10 && check[39] == 49);
+	SELFTEST_ASSERT(UART_GetDataSize() == 50);
+	// header search, also across wrap
+	SELFTEST_ASSERT(UART_FindHeader(0, hdr, 2) == -1);
+	UART_ConsumeBytes(20);
+	data[0] = 0x55;
+	data[1] = 0xAA;
+	UART_AppendBytesToReceiveRingBuffer(data, 2);
+	SELFTEST_ASSERT(UART_FindHeader(0, hdr, 2) == 30);
+	SELFTEST_ASSERT(UART_FindHeader(31, hdr, 2) == -1);
+	SELFTEST_ASSERT(UART_FindHeader(0, hdr, 1) == 30);
+	SELFTEST_ASSERT(UART_ReadBytes(check, 31) == 31);
+	SELFTEST_ASSERT(check[0] == 20 && check[29] == 49 && check[30] == 0x55);
+	SELFTEST_ASSERT(UART_GetDataSize() == 1);
+	UART_ConsumeBytes(1);
+	// bulk overflow keeps only last (size-1) bytes, just like single byte append
+	for (int i = 0; i < (int)sizeof(data); i++) {
+		data[i] = i;
+	}
+	UART_AppendBytesToReceiveRingBuffer(data, 10);
+	UART_AppendBytesToReceiveRingBuffer(data + 10, 190);
+	SELFTEST_ASSERT(UART_GetDataSize() == USED_BUFFER_SIZE - 1);
+	SELFTEST_ASSERT(UART_GetByte(0) == 200 - (USED_BUFFER_SIZE - 1));
+	SELFTEST_ASSERT(UART_GetByte(USED_BUFFER_SIZE - 2) == 199);
+
+	// receive callback is called for single and bulk append
+	UART_SetReceiveCallback(Test_UART_OnReceive);
+	g_uartReceiveCalls = 0;
+	UART_AppendByteToReceiveRingBuffer(1);
+	UART_AppendBytesToReceiveRingBuffer(data, 20);
+	SELFTEST_ASSERT(g_uartReceiveCalls == 2);
+	UART_SetReceiveCallback(0);
+	UART_AppendByteToReceiveRingBuffer(1);
+	SELFTEST_ASSERT(g_uartReceiveCalls == 2);
+
+	// bulk send is one HAL write
+	int writes;
+	SIM_UART_InitReceiveRingBuffer(64);
+	writes = SIM_UART_GetBulkWrites();
+	UART_SendBytes(data, 5);
+	SELFTEST_ASSERT(SIM_UART_GetBulkWrites() == writes + 1);
+	SELFTEST_ASSERT(SIM_UART_ExpectAndConsumeHexStr("0001020304"));
+	SELFTEST_ASSERT(SIM_UART_GetDataSize() == 0);
+	// what doesn't fit into simulated FIFO is dropped
+	UART_SendBytes(data, 100);
+	SELFTEST_ASSERT(SIM_UART_GetBulkWrites() == writes + 2);
+	SELFTEST_ASSERT(SIM_UART_GetDataSize() == 63);
+	SELFTEST_ASSERT(SIM_UART_GetByte(0) == 0 && SIM_UART_GetByte(62) == 62);
+	UART_SendBytes(data, 0);
+	SELFTEST_ASSERT(SIM_UART_GetBulkWrites() == writes + 2);
+	SIM_ClearUART();
 }
 
 void Test_PinMutex() {
@@ -2,6 +2,7 @@
 
 #include "selftest_local.h"
 #include "../driver/drv_local.h"
+#include "../driver/drv_public.h"
 #include "../devicegroups/deviceGroups_public.h"
 
 static int sim_fakeSeq = 1;
@@ -168,10 +169,53 @@ void Test_DeviceGroups_RGB() {
 	SELFTEST_ASSERT_CHANNEL(3, 0);
 
 }
+void Test_DeviceGroups_SendQueue() {
+	int coalesced, dropped;
+	int coalesced0, dropped0;
+	int pending;
+	int seqs[4];
+
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("startDriver DGR", 0);
+	// stats are never reset, so check the difference
+	DGR_GetSendQueueStats(&coalesced0, &dropped0);
+
+	// no frames are run, so everything stays in queue
+	CMD_ExecuteCommand("DGR_SendBrightness qTestGr 10", 0);
+	CMD_ExecuteCommand("DGR_SendBrightness qTestGr 20", 0);
+	CMD_ExecuteCommand("DGR_SendBrightness qTestGr 30", 0);
+	CMD_ExecuteCommand("DGR_SendPower qTestGr 1 1", 0);
+	// other group is not merged
+	CMD_ExecuteCommand("DGR_SendBrightness otherGr 30", 0);
+	pending = DGR_GetSendQueueStats(&coalesced, &dropped);
+	SELFTEST_ASSERT(pending == 3);
+	SELFTEST_ASSERT(coalesced - coalesced0 == 2);
+	SELFTEST_ASSERT(dropped - dropped0 == 0);
+
+	// fill the pool, rest is dropped
+	for (int i = 0; i < 10; i++) {
+		CMD_ExecuteCommand(va("DGR_SendPower grp%i 1 1", i), 0);
+	}
+	pending = DGR_GetSendQueueStats(&coalesced, &dropped);
+	SELFTEST_ASSERT(pending == 8);
+	SELFTEST_ASSERT(dropped - dropped0 == 5);
+
+	// superseded packet moves to the tail, so sequence numbers go out in order
+	Sim_RunSeconds(2, false);
+	SELFTEST_ASSERT(DGR_GetSendQueueStats(0, 0) == 0);
+	DGR_Test_ClearSentSequences();
+	CMD_ExecuteCommand("DGR_SendPower seqGr 1 1", 0);
+	CMD_ExecuteCommand("DGR_SendBrightness seqGr 50", 0);
+	CMD_ExecuteCommand("DGR_SendPower seqGr 0 1", 0);
+	Sim_RunSeconds(1, false);
+	SELFTEST_ASSERT(DGR_Test_GetSentSequences(seqs, 4) == 2);
+	SELFTEST_ASSERT(seqs[0] < seqs[1]);
+}
 void Test_DeviceGroups() {
 
 	Test_DeviceGroups_TwoRelays();
 	Test_DeviceGroups_RGB();
+	Test_DeviceGroups_SendQueue();
 
 }
 
@@ -0,0 +1,63 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../driver/drv_public.h"
+
+void Test_DriverLists() {
+	int id, calls;
+	int cache = 0;
+	int unknownCache = 0;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("stopDriver *", 0);
+
+	id = DRV_FindDriver("TESTPOWER");
+	SELFTEST_ASSERT(id >= 0);
+	// names are not case sensitive
+	SELFTEST_ASSERT(DRV_FindDriver("testpower") == id);
+	SELFTEST_ASSERT(DRV_FindDriver("NoSuchDriver") == -1);
+	SELFTEST_ASSERT(DRV_IsRunningID(id) == false);
+	SELFTEST_ASSERT(DRV_IsRunningCached("TESTPOWER", &cache) == false);
+	SELFTEST_ASSERT(DRV_HasRunningQuickTick() == false);
+	SELFTEST_ASSERT(DRV_IsMeasuringPower() == false);
+
+	CMD_ExecuteCommand("startDriver TESTPOWER", 0);
+	SELFTEST_ASSERT(DRV_IsRunningID(id));
+	SELFTEST_ASSERT(DRV_IsRunning("TestPower"));
+	SELFTEST_ASSERT(DRV_IsRunningCached("TESTPOWER", &cache));
+	SELFTEST_ASSERT(cache == id + 1);
+	SELFTEST_ASSERT(DRV_IsMeasuringPower());
+	// it has no quick tick, so it's not in that list
+	SELFTEST_ASSERT(DRV_HasRunningQuickTick() == false);
+	SELFTEST_ASSERT(DRV_IsRunningCached("NoSuchDriver", &unknownCache) == false);
+	SELFTEST_ASSERT(unknownCache == -1);
+
+	Sim_RunSeconds(5, false);
+	calls = DRV_Test_GetEverySecondCalls("TESTPOWER");
+	SELFTEST_ASSERT(calls >= 4 && calls <= 6);
+	SELFTEST_ASSERT(DRV_Test_GetQuickTickCalls("TESTPOWER") == 0);
+
+	CMD_ExecuteCommand("startDriver SSDP", 0);
+	SELFTEST_ASSERT(DRV_HasRunningQuickTick());
+	Sim_RunFrames(10, false);
+	SELFTEST_ASSERT(DRV_Test_GetQuickTickCalls("SSDP") == 10);
+	CMD_ExecuteCommand("driverStats reset", 0);
+	SELFTEST_ASSERT(DRV_Test_GetQuickTickCalls("SSDP") == 0);
+
+	// stopped driver is not called and its counters are cleared
+	CMD_ExecuteCommand("stopDriver TESTPOWER", 0);
+	SELFTEST_ASSERT(DRV_IsRunningID(id) == false);
+	SELFTEST_ASSERT(DRV_IsRunningCached("TESTPOWER", &cache) == false);
+	SELFTEST_ASSERT(DRV_IsMeasuringPower() == false);
+	SELFTEST_ASSERT(DRV_IsRunning("SSDP"));
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT(DRV_Test_GetEverySecondCalls("TESTPOWER") == 0);
+	SELFTEST_ASSERT(DRV_Test_GetEverySecondCalls("SSDP") > 0);
+
+	CMD_ExecuteCommand("stopDriver *", 0);
+	SELFTEST_ASSERT(DRV_HasRunningQuickTick() == false);
+	SELFTEST_ASSERT(DRV_IsRunning("SSDP") == false);
+}
+
+#endif
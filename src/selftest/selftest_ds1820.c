@@ -0,0 +1,99 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../httpserver/new_http.h"
+#include "../driver/drv_ds1820_full.h"
+
+static int Test_DS1820_GetTotalReads(int count) {
+	int reads, crcErrors, interval;
+	int total = 0;
+
+	for (int i = 0; i < count; i++) {
+		DS1820_full_Test_GetStats(i, &reads, &crcErrors, &interval);
+		total += reads;
+	}
+	return total;
+}
+
+void Test_DS1820_Full() {
+	int reads, crcErrors, interval;
+	int prev, now;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	// three sensors on one bus, two on another
+	DS1820_full_Sim_Clear();
+	DS1820_full_Sim_AddSensor(9, "28FF000000000001", 21.5f);
+	DS1820_full_Sim_AddSensor(9, "28FF000000000002", 22.0f);
+	DS1820_full_Sim_AddSensor(9, "28FF000000000003", -5.25f);
+	DS1820_full_Sim_AddSensor(10, "28FF000000000004", 30.0f);
+	DS1820_full_Sim_AddSensor(10, "28FF000000000005", 31.0625f);
+	PIN_SetPinRoleForPinIndex(9, IOR_DS1820_IO);
+	PIN_SetPinRoleForPinIndex(10, IOR_DS1820_IO);
+
+	// conversion period 2 seconds, stable sensors up to 4 times less often
+	CMD_ExecuteCommand("startDriver DS1820_FULL 2 4", 0);
+	CMD_ExecuteCommand("DS1820_FULL_setsensor 28FF000000000001 9 \"a\" 1", 0);
+	CMD_ExecuteCommand("DS1820_FULL_setsensor 28FF000000000002 9 \"b\" 2", 0);
+	CMD_ExecuteCommand("DS1820_FULL_setsensor 28FF000000000003 9 \"c\" 3", 0);
+	CMD_ExecuteCommand("DS1820_FULL_setsensor 28FF000000000004 10 \"d\" 4", 0);
+	CMD_ExecuteCommand("DS1820_FULL_setsensor 28FF000000000005 10 \"e\" 5", 0);
+
+	// scratchpads are read one per quick tick, never all at once
+	prev = 0;
+	for (int i = 0; i < 600; i++) {
+		Sim_RunFrames(1, false);
+		now = Test_DS1820_GetTotalReads(5);
+		SELFTEST_ASSERT(now - prev <= 1);
+		prev = now;
+	}
+	SELFTEST_ASSERT(prev >= 5);
+	SELFTEST_ASSERT_CHANNEL(1, 2150);
+	SELFTEST_ASSERT_CHANNEL(2, 2200);
+	SELFTEST_ASSERT_CHANNEL(3, -525);
+	SELFTEST_ASSERT_CHANNEL(4, 3000);
+	SELFTEST_ASSERT_CHANNEL(5, 3106);
+
+	// temperature doesn't change, so sensors are read less often
+	Sim_RunSeconds(30, false);
+	DS1820_full_Test_GetStats(3, &reads, &crcErrors, &interval);
+	SELFTEST_ASSERT(interval == 8);
+	// change resets interval of that sensor only
+	DS1820_full_Sim_SetTemperature(4, 35.5f);
+	Sim_RunSeconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(5, 3550);
+	DS1820_full_Test_GetStats(4, &reads, &crcErrors, &interval);
+	SELFTEST_ASSERT(interval == 2);
+	DS1820_full_Test_GetStats(3, &reads, &crcErrors, &interval);
+	SELFTEST_ASSERT(interval == 8);
+
+	// two bad CRCs are retried and counted, third read succeeds
+	DS1820_full_Sim_SetTemperature(0, 23.0f);
+	DS1820_full_Sim_InjectCRCErrors(0, 2);
+	Sim_RunSeconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(1, 2300);
+	DS1820_full_Test_GetStats(0, &reads, &crcErrors, &interval);
+	SELFTEST_ASSERT(crcErrors == 2);
+
+	// sensor always failing gives up after retries and keeps last value,
+	// others on the same bus are still read
+	DS1820_full_Sim_SetTemperature(1, 25.0f);
+	DS1820_full_Sim_InjectCRCErrors(1, 1000);
+	DS1820_full_Sim_SetTemperature(2, -6.0f);
+	Sim_RunSeconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(2, 2200);
+	SELFTEST_ASSERT_CHANNEL(3, -600);
+	DS1820_full_Test_GetStats(1, &reads, &crcErrors, &interval);
+	SELFTEST_ASSERT(crcErrors >= 4);
+	SELFTEST_ASSERT(interval == 2);
+
+	// sensor works again
+	DS1820_full_Sim_InjectCRCErrors(1, 0);
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT_CHANNEL(2, 2500);
+
+	CMD_ExecuteCommand("DS1820_FULL_stats", 0);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../driver/drv_bl_samples.h"
 
 #if ENABLE_BL_SHARED
 
@@ -532,18 +533,136 @@ void Test_EnergyMeter_ResetBug() {
 
 	SIM_ClearMQTTHistory();
 }
+#if ENABLE_BL_SAMPLES
+static unsigned int Test_EnergyMeter_Get32(const byte *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// looks for bytes sent by driver, anywhere in simulated UART
+static bool Test_EnergyMeter_HasSentUART(const byte *data, int len) {
+	int i, size;
+
+	size = SIM_UART_GetDataSize();
+	for (i = 0; i + len <= size; i++) {
+		int j;
+		for (j = 0; j < len; j++) {
+			if (SIM_UART_GetByte(i + j) != data[j])
+				break;
+		}
+		if (j == len)
+			return true;
+	}
+	return false;
+}
+
+void Test_EnergyMeter_Samples() {
+	// BL0942 REG_MODE with 800 ms RMS refresh
+	static const byte slowMode[] = { 0xA8, 0x19, 0x8F, 0x00, 0x00 };
+	const byte *body;
+	float f;
+	int i, count, bSpike;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	// keep 16 samples, BL0942 refreshes RMS every 400 ms, so it's not polled faster than that
+	CMD_ExecuteCommand("EnergySamples 16 100", 0);
+	SELFTEST_ASSERT(BL_Samples_GetIntervalMs() == 100);
+	CMD_ExecuteCommand("startDriver BL0942", 0);
+	SELFTEST_ASSERT(BL_Samples_GetIntervalMs() == 400);
+	Sim_SendFakeBL0942Packet(230, 0.26, 60);
+	Sim_RunSeconds(1, false);
+	CMD_ExecuteCommand("PowerSet 60", 0);
+	CMD_ExecuteCommand("VoltageSet 230", 0);
+	CMD_ExecuteCommand("CurrentSet 0.26", 0);
+
+	// packet every 400 ms, with one short inrush in the middle
+	for (i = 0; i < 21; i++) {
+		if (i == 10) {
+			Sim_SendFakeBL0942Packet(230, 2.6, 600);
+		}
+		else {
+			Sim_SendFakeBL0942Packet(230, 0.26, 60);
+		}
+		Sim_RunMiliseconds(400, false);
+	}
+	Sim_RunSeconds(1, false);
+	// once a second publish still sees the last reading
+	SELFTEST_ASSERT_EXPRESSION("$power", 60);
+
+	// ring has last 16 of 22 samples, spike included
+	Test_FakeHTTPClientPacket_GET("api/energysamples?since=0");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "application/octet-stream"));
+	body = (const byte*)Helper_GetPastHTTPHeader(Test_GetLastHTTPResponse());
+	SELFTEST_ASSERT(body && !memcmp(body, "OBKS", 4));
+	count = body[6] | (body[7] << 8);
+	SELFTEST_ASSERT(count == 16);
+	SELFTEST_ASSERT(Test_EnergyMeter_Get32(body + 8) == 6);
+	SELFTEST_ASSERT(Test_EnergyMeter_Get32(body + 12) == 22);
+	SELFTEST_ASSERT(Test_EnergyMeter_Get32(body + 16) == 400);
+	bSpike = 0;
+	for (i = 0; i < count; i++) {
+		memcpy(&f, body + 24 + i * 16 + 12, 4);
+		if (f > 500)
+			bSpike++;
+	}
+	SELFTEST_ASSERT(bSpike == 1);
+	// nothing new since last one
+	Test_FakeHTTPClientPacket_GET("api/energysamples?since=22");
+	body = (const byte*)Helper_GetPastHTTPHeader(Test_GetLastHTTPResponse());
+	SELFTEST_ASSERT((body[6] | (body[7] << 8)) == 0);
+	Test_FakeHTTPClientPacket_GET("api/energysamples?meter=1");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 404", 12));
+
+	// minute window with the spike is completed after a minute
+	Sim_RunSeconds(60, false);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$power_max_1m", 0), 600, 1);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$power_min_1m", 0), 60, 1);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$current_max_1m", 0), 2.6f, 0.01f);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$power_avg_1m", 0), (21 * 60 + 600) / 22.0f, 2);
+	// percentiles are approximate
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$power_p50_1m", 0), 60, 6);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(CMD_EvaluateExpression("$power_p99_1m", 0), 600, 60);
+	SELFTEST_ASSERT_EXPRESSION("$power_count_1m", 22);
+	SELFTEST_ASSERT_FLOATCOMPAREEPSILON(DRV_GetReadingStat(0, BL_SAMPLE_VOLTAGE, BL_SAMPLE_WINDOW_1M, BL_SAMPLE_STAT_RMS), 230, 1);
+	// no packets in last second
+	SELFTEST_ASSERT_EXPRESSION("$power_count_1s", 0);
+	SELFTEST_ASSERT(isnan(DRV_GetReadingStat(0, BL_SAMPLE_POWER, BL_SAMPLE_WINDOW_1S, BL_SAMPLE_STAT_MAX)));
+
+	// driver adds samples from its own tick, so ring can't be resized under it
+	SELFTEST_ASSERT(CMD_ExecuteCommand("EnergySamples 32 100", 0) == CMD_RES_ERROR);
+	// but interval can change, and chip goes back to slow RMS refresh
+	SIM_UART_InitReceiveRingBuffer(512);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("EnergySamples 16 1000", 0) == CMD_RES_OK);
+	Sim_RunSeconds(2, false);
+	SELFTEST_ASSERT(Test_EnergyMeter_HasSentUART(slowMode, sizeof(slowMode)));
+
+	CMD_ExecuteCommand("stopDriver BL0942", 0);
+	// CSE7766 sends a packet every 50 ms
+	SELFTEST_ASSERT(CMD_ExecuteCommand("EnergySamples 16 10", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(BL_Samples_GetIntervalMs() == 10);
+	CMD_ExecuteCommand("startDriver CSE7766", 0);
+	SELFTEST_ASSERT(BL_Samples_GetIntervalMs() == 50);
+	CMD_ExecuteCommand("stopDriver CSE7766", 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("EnergySamples 16 9", 0) == CMD_RES_BAD_ARGUMENT);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("EnergySamples 0", 0) == CMD_RES_OK);
+	SIM_ClearUART();
+	SIM_ClearMQTTHistory();
+}
+#endif
+
 void Test_EnergyMeter() {
 	Test_EnergyMeter_ResetBug();
 	Test_EnergyMeter_CSE7766();
-#ifndef LINUX
-	// TODO: fix on Linux
 	Test_EnergyMeter_BL0942();
-#endif
 	Test_EnergyMeter_Basic();
 	Test_EnergyMeter_Tasmota();
 	Test_EnergyMeter_Events();
 	Test_EnergyMeter_TurnOffScript();
 	Test_EnergyMeter_Limits();
+#if ENABLE_BL_SAMPLES
+	Test_EnergyMeter_Samples();
+#endif
 }
 
 #endif
@@ -2,6 +2,9 @@
 
 #include "selftest_local.h"
 #include "../httpserver/new_http.h"
+#include "../httpserver/http_events.h"
+#include "../driver/drv_deviceclock.h"
+#include "../logging/logging.h"
 //#define JSMN_HEADER
 ///#include "../jsmn/jsmn.h"
 #include "../cJSON/cJSON.h"
@@ -81,6 +84,7 @@ void Test_FakeHTTPClientPacket_Generic() {
 	request.replylen = 0;
 
 	request.replymaxlen = sizeof(outbuf);
+	request.responseCode = HTTP_RESPONSE_OK;
 
 	printf("Test_FakeHTTPClientPacket_GET fake bytes sent: %d \n", iResult);
  	len = HTTP_ProcessPacket(&request);
@@ -101,6 +105,11 @@ void Test_FakeHTTPClientPacket_GET(const char *tg) {
 	sprintf(buffer, http_get_template1, tg);
 	Test_FakeHTTPClientPacket_Generic();
 }
+// same as above, but with given extra headers, each ending with \r\n
+void Test_FakeHTTPClientPacket_GET_WithHeaders(const char *tg, const char *headers) {
+	sprintf(buffer, "GET /%s HTTP/1.1\r\nHost: 127.0.0.1\r\n%s\r\n", tg, headers);
+	Test_FakeHTTPClientPacket_Generic();
+}
 void Test_FakeHTTPClientPacket_POST(const char *tg, const char *data) {
 	int dataLen = strlen(data);
 
@@ -280,6 +289,10 @@ const char *Test_GetJSONValue_String(const char *keyword, const char *obj) {
 const char *Test_GetLastHTMLReply() {
 	return replyAt;
 }
+// whole reply, with status line and headers
+const char *Test_GetLastHTTPResponse() {
+	return outbuf;
+}
 const char *Test_QueryHTMLReply(const char *url) {
 	Test_FakeHTTPClientPacket_GET(url);
 	return Test_GetLastHTMLReply();
@@ -914,7 +927,240 @@ void Test_Http_Commands() {
 	SELFTEST_ASSERT_CHANNEL(1, 567);
 	SELFTEST_ASSERT_JSON_VALUE_INTEGER(0, "success", 200);
 }
+#if ENABLE_LITTLEFS
+static void Test_Http_LFS_ETagAndRange() {
+	char etag[64];
+	char hdr[128];
+	const char *p;
+	int len;
+
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("lfs_format", 0);
+	Test_FakeHTTPClientPacket_POST("api/lfs/range.txt", "0123456789abcdefghij");
+
+	Test_FakeHTTPClientPacket_GET("api/lfs/range.txt");
+	SELFTEST_ASSERT_HTML_REPLY("0123456789abcdefghij");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 200", 12));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Length: 20\r\n"));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Cache-Control: no-cache\r\n"));
+	p = strstr(Test_GetLastHTTPResponse(), "ETag: ");
+	SELFTEST_ASSERT(p);
+	p += 6;
+	len = strchr(p, '\r') - p;
+	SELFTEST_ASSERT(len > 2 && len < (int)sizeof(etag));
+	memcpy(etag, p, len);
+	etag[len] = 0;
+
+	// same file, browser gets 304 without body
+	snprintf(hdr, sizeof(hdr), "If-None-Match: %s\r\n", etag);
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", hdr);
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 304", 12));
+	SELFTEST_ASSERT_HTML_REPLY("");
+
+	// ranges
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", "Range: bytes=5-9\r\n");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 206", 12));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Range: bytes 5-9/20\r\n"));
+	SELFTEST_ASSERT_HTML_REPLY("56789");
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", "Range: bytes=15-\r\n");
+	SELFTEST_ASSERT_HTML_REPLY("fghij");
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", "Range: bytes=-3\r\n");
+	SELFTEST_ASSERT_HTML_REPLY("hij");
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", "Range: bytes=30-40\r\n");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 416", 12));
+
+	// nothing to take the last bytes of
+	Test_FakeHTTPClientPacket_POST("api/lfs/empty.txt", "");
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/empty.txt", "Range: bytes=-5\r\n");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 416", 12));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Range: bytes */0\r\n"));
+
+	// changed file must get a new ETag
+	Test_FakeHTTPClientPacket_POST("api/lfs/range.txt", "0123456789abcdefghiJ");
+	Test_FakeHTTPClientPacket_GET_WithHeaders("api/lfs/range.txt", hdr);
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 200", 12));
+	SELFTEST_ASSERT_HTML_REPLY("0123456789abcdefghiJ");
+
+	// precompressed assets may be kept by browser
+	Test_FakeHTTPClientPacket_POST("api/lfs/app.js.gz", "notreallygz");
+	Test_FakeHTTPClientPacket_GET("api/lfs/app.js.gz");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Encoding: gzip\r\n"));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Cache-Control: max-age=86400\r\n"));
+}
+#endif
+
+static void Test_Http_StaticFilesAndStateVersion() {
+	char version[16];
+	char url[64];
+	const char *p;
+	int len;
+
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("setChannelType 1 Toggle", 0);
+	// let config be saved and WiFi connect, both are shown on the page
+	Sim_RunSeconds(10, false);
+	TIME_setDeviceTime(1703144803);
+
+	// page only links style and script, they are long cached
+	Test_FakeHTTPClientPacket_GET("index");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<link rel=\"stylesheet\" href=\"/obk.css?v="));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<script src=\"/obk.js?v="));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<style>") == 0);
+	Test_FakeHTTPClientPacket_GET("obk.css");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 200", 12));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Cache-Control: public, max-age=31536000, immutable\r\n"));
+	// fake client accepts gzip, and gzipped data must match the text
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Encoding: gzip\r\n"));
+	Test_FakeHTTPClientPacket_GET_WithHeaders("obk.js", "Accept-Encoding: gzip\r\nIf-None-Match: \"00000000g\"\r\n");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 200", 12));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-Encoding: gzip\r\n"));
+	snprintf(url, sizeof(url), "Accept-Encoding: gzip\r\nIf-None-Match: \"%08Xg\"\r\n", HTTP_GetStaticFileVersion("obk.js"));
+	Test_FakeHTTPClientPacket_GET_WithHeaders("obk.js", url);
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 304", 12));
+
+	// old style state request still works
+	Test_FakeHTTPClientPacket_GET("index?state=1");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "X-State-Version") == 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<td class='off'>OFF</td>"));
+
+	// unknown version gives full state and its version
+	Test_FakeHTTPClientPacket_GET("index?state=1&v=0");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<td class='off'>OFF</td>"));
+	p = strstr(Test_GetLastHTTPResponse(), "X-State-Version: ");
+	SELFTEST_ASSERT(p);
+	p += 17;
+	len = strchr(p, '\r') - p;
+	SELFTEST_ASSERT(len == 8);
+	memcpy(version, p, len);
+	version[len] = 0;
+
+	// same version, nothing has changed, so empty body
+	snprintf(url, sizeof(url), "index?state=1&v=%s", version);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), version));
+	SELFTEST_ASSERT_HTML_REPLY("");
+
+	// clock, RSSI etc are not part of version, they come in a header
+	Sim_RunSeconds(3, false);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), version));
+	SELFTEST_ASSERT_HTML_REPLY("");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "X-State-Volatile: {\"vclock\":"));
+	Test_FakeHTTPClientPacket_GET("index");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Local clock: <span id=\"vclock\">"));
+
+	// channel change gives new state
+	CMD_ExecuteCommand("setChannel 1 1", 0);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), version) == 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "<td class='on'>ON</td>"));
+
+	// HTML of drivers can't be versioned, so it's refreshed every second
+	p = strstr(Test_GetLastHTTPResponse(), "X-State-Version: ");
+	SELFTEST_ASSERT(p);
+	memcpy(version, p + 17, 8);
+	snprintf(url, sizeof(url), "index?state=1&v=%s", version);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT_HTML_REPLY("");
+	CMD_ExecuteCommand("startDriver NTP", 0);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "NTP"));
+	p = strstr(Test_GetLastHTTPResponse(), "X-State-Version: ");
+	SELFTEST_ASSERT(p);
+	memcpy(version, p + 17, 8);
+	snprintf(url, sizeof(url), "index?state=1&v=%s", version);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT_HTML_REPLY("");
+	Sim_RunSeconds(1, false);
+	Test_FakeHTTPClientPacket_GET(url);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "NTP"));
+	CMD_ExecuteCommand("stopDriver NTP", 0);
+}
+
+#if ENABLE_HTTP_EVENTS
+static void Test_Http_Events() {
+	const char *q;
+	const char *p;
+	char tmp[64];
+	char ev[64];
+	int i;
+
+	SIM_ClearOBK(0);
+	HTTP_Events_Test_Clear();
+	CMD_ExecuteCommand("setChannelType 1 Toggle", 0);
+	// let config be saved and WiFi connect, both change state version
+	Sim_RunSeconds(10, false);
+
+	Test_FakeHTTPClientPacket_GET("events");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "Content-type: text/event-stream\r\n"));
+	SELFTEST_ASSERT(strstr(Test_GetLastHTTPResponse(), "retry: 5000\n\n"));
+	SELFTEST_ASSERT(HTTP_Events_GetClientsCount() == 1);
+
+	CMD_ExecuteCommand("setChannel 1 1", 0);
+	q = HTTP_Events_Test_GetQueue(0);
+	SELFTEST_ASSERT(q && strstr(q, "event: channel\ndata: {\"ch\":1,\"val\":1}\n\n"));
+
+	// state version is pushed once a second, when it changes
+	Sim_RunSeconds(1.5f, false);
+	q = HTTP_Events_Test_GetQueue(0);
+	SELFTEST_ASSERT(strstr(q, "event: state\ndata: "));
+	// and it's the same version that index?state=1 reports
+	Test_FakeHTTPClientPacket_GET("index?state=1&v=0");
+	p = strstr(Test_GetLastHTTPResponse(), "X-State-Version: ");
+	SELFTEST_ASSERT(p);
+	snprintf(ev, sizeof(ev), "event: state\ndata: %.8s\n\n", p + 17);
+	SELFTEST_ASSERT(strstr(q, ev));
+	// clock etc come separately, they don't change the version
+	SELFTEST_ASSERT(strstr(q, "event: vstate\ndata: {"));
+	HTTP_Events_Test_Clear();
+	Test_FakeHTTPClientPacket_GET("events");
+	Sim_RunSeconds(3, false);
+	q = HTTP_Events_Test_GetQueue(0);
+	SELFTEST_ASSERT(strstr(q, ev) && strstr(strstr(q, ev) + 1, ev) == 0);
+	SELFTEST_ASSERT(strstr(q, "event: vstate\ndata: {"));
+
+	// log lines only go to clients that asked for them
+	Test_FakeHTTPClientPacket_GET("events?log=1");
+	SELFTEST_ASSERT(HTTP_Events_GetClientsCount() == 2);
+	ADDLOG_INFO(LOG_FEATURE_HTTP, "EventsLogMarker");
+	Sim_RunFrames(2, false);
+	SELFTEST_ASSERT(strstr(HTTP_Events_Test_GetQueue(1), "event: log\ndata: Info:HTTP:EventsLogMarker\n\n"));
+	SELFTEST_ASSERT(strstr(HTTP_Events_Test_GetQueue(0), "EventsLogMarker") == 0);
+
+	// queue is bounded, oldest events are dropped first
+	for (i = 0; i < 100; i++) {
+		CMD_ExecuteCommand(i % 2 ? "setChannel 1 1" : "setChannel 1 0", 0);
+	}
+	CMD_ExecuteCommand("setChannel 2 123", 0);
+	q = HTTP_Events_Test_GetQueue(0);
+	SELFTEST_ASSERT(HTTP_Events_Test_GetDropped(0) > 0);
+	SELFTEST_ASSERT(strlen(q) <= 1024);
+	SELFTEST_ASSERT(strstr(q, "event: state") == 0);
+	snprintf(tmp, sizeof(tmp), "data: {\"ch\":2,\"val\":123}\n\n");
+	SELFTEST_ASSERT(strstr(q, tmp) && !strcmp(strstr(q, tmp), tmp));
+	// whole events only
+	SELFTEST_ASSERT(!strncmp(q, "event: channel\n", 15));
+
+	// limited number of clients
+	Test_FakeHTTPClientPacket_GET("events");
+	SELFTEST_ASSERT(HTTP_Events_GetClientsCount() == 3);
+	Test_FakeHTTPClientPacket_GET("events");
+	SELFTEST_ASSERT(!strncmp(Test_GetLastHTTPResponse(), "HTTP/1.1 503", 12));
+	SELFTEST_ASSERT(HTTP_Events_GetClientsCount() == 3);
+
+	HTTP_Events_Test_Clear();
+	SELFTEST_ASSERT(HTTP_Events_GetClientsCount() == 0);
+}
+#endif
+
 void Test_Http() {
+#if ENABLE_HTTP_EVENTS
+	Test_Http_Events();
+#endif
+	Test_Http_StaticFilesAndStateVersion();
+#if ENABLE_LITTLEFS
+	Test_Http_LFS_ETagAndRange();
+#endif
 	Test_Http_SingleRelayOnChannel1();
 	Test_Http_TwoRelays();
 	Test_Http_FourRelays();
@@ -1,7 +1,93 @@
-#if defined(_WIN32)
+#ifdef WINDOWS
 
 #include "selftest_local.h"
 #include "../httpclient/http_client.h"
+
+#if ENABLE_SEND_POSTANDGET
+
+// Worker is held, so requests just wait in queue and we can check what was queued
+static void Test_HTTP_Client_Queue() {
+	static httprequest_t ownRequest;
+	httpclient_stats_t stats;
+	char url[64];
+	int ret;
+	int i;
+
+	HTTPClient_Test_ClearQueue();
+	HTTPClient_Test_SetHoldQueue(1);
+
+	// identical GETs are sent once
+	ret = HTTPClient_Async_SendGet("http://127.0.0.1/cm?cmnd=POWER%20ON", 0, 0);
+	SELFTEST_ASSERT(ret == 0);
+	ret = HTTPClient_Async_SendGet("http://127.0.0.1/cm?cmnd=POWER%20ON", 0, 0);
+	SELFTEST_ASSERT(ret == 0);
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 1);
+	SELFTEST_ASSERT(stats.coalesced == 1);
+
+	// different target or post command is not the same request
+	ret = HTTPClient_Async_SendGet("http://127.0.0.1/cm?cmnd=POWER%20ON", "cmd", 0);
+	SELFTEST_ASSERT(ret == 0);
+	ret = HTTPClient_Async_SendGet("http://127.0.0.1/cm?cmnd=POWER%20ON", 0, "echo done");
+	SELFTEST_ASSERT(ret == 0);
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 3);
+	SELFTEST_ASSERT(stats.coalesced == 1);
+
+	// POSTs are never merged
+	ret = HTTPClient_Async_SendPost("http://127.0.0.1/write", 80, "text/plain", "abc", 0);
+	SELFTEST_ASSERT(ret == 0);
+	ret = HTTPClient_Async_SendPost("http://127.0.0.1/write", 80, "text/plain", "abc", 0);
+	SELFTEST_ASSERT(ret == 0);
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 5);
+
+	// queue is bounded, extra requests are rejected
+	for (i = 0; i < 10; i++) {
+		snprintf(url, sizeof(url), "http://127.0.0.1/test%i", i);
+		HTTPClient_Async_SendGet(url, 0, 0);
+	}
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 8);
+	SELFTEST_ASSERT(stats.queuePeak == 8);
+	SELFTEST_ASSERT(stats.dropped == 7);
+	ret = HTTPClient_Async_SendPost("http://127.0.0.1/write", 80, "text/plain", "abc", 0);
+	SELFTEST_ASSERT(ret != 0);
+
+	HTTPClient_Test_ClearQueue();
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 0);
+
+	// caller owned request, like OTA one, can't be queued again until it's done
+	memset(&ownRequest, 0, sizeof(ownRequest));
+	ownRequest.url = "http://127.0.0.1/firmware";
+	ownRequest.method = HTTPCLIENT_GET;
+	ownRequest.port = 80;
+	SELFTEST_ASSERT(HTTPClient_IsRequestBusy(&ownRequest) == false);
+	ret = HTTPClient_Async_SendGeneric(&ownRequest);
+	SELFTEST_ASSERT(ret == 0);
+	SELFTEST_ASSERT(HTTPClient_IsRequestBusy(&ownRequest));
+	ret = HTTPClient_Async_SendGeneric(&ownRequest);
+	SELFTEST_ASSERT(ret != 0);
+	HTTPClient_GetStats(&stats);
+	SELFTEST_ASSERT(stats.queueDepth == 1);
+	SELFTEST_ASSERT(stats.coalesced == 0);
+	HTTPClient_Test_ClearQueue();
+	SELFTEST_ASSERT(HTTPClient_IsRequestBusy(&ownRequest) == false);
+	HTTPClient_Test_ClearLastRequest();
+
+	HTTPClient_Test_SetHoldQueue(0);
+}
+
+#else
+
+static void Test_HTTP_Client_Queue() {
+}
+
+#endif
+
+#if defined(_WIN32)
+
 #include <windows.h>
 
 static int SelfTest_RunPostRequestAllocFailure(int *outRet) {
@@ -98,11 +184,16 @@ void Test_HTTP_Client() {
 	HTTPClient_Test_FreeLastRequest();
 
 	HTTPClient_Test_SetSkipAsyncThread(0);
+
+	Test_HTTP_Client_Queue();
 }
 
 #else
 
 void Test_HTTP_Client() {
+	Test_HTTP_Client_Queue();
 }
 
 #endif
+
+#endif
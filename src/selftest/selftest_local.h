@@ -12,6 +12,7 @@
 #include "../sim/sim_import.h"
 
 void SelfTest_Failed(const char *file, const char *function, int line, const char *exp);
+int SelfTest_GetNumErrors();
 
 #define SELFTEST_ASSERT(expr) \
 	if (!(expr))              \
@@ -75,8 +76,23 @@ bool Float_Equals(float a, float b);
 bool Float_EqualsEpsilon(float a, float b, float epsilon);
 
 const char *va(const char *fmt, ...);
+// real (not simulated) time in ms, for benchmarks
+long SIM_GetTime();
+// win_main -benchmark, returns non-zero on failure
+int SIM_RunBenchmarks(const char *jsonPath);
+
+typedef struct selfTestCase_s {
+	const char *name;
+	void (*run)();
+} selfTestCase_t;
+
+const selfTestCase_t *Win_GetUnitTests(int *count);
+// win_main -runUnitTestsParallel, returns count of failed tests
+int SelfTest_RunParallel(int jobs, const char *reportPath, bool bCompareFastForward);
 
 void Test_Battery();
+void Test_TuyaMCU_TH08();
+void Test_Http_LED();
 void Test_Flash_Search();
 void Test_JSON_Lib();
 void Test_Commands_Startup();
@@ -91,9 +107,12 @@ void Test_TuyaMCU_DP22();
 void Test_TuyaMCU_Mult();
 void Test_TuyaMCU_RawAccess();
 void Test_TuyaMCU_Robustness();
+void Test_TuyaMCU_ParseBenchmark();
+void Test_TuyaMCU_Coalesce();
 void Test_Command_If();
 void Test_Command_If_Else();
 void Test_LFS();
+void Test_Charts();
 void Test_Tokenizer();
 void Test_Commands_Alias();
 void Test_ExpandConstant();
@@ -150,16 +169,24 @@ void Test_Demo_ConditionalRelay();
 void Test_PIR();
 void Test_Driver_TCL_AC();
 void Test_MAX72XX();
+void Test_DS1820_Full();
+void Test_SoftI2C();
+void Test_SSDP();
+void Test_DriverLists();
+void Test_ButtonEdges();
 void Test_OpenWeatherMap();
 void Test_Shutters();
 void Test_Pins();
 
 void Test_GetJSONValue_Setup(const char *text);
 void Test_FakeHTTPClientPacket_GET(const char *tg);
+void Test_FakeHTTPClientPacket_GET_WithHeaders(const char *tg, const char *headers);
 void Test_FakeHTTPClientPacket_POST(const char *tg, const char *data);
 void Test_FakeHTTPClientPacket_POST_withJSONReply(const char *tg, const char *data);
 void Test_FakeHTTPClientPacket_JSON(const char *tg);
 const char *Test_GetLastHTMLReply();
+const char *Test_GetLastHTTPResponse();
+const char *Helper_GetPastHTTPHeader(const char *s);
 const char *Test_QueryHTMLReply(const char *url);
 
 bool SIM_HasHTTPTemperature();
@@ -207,6 +234,8 @@ int SIM_UART_GetDataSize();
 byte SIM_UART_GetByte(int index);
 void SIM_UART_ConsumeBytes(int idx);
 void SIM_AppendUARTByte(byte rc);
+void SIM_AppendUARTBytes(const byte *data, int len);
+int SIM_UART_GetBulkWrites();
 bool SIM_UART_ExpectAndConsumeHByte(byte b);
 bool SIM_UART_ExpectAndConsumeHexStr(const char *hexString);
 void SIM_ClearUART();
@@ -12,7 +12,10 @@ void SelfTest_Failed(const char *file, const char *function, int line, const cha
 	printf("Check %s - %s - line %i\n", file, function, line);
 	printf("Total SelfTest errors so far: %i\n", g_selfTestErrors);
 
-	system("pause");
+	// mode 2 (and parallel runner) must never wait for a key
+	if (g_selfTestsMode != 2) {
+		system("pause");
+	}
 }
 int SelfTest_GetNumErrors() {
 	return g_selfTestErrors;
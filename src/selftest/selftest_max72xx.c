@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../driver/drv_local.h"
 
 void Test_MAX72XX() {
 	// reset whole device
@@ -119,6 +120,20 @@ void Test_MAX72XX() {
 	SELFTEST_ASSERT(MAX72XXSingle_CountPixels(true) == 1);
 	CMD_ExecuteCommand("MAX72XX_SetPixel 1 1 1", 0);
 	SELFTEST_ASSERT(MAX72XXSingle_CountPixels(true) == 2);
+
+	// refresh sends only changed rows, each to all 16 devices in one transfer
+	int transfers = MAX72XXSingle_GetTransferCount();
+	CMD_ExecuteCommand("MAX72XX_refresh", 0);
+	SELFTEST_ASSERT(MAX72XXSingle_GetTransferCount() == transfers);
+	CMD_ExecuteCommand("MAX72XX_Print 1", 0);
+	CMD_ExecuteCommand("MAX72XX_refresh", 0);
+	SELFTEST_ASSERT(MAX72XXSingle_GetTransferCount() <= transfers + 8);
+	transfers = MAX72XXSingle_GetTransferCount();
+	CMD_ExecuteCommand("MAX72XX_Scroll 1", 0);
+	SELFTEST_ASSERT(MAX72XXSingle_GetTransferCount() <= transfers + 8);
+	transfers = MAX72XXSingle_GetTransferCount();
+	CMD_ExecuteCommand("MAX72XX_refresh", 0);
+	SELFTEST_ASSERT(MAX72XXSingle_GetTransferCount() == transfers);
 	CMD_ExecuteCommand("stopDriver MAX72XX", 0);
 	
 }
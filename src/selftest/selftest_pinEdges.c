@@ -0,0 +1,127 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+
+void Test_ButtonEdges() {
+	int reads;
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	// buttons are reported by interrupts
+	CMD_ExecuteCommand("SetFlag 52 1", 0);
+	// by default, we have a pull up resistor - so high level
+	SIM_SetSimulatedPinValue(9, true);
+	PIN_SetPinRoleForPinIndex(9, IOR_Button);
+	CMD_ExecuteCommand("addEventHandler OnPress 9 addChannel 10 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnRelease 9 addChannel 11 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnClick 9 addChannel 12 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnDblClick 9 addChannel 13 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnHoldStart 9 addChannel 14 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnHold 9 addChannel 15 1", 0);
+	Sim_RunFrames(5, false);
+
+	// idle button is not polled
+	reads = SIM_GetDigitalReadsCount(9);
+	Sim_RunSeconds(5, false);
+	SELFTEST_ASSERT(SIM_GetDigitalReadsCount(9) - reads <= 6);
+
+	//
+	// click - press is accepted after 75ms of debounce
+	//
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(70, false);
+	SELFTEST_ASSERT_CHANNEL(10, 0);
+	Sim_RunMiliseconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(10, 1);
+	Sim_RunMiliseconds(20, false);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunMiliseconds(80, false);
+	SELFTEST_ASSERT_CHANNEL(11, 1);
+	// click fires 300ms after debounced release, not rounded up to next poll
+	Sim_RunMiliseconds(290, false);
+	SELFTEST_ASSERT_CHANNEL(12, 0);
+	Sim_RunMiliseconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(12, 1);
+	SELFTEST_ASSERT_CHANNEL(13, 0);
+	Sim_RunSeconds(2, false);
+
+	//
+	// double click
+	//
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(100, false);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunMiliseconds(150, false);
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(100, false);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunMiliseconds(370, false);
+	// second press of a multi click is not OnPress
+	SELFTEST_ASSERT_CHANNEL(10, 2);
+	SELFTEST_ASSERT_CHANNEL(11, 3);
+	SELFTEST_ASSERT_CHANNEL(13, 0);
+	Sim_RunMiliseconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(12, 1);
+	SELFTEST_ASSERT_CHANNEL(13, 1);
+	Sim_RunSeconds(2, false);
+
+	//
+	// hold - starts 1000ms after press, then repeats every 500ms
+	//
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(1070, false);
+	SELFTEST_ASSERT_CHANNEL(14, 0);
+	Sim_RunMiliseconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(14, 1);
+	SELFTEST_ASSERT_CHANNEL(15, 0);
+	Sim_RunMiliseconds(490, false);
+	SELFTEST_ASSERT_CHANNEL(15, 0);
+	Sim_RunMiliseconds(10, false);
+	SELFTEST_ASSERT_CHANNEL(15, 1);
+	Sim_RunMiliseconds(1000, false);
+	SELFTEST_ASSERT_CHANNEL(15, 3);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunSeconds(2, false);
+	SELFTEST_ASSERT_CHANNEL(11, 4);
+	SELFTEST_ASSERT_CHANNEL(12, 1);
+	SELFTEST_ASSERT_CHANNEL(15, 3);
+
+	//
+	// glitches are filtered, even shorter than a tick
+	//
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(50, false);
+	SIM_SetSimulatedPinValue(9, true);
+	SIM_SetSimulatedPinValue(9, false);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunSeconds(1, false);
+	SELFTEST_ASSERT_CHANNEL(10, 3);
+
+	// so many edges that queue overflows, last ones are lost,
+	// but pin is read again and ends up released
+	for (i = 0; i < 100; i++) {
+		SIM_SetSimulatedPinValue(9, i % 2);
+	}
+	SELFTEST_ASSERT(SIM_GetSimulatedPinValue(9));
+	Sim_RunSeconds(1, false);
+	SELFTEST_ASSERT_CHANNEL(10, 3);
+
+	//
+	// polling is used again when flag is cleared
+	//
+	CMD_ExecuteCommand("SetFlag 52 0", 0);
+	Sim_RunFrames(5, false);
+	reads = SIM_GetDigitalReadsCount(9);
+	Sim_RunSeconds(1, false);
+	SELFTEST_ASSERT(SIM_GetDigitalReadsCount(9) - reads >= 90);
+	SIM_SetSimulatedPinValue(9, false);
+	Sim_RunMiliseconds(100, false);
+	SIM_SetSimulatedPinValue(9, true);
+	Sim_RunSeconds(1, false);
+	SELFTEST_ASSERT_CHANNEL(10, 4);
+	SELFTEST_ASSERT_CHANNEL(12, 2);
+}
+
+#endif
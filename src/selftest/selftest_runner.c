@@ -0,0 +1,400 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+
+// Runs every unit test in its own process, several at once, with:
+// win_main -runUnitTestsParallel [jobs] [-testReport report.xml|report.json]
+// Each test gets a fresh fork of a started OBK, its own working directory
+// and simulated flash file, so state leaking from one test can't break another.
+// Output of passed tests is removed, failed tests keep their output.log and flash.bin.
+// With -compareFastForward every test runs twice, with and without simulator
+// fast-forward, and fails if the two runs don't pass alike with the same log.
+
+#if LINUX
+
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern int g_bDoingUnitTestsNow;
+extern int g_selfTestsMode;
+extern int g_httpPort;
+extern bool g_bSimFastForward;
+void Sim_RunFrames(int n, bool bApplyRealtimeWait);
+
+// a single test running longer than that is considered hung
+#define SELFTEST_TIMEOUT_SECONDS 300
+#define SELFTEST_MAX_MESSAGE 1024
+
+typedef struct testResult_s {
+	pid_t pid;
+	// only for -compareFastForward, second run of test without fast-forward
+	bool bNoFastForward;
+	bool bFailed;
+	double seconds;
+	double started;
+	char message[SELFTEST_MAX_MESSAGE];
+} testResult_t;
+
+static double Runner_GetSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 0.000000001;
+}
+
+static void Runner_RunChild(const selfTestCase_t *test, const char *dir, bool bFastForward) {
+	int errors;
+
+	if (chdir(dir) != 0 || freopen("output.log", "w", stdout) == 0) {
+		_exit(2);
+	}
+	dup2(fileno(stdout), 2);
+	alarm(SELFTEST_TIMEOUT_SECONDS);
+
+	g_selfTestsMode = 2;
+	g_bDoingUnitTestsNow = 1;
+	// every process has its own HTTP server, let system pick the port
+	g_httpPort = 0;
+	g_bSimFastForward = bFastForward;
+	SIM_ClearOBK("flash.bin");
+	// let things warm up a little, same as serial run does
+	Sim_RunFrames(50, false);
+	test->run();
+
+	errors = SelfTest_GetNumErrors();
+	if (errors) {
+		SIM_SaveFlashData("flash.bin");
+	}
+	fflush(stdout);
+	_exit(errors ? 1 : 0);
+}
+
+// collect assertion messages from the test log
+static void Runner_ReadFailures(const char *dir, testResult_t *r) {
+	char line[512];
+	FILE *f;
+	int len;
+
+	snprintf(line, sizeof(line), "%s/output.log", dir);
+	f = fopen(line, "r");
+	if (f == 0) {
+		return;
+	}
+	len = strlen(r->message);
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "ERROR: SelfTest", 15) && strncmp(line, "Check ", 6)) {
+			continue;
+		}
+		snprintf(r->message + len, sizeof(r->message) - len, "%s", line);
+		len = strlen(r->message);
+	}
+	fclose(f);
+}
+
+// benchmarks print wall-clock time, which differs between any two runs
+static bool Runner_IsTimingLine(const char *line) {
+	return strstr(line, "benchmark") != 0;
+}
+
+static const char *Runner_NextLine(FILE *f, char *buf, int size) {
+	while (fgets(buf, size, f)) {
+		if (Runner_IsTimingLine(buf) == false) {
+			return buf;
+		}
+	}
+	return 0;
+}
+
+static bool Runner_SameLogs(const char *a, const char *b) {
+	char la[1024], lb[1024];
+	const char *pa, *pb;
+	FILE *fa, *fb;
+	bool bSame;
+
+	fa = fopen(a, "rb");
+	fb = fopen(b, "rb");
+	bSame = fa && fb;
+	while (bSame) {
+		pa = Runner_NextLine(fa, la, sizeof(la));
+		pb = Runner_NextLine(fb, lb, sizeof(lb));
+		if (pa == 0 || pb == 0) {
+			bSame = pa == pb;
+			break;
+		}
+		bSame = strcmp(pa, pb) == 0;
+	}
+	if (fa)
+		fclose(fa);
+	if (fb)
+		fclose(fb);
+	return bSame;
+}
+
+// test directories are flat, just files written by OBK
+static void Runner_RemoveDir(const char *dir) {
+	char path[512];
+	struct dirent *e;
+	DIR *d;
+
+	d = opendir(dir);
+	if (d == 0) {
+		return;
+	}
+	while ((e = readdir(d)) != 0) {
+		if (strcmp(e->d_name, ".") && strcmp(e->d_name, "..")) {
+			snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+			remove(path);
+		}
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static void Runner_WriteEscaped(FILE *f, const char *s, bool bXML) {
+	for (; *s; s++) {
+		if (bXML) {
+			switch (*s) {
+			case '&': fputs("&amp;", f); break;
+			case '<': fputs("&lt;", f); break;
+			case '>': fputs("&gt;", f); break;
+			case '"': fputs("&quot;", f); break;
+			default: fputc(*s, f); break;
+			}
+		}
+		else {
+			switch (*s) {
+			case '"': fputs("\\\"", f); break;
+			case '\\': fputs("\\\\", f); break;
+			case '\n': fputs("\\n", f); break;
+			case '\r': break;
+			case '\t': fputs("\\t", f); break;
+			default: fputc(*s, f); break;
+			}
+		}
+	}
+}
+
+// JUnit XML if path ends with .xml, JSON otherwise
+static int Runner_WriteReport(const char *path, const selfTestCase_t *tests,
+	testResult_t *results, int count, int failed, double total) {
+	char summary[256];
+	bool bXML;
+	FILE *f;
+	int i;
+
+	f = fopen(path, "w");
+	if (f == 0) {
+		printf("Failed to open %s\n", path);
+		return 1;
+	}
+	bXML = strlen(path) > 4 && !stricmp(path + strlen(path) - 4, ".xml");
+	if (bXML) {
+		fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+		fprintf(f, "<testsuite name=\"OpenBK selftests\" tests=\"%i\" failures=\"%i\" time=\"%.3f\">\n",
+			count, failed, total);
+		for (i = 0; i < count; i++) {
+			fprintf(f, "  <testcase classname=\"selftest\" name=\"%s\" time=\"%.3f\"",
+				tests[i].name, results[i].seconds);
+			if (results[i].bFailed == false) {
+				fprintf(f, "/>\n");
+				continue;
+			}
+			// first line as message, all of them as text
+			strncpy(summary, results[i].message, sizeof(summary) - 1);
+			summary[sizeof(summary) - 1] = 0;
+			strtok(summary, "\n");
+			fprintf(f, ">\n    <failure message=\"");
+			Runner_WriteEscaped(f, summary, true);
+			fprintf(f, "\">");
+			Runner_WriteEscaped(f, results[i].message, true);
+			fprintf(f, "</failure>\n  </testcase>\n");
+		}
+		fprintf(f, "</testsuite>\n");
+	}
+	else {
+		fprintf(f, "{\"tests\":%i,\"failures\":%i,\"time\":%.3f,\"results\":[\n", count, failed, total);
+		for (i = 0; i < count; i++) {
+			fprintf(f, "  {\"name\":\"%s\",\"result\":\"%s\",\"time\":%.3f,\"message\":\"",
+				tests[i].name, results[i].bFailed ? "fail" : "pass", results[i].seconds);
+			Runner_WriteEscaped(f, results[i].message, false);
+			fprintf(f, "\"}%s\n", (i + 1 < count) ? "," : "");
+		}
+		fprintf(f, "]}\n");
+	}
+	fclose(f);
+	printf("Report written to %s\n", path);
+	return 0;
+}
+
+static void Runner_GetDir(char *dir, int size, const char *runDir, const selfTestCase_t *test, bool bNoFastForward) {
+	snprintf(dir, size, "%s/%s%s", runDir, test->name, bNoFastForward ? "_noFastForward" : "");
+}
+
+// -compareFastForward, merges both runs of every test into results[test]
+static int Runner_CompareFastForward(const char *runDir, const selfTestCase_t *tests,
+	testResult_t *results, int count) {
+	testResult_t a, b;
+	char dirA[256], dirB[256];
+	char logA[300], logB[300];
+	int i, failed, len;
+
+	failed = 0;
+	for (i = 0; i < count; i++) {
+		a = results[i * 2];
+		b = results[i * 2 + 1];
+		Runner_GetDir(dirA, sizeof(dirA), runDir, &tests[i], false);
+		Runner_GetDir(dirB, sizeof(dirB), runDir, &tests[i], true);
+		results[i] = a;
+		results[i].seconds = a.seconds + b.seconds;
+		len = strlen(results[i].message);
+		if (a.bFailed != b.bFailed) {
+			snprintf(results[i].message + len, SELFTEST_MAX_MESSAGE - len,
+				"fails only %s fast-forward\n%s", a.bFailed ? "with" : "without", b.message);
+		}
+		else if (a.bFailed == false) {
+			snprintf(logA, sizeof(logA), "%s/output.log", dirA);
+			snprintf(logB, sizeof(logB), "%s/output.log", dirB);
+			if (Runner_SameLogs(logA, logB)) {
+				Runner_RemoveDir(dirA);
+				Runner_RemoveDir(dirB);
+				continue;
+			}
+			snprintf(results[i].message + len, SELFTEST_MAX_MESSAGE - len,
+				"output differs with and without fast-forward, compare %s and %s\n", logA, logB);
+		}
+		results[i].bFailed = true;
+		printf("FAIL %s\n%s", tests[i].name, results[i].message);
+		failed++;
+	}
+	return failed;
+}
+
+int SelfTest_RunParallel(int jobs, const char *reportPath, bool bCompareFastForward) {
+	const selfTestCase_t *tests;
+	testResult_t *results;
+	char runDir[] = "/tmp/obk_selftests_XXXXXX";
+	char dir[256];
+	int count, runs, runsPerTest, next, running, finished, failed;
+	int status, i;
+	double start;
+	pid_t pid;
+
+	tests = Win_GetUnitTests(&count);
+	runsPerTest = bCompareFastForward ? 2 : 1;
+	runs = count * runsPerTest;
+	if (jobs <= 0) {
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+		if (jobs <= 0)
+			jobs = 1;
+	}
+	if (mkdtemp(runDir) == 0) {
+		printf("Failed to create %s\n", runDir);
+		return 1;
+	}
+	results = (testResult_t*)calloc(runs, sizeof(testResult_t));
+	for (i = 0; i < runs; i++) {
+		results[i].bNoFastForward = (i % runsPerTest) == 1;
+	}
+	printf("Running %i tests with %i jobs in %s\n", count, jobs, runDir);
+	fflush(stdout);
+
+	start = Runner_GetSeconds();
+	next = 0;
+	running = 0;
+	finished = 0;
+	failed = 0;
+	while (finished < runs) {
+		while (running < jobs && next < runs) {
+			Runner_GetDir(dir, sizeof(dir), runDir, &tests[next / runsPerTest], results[next].bNoFastForward);
+			mkdir(dir, 0755);
+			results[next].started = Runner_GetSeconds();
+			pid = fork();
+			if (pid == 0) {
+				Runner_RunChild(&tests[next / runsPerTest], dir, !results[next].bNoFastForward);
+			}
+			if (pid < 0) {
+				results[next].bFailed = true;
+				snprintf(results[next].message, SELFTEST_MAX_MESSAGE, "fork failed\n");
+				finished++;
+			}
+			else {
+				results[next].pid = pid;
+				running++;
+			}
+			next++;
+		}
+		if (running == 0) {
+			continue;
+		}
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			break;
+		}
+		for (i = 0; i < next; i++) {
+			if (results[i].pid == pid)
+				break;
+		}
+		if (i == next) {
+			continue;
+		}
+		running--;
+		finished++;
+		results[i].pid = 0;
+		results[i].seconds = Runner_GetSeconds() - results[i].started;
+		Runner_GetDir(dir, sizeof(dir), runDir, &tests[i / runsPerTest], results[i].bNoFastForward);
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			// logs of both runs are compared later
+			if (bCompareFastForward == false) {
+				Runner_RemoveDir(dir);
+			}
+		}
+		else {
+			results[i].bFailed = true;
+			if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+				snprintf(results[i].message, SELFTEST_MAX_MESSAGE, "timed out after %i seconds\n", SELFTEST_TIMEOUT_SECONDS);
+			}
+			else if (WIFSIGNALED(status)) {
+				snprintf(results[i].message, SELFTEST_MAX_MESSAGE, "crashed with signal %i\n", WTERMSIG(status));
+			}
+			Runner_ReadFailures(dir, &results[i]);
+			failed++;
+		}
+		printf("[%3i/%i] %s %s%s (%.2f s)\n", finished, runs,
+			results[i].bFailed ? "FAIL" : "PASS", tests[i / runsPerTest].name,
+			results[i].bNoFastForward ? " without fast-forward" : "", results[i].seconds);
+		if (results[i].bFailed) {
+			printf("%s", results[i].message);
+		}
+		fflush(stdout);
+	}
+	if (bCompareFastForward) {
+		failed = Runner_CompareFastForward(runDir, tests, results, count);
+	}
+
+	printf("%i of %i tests passed in %.2f s\n", count - failed, count, Runner_GetSeconds() - start);
+	if (failed) {
+		printf("Output of failed tests is kept in %s\n", runDir);
+	}
+	else {
+		rmdir(runDir);
+	}
+	if (reportPath) {
+		Runner_WriteReport(reportPath, tests, results, count, failed, Runner_GetSeconds() - start);
+	}
+	free(results);
+	return failed;
+}
+
+#else
+
+int SelfTest_RunParallel(int jobs, const char *reportPath, bool bCompareFastForward) {
+	printf("Parallel selftest runner needs fork, it's only available in Linux build\n");
+	return 1;
+}
+
+#endif
+
+#endif
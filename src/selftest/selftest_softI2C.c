@@ -0,0 +1,87 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../driver/drv_local.h"
+
+void Test_SoftI2C() {
+	int transactions, bytes, nacks, clocks;
+	int t0, b0, c0;
+	int dev;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	// MCP9808 model, 16 bit registers, ambient temperature 26.5C
+	Soft_I2C_Sim_Clear();
+	dev = Soft_I2C_Sim_AddDevice(26, 24, 0x18, 2);
+	Soft_I2C_Sim_SetRegister(dev, 5, 0x01A8);
+
+	CMD_ExecuteCommand("setChannelType 1 Temperature_div10", 0);
+	CMD_ExecuteCommand("startDriver MCP9808 26 24 1", 0);
+	CMD_ExecuteCommand("MCP9808_Adr 0x30", 0);
+	CMD_ExecuteCommand("MCP9808_Cycle 1", 0);
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT_CHANNEL(1, 265);
+	SELFTEST_ASSERT(Soft_I2C_Test_GetStats(26, 24, &transactions, &bytes, &nacks, &clocks));
+	SELFTEST_ASSERT(transactions > 0);
+	SELFTEST_ASSERT(nacks == 0);
+
+	// three register writes, then read-modify-write of config
+	t0 = transactions;
+	b0 = bytes;
+	c0 = clocks;
+	CMD_ExecuteCommand("MCP9808_AlertRange 20 26 1", 0);
+	SELFTEST_ASSERT(Soft_I2C_Sim_GetRegister(dev, 2) == 0x01A0);
+	SELFTEST_ASSERT(Soft_I2C_Sim_GetRegister(dev, 3) == 0x0140);
+	SELFTEST_ASSERT(Soft_I2C_Sim_GetRegister(dev, 4) == 0x01A0);
+	SELFTEST_ASSERT(Soft_I2C_Sim_GetRegister(dev, 1) == 0x0008);
+	Soft_I2C_Test_GetStats(26, 24, &transactions, &bytes, &nacks, &clocks);
+	// register read is a single transaction with repeated start
+	SELFTEST_ASSERT(transactions - t0 == 5);
+	// 4 writes of address, pointer and 2 bytes, read of address, pointer, address and 2 bytes
+	SELFTEST_ASSERT(bytes - b0 == 4 * 4 + 5);
+	// 9 clocks per byte, 1 per start, repeated start and stop
+	SELFTEST_ASSERT(clocks - c0 == 4 * (1 + 4 * 9 + 1) + (1 + 5 * 9 + 1 + 1));
+
+	// temperature change is seen on next measurement
+	Soft_I2C_Sim_SetRegister(dev, 5, 0x01B0);
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT_CHANNEL(1, 270);
+
+	// nobody answers on wrong address
+	CMD_ExecuteCommand("MCP9808_Adr 0x32", 0);
+	Sim_RunSeconds(3, false);
+	Soft_I2C_Test_GetStats(26, 24, &transactions, &bytes, &nacks, &clocks);
+	SELFTEST_ASSERT(nacks > 0);
+
+	CMD_ExecuteCommand("SoftI2C_Stats", 0);
+
+	// start without address (used by BMP280), address comes as first written byte
+	dev = Soft_I2C_Sim_AddDevice(10, 11, 0x40, 2);
+	Soft_I2C_Sim_SetRegister(dev, 3, 0x1234);
+	softI2C_t *bus = (softI2C_t*)malloc(sizeof(softI2C_t));
+	memset(bus, 0, sizeof(*bus));
+	bus->pin_clk = 10;
+	bus->pin_data = 11;
+	Soft_I2C_PreInit(bus);
+	Soft_I2C_Start_Internal(bus);
+	SELFTEST_ASSERT(Soft_I2C_WriteByte(bus, 0x40 << 1));
+	SELFTEST_ASSERT(Soft_I2C_WriteByte(bus, 3));
+	Soft_I2C_Start_Internal(bus);
+	SELFTEST_ASSERT(Soft_I2C_WriteByte(bus, (0x40 << 1) | 1));
+	SELFTEST_ASSERT(Soft_I2C_ReadByte(bus, false) == 0x12);
+	SELFTEST_ASSERT(Soft_I2C_ReadByte(bus, true) == 0x34);
+	Soft_I2C_Stop(bus);
+	SELFTEST_ASSERT(Soft_I2C_Test_GetStats(10, 11, &transactions, &bytes, &nacks, &clocks));
+	SELFTEST_ASSERT(transactions == 2 && nacks == 0);
+	// bus freed by its owner (e.g. Berry) is gone from stats
+	Soft_I2C_Release(bus);
+	free(bus);
+	SELFTEST_ASSERT(!Soft_I2C_Test_GetStats(10, 11, &transactions, &bytes, &nacks, &clocks));
+	SELFTEST_ASSERT(Soft_I2C_Test_GetStats(26, 24, &transactions, &bytes, &nacks, &clocks));
+	CMD_ExecuteCommand("SoftI2C_Stats", 0);
+
+	Soft_I2C_Sim_Clear();
+}
+
+#endif
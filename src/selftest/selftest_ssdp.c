@@ -0,0 +1,96 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "lwip/sockets.h"
+#include "../driver/drv_ssdp.h"
+
+// traffic recorded on a busy LAN, searches from Windows, Alexa and a phone,
+// alive messages of a router and a TV, and of three OpenBeken devices
+static const char *g_ssdpStorm[][2] = {
+	{ "192.168.0.10", "M-SEARCH * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nMAN: \"ssdp:discover\"\r\nMX: 1\r\nST: upnp:rootdevice\r\n\r\n" },
+	{ "192.168.0.1", "NOTIFY * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nCACHE-CONTROL: max-age=100\r\nLOCATION: http://192.168.0.1:1900/igd.xml\r\nNT: urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\nNTS: ssdp:alive\r\nSERVER: Linux/2.6 UPnP/1.0 miniupnpd/1.0\r\n\r\n" },
+	{ "192.168.0.21", "NOTIFY * HTTP/1.1\r\nSERVER: OpenBk\r\nHOST: 239.255.255.250:1900\r\nCACHE-CONTROL: max-age=1800\r\nLOCATION: http://192.168.0.21:80/ssdp.xml\r\nNTS: ssdp:alive\r\nNT: upnp:rootdevice\r\nUSN: uuid:1b2c3d4e-0001-0002-0003-000400050006::upnp:rootdevice\r\n\r\n\r\n" },
+	{ "192.168.0.33", "M-SEARCH * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nMAN: \"ssdp:discover\"\r\nMX: 3\r\nST: urn:Belkin:device:**\r\n\r\n" },
+	{ "192.168.0.22", "NOTIFY * HTTP/1.1\r\nSERVER: OpenBk\r\nHOST: 239.255.255.250:1900\r\nCACHE-CONTROL: max-age=1800\r\nLOCATION: http://192.168.0.22:80/ssdp.xml\r\nNTS: ssdp:alive\r\nNT: upnp:rootdevice\r\nUSN: uuid:1b2c3d4e-0001-0002-0003-000400050007::upnp:rootdevice\r\n\r\n\r\n" },
+	{ "192.168.0.40", "NOTIFY * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nCACHE-CONTROL: max-age=1800\r\nLOCATION: http://192.168.0.40:7676/smp_2_\r\nNT: urn:dial-multiscreen-org:service:dial:1\r\nNTS: ssdp:alive\r\nSERVER: SHP, UPnP/1.0, Samsung UPnP SDK/1.0\r\n\r\n" },
+	{ "192.168.0.51", "M-SEARCH * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nMAN: \"ssdp:discover\"\r\nMX: 1\r\nST: ssdp:all\r\n\r\n" },
+	{ "192.168.0.23", "NOTIFY * HTTP/1.1\r\nSERVER: OpenBk\r\nHOST: 239.255.255.250:1900\r\nCACHE-CONTROL: max-age=1800\r\nLOCATION: http://192.168.0.23:80/ssdp.xml\r\nNTS: ssdp:alive\r\nNT: upnp:rootdevice\r\nUSN: uuid:1b2c3d4e-0001-0002-0003-000400050008::upnp:rootdevice\r\n\r\n\r\n" },
+};
+#define SSDP_STORM_PACKETS ((int)(sizeof(g_ssdpStorm) / sizeof(g_ssdpStorm[0])))
+
+static const char *g_ssdpPeerNotify = "NOTIFY * HTTP/1.1\r\nSERVER: OpenBk\r\nNTS: ssdp:alive\r\n\r\n";
+
+void Test_SSDP() {
+	int received, dropped, searches, replies, limited;
+	int prevReplies;
+	char ip[32];
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	CMD_ExecuteCommand("startDriver SSDP", 0);
+	CMD_ExecuteCommand("startDriver WEMO", 0);
+	CMD_ExecuteCommand("startDriver HUE", 0);
+
+	// replies are rendered once, with our IP
+	SELFTEST_ASSERT(strstr(DRV_SSDP_Test_GetAdvert(), "LOCATION: http://127.0.0.1:80/ssdp.xml") != 0);
+
+	// 10 rounds of storm within one second
+	for (i = 0; i < 10 * SSDP_STORM_PACKETS; i++) {
+		DRV_SSDP_Test_InjectPacket(g_ssdpStorm[i % SSDP_STORM_PACKETS][1], g_ssdpStorm[i % SSDP_STORM_PACKETS][0]);
+	}
+	DRV_SSDP_Test_GetStats(&received, &dropped, &searches, &replies, &limited);
+	SELFTEST_ASSERT(received == 10 * SSDP_STORM_PACKETS);
+	// only 64 are parsed, that's 8 rounds with 3 searches each
+	SELFTEST_ASSERT(dropped == 2 * SSDP_STORM_PACKETS);
+	SELFTEST_ASSERT(searches == 8 * 3);
+	// and only 8 of them are answered
+	SELFTEST_ASSERT(replies == 8);
+	SELFTEST_ASSERT(limited == 8 * 3 - 8);
+	// only OpenBeken peers are remembered
+	SELFTEST_ASSERT(DRV_SSDP_Test_GetDevicesCount() == 3);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.21"));
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.22"));
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.23"));
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.1") == false);
+
+	// budget is renewed every second
+	Sim_RunSeconds(1, false);
+	DRV_SSDP_Test_GetStats(&received, &dropped, &searches, &prevReplies, &limited);
+	DRV_SSDP_Test_InjectPacket(g_ssdpStorm[0][1], g_ssdpStorm[0][0]);
+	DRV_SSDP_Test_GetStats(&received, &dropped, &searches, &replies, &limited);
+	SELFTEST_ASSERT(replies == prevReplies + 1);
+
+	// simulator socket is real and gets our own NOTIFY back,
+	// so from now on only injected devices are checked, not the total count
+
+	// only the device that keeps sending NOTIFY stays
+	Sim_RunSeconds(30, false);
+	DRV_SSDP_Test_InjectPacket(g_ssdpPeerNotify, "192.168.0.22");
+	Sim_RunSeconds(35, false);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.21") == false);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.22"));
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.23") == false);
+	Sim_RunSeconds(30, false);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("192.168.0.22") == false);
+
+	// table is full at 40 devices, but freed entries are reused
+	for (i = 0; i < 50; i++) {
+		snprintf(ip, sizeof(ip), "10.0.%i.%i", i / 4, i);
+		DRV_SSDP_Test_InjectPacket(g_ssdpPeerNotify, ip);
+	}
+	SELFTEST_ASSERT(DRV_SSDP_Test_GetDevicesCount() == 40);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("10.0.0.0"));
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("10.0.12.49") == false);
+	Sim_RunSeconds(65, false);
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("10.0.0.0") == false);
+	SELFTEST_ASSERT(DRV_SSDP_Test_GetDevicesCount() < 40);
+	DRV_SSDP_Test_InjectPacket(g_ssdpPeerNotify, "10.0.12.49");
+	SELFTEST_ASSERT(DRV_SSDP_Test_HasDevice("10.0.12.49"));
+
+	CMD_ExecuteCommand("SSDP_Stats", 0);
+	CMD_ExecuteCommand("stopDriver *", 0);
+}
+
+#endif
@@ -843,4 +843,137 @@ void Test_TuyaMCU_Robustness() {
 	SELFTEST_ASSERT_CHANNEL(22, 1);
 }
 
+
+// Builds a state report (cmd 0x07) carrying dpCount Value dpIds, starting at dpId 1,
+// with value (dpId + valueOffset), and hex-encodes it for fakeTuyaPacket
+static void Test_TuyaMCU_BuildMultiDPReport(char *hex, int dpCount, int valueOffset) {
+	byte packet[256];
+	int len = 6;
+	byte checksum = 0;
+
+	packet[0] = 0x55;
+	packet[1] = 0xAA;
+	packet[2] = 0x03;
+	packet[3] = 0x07;
+	packet[4] = 0x00;
+	packet[5] = dpCount * 8;
+	for (int i = 0; i < dpCount; i++) {
+		int dpId = i + 1;
+		int value = dpId + valueOffset;
+		packet[len++] = dpId;
+		packet[len++] = 0x02;
+		packet[len++] = 0x00;
+		packet[len++] = 0x04;
+		packet[len++] = (value >> 24) & 0xFF;
+		packet[len++] = (value >> 16) & 0xFF;
+		packet[len++] = (value >> 8) & 0xFF;
+		packet[len++] = value & 0xFF;
+	}
+	for (int i = 0; i < len; i++) {
+		checksum += packet[i];
+	}
+	packet[len++] = checksum;
+	for (int i = 0; i < len; i++) {
+		sprintf(hex + i * 2, "%02X", packet[i]);
+	}
+}
+// Replays a big multi-dpId report (like thermostats and power strips send)
+// and prints parse throughput. Also checks that dpId and channel lookups
+// follow remapping.
+void Test_TuyaMCU_ParseBenchmark() {
+	char hex[2 * 256 + 1];
+	char cmd[sizeof(hex) + 32];
+	int dpCount = 30;
+	int reps = 500;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	SIM_UART_InitReceiveRingBuffer(2048);
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+
+	for (int i = 1; i <= dpCount; i++) {
+		CMD_ExecuteCommand(va("linkTuyaMCUOutputToChannel %i val %i", i, i), 0);
+	}
+	Test_TuyaMCU_BuildMultiDPReport(hex, dpCount, 100);
+	snprintf(cmd, sizeof(cmd), "fakeTuyaPacket %s", hex);
+
+	long start = SIM_GetTime();
+	for (int r = 0; r < reps; r++) {
+		CMD_ExecuteCommand(cmd, 0);
+	}
+	long took = SIM_GetTime() - start;
+	printf("TuyaMCU parse benchmark: %i reports with %i dpIds in %li ms\n", reps, dpCount, took);
+	for (int i = 1; i <= dpCount; i++) {
+		SELFTEST_ASSERT_CHANNEL(i, i + 100);
+	}
+
+	// move dpId 1 to other channel, lookup must follow
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 1 val 40", 0);
+	Test_TuyaMCU_BuildMultiDPReport(hex, dpCount, 200);
+	snprintf(cmd, sizeof(cmd), "fakeTuyaPacket %s", hex);
+	CMD_ExecuteCommand(cmd, 0);
+	SELFTEST_ASSERT_CHANNEL(1, 101);
+	SELFTEST_ASSERT_CHANNEL(40, 201);
+	SELFTEST_ASSERT_CHANNEL(dpCount, dpCount + 200);
+}
+
+void Test_TuyaMCU_Coalesce() {
+	char buffer[64];
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	SIM_UART_InitReceiveRingBuffer(2048);
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 1 bool 1", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 2", 0);
+	CMD_ExecuteCommand("tuyaMcu_setCoalesceWindow 50", 0);
+	SIM_ClearUART();
+
+	CMD_ExecuteCommand("setChannel 1 1", 0);
+	CMD_ExecuteCommand("setChannel 2 10", 0);
+	CMD_ExecuteCommand("setChannel 2 20", 0);
+	// nothing is sent before window passes
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+	Sim_RunMiliseconds(100, false);
+	// one frame with both dpIds, dpId 2 has only the latest value
+	// 55 AA	00	06		00 0D	0101000101 0202000400000014	32
+	SELFTEST_ASSERT_HAS_SENT_UART_STRING("55 AA	00	06		00 0D	0101000101 0202000400000014	32");
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+
+	// MCU did not answer yet, so next frame is held back
+	CMD_ExecuteCommand("setChannel 2 30", 0);
+	Sim_RunMiliseconds(100, false);
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+	// MCU reports state (unchanged dpId 2), held frame can go now
+	CMD_ExecuteCommand("fakeTuyaPacket 55AA0307000802020004000000142D", 0);
+	Sim_RunMiliseconds(100, false);
+	SELFTEST_ASSERT_HAS_SENT_UART_STRING("55 AA	00	06		00 08	020200040000001E	33");
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+
+	// more dpIds than initial pending list size, still held until MCU answers
+	for (i = 10; i < 50; i++) {
+		sprintf(buffer, "linkTuyaMCUOutputToChannel %i bool %i", i, i);
+		CMD_ExecuteCommand(buffer, 0);
+		sprintf(buffer, "setChannel %i 1", i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	Sim_RunMiliseconds(100, false);
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+	CMD_ExecuteCommand("fakeTuyaPacket 55AA0307000802020004000000142D", 0);
+	Sim_RunMiliseconds(100, false);
+	SELFTEST_ASSERT_HAS_SOME_DATA_IN_UART();
+	// let the rest go, if it did not fit in one frame
+	CMD_ExecuteCommand("fakeTuyaPacket 55AA0307000802020004000000142D", 0);
+	Sim_RunMiliseconds(100, false);
+	SIM_ClearUART();
+	CMD_ExecuteCommand("fakeTuyaPacket 55AA0307000802020004000000142D", 0);
+
+	// disabled again - sent at once
+	CMD_ExecuteCommand("tuyaMcu_setCoalesceWindow 0", 0);
+	CMD_ExecuteCommand("setChannel 2 40", 0);
+	SELFTEST_ASSERT_HAS_SENT_UART_STRING("55 AA	00	06		00 08	0202000400000028	3D");
+	SELFTEST_ASSERT_HAS_UART_EMPTY();
+}
+
 #endif
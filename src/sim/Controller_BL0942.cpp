@@ -5,55 +5,9 @@
 #include "Text.h"
 #include "../cJSON/cJSON.h"
 
-#define BL0942_PACKET_LEN 23
-#define BL0942_READ_COMMAND 0x58
-static float BL0942_PREF = 598;
-static float BL0942_UREF = 15188;
-static float BL0942_IREF = 251210;
+// packet builder is shared with headless build, see win_main.c
+extern "C" void Sim_SendFakeBL0942Packet(float v, float c, float p);
 
-
-extern "C" void Sim_SendFakeBL0942Packet(float v, float c, float p) {
-
-	int i;
-	byte data[BL0942_PACKET_LEN];
-	memset(data, 0, sizeof(data));
-	data[0] = 0x55;
-	byte checksum = BL0942_READ_COMMAND;
-
-	int bl_current = (int)(BL0942_IREF * c);
-	int bl_power = (int)(BL0942_PREF * p);
-	int bl_voltage = (int)(BL0942_UREF * v);
-
-	data[1] = (byte)(bl_current);
-	data[2] = (byte)(bl_current >> 8);
-	data[3] = (byte)(bl_current >> 16);
-
-	data[4] = (byte)(bl_voltage);
-	data[5] = (byte)(bl_voltage >> 8);
-	data[6] = (byte)(bl_voltage >> 16);
-
-	data[10] = (byte)(bl_power);
-	data[11] = (byte)(bl_power >> 8);
-	data[12] = (byte)(bl_power >> 16);
-	for (i = 0; i < BL0942_PACKET_LEN - 1; i++) {
-		checksum += data[i];
-	}
-	checksum ^= 0xFF;
-	data[BL0942_PACKET_LEN - 1] = checksum;
-
-	if (0) {
-		printf("BL0942 packet: ");
-		for (i = 0; i < BL0942_PACKET_LEN; i++) {
-			printf("%02X ", data[i]);
-		}
-		printf("\n");
-		printf("Voltage = %.2f, Current = %.3f, Power = %.2f\n", v, c, p);
-	}
-
-	for (i = 0; i < BL0942_PACKET_LEN; i++) {
-		UART_AppendByteToReceiveRingBuffer(data[i]);
-	}
-}
 void CControllerBL0942::onDrawn() {
 	int currentPending = UART_GetDataSize();
 	if (currentPending > 0) {
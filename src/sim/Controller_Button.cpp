@@ -3,6 +3,8 @@
 #include "Shape.h"
 #include "Junction.h"
 #include "sim_import.h"
+#include "Simulator.h"
+#include "Solver.h"
 
 CControllerButton::CControllerButton(class CJunction *_a, class CJunction *_b) {
 	timeAfterMouseHold = 99.0f;
@@ -44,6 +46,7 @@ void CControllerButton::sendEvent(int code, const class Coord &mouseOfs) {
 void CControllerButton::onDrawn() {
 	float dt = SIM_GetDeltaTimeSeconds();
 	float speed = 160.0f * dt;
+	bool bWasPassable = remDist <= 5;
 	if (timeAfterMouseHold < 0.2f) {
 		remDist = mover->moveTowards(closedPos, speed);
 	}
@@ -52,6 +55,9 @@ void CControllerButton::onDrawn() {
 		mover->moveTowards(openPos, speed);
 	}
 	timeAfterMouseHold += dt;
+	if (bWasPassable != (remDist <= 5)) {
+		g_sim->getSolver()->markDirty();
+	}
 }
 
 #endif
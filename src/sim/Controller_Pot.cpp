@@ -3,6 +3,8 @@
 #include "Shape.h"
 #include "Junction.h"
 #include "Text.h"
+#include "Simulator.h"
+#include "Solver.h"
 
 CControllerPot::CControllerPot(class CJunction *_a, class CJunction *_b, class CJunction *_o) {
 	a = _a;
@@ -46,14 +48,20 @@ void CControllerPot::onDrawn() {
 		float aVal = a->getVoltage();
 		float bVal = b->getVoltage();
 		float fin = aVal + (bVal - aVal) * frac;
+		if (o->isCurrentSource() == false || o->getVoltage() != fin) {
+			g_sim->getSolver()->markDirty();
+		}
 		o->setCurrentSource(true);
 		o->setVoltage(fin);
 		o->setVisitCount(1);
 		display->setTextf("%f", fin);
 	}
 	else {
-		o->setCurrentSource(false);
-		o->setVoltage(0);
+		if (o->isCurrentSource()) {
+			o->setCurrentSource(false);
+			o->setVoltage(0);
+			g_sim->getSolver()->markDirty();
+		}
 		display->setTextf("Not connected");
 	}
 	mover->setPosition(posA.lerp(posB, frac));
@@ -3,6 +3,8 @@
 #include "Shape.h"
 #include "Junction.h"
 #include "sim_import.h"
+#include "Simulator.h"
+#include "Solver.h"
 
 
 CControllerSimulatorLink::CControllerSimulatorLink() {
@@ -18,6 +20,22 @@ CJunction *CControllerSimulatorLink::findJunctionByGPIOIndex(int idx) {
 	}
 	return 0;
 }
+// returns true if junction was not already driven this way
+static bool setSource(CJunction *ju, float voltage, float duty) {
+	if (ju->isCurrentSource() && ju->getVoltage() == voltage && ju->getDuty() == duty)
+		return false;
+	ju->setCurrentSource(true);
+	ju->setVoltage(voltage);
+	ju->setDuty(duty);
+	return true;
+}
+// returns true if junction was driven before
+static bool clearSource(CJunction *ju) {
+	if (ju->isCurrentSource() == false)
+		return false;
+	ju->setCurrentSource(false);
+	return true;
+}
 class CControllerBase *CControllerSimulatorLink::cloneController(class CShape *origOwner, class CShape *newOwner) {
 	CControllerSimulatorLink *r = new CControllerSimulatorLink();
 	for (int i = 0; i < related.size(); i++) {
@@ -36,6 +54,7 @@ void CControllerSimulatorLink::onPostSolveVoltages() {
 	}
 }
 void CControllerSimulatorLink::onDrawn() {
+	bool bChanged = false;
 	for (int i = 0; i < related.size(); i++) {
 		CJunction *ju = related[i];
 		int gpio = ju->getGPIO();
@@ -44,31 +63,32 @@ void CControllerSimulatorLink::onDrawn() {
 			continue;
 		if (SIM_IsPinADC(gpio)) {
 			SIM_SetVoltageOnADCPin(gpio, v);
-			ju->setCurrentSource(false);
-			ju->setVisitCount(0);
+			if (clearSource(ju)) {
+				ju->setVisitCount(0);
+				bChanged = true;
+			}
 		}
 		else if (SIM_IsPinPWM(gpio)) {
 			int pwm = SIM_GetPWMValue(gpio);
-			ju->setCurrentSource(true);
-			ju->setVoltage(3.3f);
-			ju->setDuty(pwm);
+			bChanged |= setSource(ju, 3.3f, pwm);
 		} else if (!SIM_IsPinInput(gpio)) {
 			bool bVal = SIM_GetSimulatedPinValue(gpio);
-			ju->setCurrentSource(true);
-			if (bVal)
-				ju->setVoltage(3.3f);
-			else
-				ju->setVoltage(0.0f);
-			ju->setDuty(100.0f);
+			bChanged |= setSource(ju, bVal ? 3.3f : 0.0f, 100.0f);
 		}
 		else {
 			if (ju->getVisitCount() == 0)
 				v = 3.3f;
 			SIM_SetSimulatedPinValue(gpio, v > 1.5f);
-			ju->setCurrentSource(false);
-			ju->setDuty(100.0f);
+			if (clearSource(ju)) {
+				ju->setDuty(100.0f);
+				bChanged = true;
+			}
 		}
 	}
+	// pin states are polled each frame, solve again only if any of them changed
+	if (bChanged) {
+		g_sim->getSolver()->markDirty();
+	}
 }
 
 #endif
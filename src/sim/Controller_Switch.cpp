@@ -4,6 +4,8 @@
 #include "Line.h"
 #include "Junction.h"
 #include "sim_import.h"
+#include "Simulator.h"
+#include "Solver.h"
 
 CControllerSwitch::CControllerSwitch(class CJunction *_a, class CJunction *_b) {
 	timeAfterMouseHold = 99.0f;
@@ -55,12 +57,16 @@ void CControllerSwitch::onDrawn() {
 		tgPos = 20;
 	remDist = l->getPos2().moveMeTowards(Coord(l->getPos2().getX(), tgPos),speed);
 	timeAfterMouseHold += dt;
+	bool bWasVisualPressed = bVisualPressed;
 	bVisualPressed = false;
 	if (bPressed) {
 		if(remDist <= 0.01f) {
 			bVisualPressed = true;
 		}
 	}
+	if (bWasVisualPressed != bVisualPressed) {
+		g_sim->getSolver()->markDirty();
+	}
 }
 
 #endif
@@ -34,11 +34,14 @@ class CJunction : public CShape {
 	float voltage;
 	float duty;
 	int visitCount;
+	// stamp of the last path search that reached this junction
+	int pathStamp;
 	bool bCurrentSource;
 	int depth;
 public:
 	CJunction() {
 		depth = 0;
+		pathStamp = 0;
 	}
 	CJunction(float _x, float _y, const char *s, int gpio = -1) {
 		this->setPosition(_x, _y);
@@ -47,6 +50,7 @@ public:
 		this->voltage = -1;
 		this->duty = 100;
 		this->visitCount = 0;
+		this->pathStamp = 0;
 		this->bCurrentSource = false;
 		this->depth = 0;
 	}
@@ -94,6 +98,12 @@ public:
 	int getVisitCount() const {
 		return visitCount;
 	}
+	void setPathStamp(int i) {
+		pathStamp = i;
+	}
+	int getPathStamp() const {
+		return pathStamp;
+	}
 	bool hasVoltage(float f) const {
 		if (visitCount <= 0)
 			return false;
@@ -7,7 +7,16 @@
 #include "Simulator.h"
 #include "PrefabManager.h"
 
+static int g_lastSimulationRevision = 0;
 
+CSimulation::CSimulation() {
+	sim = 0;
+	revision = ++g_lastSimulationRevision;
+}
+void CSimulation::markModified() {
+	// global counter, so a new simulation never reuses revision of old one
+	revision = ++g_lastSimulationRevision;
+}
 void CSimulation::removeJunctions(class CShape *s) {
 	CJunction *j = dynamic_cast<CJunction*>(s);
 	if (j != 0) {
@@ -26,6 +35,7 @@ void CSimulation::removeJunctions(class CShape *s) {
 }
 void CSimulation::removeJunction(class CJunction *ju) {
 	junctions.remove(ju);
+	markModified();
 }
 float CSimulation::drawTextStats(float h) {
 	h = drawText(NULL, 10, h, "Objects %i, wires %i", objects.size(), wires.size());
@@ -95,6 +105,7 @@ bool CSimulation::isJunctionOnList(class CJunction *ju) {
 }
 void CSimulation::registerJunction(class CJunction *ju) {
 	junctions.push_back(ju);
+	markModified();
 }
 void CSimulation::registerJunctions(class CWire *w) {
 	for (int i = 0; i < w->getJunctionsCount(); i++) {
@@ -196,30 +207,37 @@ void CSimulation::createDemo() {
 	recalcBounds();
 }
 void CSimulation::matchAllJunctions() {
+	rebuildJunctionGrid();
 	for (int i = 0; i < wires.size(); i++) {
 		CWire *w = wires[i];
-		matchJunction(w);
+		for (int j = 0; j < w->getJunctionsCount(); j++) {
+			matchJunctionUsingGrid(w->getJunction(j));
+		}
 	}
 }
 
 
 void CSimulation::matchJunctionsOf_r(class CShape *s) {
+	rebuildJunctionGrid();
+	matchJunctionsUsingGrid_r(s);
+}
+void CSimulation::matchJunctionsUsingGrid_r(class CShape *s) {
 	for (int j = 0; j < s->getShapesCount(); j++) {
 		CShape *ch = s->getShape(j);
 		if (ch->isJunction()) {
-			// this could be done much better, dont rematch all, just add new
 			CJunction *jun = dynamic_cast<CJunction*>(ch);
-			matchJunction(jun);
+			matchJunctionUsingGrid(jun);
 		}
 		else {
-			matchJunctionsOf_r(ch);
+			matchJunctionsUsingGrid_r(ch);
 		}
 	}
 }
 void CSimulation::matchJunction(class CWire *w) {
+	rebuildJunctionGrid();
 	for (int j = 0; j < w->getJunctionsCount(); j++) {
 		CJunction *oj = w->getJunction(j);
-		matchJunction(oj);
+		matchJunctionUsingGrid(oj);
 	}
 }
 void CSimulation::tryMatchJunction(class CJunction *jn, class CJunction *oj) {
@@ -238,27 +256,60 @@ void CSimulation::tryMatchJunction(class CJunction *jn, class CJunction *oj) {
 		oj->addLink(jn);
 	}
 }
-void CSimulation::matchJunction_r(class CShape *sh, class CJunction *jn) {
-	for (int i = 0; i < sh->getShapesCount(); i++) {
-		CShape *s = sh->getShape(i);
-		tryMatchJunction(jn, dynamic_cast<CJunction*>(s));
-	}
-}
+// Junctions closer than 1 unit are linked, so with cells bigger than that
+// it's enough to check the cell of junction and its 8 neighbours
+#define JUNCTION_GRID_CELL 16.0f
 
-void CSimulation::matchJunction(class CJunction *jn) {
-	jn->clearLinks();
+static long long getJunctionGridKey(int cx, int cy) {
+	return (((long long)cx) << 32) ^ (unsigned int)cy;
+}
+void CSimulation::addToJunctionGrid(class CJunction *ju) {
+	Coord p = ju->getAbsPosition();
+	int cx = (int)floor(p.getX() / JUNCTION_GRID_CELL);
+	int cy = (int)floor(p.getY() / JUNCTION_GRID_CELL);
+	junctionGrid[getJunctionGridKey(cx, cy)].push_back(ju);
+}
+// same candidates as before: junctions of wires and direct child junctions of objects
+void CSimulation::rebuildJunctionGrid() {
+	junctionGrid.clear();
 	for (int i = 0; i < wires.size(); i++) {
 		CWire *w = wires[i];
 		for (int j = 0; j < w->getJunctionsCount(); j++) {
-			CJunction *oj = w->getJunction(j);
-			tryMatchJunction(jn, oj);
+			addToJunctionGrid(w->getJunction(j));
 		}
 	}
 	for (int i = 0; i < objects.size(); i++) {
-		CShape *s = objects[i];
-		matchJunction_r(s, jn);
+		CShape *o = objects[i];
+		for (int j = 0; j < o->getShapesCount(); j++) {
+			CJunction *oj = dynamic_cast<CJunction*>(o->getShape(j));
+			if (oj) {
+				addToJunctionGrid(oj);
+			}
+		}
+	}
+	markModified();
+}
+void CSimulation::matchJunctionUsingGrid(class CJunction *jn) {
+	jn->clearLinks();
+	Coord p = jn->getAbsPosition();
+	int cx = (int)floor(p.getX() / JUNCTION_GRID_CELL);
+	int cy = (int)floor(p.getY() / JUNCTION_GRID_CELL);
+	for (int x = cx - 1; x <= cx + 1; x++) {
+		for (int y = cy - 1; y <= cy + 1; y++) {
+			auto it = junctionGrid.find(getJunctionGridKey(x, y));
+			if (it == junctionGrid.end())
+				continue;
+			TArray<CJunction*> &cell = it->second;
+			for (int i = 0; i < cell.size(); i++) {
+				tryMatchJunction(jn, cell[i]);
+			}
+		}
 	}
 }
+void CSimulation::matchJunction(class CJunction *jn) {
+	rebuildJunctionGrid();
+	matchJunctionUsingGrid(jn);
+}
 void CSimulation::destroyObject(CShape *s) {
 	CJunction *j = 0;
 	CEdge *ed = 0;
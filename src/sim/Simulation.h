@@ -2,7 +2,7 @@
 #define __SIMULATION_H__
 
 #include "sim_local.h"
-
+#include <unordered_map>
 
 class CSimulation {
 	class CSimulator *sim;
@@ -12,6 +12,12 @@ class CSimulation {
 	TArray<class CWire*> wires;
 	// only pointers to junctions that belongs to allocated objects or wires
 	TArray<class CJunction*> junctions;
+	// uniform grid of junctions that can be matched, keyed by cell,
+	// rebuilt before each matching pass because shapes move freely
+	std::unordered_map<long long, TArray<class CJunction*>> junctionGrid;
+	// changed each time junctions or links are added or removed,
+	// lets solver know when it has to flood the net again
+	int revision;
 
 	void removeJunctions(class CShape *s);
 	void removeJunction(class CJunction *ju);
@@ -20,7 +26,13 @@ class CSimulation {
 	void registerJunctions(class CWire *w);
 	void registerJunctions(class CShape *s);
 	class CShape *findDeepText_r(const class Coord &p, class CShape *cur);
+	void markModified();
+	void addToJunctionGrid(class CJunction *ju);
+	void rebuildJunctionGrid();
+	void matchJunctionUsingGrid(class CJunction *jn);
+	void matchJunctionsUsingGrid_r(class CShape *s);
 public:
+	CSimulation();
 	template <typename T>
 	T *findFirstControllerOfType() {
 		for (int i = 0; i < objects.size(); i++) {
@@ -64,6 +76,9 @@ public:
 	class CJunction *getJunction(int i) {
 		return junctions[i];
 	}
+	int getRevision() const {
+		return revision;
+	}
 
 	void recalcBounds();
 	void createDemo();
@@ -77,7 +92,6 @@ public:
 	class CShape *findShapeByBoundsPoint(const class Coord &p, bool bIncludeDeepText = false);
 	void destroyObject(CShape *s);
 	void tryMatchJunction(class CJunction *jn, class CJunction *other);
-	void matchJunction_r(class CShape *sh, class CJunction *j);
 	void matchJunction(class CJunction *j);
 	void matchJunction(class CWire *w);
 	void matchJunctionsOf_r(class CShape *s);
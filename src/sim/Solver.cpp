@@ -4,7 +4,21 @@
 #include "Simulation.h"
 #include "Controller_Base.h"
 
+CSolver::CSolver() {
+	sim = 0;
+	solvedSim = 0;
+	solvedRevision = 0;
+	bDirty = true;
+	pathStamp = 0;
+}
 void CSolver::solveVoltages() {
+	// flooding whole net every frame is slow for big boards,
+	// results only change when sources, switches or links change
+	if (bDirty == false && solvedSim == sim && solvedRevision == sim->getRevision())
+		return;
+	bDirty = false;
+	solvedSim = sim;
+	solvedRevision = sim->getRevision();
 	for (int i = 0; i < sim->getJunctionsCount(); i++) {
 		CJunction *ju = sim->getJunction(i);
 		if (ju->isCurrentSource() == false) {
@@ -35,29 +49,31 @@ void CSolver::solveVoltages() {
 }
 bool CSolver::hasPath(class CJunction *a, class CJunction *b) {
 	TArray<CJunction*> toVisit;
-	TArray<CJunction*> checked;
+	pathStamp++;
+	a->setPathStamp(pathStamp);
 	toVisit.push_back(a);
 	while (toVisit.size()) {
 		CJunction *j = toVisit.pop();
-		checked.push_back(j);
 		for (int i = 0; i < j->getEdgesCount(); i++) {
 			CJunction *other = j->getEdge(i)->getOther(j);
 			if (other == 0)
 				continue;
-			if (checked.contains(other))
+			if (other->getPathStamp() == pathStamp)
 				continue;
 			if (other == b)
 				return true;
+			other->setPathStamp(pathStamp);
 			toVisit.push_back(other);
 		}
 		for (int i = 0; i < j->getLinksCount(); i++) {
 			CJunction *other = j->getLink(i);
 			if (other == 0)
 				continue;
-			if (checked.contains(other))
+			if (other->getPathStamp() == pathStamp)
 				continue;
 			if (other == b)
 				return true;
+			other->setPathStamp(pathStamp);
 			toVisit.push_back(other);
 		}
 	}
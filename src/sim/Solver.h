@@ -5,9 +5,20 @@
 
 class CSolver {
 	class CSimulation *sim;
+	// simulation and its revision that voltages were last solved for
+	class CSimulation *solvedSim;
+	int solvedRevision;
+	// set by controllers when switch, button or pin state changes
+	bool bDirty;
+	// incremented for each hasPath search
+	int pathStamp;
 
 	void floodJunctions(class CJunction *ju, float voltage, float duty, int depth = 0);
 public:
+	CSolver();
+	void markDirty() {
+		bDirty = true;
+	}
 	void setSimulation(class CSimulation *p) {
 		sim = p;
 	}
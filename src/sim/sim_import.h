@@ -7,6 +7,7 @@ extern "C" {
 	// pins control simulation
 	void SIM_SetSimulatedPinValue(int pinIndex, bool bHigh);
 	bool SIM_GetSimulatedPinValue(int pinIndex);
+	int SIM_GetDigitalReadsCount(int pinIndex);
 	bool SIM_IsPinInput(int index);
 	bool SIM_IsPinPWM(int index);
 	bool SIM_IsPinADC(int index);
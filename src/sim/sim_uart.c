@@ -4,6 +4,7 @@ static byte *g_recvBuf = 0;
 static int g_recvBufSize = 0;
 static int g_recvBufIn = 0;
 static int g_recvBufOut = 0;
+static int g_bulkWrites = 0;
 
 void SIM_UART_InitReceiveRingBuffer(int size) {
 	if (g_recvBuf != 0)
@@ -24,7 +25,7 @@ int SIM_UART_GetDataSize()
 {
     int ret = (g_recvBufIn >= g_recvBufOut
                 ? g_recvBufIn - g_recvBufOut
-                : g_recvBufIn + (g_recvBufSize - g_recvBufOut) + 1);
+                : g_recvBufIn + (g_recvBufSize - g_recvBufOut));
 	return ret;
 }
 
@@ -44,6 +45,28 @@ void SIM_AppendUARTByte(byte rc) {
     }
 }
 
+// whole write at once, like a HAL with bulk write (DMA/FIFO)
+void SIM_AppendUARTBytes(const byte *data, int len) {
+	int space, first;
+
+	g_bulkWrites++;
+	space = g_recvBufSize - 1 - SIM_UART_GetDataSize();
+	if (len > space)
+		len = space;
+	if (len <= 0)
+		return;
+	first = g_recvBufSize - g_recvBufIn;
+	if (first > len)
+		first = len;
+	memcpy(g_recvBuf + g_recvBufIn, data, first);
+	memcpy(g_recvBuf, data + first, len - first);
+	g_recvBufIn = (g_recvBufIn + len) % g_recvBufSize;
+}
+
+int SIM_UART_GetBulkWrites() {
+	return g_bulkWrites;
+}
+
 bool SIM_UART_ExpectAndConsumeHByte(byte b) {
 	byte nextB;
 	int dataSize = SIM_UART_GetDataSize();
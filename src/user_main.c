@@ -30,6 +30,7 @@
 #include "logging/logging.h"
 #include "httpserver/http_tcp_server.h"
 #include "httpserver/rest_interface.h"
+#include "httpserver/http_events.h"
 #include "mqtt/new_mqtt.h"
 #include "hal/hal_ota.h"
 
@@ -791,6 +792,9 @@ void Main_OnEverySecond()
 			EventHandlers_FireEvent(CMD_EVENT_MQTT_STATE, 0);
 		}
 	}
+#endif
+#if ENABLE_HTTP_EVENTS
+	HTTP_Events_OnEverySecond();
 #endif
 	if (g_newWiFiStatus != g_prevWiFiStatus) {
 		g_prevWiFiStatus = g_newWiFiStatus;
@@ -1122,6 +1126,33 @@ int g_pinDeepSleepWakeUp = 0;
 unsigned int g_deltaTimeMS;
 
 
+// WiFi LED
+static void QuickTick_RunWiFiLED(int deltaMS)
+{
+	// In Open Access point mode, fast blink
+	if (Main_IsOpenAccessPointMode()) {
+		g_wifiLedToggleTime += deltaMS;
+		if (g_wifiLedToggleTime > WIFI_LED_FAST_BLINK_DURATION) {
+			g_wifi_ledState = !g_wifi_ledState;
+			g_wifiLedToggleTime = 0;
+			PIN_set_wifi_led(g_wifi_ledState);
+		}
+	}
+	else if (Main_IsConnectedToWiFi()) {
+		// In WiFi client success mode, just stay enabled
+		PIN_set_wifi_led(1);
+	}
+	else {
+		// in connecting mode, slow blink
+		g_wifiLedToggleTime += deltaMS;
+		if (g_wifiLedToggleTime > WIFI_LED_SLOW_BLINK_DURATION) {
+			g_wifi_ledState = !g_wifi_ledState;
+			g_wifiLedToggleTime = 0;
+			PIN_set_wifi_led(g_wifi_ledState);
+		}
+	}
+}
+
 /////////////////////////////////////////////////////
 // this is what we do in a qucik tick
 void QuickTick(void* param)
@@ -1173,6 +1204,9 @@ void QuickTick(void* param)
 #if ENABLE_MQTT
 	MQTT_RunQuickTick();
 #endif
+#if ENABLE_HTTP_EVENTS
+	HTTP_Events_RunQuickTick();
+#endif
 
 #if ENABLE_LED_BASIC
 	if (CFG_HasFlag(OBK_FLAG_LED_SMOOTH_TRANSITIONS) == true) {
@@ -1180,31 +1214,83 @@ void QuickTick(void* param)
 	}
 #endif
 
-	// WiFi LED
-	// In Open Access point mode, fast blink
-	if (Main_IsOpenAccessPointMode()) {
-		g_wifiLedToggleTime += g_deltaTimeMS;
-		if (g_wifiLedToggleTime > WIFI_LED_FAST_BLINK_DURATION) {
-			g_wifi_ledState = !g_wifi_ledState;
-			g_wifiLedToggleTime = 0;
-			PIN_set_wifi_led(g_wifi_ledState);
-		}
+	QuickTick_RunWiFiLED(g_deltaTimeMS);
+
+}
+
+#ifdef WINDOWS
+// Simulator fast-forward. Returns how many frames of frameMS (up to maxFrames)
+// QuickTick would spend doing nothing but counting down delays.
+int QuickTick_GetIdleFrames(int maxFrames, int frameMS) {
+	int deadline;
+
+	if (g_bWantPinDeepSleep || PIN_NeedsQuickTick()) {
+		return 0;
 	}
-	else if (Main_IsConnectedToWiFi()) {
-		// In WiFi client success mode, just stay enabled
-		PIN_set_wifi_led(1);
+#ifndef OBK_DISABLE_ALL_DRIVERS
+	if (DRV_HasRunningQuickTick()) {
+		return 0;
 	}
-	else {
-		// in connecting mode, slow blink
-		g_wifiLedToggleTime += g_deltaTimeMS;
-		if (g_wifiLedToggleTime > WIFI_LED_SLOW_BLINK_DURATION) {
-			g_wifi_ledState = !g_wifi_ledState;
-			g_wifiLedToggleTime = 0;
-			PIN_set_wifi_led(g_wifi_ledState);
-		}
+#endif
+#if ENABLE_MQTT
+	if (MQTT_HasPendingReceived()) {
+		return 0;
 	}
-
+#endif
+#if ENABLE_HTTP_EVENTS
+	if (HTTP_Events_HasQuickTickWork()) {
+		return 0;
+	}
+#endif
+#if ENABLE_LED_BASIC
+	if (CFG_HasFlag(OBK_FLAG_LED_SMOOTH_TRANSITIONS) == true) {
+		return 0;
+	}
+#endif
+#if ENABLE_OBK_SCRIPTING
+	// thread with delay d wakes in frame ceil(d / frameMS), so it can skip one less
+	deadline = SVM_GetNextDeadlineMS();
+	if (deadline >= 0) {
+		deadline = (deadline + frameMS - 1) / frameMS - 1;
+		if (deadline < maxFrames)
+			maxFrames = deadline;
+	}
+#endif
+#if ENABLE_OBK_BERRY
+	extern int Berry_GetNextDeadlineMS();
+	deadline = Berry_GetNextDeadlineMS();
+	if (deadline >= 0) {
+		deadline = (deadline + frameMS - 1) / frameMS - 1;
+		if (deadline < maxFrames)
+			maxFrames = deadline;
+	}
+#endif
+	if (maxFrames <= 0) {
+		return 0;
+	}
+	return RepeatingEvents_GetIdleFrames(maxFrames, frameMS * 0.001f);
 }
+// Simulated time was already moved forward by frames * frameMS;
+// update everything that QuickTick would have counted down.
+void QuickTick_SkipIdleFrames(int frames, int frameMS) {
+	PIN_SkipIdleTime();
+	g_timeMs = rtos_get_time();
+	g_deltaTimeMS = frameMS;
+	g_last_time = g_timeMs;
+#if ENABLE_OBK_SCRIPTING
+	SVM_SkipIdleTime(frames * frameMS);
+#endif
+#if ENABLE_OBK_BERRY
+	extern void Berry_SkipIdleTime(int deltaMS);
+	Berry_SkipIdleTime(frames * frameMS);
+#endif
+	RepeatingEvents_SkipIdleFrames(frames, frameMS * 0.001f);
+	// there is no WiFi LED pin, but keep the blink phase as it would be
+	while (frames-- > 0) {
+		QuickTick_RunWiFiLED(frameMS);
+	}
+}
+#endif
 
 #define QT_STACK_SIZE 2048
 
@@ -1357,6 +1443,9 @@ void Main_Init_BeforeDelay_Unsafe(bool bAutoRunScripts) {
 
 	// initialise rest interface
 	init_rest();
+#if ENABLE_HTTP_EVENTS
+	HTTP_Events_Init();
+#endif
 
 	// add some commands...
 	taslike_commands_init();
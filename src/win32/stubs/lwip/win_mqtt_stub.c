@@ -1373,7 +1373,8 @@ void WIN_RunMQTTClient(mqtt_client_t *cl) {
 		FD_SET(cl->conn->sock, &fd);
 		time.tv_sec = 0;
 		time.tv_usec = 0;
-		if (select(0, NULL, &fd, NULL, &time) == 1) {
+		// first argument is ignored on Windows, but Linux needs highest fd + 1
+		if (select(cl->conn->sock + 1, NULL, &fd, NULL, &time) == 1) {
 			int error = 0;
 			unsigned int len = sizeof(error);
 			getsockopt(cl->conn->sock, SOL_SOCKET, SO_ERROR, (char*)&error, &len);
@@ -1426,6 +1427,15 @@ void WIN_ResetMQTT() {
 	memset(g_clients, 0, sizeof(g_clients));
 	g_numClients = 0;
 }
+// true if no client has a socket that WIN_RunMQTTFrame would poll
+bool WIN_IsMQTTIdle() {
+	for (int i = 0; i < g_numClients; i++) {
+		if (g_clients[i] && g_clients[i]->conn) {
+			return false;
+		}
+	}
+	return true;
+}
 void WIN_RunMQTTFrame() {
 	for (int i = 0; i < g_numClients; i++) {
 		mqtt_client_t *client = g_clients[i];
@@ -0,0 +1,543 @@
+#ifdef WINDOWS
+
+// Headless fleet mode, runs many simulated devices at once to load test
+// MQTT brokers, Home Assistant and Device Groups without real hardware:
+// win_main -fleet 100 -fleetMQTT 192.168.0.113 -fleetMQTTUser homeassistant -fleetMQTTPassword xxx
+// Other options:
+// -fleetSeconds 600 - run time, 0 runs until Ctrl+C
+// -fleetPort 8100 - HTTP port of first device, next devices get next ports
+// -fleetClient obkfleet - MQTT client ID prefix, device index is appended
+// -fleetDir path - where devices keep flash.bin and device.log (default is a new temp dir)
+// -fleetWorkload toggle=10,energy=1,button=0 - seconds between synthetic events, 0 disables
+// -fleetReport report.json - write per device and aggregate results
+// Each device is a forked process with its own flash file, HTTP port and MQTT client ID.
+
+#include "new_common.h"
+#include "new_pins.h"
+#include "cmnds/cmd_public.h"
+#include "mqtt/new_mqtt.h"
+#include "sim/sim_import.h"
+
+#if LINUX
+
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern int g_httpPort;
+extern long g_delta;
+long SIM_GetTime();
+void Sim_RunFrame(int frameTime);
+void Sim_SendFakeBL0942Packet(float v, float c, float p);
+const char *va(const char *fmt, ...);
+
+#define FLEET_FRAME_TIME 10
+// pins used by synthetic workload
+#define FLEET_RELAY_PIN 6
+#define FLEET_BUTTON_PIN 8
+// how long the simulated button is held
+#define FLEET_BUTTON_HOLD_MS 150
+
+typedef struct fleetConfig_s {
+	int devices;
+	int seconds;
+	int basePort;
+	char mqttHost[64];
+	char mqttUser[64];
+	char mqttPassword[128];
+	char clientPrefix[32];
+	char dir[192];
+	const char *reportPath;
+	// seconds between events, 0 if disabled
+	float togglePeriod;
+	float energyPeriod;
+	float buttonPeriod;
+} fleetConfig_t;
+
+typedef struct fleetStats_s {
+	int publishes;
+	int publishErrors;
+	int received;
+	int connects;
+	int bConnected;
+	int toggles;
+	int energySamples;
+	int buttonPresses;
+	// from synthetic event to the first publish caused by it
+	int latencyCount;
+	double latencySum;
+	int latencyMax;
+	// real time between frames, shows how overloaded the host is
+	int frames;
+	double frameTimeSum;
+	int frameTimeMax;
+	int rssKB;
+	int peakRssKB;
+	double seconds;
+} fleetStats_t;
+
+static fleetConfig_t g_fleet = {
+	0, 60, 8100, "", "", "", "obkfleet", "", 0,
+	10.0f, 1.0f, 0.0f
+};
+// signal that stopped the fleet, 0 while running
+static volatile sig_atomic_t g_fleetStop = 0;
+
+static void Fleet_OnSignal(int sig) {
+	g_fleetStop = sig;
+}
+
+// usleep is taken by the soft I2C delay loop in this build, so sleep for real here
+static void Fleet_Sleep(int ms) {
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep(&ts, 0);
+}
+
+static void Fleet_SetString(char *out, int outSize, const char *value) {
+	strncpy(out, value, outSize - 1);
+	out[outSize - 1] = 0;
+}
+
+// spec is like "toggle=10,energy=1,button=0"
+static bool Fleet_ParseWorkload(const char *spec) {
+	char name[16];
+	float period;
+	int used;
+
+	while (*spec) {
+		if (sscanf(spec, "%15[^=]=%f%n", name, &period, &used) != 2) {
+			return false;
+		}
+		if (!stricmp(name, "toggle")) {
+			g_fleet.togglePeriod = period;
+		}
+		else if (!stricmp(name, "energy")) {
+			g_fleet.energyPeriod = period;
+		}
+		else if (!stricmp(name, "button")) {
+			g_fleet.buttonPeriod = period;
+		}
+		else {
+			return false;
+		}
+		spec += used;
+		if (*spec == ',') {
+			spec++;
+		}
+	}
+	return true;
+}
+
+// name is the part after "-fleet", so empty name is the device count
+bool Fleet_SetOption(const char *name, const char *value) {
+	if (value == 0) {
+		return false;
+	}
+	if (*name == 0) {
+		g_fleet.devices = atoi(value);
+	}
+	else if (!stricmp(name, "Seconds")) {
+		g_fleet.seconds = atoi(value);
+	}
+	else if (!stricmp(name, "Port")) {
+		g_fleet.basePort = atoi(value);
+	}
+	else if (!stricmp(name, "MQTT")) {
+		Fleet_SetString(g_fleet.mqttHost, sizeof(g_fleet.mqttHost), value);
+	}
+	else if (!stricmp(name, "MQTTUser")) {
+		Fleet_SetString(g_fleet.mqttUser, sizeof(g_fleet.mqttUser), value);
+	}
+	else if (!stricmp(name, "MQTTPassword")) {
+		Fleet_SetString(g_fleet.mqttPassword, sizeof(g_fleet.mqttPassword), value);
+	}
+	else if (!stricmp(name, "Client")) {
+		Fleet_SetString(g_fleet.clientPrefix, sizeof(g_fleet.clientPrefix), value);
+	}
+	else if (!stricmp(name, "Dir")) {
+		Fleet_SetString(g_fleet.dir, sizeof(g_fleet.dir), value);
+	}
+	else if (!stricmp(name, "Report")) {
+		g_fleet.reportPath = value;
+	}
+	else if (!stricmp(name, "Workload")) {
+		return Fleet_ParseWorkload(value);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+bool Fleet_IsEnabled() {
+	return g_fleet.devices > 0;
+}
+
+static void Fleet_ReadMemory(fleetStats_t *st) {
+	char line[128];
+	FILE *f;
+
+	f = fopen("/proc/self/status", "r");
+	if (f == 0) {
+		return;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		sscanf(line, "VmRSS: %i", &st->rssKB);
+		sscanf(line, "VmHWM: %i", &st->peakRssKB);
+	}
+	fclose(f);
+}
+
+static void Fleet_SetupDevice(int index) {
+	CMD_ExecuteCommand(va("MqttClient %s_%i", g_fleet.clientPrefix, index), 0);
+	if (g_fleet.mqttHost[0]) {
+		CMD_ExecuteCommand(va("MqttHost %s", g_fleet.mqttHost), 0);
+	}
+	if (g_fleet.mqttUser[0]) {
+		CMD_ExecuteCommand(va("MqttUser %s", g_fleet.mqttUser), 0);
+	}
+	if (g_fleet.mqttPassword[0]) {
+		CMD_ExecuteCommand(va("MqttPassword %s", g_fleet.mqttPassword), 0);
+	}
+	PIN_SetPinRoleForPinIndex(FLEET_RELAY_PIN, IOR_Relay);
+	PIN_SetPinChannelForPinIndex(FLEET_RELAY_PIN, 1);
+	if (g_fleet.buttonPeriod > 0) {
+		PIN_SetPinRoleForPinIndex(FLEET_BUTTON_PIN, IOR_Button);
+		PIN_SetPinChannelForPinIndex(FLEET_BUTTON_PIN, 1);
+		SIM_SetSimulatedPinValue(FLEET_BUTTON_PIN, true);
+	}
+	if (g_fleet.energyPeriod > 0) {
+		CMD_ExecuteCommand("startDriver BL0942", 0);
+	}
+}
+
+// first event of each kind is at random time, so devices don't fire in sync
+static long Fleet_FirstEventTime(long now, float period) {
+	if (period <= 0) {
+		return -1;
+	}
+	return now + rand() % ((int)(period * 1000) + 1);
+}
+
+static void Fleet_WriteStats(const fleetStats_t *st) {
+	FILE *f;
+
+	f = fopen("stats.txt", "w");
+	if (f == 0) {
+		return;
+	}
+	fprintf(f, "%i %i %i %i %i %i %i %i %i %lf %i %i %lf %i %i %i %lf\n",
+		st->publishes, st->publishErrors, st->received, st->connects, st->bConnected,
+		st->toggles, st->energySamples, st->buttonPresses,
+		st->latencyCount, st->latencySum, st->latencyMax,
+		st->frames, st->frameTimeSum, st->frameTimeMax,
+		st->rssKB, st->peakRssKB, st->seconds);
+	fclose(f);
+}
+
+static bool Fleet_ReadStats(const char *dir, fleetStats_t *st) {
+	char path[256];
+	FILE *f;
+	int read;
+
+	snprintf(path, sizeof(path), "%s/stats.txt", dir);
+	f = fopen(path, "r");
+	if (f == 0) {
+		return false;
+	}
+	read = fscanf(f, "%i %i %i %i %i %i %i %i %i %lf %i %i %lf %i %i %i %lf",
+		&st->publishes, &st->publishErrors, &st->received, &st->connects, &st->bConnected,
+		&st->toggles, &st->energySamples, &st->buttonPresses,
+		&st->latencyCount, &st->latencySum, &st->latencyMax,
+		&st->frames, &st->frameTimeSum, &st->frameTimeMax,
+		&st->rssKB, &st->peakRssKB, &st->seconds);
+	fclose(f);
+	return read == 17;
+}
+
+static void Fleet_RunDevice(int index, const char *dir) {
+	fleetStats_t st;
+	long start, now, prev;
+	long nextToggle, nextEnergy, nextButton, buttonRelease;
+	// time of the oldest event still waiting for publish, -1 if none,
+	// events from before MQTT is connected are not counted
+	long pendingEvent;
+	int lastPublishes;
+
+	if (chdir(dir) != 0 || freopen("device.log", "w", stdout) == 0) {
+		_exit(2);
+	}
+	dup2(fileno(stdout), 2);
+	srand(getpid());
+	memset(&st, 0, sizeof(st));
+
+	g_httpPort = g_fleet.basePort + index;
+	SIM_ClearOBK("flash.bin");
+	Fleet_SetupDevice(index);
+
+	start = SIM_GetTime();
+	prev = start;
+	nextToggle = Fleet_FirstEventTime(start, g_fleet.togglePeriod);
+	nextEnergy = Fleet_FirstEventTime(start, g_fleet.energyPeriod);
+	nextButton = Fleet_FirstEventTime(start, g_fleet.buttonPeriod);
+	buttonRelease = -1;
+	pendingEvent = -1;
+	lastPublishes = MQTT_GetPublishEventCounter();
+	while (g_fleetStop == 0) {
+		now = SIM_GetTime();
+		if (g_fleet.seconds > 0 && now - start >= g_fleet.seconds * 1000) {
+			break;
+		}
+		g_delta = now - prev;
+		if (g_delta <= 0) {
+			Fleet_Sleep(1);
+			continue;
+		}
+		prev = now;
+		if (nextToggle >= 0 && now >= nextToggle) {
+			nextToggle = now + (long)(g_fleet.togglePeriod * 1000);
+			CHANNEL_Toggle(1);
+			st.toggles++;
+			if (pendingEvent < 0 && MQTT_IsReady()) {
+				pendingEvent = now;
+			}
+		}
+		if (nextEnergy >= 0 && now >= nextEnergy) {
+			nextEnergy = now + (long)(g_fleet.energyPeriod * 1000);
+			// some noise around 230V and a load that depends on relay state
+			if (CHANNEL_Get(1)) {
+				Sim_SendFakeBL0942Packet(225 + rand() % 10, 0.26f + (rand() % 10) * 0.01f, 60 + rand() % 5);
+			}
+			else {
+				Sim_SendFakeBL0942Packet(225 + rand() % 10, 0, 0);
+			}
+			st.energySamples++;
+		}
+		if (nextButton >= 0 && now >= nextButton) {
+			nextButton = now + (long)(g_fleet.buttonPeriod * 1000);
+			SIM_SetSimulatedPinValue(FLEET_BUTTON_PIN, false);
+			buttonRelease = now + FLEET_BUTTON_HOLD_MS;
+			st.buttonPresses++;
+			if (pendingEvent < 0 && MQTT_IsReady()) {
+				pendingEvent = now;
+			}
+		}
+		if (buttonRelease >= 0 && now >= buttonRelease) {
+			SIM_SetSimulatedPinValue(FLEET_BUTTON_PIN, true);
+			buttonRelease = -1;
+		}
+		Sim_RunFrame(g_delta);
+		st.frames++;
+		st.frameTimeSum += g_delta;
+		if (g_delta > st.frameTimeMax) {
+			st.frameTimeMax = g_delta;
+		}
+		if (MQTT_GetPublishEventCounter() != lastPublishes) {
+			lastPublishes = MQTT_GetPublishEventCounter();
+			if (pendingEvent >= 0) {
+				int latency = SIM_GetTime() - pendingEvent;
+				st.latencyCount++;
+				st.latencySum += latency;
+				if (latency > st.latencyMax) {
+					st.latencyMax = latency;
+				}
+				pendingEvent = -1;
+			}
+		}
+		Fleet_Sleep(FLEET_FRAME_TIME);
+	}
+
+	st.seconds = (SIM_GetTime() - start) * 0.001;
+	st.publishes = MQTT_GetPublishEventCounter();
+	st.publishErrors = MQTT_GetPublishErrorCounter();
+	st.received = MQTT_GetReceivedEventCounter();
+	st.connects = MQTT_GetConnectEvents();
+	st.bConnected = MQTT_IsReady();
+	Fleet_ReadMemory(&st);
+	Fleet_WriteStats(&st);
+	SIM_SaveFlashData("flash.bin");
+	fflush(stdout);
+	_exit(0);
+}
+
+static void Fleet_WriteReport(const char *path, const fleetStats_t *stats, int count, const fleetStats_t *total) {
+	FILE *f;
+	int i;
+
+	f = fopen(path, "w");
+	if (f == 0) {
+		printf("Failed to open %s\n", path);
+		return;
+	}
+	fprintf(f, "{\"devices\":%i,\"publishes\":%i,\"publishErrors\":%i,\"connected\":%i,"
+		"\"latencyAvgMs\":%.1f,\"latencyMaxMs\":%i,\"rssAvgKB\":%i,\"results\":[\n",
+		count, total->publishes, total->publishErrors, total->bConnected,
+		total->latencyCount ? total->latencySum / total->latencyCount : 0, total->latencyMax,
+		count ? total->rssKB / count : 0);
+	for (i = 0; i < count; i++) {
+		const fleetStats_t *st = &stats[i];
+		fprintf(f, "  {\"device\":%i,\"seconds\":%.1f,\"publishes\":%i,\"publishErrors\":%i,\"received\":%i,"
+			"\"connects\":%i,\"connected\":%s,\"toggles\":%i,\"energySamples\":%i,\"buttonPresses\":%i,"
+			"\"latencyAvgMs\":%.1f,\"latencyMaxMs\":%i,\"frameAvgMs\":%.1f,\"frameMaxMs\":%i,"
+			"\"rssKB\":%i,\"peakRssKB\":%i}%s\n",
+			i, st->seconds, st->publishes, st->publishErrors, st->received,
+			st->connects, st->bConnected ? "true" : "false", st->toggles, st->energySamples, st->buttonPresses,
+			st->latencyCount ? st->latencySum / st->latencyCount : 0, st->latencyMax,
+			st->frames ? st->frameTimeSum / st->frames : 0, st->frameTimeMax,
+			st->rssKB, st->peakRssKB, (i + 1 < count) ? "," : "");
+	}
+	fprintf(f, "]}\n");
+	fclose(f);
+	printf("Report written to %s\n", path);
+}
+
+int Fleet_Run() {
+	fleetStats_t *stats;
+	fleetStats_t total;
+	char dir[256];
+	pid_t *pids;
+	double seconds;
+	int running, status, i;
+	int failed;
+	struct sigaction sa;
+	pid_t pid;
+
+	if (g_fleet.dir[0] == 0) {
+		strcpy(g_fleet.dir, "/tmp/obk_fleet_XXXXXX");
+		if (mkdtemp(g_fleet.dir) == 0) {
+			printf("Failed to create %s\n", g_fleet.dir);
+			return 1;
+		}
+	}
+	else {
+		mkdir(g_fleet.dir, 0755);
+	}
+	if (g_fleet.mqttHost[0] == 0) {
+		printf("No -fleetMQTT host given, devices will keep their saved MQTT settings\n");
+	}
+	printf("Starting %i devices in %s, HTTP ports %i-%i\n", g_fleet.devices, g_fleet.dir,
+		g_fleet.basePort, g_fleet.basePort + g_fleet.devices - 1);
+	fflush(stdout);
+
+	// no SA_RESTART, waitpid has to return on Ctrl+C
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = Fleet_OnSignal;
+	sigaction(SIGINT, &sa, 0);
+	sigaction(SIGTERM, &sa, 0);
+	stats = (fleetStats_t*)calloc(g_fleet.devices, sizeof(fleetStats_t));
+	pids = (pid_t*)calloc(g_fleet.devices, sizeof(pid_t));
+	running = 0;
+	for (i = 0; i < g_fleet.devices && g_fleetStop == 0; i++) {
+		snprintf(dir, sizeof(dir), "%s/device_%i", g_fleet.dir, i);
+		mkdir(dir, 0755);
+		pid = fork();
+		if (pid == 0) {
+			Fleet_RunDevice(i, dir);
+		}
+		if (pid < 0) {
+			printf("fork failed for device %i\n", i);
+			break;
+		}
+		pids[i] = pid;
+		running++;
+		// don't hit the broker with all connections at once
+		Fleet_Sleep(20);
+	}
+	printf("%i devices running, %s\n", running,
+		g_fleet.seconds > 0 ? va("for %i seconds", g_fleet.seconds) : "press Ctrl+C to stop");
+	fflush(stdout);
+
+	failed = 0;
+	while (running > 0) {
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR) {
+				// Ctrl+C reaches children too, but not a kill of this process
+				for (i = 0; i < g_fleet.devices; i++) {
+					if (pids[i] > 0)
+						kill(pids[i], SIGTERM);
+				}
+				continue;
+			}
+			break;
+		}
+		for (i = 0; i < g_fleet.devices; i++) {
+			if (pids[i] == pid)
+				break;
+		}
+		if (i == g_fleet.devices) {
+			continue;
+		}
+		pids[i] = 0;
+		running--;
+		if (WIFEXITED(status) == false || WEXITSTATUS(status) != 0) {
+			printf("Device %i exited abnormally, see %s/device_%i/device.log\n", i, g_fleet.dir, i);
+			failed++;
+		}
+	}
+
+	memset(&total, 0, sizeof(total));
+	seconds = 0;
+	printf("Device  Publishes  Errors  Connected  Latency avg/max ms  Frame avg/max ms  RSS KB\n");
+	for (i = 0; i < g_fleet.devices; i++) {
+		fleetStats_t *st = &stats[i];
+		snprintf(dir, sizeof(dir), "%s/device_%i", g_fleet.dir, i);
+		if (Fleet_ReadStats(dir, st) == false) {
+			continue;
+		}
+		printf("%6i  %9i  %6i  %9s  %8.1f / %-7i  %7.1f / %-6i  %6i\n", i,
+			st->publishes, st->publishErrors, st->bConnected ? "yes" : "no",
+			st->latencyCount ? st->latencySum / st->latencyCount : 0, st->latencyMax,
+			st->frames ? st->frameTimeSum / st->frames : 0, st->frameTimeMax, st->rssKB);
+		total.publishes += st->publishes;
+		total.publishErrors += st->publishErrors;
+		total.bConnected += st->bConnected;
+		total.latencyCount += st->latencyCount;
+		total.latencySum += st->latencySum;
+		if (st->latencyMax > total.latencyMax)
+			total.latencyMax = st->latencyMax;
+		total.rssKB += st->rssKB;
+		if (st->seconds > seconds)
+			seconds = st->seconds;
+	}
+	printf("Total: %i publishes (%.1f/s), %i errors, %i/%i devices connected\n",
+		total.publishes, seconds > 0 ? total.publishes / seconds : 0,
+		total.publishErrors, total.bConnected, g_fleet.devices);
+	printf("Latency from event to publish: avg %.1f ms, max %i ms\n",
+		total.latencyCount ? total.latencySum / total.latencyCount : 0, total.latencyMax);
+	printf("Memory: avg %i KB RSS per device\n", g_fleet.devices ? total.rssKB / g_fleet.devices : 0);
+	if (g_fleet.reportPath) {
+		Fleet_WriteReport(g_fleet.reportPath, stats, g_fleet.devices, &total);
+	}
+	free(stats);
+	free(pids);
+	return failed;
+}
+
+#else
+
+static int g_fleetDevices = 0;
+
+bool Fleet_SetOption(const char *name, const char *value) {
+	if (*name == 0 && value) {
+		g_fleetDevices = atoi(value);
+	}
+	return true;
+}
+bool Fleet_IsEnabled() {
+	return g_fleetDevices > 0;
+}
+int Fleet_Run() {
+	printf("Fleet mode needs fork, it's only available in Linux build\n");
+	return 1;
+}
+
+#endif
+
+#endif
@@ -41,6 +41,7 @@
 #include "hal/hal_flashVars.h"
 #include "selftest/selftest_local.h"
 #include "new_pins.h"
+#include "driver/drv_uart.h"
 
 #define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
 
@@ -114,6 +115,54 @@ void Sim_RunFrame(int frameTime)
 		Main_OnEverySecond();
 	}
 }
+// Unit tests don't run frames in which nothing would happen. Simulated time
+// just jumps to the next script delay or repeating event. Main_OnEverySecond
+// still runs at every second boundary on the way, and jump goes on
+// if nothing it did needs quick ticks.
+// Disable with -noFastForward to compare.
+bool g_bSimFastForward = true;
+extern int g_bDoingUnitTestsNow;
+bool WIN_IsMQTTIdle();
+
+static int Sim_SkipIdleFrames(int maxFrames)
+{
+	int frames, skipped, total;
+
+	if (g_bSimFastForward == false || g_bDoingUnitTestsNow == 0)
+	{
+		return 0;
+	}
+	total = 0;
+	while (total < maxFrames && WIN_IsMQTTIdle())
+	{
+		// up to the frame that takes accum_time over 1000 and runs Main_OnEverySecond
+		frames = (1000 - accum_time) / DEFAULT_FRAME_TIME + 1;
+		if (frames > maxFrames - total)
+		{
+			frames = maxFrames - total;
+		}
+		skipped = QuickTick_GetIdleFrames(frames, DEFAULT_FRAME_TIME);
+		if (skipped <= 0)
+		{
+			break;
+		}
+		win_frameNum += skipped;
+		g_simulatedTimeNow += skipped * DEFAULT_FRAME_TIME;
+		accum_time += skipped * DEFAULT_FRAME_TIME;
+		QuickTick_SkipIdleFrames(skipped, DEFAULT_FRAME_TIME);
+		total += skipped;
+		if (accum_time > 1000)
+		{
+			accum_time -= 1000;
+			Main_OnEverySecond();
+		}
+		if (skipped < frames)
+		{
+			break;
+		}
+	}
+	return total;
+}
 void Sim_RunMiliseconds(int ms, bool bApplyRealtimeWait)
 {
 	while (ms > 0)
@@ -122,6 +171,14 @@ void Sim_RunMiliseconds(int ms, bool bApplyRealtimeWait)
 		{
 			Sleep(DEFAULT_FRAME_TIME);
 		}
+		else
+		{
+			ms -= Sim_SkipIdleFrames((ms + DEFAULT_FRAME_TIME - 1) / DEFAULT_FRAME_TIME) * DEFAULT_FRAME_TIME;
+			if (ms <= 0)
+			{
+				break;
+			}
+		}
 		Sim_RunFrame(DEFAULT_FRAME_TIME);
 		ms -= DEFAULT_FRAME_TIME;
 	}
@@ -141,6 +198,14 @@ void Sim_RunFrames(int n, bool bApplyRealtimeWait)
 		{
 			Sleep(DEFAULT_FRAME_TIME);
 		}
+		else
+		{
+			i += Sim_SkipIdleFrames(n - i);
+			if (i >= n)
+			{
+				break;
+			}
+		}
 		Sim_RunFrame(DEFAULT_FRAME_TIME);
 	}
 }
@@ -201,109 +266,137 @@ void Test_PartitionSearch()
 	CMD_ExecuteCommand("startDriver BKPartitions", 0);
 	Sim_RunFrames(500000, false);
 }
-void Win_DoUnitTests()
+static void Test_PinRoleNames()
 {
-	Test_LEDstrips();
-
 	// SELFTEST_ASSERT_EXPRESSION("sqrt(4)", 2)
 	SELFTEST_ASSERT(PIN_ParsePinRoleName("Btn_pd") == IOR_Button_pd);
 	SELFTEST_ASSERT(PIN_ParsePinRoleName("Btn_pd_n") == IOR_Button_pd_n);
 	SELFTEST_ASSERT(PIN_ParsePinRoleName("TglChanOnTgl_pd") == IOR_ToggleChannelOnToggle_pd);
+}
 
-	//Test_Shutters();
-	Test_TuyaMCU_TH08();
-	Test_ButtonEvents();
-	Test_Command_If();
-	Test_MQTT();
-	Test_HTTP_Client();
-	// Test_PartitionSearch();
-	Test_OpenWeatherMap();
-	Test_MAX72XX();
-
-	Test_Commands_Channels();
-
-	Test_Driver_TCL_AC();
-
-	Test_PIR();
+#define SELFTEST_CASE(x) { .name = #x, .run = x }
+
+// all unit tests, in the order Win_DoUnitTests runs them
+static const selfTestCase_t g_unitTests[] = {
+	SELFTEST_CASE(Test_LEDstrips),
+	SELFTEST_CASE(Test_PinRoleNames),
+	//SELFTEST_CASE(Test_Shutters),
+	SELFTEST_CASE(Test_TuyaMCU_TH08),
+	SELFTEST_CASE(Test_ButtonEvents),
+	SELFTEST_CASE(Test_Command_If),
+	SELFTEST_CASE(Test_MQTT),
+	SELFTEST_CASE(Test_HTTP_Client),
+	// SELFTEST_CASE(Test_PartitionSearch),
+	SELFTEST_CASE(Test_OpenWeatherMap),
+	SELFTEST_CASE(Test_MAX72XX),
+	SELFTEST_CASE(Test_DS1820_Full),
+	SELFTEST_CASE(Test_SoftI2C),
+	SELFTEST_CASE(Test_SSDP),
+	SELFTEST_CASE(Test_DriverLists),
+	SELFTEST_CASE(Test_ButtonEdges),
+
+	SELFTEST_CASE(Test_Commands_Channels),
+
+	SELFTEST_CASE(Test_Driver_TCL_AC),
+
+	SELFTEST_CASE(Test_PIR),
 #if ENABLE_OBK_BERRY
-	Test_Berry();
+	SELFTEST_CASE(Test_Berry),
 #endif
 
-	Test_TuyaMCU_Boolean();
-	Test_TuyaMCU_DP22();
-
-	Test_Demo_ConditionalRelay();
-	Test_Expressions_RunTests_Braces();
-	Test_Expressions_RunTests_Basic();
-	Test_Enums();
-	Test_Backlog();
-	Test_DoorSensor();
-	Test_Command_If_Else();
-	Test_ChargeLimitDriver();
+	SELFTEST_CASE(Test_TuyaMCU_Boolean),
+	SELFTEST_CASE(Test_TuyaMCU_DP22),
+
+	SELFTEST_CASE(Test_Demo_ConditionalRelay),
+	SELFTEST_CASE(Test_Expressions_RunTests_Braces),
+	SELFTEST_CASE(Test_Expressions_RunTests_Basic),
+	SELFTEST_CASE(Test_Enums),
+	SELFTEST_CASE(Test_Backlog),
+	SELFTEST_CASE(Test_DoorSensor),
+	SELFTEST_CASE(Test_Command_If_Else),
+	SELFTEST_CASE(Test_ChargeLimitDriver),
 #if ENABLE_BL_SHARED
-	Test_EnergyMeter();
+	SELFTEST_CASE(Test_EnergyMeter),
 #endif
-	Test_TuyaMCU_Calib();
+	SELFTEST_CASE(Test_TuyaMCU_Calib),
 	// this is slowest
-	Test_TuyaMCU_Basic();
-	Test_TuyaMCU_Mult();
-	Test_TuyaMCU_RawAccess();
-	Test_TuyaMCU_Robustness();
-	Test_Battery();
-	Test_TuyaMCU_BatteryPowered();
-	Test_JSON_Lib();
+	SELFTEST_CASE(Test_TuyaMCU_Basic),
+	SELFTEST_CASE(Test_TuyaMCU_Mult),
+	SELFTEST_CASE(Test_TuyaMCU_RawAccess),
+	SELFTEST_CASE(Test_TuyaMCU_Robustness),
+	SELFTEST_CASE(Test_TuyaMCU_ParseBenchmark),
+	SELFTEST_CASE(Test_TuyaMCU_Coalesce),
+	SELFTEST_CASE(Test_Battery),
+	SELFTEST_CASE(Test_TuyaMCU_BatteryPowered),
+	SELFTEST_CASE(Test_JSON_Lib),
 #if ENABLE_LED_BASIC
-	Test_MQTT_Get_LED_EnableAll();
+	SELFTEST_CASE(Test_MQTT_Get_LED_EnableAll),
 #endif
-	Test_MQTT_Get_Relay();
-	Test_Commands_Startup();
-	Test_IF_Inside_Backlog();
-	Test_WaitFor();
-	Test_TwoPWMsOneChannel();
-	Test_ClockEvents();
+	SELFTEST_CASE(Test_MQTT_Get_Relay),
+	SELFTEST_CASE(Test_Commands_Startup),
+	SELFTEST_CASE(Test_IF_Inside_Backlog),
+	SELFTEST_CASE(Test_WaitFor),
+	SELFTEST_CASE(Test_TwoPWMsOneChannel),
+	SELFTEST_CASE(Test_ClockEvents),
 #if ENABLE_HA_DISCOVERY
-	Test_HassDiscovery_Base();
-	Test_HassDiscovery();
-	Test_HassDiscovery_Ext();
+	SELFTEST_CASE(Test_HassDiscovery_Base),
+	SELFTEST_CASE(Test_HassDiscovery),
+	SELFTEST_CASE(Test_HassDiscovery_Ext),
 #endif
-	Test_Role_ToggleAll_2();
-	Test_Demo_ButtonToggleGroup();
-	Test_Demo_ButtonScrollingChannelValues();
-	Test_CFG_Via_HTTP();
-	Test_Commands_Calendar();
-	Test_Commands_Generic();
-	Test_Demo_SimpleShuttersScript();
-	Test_Role_ToggleAll();
-	Test_Demo_FanCyclingRelays();
-	Test_Demo_MapFanSpeedToRelays();
-	Test_MapRanges();
-	Test_Demo_ExclusiveRelays();
-	Test_MultiplePinsOnChannel();
-	Test_Flags();
+	SELFTEST_CASE(Test_Role_ToggleAll_2),
+	SELFTEST_CASE(Test_Demo_ButtonToggleGroup),
+	SELFTEST_CASE(Test_Demo_ButtonScrollingChannelValues),
+	SELFTEST_CASE(Test_CFG_Via_HTTP),
+	SELFTEST_CASE(Test_Commands_Calendar),
+	SELFTEST_CASE(Test_Commands_Generic),
+	SELFTEST_CASE(Test_Demo_SimpleShuttersScript),
+	SELFTEST_CASE(Test_Role_ToggleAll),
+	SELFTEST_CASE(Test_Demo_FanCyclingRelays),
+	SELFTEST_CASE(Test_Demo_MapFanSpeedToRelays),
+	SELFTEST_CASE(Test_MapRanges),
+	SELFTEST_CASE(Test_Demo_ExclusiveRelays),
+	SELFTEST_CASE(Test_MultiplePinsOnChannel),
+	SELFTEST_CASE(Test_Flags),
 #ifndef LINUX
 	// TODO: fix on Linux
-	Test_DHT();
+	SELFTEST_CASE(Test_DHT),
 #endif
-	Test_Tasmota();
-	Test_NTP();
-	Test_TIME_DST();
-	Test_TIME_SunsetSunrise();
-	Test_ExpandConstant();
-	Test_ChangeHandlers_MQTT();
-	Test_ChangeHandlers();
-	Test_ChangeHandlers2();
-	Test_ChangeHandlers_EnsureThatChannelVariableIsExpandedAtHandlerRunTime();
-	Test_RepeatingEvents();
-	Test_Commands_Alias();
-	Test_Demo_SignAndValue();
-	Test_LEDDriver();
-	Test_LFS();
-	Test_Scripting();
-	Test_Tokenizer();
-	Test_Pins();
-	Test_Http();
-	Test_Http_LED();
-	Test_DeviceGroups();
+	SELFTEST_CASE(Test_Tasmota),
+	SELFTEST_CASE(Test_NTP),
+	SELFTEST_CASE(Test_TIME_DST),
+	SELFTEST_CASE(Test_TIME_SunsetSunrise),
+	SELFTEST_CASE(Test_ExpandConstant),
+	SELFTEST_CASE(Test_ChangeHandlers_MQTT),
+	SELFTEST_CASE(Test_ChangeHandlers),
+	SELFTEST_CASE(Test_ChangeHandlers2),
+	SELFTEST_CASE(Test_ChangeHandlers_EnsureThatChannelVariableIsExpandedAtHandlerRunTime),
+	SELFTEST_CASE(Test_RepeatingEvents),
+	SELFTEST_CASE(Test_Commands_Alias),
+	SELFTEST_CASE(Test_Demo_SignAndValue),
+	SELFTEST_CASE(Test_LEDDriver),
+	SELFTEST_CASE(Test_LFS),
+	SELFTEST_CASE(Test_Charts),
+	SELFTEST_CASE(Test_Scripting),
+	SELFTEST_CASE(Test_Tokenizer),
+	SELFTEST_CASE(Test_Pins),
+	SELFTEST_CASE(Test_Http),
+	SELFTEST_CASE(Test_Http_LED),
+	SELFTEST_CASE(Test_DeviceGroups),
+};
+
+const selfTestCase_t *Win_GetUnitTests(int *count)
+{
+	*count = sizeof(g_unitTests) / sizeof(g_unitTests[0]);
+	return g_unitTests;
+}
+void Win_DoUnitTests()
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(g_unitTests) / sizeof(g_unitTests[0])); i++)
+	{
+		g_unitTests[i].run();
+	}
 
 	// Just to be sure
 	// Must be last step
@@ -338,6 +431,10 @@ int g_bDoingUnitTestsNow = 0;
 
 int SelfTest_GetNumErrors();
 extern int g_selfTestsMode;
+// headless multi-device mode, see win_fleet.c
+bool Fleet_SetOption(const char *name, const char *value);
+bool Fleet_IsEnabled();
+int Fleet_Run();
 
 float myFabs(float f)
 {
@@ -377,14 +474,54 @@ const char *va(const char *fmt, ...)
 // fixes - temp
 #endif
 
+#define BL0942_PACKET_LEN 23
+#define BL0942_READ_COMMAND 0x58
+// default calibration values
+#define BL0942_PREF 598
+#define BL0942_UREF 15188
+#define BL0942_IREF 251210
+
+// this takes values like 230V, etc
+// and creates a fake BL0942 packet that is added to UART,
+// used by simulator BL0942 object, unit tests and fleet workload
+void Sim_SendFakeBL0942Packet(float v, float c, float p)
+{
+	byte data[BL0942_PACKET_LEN];
+	byte checksum = BL0942_READ_COMMAND;
+	int bl_current = (int)(BL0942_IREF * c);
+	int bl_power = (int)(BL0942_PREF * p);
+	int bl_voltage = (int)(BL0942_UREF * v);
+	int i;
+
+	memset(data, 0, sizeof(data));
+	data[0] = 0x55;
+	data[1] = (byte)(bl_current);
+	data[2] = (byte)(bl_current >> 8);
+	data[3] = (byte)(bl_current >> 16);
+	data[4] = (byte)(bl_voltage);
+	data[5] = (byte)(bl_voltage >> 8);
+	data[6] = (byte)(bl_voltage >> 16);
+	data[10] = (byte)(bl_power);
+	data[11] = (byte)(bl_power >> 8);
+	data[12] = (byte)(bl_power >> 16);
+	for (i = 0; i < BL0942_PACKET_LEN - 1; i++)
+	{
+		checksum += data[i];
+	}
+	checksum ^= 0xFF;
+	data[BL0942_PACKET_LEN - 1] = checksum;
+
+	for (i = 0; i < BL0942_PACKET_LEN; i++)
+	{
+		UART_AppendByteToReceiveRingBuffer(data[i]);
+	}
+}
+
 #if !ENABLE_SDL_WINDOW
 bool SIM_ReadDHT11(int pin, byte *data)
 {
 	return false;
 }
-void Sim_SendFakeBL0942Packet(float v, float c, float p)
-{
-}
 void SIM_GeneratePowerStateDesc(char *o, int outLen)
 {
 	*o = 0;
@@ -394,6 +531,12 @@ void SIM_GeneratePowerStateDesc(char *o, int outLen)
 int __cdecl main(int argc, char **argv)
 {
 	bool bWantsUnitTests = 1;
+	bool bWantsBenchmark = false;
+	const char *benchmarkJSON = 0;
+	bool bWantsListTests = false;
+	int parallelTestJobs = -1;
+	const char *testReport = 0;
+	bool bCompareFastForward = false;
 
 #ifndef LINUX
 	WSADATA wsaData;
@@ -448,6 +591,64 @@ int __cdecl main(int argc, char **argv)
 #endif
 					}
 				}
+				else if (wal_strnicmp(argv[i] + 1, "benchmarkJSON", 13) == 0)
+				{
+					i++;
+
+					if (i < argc)
+					{
+						bWantsBenchmark = true;
+						benchmarkJSON = argv[i];
+					}
+				}
+				else if (wal_strnicmp(argv[i] + 1, "benchmark", 9) == 0)
+				{
+					bWantsBenchmark = true;
+				}
+				else if (wal_strnicmp(argv[i] + 1, "noFastForward", 13) == 0)
+				{
+					g_bSimFastForward = false;
+				}
+				else if (wal_strnicmp(argv[i] + 1, "compareFastForward", 18) == 0)
+				{
+					// with -runUnitTestsParallel, runs every test with and without fast-forward
+					bCompareFastForward = true;
+				}
+				else if (wal_strnicmp(argv[i] + 1, "fleet", 5) == 0)
+				{
+					// -fleet N, -fleetSeconds S, -fleetMQTT host etc, see win_fleet.c
+					const char *option = argv[i] + 6;
+
+					i++;
+					if (Fleet_SetOption(option, i < argc ? argv[i] : 0) == false)
+					{
+						printf("Bad fleet option -fleet%s\n", option);
+						return 1;
+					}
+				}
+				else if (wal_strnicmp(argv[i] + 1, "runUnitTestsParallel", 20) == 0)
+				{
+					i++;
+
+					// 0 = as many jobs as CPU cores
+					if (i < argc && sscanf(argv[i], "%d", &value) == 1)
+					{
+						parallelTestJobs = value;
+					}
+				}
+				else if (wal_strnicmp(argv[i] + 1, "testReport", 10) == 0)
+				{
+					i++;
+
+					if (i < argc)
+					{
+						testReport = argv[i];
+					}
+				}
+				else if (wal_strnicmp(argv[i] + 1, "listTests", 9) == 0)
+				{
+					bWantsListTests = true;
+				}
 				else if (wal_strnicmp(argv[i] + 1, "runUnitTests", 12) == 0)
 				{
 					i++;
@@ -630,6 +831,31 @@ int __cdecl main(int argc, char **argv)
 	SIM_StartOBK(0);
 #endif
 
+	if (bWantsListTests)
+	{
+		const selfTestCase_t *tests;
+		int count;
+
+		tests = Win_GetUnitTests(&count);
+		for (int i = 0; i < count; i++)
+		{
+			printf("%s\n", tests[i].name);
+		}
+		return 0;
+	}
+	if (parallelTestJobs >= 0)
+	{
+		return SelfTest_RunParallel(parallelTestJobs, testReport, bCompareFastForward);
+	}
+	if (Fleet_IsEnabled())
+	{
+		return Fleet_Run();
+	}
+	if (bWantsBenchmark)
+	{
+		g_bDoingUnitTestsNow = 1;
+		return SIM_RunBenchmarks(benchmarkJSON);
+	}
 	if (g_selfTestsMode)
 	{
 		g_bDoingUnitTestsNow = 1;